@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include "cpu.h"
 #include "hlog.h"
 #include "os/assert.h"
 #include "os/mqueue.h"
@@ -30,6 +31,30 @@ struct mode_handler {
 	void *data;
 };
 
+/*
+ * Audio instances run concurrently, each with its own period and sample rate,
+ * and must use distinct SAI interfaces (enforced by play_pipeline_init()).
+ */
+#define AUDIO_MAX_INSTANCES	2
+#define AUDIO_MQUEUE_SIZE	(10 * AUDIO_MAX_INSTANCES)
+
+struct data_ctx;
+
+struct audio_instance {
+	struct data_ctx *ctx;
+	unsigned int id;
+
+	const struct mode_handler *handler;
+	void *handle;
+
+	unsigned int generation;	/* incremented at each run, tags the instance events */
+	unsigned int pending;	/* periods started, instance waiting to be run */
+	uint64_t deadline;	/* cpu counter, end of the first pending period */
+	uint64_t period_ticks;	/* cpu counter ticks per period */
+	uint64_t xrun;		/* periods not run in time, merged with the next one */
+	struct event event;	/* last event received */
+};
+
 struct data_ctx {
 	struct ivshmem mem;
 	struct mailbox mb;
@@ -37,8 +62,7 @@ struct data_ctx {
 	os_sem_t semaphore;
 	os_mqd_t mqueue;
 
-	const struct mode_handler *handler;
-	void *handle;
+	struct audio_instance instance[AUDIO_MAX_INSTANCES];
 };
 
 static struct play_pipeline_config play_pipeline_dtmf_config = {
@@ -57,6 +81,11 @@ static struct play_pipeline_config play_pipeline_full_config = {
 	.cfg = &pipeline_full_config,
 };
 
+/* Configuration loaded at run time, HRPN_CMD_TYPE_AUDIO_PIPELINE_LOAD */
+static struct play_pipeline_config play_pipeline_loaded_config = {
+	.cfg = NULL,
+};
+
 const static struct mode_handler handler[] =
 {
 	[0] = {
@@ -86,31 +115,111 @@ const static struct mode_handler handler[] =
 		.run = play_pipeline_run,
 		.stats = play_pipeline_stats,
 		.data = &play_pipeline_full_config,
+	},
+	[4] = {
+		.init = play_pipeline_init,
+		.exit = play_pipeline_exit,
+		.run = play_pipeline_run,
+		.stats = play_pipeline_stats,
+		.data = &play_pipeline_loaded_config,
 	}
 };
 
+static bool audio_instance_running(struct data_ctx *ctx)
+{
+	int i;
+
+	for (i = 0; i < AUDIO_MAX_INSTANCES; i++)
+		if (ctx->instance[i].handler)
+			return true;
+
+	return false;
+}
+
 static void data_send_event(void *userData, uint8_t status)
 {
-	os_mqd_t *mqueue = userData;
+	struct audio_instance *instance = userData;
 	struct event e;
 
 	e.type = EVENT_TYPE_TX_RX;
+	e.instance = instance->id;
+	e.generation = __atomic_load_n(&instance->generation, __ATOMIC_RELAXED);
+	e.time = os_cpu_counter();
 	e.data = status;
 
-	os_mq_send(mqueue, &e, OS_MQUEUE_FLAGS_ISR_CONTEXT, 0);
+	os_mq_send(&instance->ctx->mqueue, &e, OS_MQUEUE_FLAGS_ISR_CONTEXT, 0);
+}
+
+/* Called with semaphore held */
+static void audio_event_ready(struct data_ctx *ctx, struct event *e)
+{
+	struct audio_instance *instance;
+
+	if (e->instance >= AUDIO_MAX_INSTANCES)
+		return;
+
+	instance = &ctx->instance[e->instance];
+
+	/* stale event, from a stopped instance or from a previous run of the instance */
+	if (!instance->handler || (e->generation != instance->generation))
+		return;
+
+	/* the first pending period sets the deadline */
+	if (!instance->pending)
+		instance->deadline = e->time + instance->period_ticks;
+
+	instance->pending++;
+	instance->event = *e;
 }
 
+/* Called with semaphore held, returns the ready instance with the earliest deadline */
+static struct audio_instance *audio_instance_next(struct data_ctx *ctx)
+{
+	struct audio_instance *next = NULL, *instance;
+	int i;
+
+	for (i = 0; i < AUDIO_MAX_INSTANCES; i++) {
+		instance = &ctx->instance[i];
+
+		if (!instance->pending)
+			continue;
+
+		if (!next || ((int64_t)(instance->deadline - next->deadline) < 0))
+			next = instance;
+	}
+
+	return next;
+}
+
+/*
+ * Earliest deadline first scheduling of the audio instances. Instances are
+ * not preempted: once the ready instance with the earliest deadline is run,
+ * the events received meanwhile are collected and the next instance picked.
+ * A short period instance is delayed at most by one run of the others.
+ * An instance with several pending periods (run too late) is run once, the
+ * other periods are counted as xruns.
+ */
 void audio_process_data(void *context)
 {
 	struct data_ctx *ctx = context;
+	struct audio_instance *instance;
 	struct event e;
 
 	if (!os_mq_receive(&ctx->mqueue, &e, 0, OS_QUEUE_EVENT_TIMEOUT_MAX)) {
 
 		os_sem_take(&ctx->semaphore, 0, OS_SEM_TIMEOUT_MAX);
 
-		if (ctx->handler)
-			ctx->handler->run(ctx->handle, &e);
+		audio_event_ready(ctx, &e);
+
+		while ((instance = audio_instance_next(ctx))) {
+			instance->xrun += instance->pending - 1;
+			instance->pending = 0;
+
+			instance->handler->run(instance->handle, &instance->event);
+
+			while (!os_mq_receive(&ctx->mqueue, &e, 0, 0))
+				audio_event_ready(ctx, &e);
+		}
 
 		os_sem_give(&ctx->semaphore, 0);
 	}
@@ -118,8 +227,17 @@ void audio_process_data(void *context)
 
 static void audio_stats(struct data_ctx *ctx)
 {
-	if (ctx->handler)
-		ctx->handler->stats(ctx->handle);
+	struct audio_instance *instance;
+	int i;
+
+	for (i = 0; i < AUDIO_MAX_INSTANCES; i++) {
+		instance = &ctx->instance[i];
+
+		if (instance->handler) {
+			log_info("instance %u, xrun: %llu\n", instance->id, instance->xrun);
+			instance->handler->stats(instance->handle);
+		}
+	}
 }
 
 static void response(struct mailbox *m, uint32_t status)
@@ -131,34 +249,73 @@ static void response(struct mailbox *m, uint32_t status)
 	mailbox_resp_send(m, &resp, sizeof(resp));
 }
 
+static void pipeline_response(struct mailbox *m, uint32_t status)
+{
+	struct hrpn_resp_audio_pipeline resp;
+
+	resp.type = HRPN_RESP_TYPE_AUDIO_PIPELINE;
+	resp.status = status;
+	mailbox_resp_send(m, &resp, sizeof(resp));
+}
+
+/*
+ * The handler init() and exit() run on the control thread, without the
+ * semaphore, while the data task may run the other instance: they only touch
+ * resources the data task doesn't use for the other instance.
+ * - SAI interfaces, their interrupt, codec and clock root: owned by a single
+ *   instance (play_pipeline_init() refuses a SAI used by a running pipeline).
+ *   The audio PLL frequency, adjusted by a running pll element, is only read.
+ * - Used SAI mask and pipeline table: only accessed from the control thread.
+ * - Pipeline configuration: each instance works on its own copy.
+ * - Audio workers: only used from the data task, by pipeline runs.
+ * The instance is only published to the data task, under the semaphore,
+ * once its handler is initialized.
+ */
 static int audio_run(struct data_ctx *ctx, struct hrpn_cmd_audio_run *run)
 {
 	int rc = HRPN_RESP_STATUS_ERROR;
+	struct audio_instance *instance;
 	struct audio_config cfg;
 	struct event e;
+	void *handle;
 
-	if (ctx->handler)
+	if (run->instance >= AUDIO_MAX_INSTANCES)
+		goto exit;
+
+	instance = &ctx->instance[run->instance];
+
+	if (instance->handler)
 		goto exit;
 
 	if (run->id >= ARRAY_SIZE(handler) || !handler[run->id].init)
 		goto exit;
 
+	/* events of the previous runs, still queued, are now stale */
+	__atomic_store_n(&instance->generation, instance->generation + 1, __ATOMIC_RELAXED);
+
 	cfg.event_send = data_send_event;
-	cfg.event_data = &ctx->mqueue;
+	cfg.event_data = instance;
 	cfg.rate = run->frequency;
 	cfg.period = run->period;
 	cfg.data = handler[run->id].data;
 
-	ctx->handle = handler[run->id].init(&cfg);
-	if (!ctx->handle)
+	handle = handler[run->id].init(&cfg);
+	if (!handle)
 		goto exit;
 
 	os_sem_take(&ctx->semaphore, 0, OS_SEM_TIMEOUT_MAX);
-	ctx->handler = &handler[run->id];
+	instance->handle = handle;
+	instance->period_ticks = ((uint64_t)cfg.period * os_cpu_counter_freq()) / cfg.rate;
+	instance->pending = 0;
+	instance->xrun = 0;
+	instance->handler = &handler[run->id];
 	os_sem_give(&ctx->semaphore, 0);
 
 	/* Send an event to trigger data thread processing */
 	e.type = EVENT_TYPE_START;
+	e.instance = instance->id;
+	e.generation = instance->generation;
+	e.time = os_cpu_counter();
 	os_mq_send(&ctx->mqueue, &e, 0, 0);
 
 	rc = HRPN_RESP_STATUS_SUCCESS;
@@ -167,24 +324,71 @@ exit:
 	return rc;
 }
 
-static int audio_stop(struct data_ctx *ctx)
+static int audio_stop(struct data_ctx *ctx, struct hrpn_cmd_audio_stop *stop)
 {
 	const struct mode_handler *handler;
+	struct audio_instance *instance;
+
+	if (stop->instance >= AUDIO_MAX_INSTANCES)
+		return HRPN_RESP_STATUS_ERROR;
 
-	if (!ctx->handler)
+	instance = &ctx->instance[stop->instance];
+
+	if (!instance->handler)
 		goto exit;
 
 	os_sem_take(&ctx->semaphore, 0, OS_SEM_TIMEOUT_MAX);
-	handler = ctx->handler;
-	ctx->handler = NULL;
+	handler = instance->handler;
+	instance->handler = NULL;
+	instance->pending = 0;
 	os_sem_give(&ctx->semaphore, 0);
 
-	handler->exit(ctx->handle);
+	handler->exit(instance->handle);
 
 exit:
 	return HRPN_RESP_STATUS_SUCCESS;
 }
 
+static int audio_pipeline_load(struct data_ctx *ctx, struct hrpn_cmd_audio_pipeline_load *load)
+{
+	struct audio_pipeline_config *config;
+	int rc = HRPN_RESP_STATUS_ERROR;
+	void *data;
+
+	/* A running pipeline may reference the current configuration */
+	if (audio_instance_running(ctx))
+		goto exit;
+
+	if ((ctx->mem.out_size < HRPN_AUDIO_PIPELINE_CONFIG_OFFSET) ||
+	    (load->size > ctx->mem.out_size - HRPN_AUDIO_PIPELINE_CONFIG_OFFSET)) {
+		log_err("invalid pipeline configuration size %u\n", load->size);
+		goto exit;
+	}
+
+	config = os_malloc(sizeof(*config) + load->size);
+	if (!config)
+		goto exit;
+
+	/* Work on a private copy, the shared memory can be updated at any time */
+	data = config + 1;
+	memcpy(data, (uint8_t *)ctx->mem.out[0] + HRPN_AUDIO_PIPELINE_CONFIG_OFFSET, load->size);
+
+	if (audio_pipeline_config_load(config, data, load->size) < 0) {
+		os_free(config);
+		goto exit;
+	}
+
+	if (play_pipeline_loaded_config.cfg)
+		os_free((void *)play_pipeline_loaded_config.cfg);
+
+	play_pipeline_loaded_config.cfg = config;
+
+	rc = HRPN_RESP_STATUS_SUCCESS;
+
+exit:
+	return rc;
+}
+
 static void audio_command_handler(struct data_ctx *ctx)
 {
 	struct hrpn_command cmd;
@@ -215,16 +419,33 @@ static void audio_command_handler(struct data_ctx *ctx)
 			break;
 		}
 
-		rc = audio_stop(ctx);
+		rc = audio_stop(ctx, &cmd.u.audio_stop);
 
 		response(m, rc);
 
 		break;
 
+	case HRPN_CMD_TYPE_AUDIO_PIPELINE_LOAD:
+		if (len != sizeof(struct hrpn_cmd_audio_pipeline_load)) {
+			pipeline_response(m, HRPN_RESP_STATUS_ERROR);
+			break;
+		}
+
+		rc = audio_pipeline_load(ctx, &cmd.u.audio_pipeline_load);
+
+		pipeline_response(m, rc);
+
+		break;
+
 	case HRPN_CMD_TYPE_AUDIO_PIPELINE_DUMP:
+	case HRPN_CMD_TYPE_AUDIO_PIPELINE_PROFILE:
 	case HRPN_CMD_TYPE_AUDIO_ELEMENT_DUMP:
 	case HRPN_CMD_TYPE_AUDIO_ELEMENT_ROUTING_CONNECT:
 	case HRPN_CMD_TYPE_AUDIO_ELEMENT_ROUTING_DISCONNECT:
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_BIQUAD_SET:
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_MIXER_SET:
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_DETECTOR_READ:
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_LATENCY_READ:
 		audio_pipeline_ctrl(&cmd.u.audio_pipeline, len, m);
 
 		break;
@@ -262,7 +483,7 @@ void audio_control_loop(void *context)
 
 void *audio_control_init(void)
 {
-	int err;
+	int err, i;
 	struct data_ctx *audio_ctx;
 	struct ivshmem *mem;
 
@@ -281,8 +502,13 @@ void *audio_control_init(void)
 	err = os_sem_init(&audio_ctx->semaphore, 1);
 	os_assert(!err, "semaphore initialization failed!");
 
-	err = os_mq_open(&audio_ctx->mqueue, "audio_mqueue", 10, sizeof(struct event));
+	err = os_mq_open(&audio_ctx->mqueue, "audio_mqueue", AUDIO_MQUEUE_SIZE, sizeof(struct event));
 	os_assert(!err, "message queue initialization failed!");
 
+	for (i = 0; i < AUDIO_MAX_INSTANCES; i++) {
+		audio_ctx->instance[i].ctx = audio_ctx;
+		audio_ctx->instance[i].id = i;
+	}
+
 	return audio_ctx;
 }
@@ -13,8 +13,8 @@ struct play_pipeline_config {
 };
 
 struct audio_config {
-	uint32_t rate;
-	uint32_t period;
+	uint32_t rate;		/* 0 for default, effective rate on init return */
+	uint32_t period;	/* 0 for default, effective period on init return */
 
 	void (*event_send)(void *, uint8_t);
 	void *event_data;
@@ -24,6 +24,9 @@ struct audio_config {
 
 struct event {
 	unsigned int type;
+	unsigned int instance;	/* audio instance the event is for */
+	unsigned int generation;	/* audio instance run the event is for */
+	uint64_t time;		/* cpu counter, when the event was sent */
 	uintptr_t data;
 };
 
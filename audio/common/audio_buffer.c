@@ -11,34 +11,33 @@
  * Audio buffer structure (circular) with single writter/reader.
  * Audio buffer uses linear memory storage.
  * When configuring pipeline, it's possible to re-use storage (and avoid memory copies).
- * Audio buffer has a compile time fixed sample format (64bit, double). Format conversion done in source/sink elements.
+ * At run time, a buffer can also be a view of another buffer storage (and avoid memory copies), see audio_buf_view().
+ * Audio buffer has a compile time fixed sample format (double, float or int32, see audio_format.h). Format conversion done in source/sink elements.
  * Audio buffer api's/variables all in sample units
  * Audio buffer size is a power of two.
  *
- * Many possible optimizations:
- * - Make all functions below, used in the data path, static inline (and move to header file)
- * - Make buffer size always a multiple of the processing period, if user(s) of the buffer always reads/writes full periods,
- *   then there is no need to check for read/write pointer wrap at each sample, only at the end.
- * - Add minimum alignment for audio buffer (at least frame aligned)
- * - Make buffer size always a power of two (in frame units), so all pointer wrapping can be done with a mask
- * - When copying data
- * 	a) unroll loops for small copies (e.g. 2, 4, 8 samples)
- * 	b) use inline assembly with floating point registers (up to 128bits copied per instruction)
- * 	c) use memcpy for big copies ( > 32 samples ?)
+ * Audio buffer storage is cache line aligned, and its size a multiple of the processing period.
+ * Data path read/write functions are static inline (see audio_buffer.h), copies are split at most once
+ * at the buffer wrap point. Small copies are unrolled, big copies ( > AUDIO_MEMCPY_MIN samples) use memcpy.
+ *
+ * Possible optimizations:
+ * - use inline assembly with floating point registers (up to 128bits copied per instruction)
  *
 */
 void audio_buf_dump(struct audio_buffer *buf)
 {
-	log_info("buf(%p): base %p, size %x/%x, read %x, write %x\n",
-		  buf, buf->base, buf->size, buf->size_mask, buf->read, buf->write);
+	log_info("buf(%p): base %p, storage %p, size %x/%x, read %x, write %x\n",
+		  buf, buf->base, buf->storage, buf->size, buf->size_mask, buf->read, buf->write);
 }
 
 void audio_buf_init(struct audio_buffer *buf, audio_sample_t *base, unsigned int size)
 {
 	buf->base = base;
+	buf->storage = base;
 	buf->size = size;
 	buf->read = 0;
 	buf->write = 0;
+	buf->parallel = false;
 
 	buf->size_mask = 0;
 	while ((size >>= 1))
@@ -72,35 +71,3 @@ bool audio_buf_empty(struct audio_buffer *buf)
 {
 	return (buf->read == buf->write);
 }
-
-void audio_buf_write(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len)
-{
-	int i;
-
-	for (i = 0; i < len; i++) {
-		buf->base[buf->write] = samples[i];
-		buf->write = (buf->write + 1) & buf->size_mask;
-	}
-}
-
-void audio_buf_write_head(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len)
-{
-	unsigned int read;
-	int i;
-
-	read = buf->read = (buf->read - len) & buf->size_mask;
-	for (i = 0; i < len; i++) {
-		buf->base[read] = samples[i];
-		read  = (read + 1) & buf->size_mask;
-	}
-}
-
-void audio_buf_read(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len)
-{
-	int i;
-
-	for (i = 0; i < len; i++) {
-		samples[i] = buf->base[buf->read];
-		buf->read = (buf->read + 1) & buf->size_mask;
-	}
-}
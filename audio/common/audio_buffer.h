@@ -10,9 +10,16 @@
 #include "os/stdint.h"
 #include "os/stdbool.h"
 #include "os/stdio.h"
+#include "os/string.h"
 
 #include "audio_format.h"
 
+/* Buffer storage alignment, in bytes (cache line size) */
+#define AUDIO_BUFFER_ALIGN	64
+
+/* Copies of more samples than this use the C library memcpy() */
+#define AUDIO_MEMCPY_MIN	32
+
 /* Configuration */
 struct audio_buffer_config {
 	unsigned int storage;	/* storage array index */
@@ -25,11 +32,13 @@ struct audio_buffer_storage_config {
 
 /* Run Time */
 struct audio_buffer {
-	audio_sample_t *base;
+	audio_sample_t *base;	/* current storage, own storage or a view of another buffer storage */
+	audio_sample_t *storage;	/* own storage */
 	unsigned int read;	/* in units of samples */
 	unsigned int write;	/* in units of samples */
 	unsigned int size;	/* in units of samples */
 	unsigned int size_mask;
+	bool parallel;	/* writer and reader run in parallel (no views) */
 };
 
 void audio_buf_init(struct audio_buffer *buf, audio_sample_t *base, unsigned int size);
@@ -37,9 +46,6 @@ unsigned int audio_buf_avail(struct audio_buffer *buf);
 unsigned int audio_buf_free(struct audio_buffer *buf);
 bool audio_buf_full(struct audio_buffer *buf);
 bool audio_buf_empty(struct audio_buffer *buf);
-void audio_buf_write(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len);
-void audio_buf_write_head(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len);
-void audio_buf_read(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len);
 void audio_buf_dump(struct audio_buffer *buf);
 
 static inline void __audio_memcpy(audio_sample_t *dst, audio_sample_t *src, unsigned int len)
@@ -75,7 +81,19 @@ static inline void __audio_memcpy(audio_sample_t *dst, audio_sample_t *src, unsi
 		break;
 
 	default:
-		for (i = 0; i < len; i++)
+		if (len > AUDIO_MEMCPY_MIN) {
+			memcpy(dst, src, len * sizeof(audio_sample_t));
+			break;
+		}
+
+		for (i = 0; i + 4 <= len; i += 4) {
+			dst[i] = src[i];
+			dst[i + 1] = src[i + 1];
+			dst[i + 2] = src[i + 2];
+			dst[i + 3] = src[i + 3];
+		}
+
+		for (; i < len; i++)
 			dst[i] = src[i];
 
 		break;
@@ -135,8 +153,125 @@ static inline void audio_buf_read_update(struct audio_buffer *buf, unsigned int
 	buf->read = read;
 }
 
+/*
+ * Buffer views
+ *
+ * A buffer can temporarily alias (view) the storage of another buffer, for
+ * the next period to be read from it, instead of getting a copy of the data.
+ * The view is only created if the buffer is empty, so that it never
+ * contains samples outside of the aliased period (the buffer indexes are
+ * then restarted at the view start).
+ * The source buffer storage must be big enough so that the aliased period
+ * is not overwritten until the view is consumed (at least two periods).
+ * The view is released (any pending samples copied back to the buffer own
+ * storage) before the buffer is written with a copy, or its head written.
+ */
+static inline bool audio_buf_view(struct audio_buffer *dst, struct audio_buffer *src, unsigned int len)
+{
+	if (dst->parallel || (dst->read != dst->write))
+		return false;
+
+	if ((src->read + len > src->size) || (len >= dst->size))
+		return false;
+
+	dst->base = &src->base[src->read];
+	dst->read = 0;
+	dst->write = len;
+
+	return true;
+}
+
+static inline void audio_buf_view_release(struct audio_buffer *buf)
+{
+	unsigned int read, len;
+
+	if (buf->base == buf->storage)
+		return;
+
+	/* pending samples are contiguous, from read to the end of the view */
+	read = buf->read;
+	len = (buf->write - read) & buf->size_mask;
+
+	if (len)
+		__audio_memcpy(&buf->storage[read], &buf->base[read], len);
+
+	buf->base = buf->storage;
+}
+
+/*
+ * Ring buffer copies, split (at most once) at the buffer wrap point.
+ * len must be smaller than the buffer size.
+ */
+static inline void audio_buf_write(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len)
+{
+	unsigned int write, n;
+
+	audio_buf_view_release(buf);
+
+	write = buf->write;
+	n = buf->size - write;
+
+	if (len <= n) {
+		__audio_memcpy(&buf->base[write], samples, len);
+	} else {
+		__audio_memcpy(&buf->base[write], samples, n);
+		__audio_memcpy(buf->base, samples + n, len - n);
+	}
+
+	buf->write = (write + len) & buf->size_mask;
+}
+
+static inline void audio_buf_write_silence(struct audio_buffer *buf, unsigned int len)
+{
+	unsigned int write, i;
+
+	audio_buf_view_release(buf);
+
+	write = buf->write;
+
+	for (i = 0; i < len; i++)
+		buf->base[(write + i) & buf->size_mask] = AUDIO_SAMPLE_SILENCE;
+
+	buf->write = (write + len) & buf->size_mask;
+}
+
+static inline void audio_buf_write_head(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len)
+{
+	unsigned int read, n;
+
+	audio_buf_view_release(buf);
+
+	read = (buf->read - len) & buf->size_mask;
+	n = buf->size - read;
+
+	if (len <= n) {
+		__audio_memcpy(&buf->base[read], samples, len);
+	} else {
+		__audio_memcpy(&buf->base[read], samples, n);
+		__audio_memcpy(buf->base, samples + n, len - n);
+	}
+
+	buf->read = read;
+}
+
+static inline void audio_buf_read(struct audio_buffer *buf, audio_sample_t *samples, unsigned int len)
+{
+	unsigned int read = buf->read;
+	unsigned int n = buf->size - read;
+
+	if (len <= n) {
+		__audio_memcpy(samples, &buf->base[read], len);
+	} else {
+		__audio_memcpy(samples, &buf->base[read], n);
+		__audio_memcpy(samples + n, buf->base, len - n);
+	}
+
+	buf->read = (read + len) & buf->size_mask;
+}
+
 static inline void audio_buf_reset(struct audio_buffer *buf)
 {
+	buf->base = buf->storage;
 	buf->read = 0;
 	buf->write = 0;
 }
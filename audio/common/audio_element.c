@@ -6,6 +6,7 @@
 
 #include "audio_element.h"
 #include "audio_pipeline.h"
+#include "cpu.h"
 #include "hrpn_ctrl.h"
 #include "hlog.h"
 #include "mailbox.h"
@@ -50,6 +51,22 @@ int audio_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_elem
 		rc = pll_element_ctrl(element, &cmd->u.pll, len, m);
 		break;
 
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_BIQUAD_SET:
+		rc = biquad_element_ctrl(element, &cmd->u.biquad, len, m);
+		break;
+
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_MIXER_SET:
+		rc = mixer_element_ctrl(element, &cmd->u.mixer, len, m);
+		break;
+
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_DETECTOR_READ:
+		rc = detector_element_ctrl(element, &cmd->u.detector, len, m);
+		break;
+
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_LATENCY_READ:
+		rc = latency_element_ctrl(element, &cmd->u.latency, len, m);
+		break;
+
 	default:
 		goto err;
 		break;
@@ -80,6 +97,119 @@ void audio_element_stats(struct audio_element *element)
 		element->stats(element);
 }
 
+#ifdef AUDIO_ELEMENT_PROFILE
+int audio_element_run_profile(struct audio_element *element)
+{
+	struct audio_element_profile *profile = &element->profile;
+	uint64_t start, cost;
+	int rc;
+
+	start = os_cpu_counter();
+
+	rc = element->run(element);
+
+	cost = os_cpu_counter() - start;
+
+	stats_update(&profile->stats, cost);
+	hist_update(&profile->hist, cost);
+
+	return rc;
+}
+
+void audio_element_profile_dump(struct audio_element *element)
+{
+	struct audio_element_profile *profile = &element->profile;
+
+	log_info("element(%p): type %u, run time (ticks) min %d mean %d max %d absmax %d\n",
+		 element, element->type, profile->stats.min, profile->stats.mean,
+		 profile->stats.max, profile->stats.abs_max);
+
+	hist_print(&profile->hist);
+}
+
+static void audio_element_profile_init(struct audio_element *element)
+{
+	struct audio_element_profile *profile = &element->profile;
+	unsigned int slot_size = 0;
+
+	/* histogram spans one period, last slot counts the overruns */
+	if (element->sample_rate)
+		slot_size = ((uint64_t)element->period * os_cpu_counter_freq()) /
+			    ((uint64_t)element->sample_rate * AUDIO_ELEMENT_PROFILE_SLOTS);
+
+	if (!slot_size)
+		slot_size = 1;
+
+	stats_init(&profile->stats, AUDIO_ELEMENT_PROFILE_LOG2_SIZE, NULL, NULL);
+	hist_init(&profile->hist, AUDIO_ELEMENT_PROFILE_SLOTS, slot_size);
+}
+#endif
+
+int audio_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	int rc;
+
+	switch (config->type) {
+	case AUDIO_ELEMENT_DTMF_SOURCE:
+		rc = dtmf_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_PLL:
+		rc = pll_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_ROUTING:
+		rc = routing_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_SAI_SINK:
+		rc = sai_sink_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_SAI_SOURCE:
+		rc = sai_source_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_SINE_SOURCE:
+		rc = sine_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_SRC:
+		rc = src_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_ASRC:
+		rc = asrc_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_BIQUAD:
+		rc = biquad_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_FIR:
+		rc = fir_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_MIXER:
+		rc = mixer_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_DETECTOR:
+		rc = detector_element_config_load(config, params, size);
+		break;
+
+	case AUDIO_ELEMENT_LATENCY:
+		rc = latency_element_config_load(config, params, size);
+		break;
+
+	default:
+		rc = -1;
+		break;
+	}
+
+	return rc;
+}
+
 int audio_element_check_config(struct audio_element_config *config)
 {
 	int rc;
@@ -109,6 +239,34 @@ int audio_element_check_config(struct audio_element_config *config)
 		rc = sine_element_check_config(config);
 		break;
 
+	case AUDIO_ELEMENT_SRC:
+		rc = src_element_check_config(config);
+		break;
+
+	case AUDIO_ELEMENT_ASRC:
+		rc = asrc_element_check_config(config);
+		break;
+
+	case AUDIO_ELEMENT_BIQUAD:
+		rc = biquad_element_check_config(config);
+		break;
+
+	case AUDIO_ELEMENT_FIR:
+		rc = fir_element_check_config(config);
+		break;
+
+	case AUDIO_ELEMENT_MIXER:
+		rc = mixer_element_check_config(config);
+		break;
+
+	case AUDIO_ELEMENT_DETECTOR:
+		rc = detector_element_check_config(config);
+		break;
+
+	case AUDIO_ELEMENT_LATENCY:
+		rc = latency_element_check_config(config);
+		break;
+
 	default:
 		rc = -1;
 		break;
@@ -146,6 +304,34 @@ unsigned int audio_element_data_size(struct audio_element_config *config)
 		size = sine_element_size(config);
 		break;
 
+	case AUDIO_ELEMENT_SRC:
+		size = src_element_size(config);
+		break;
+
+	case AUDIO_ELEMENT_ASRC:
+		size = asrc_element_size(config);
+		break;
+
+	case AUDIO_ELEMENT_BIQUAD:
+		size = biquad_element_size(config);
+		break;
+
+	case AUDIO_ELEMENT_FIR:
+		size = fir_element_size(config);
+		break;
+
+	case AUDIO_ELEMENT_MIXER:
+		size = mixer_element_size(config);
+		break;
+
+	case AUDIO_ELEMENT_DETECTOR:
+		size = detector_element_size(config);
+		break;
+
+	case AUDIO_ELEMENT_LATENCY:
+		size = latency_element_size(config);
+		break;
+
 	default:
 		size = 0;
 		break;
@@ -189,11 +375,43 @@ int audio_element_init(struct audio_element *element, struct audio_element_confi
 		rc = sine_element_init(element, config, buffer);
 		break;
 
+	case AUDIO_ELEMENT_SRC:
+		rc = src_element_init(element, config, buffer);
+		break;
+
+	case AUDIO_ELEMENT_ASRC:
+		rc = asrc_element_init(element, config, buffer);
+		break;
+
+	case AUDIO_ELEMENT_BIQUAD:
+		rc = biquad_element_init(element, config, buffer);
+		break;
+
+	case AUDIO_ELEMENT_FIR:
+		rc = fir_element_init(element, config, buffer);
+		break;
+
+	case AUDIO_ELEMENT_MIXER:
+		rc = mixer_element_init(element, config, buffer);
+		break;
+
+	case AUDIO_ELEMENT_DETECTOR:
+		rc = detector_element_init(element, config, buffer);
+		break;
+
+	case AUDIO_ELEMENT_LATENCY:
+		rc = latency_element_init(element, config, buffer);
+		break;
+
 	default:
 		rc = -1;
 		break;
 	}
 
+#ifdef AUDIO_ELEMENT_PROFILE
+	audio_element_profile_init(element);
+#endif
+
 	log_info("done\n");
 
 	return rc;
@@ -7,15 +7,26 @@
 #ifndef _AUDIO_ELEMENT_H_
 #define _AUDIO_ELEMENT_H_
 
+#include "audio_element_asrc.h"
+#include "audio_element_biquad.h"
+#include "audio_element_detector.h"
 #include "audio_element_dtmf.h"
+#include "audio_element_fir.h"
+#include "audio_element_latency.h"
+#include "audio_element_mixer.h"
 #include "audio_element_pll.h"
 #include "audio_element_routing.h"
 #include "audio_element_sai_sink.h"
 #include "audio_element_sai_source.h"
 #include "audio_element_sine.h"
+#include "audio_element_src.h"
 
 #include "hrpn_ctrl_audio_pipeline.h"
 
+#ifdef AUDIO_ELEMENT_PROFILE
+#include "stats.h"
+#endif
+
 #define AUDIO_ELEMENT_MAX_INPUTS	64
 #define AUDIO_ELEMENT_MAX_OUTPUTS	64
 
@@ -26,6 +37,13 @@ enum {
 	AUDIO_ELEMENT_SAI_SOURCE,
 	AUDIO_ELEMENT_SINE_SOURCE,
 	AUDIO_ELEMENT_PLL,
+	AUDIO_ELEMENT_SRC,
+	AUDIO_ELEMENT_ASRC,
+	AUDIO_ELEMENT_BIQUAD,
+	AUDIO_ELEMENT_FIR,
+	AUDIO_ELEMENT_MIXER,
+	AUDIO_ELEMENT_DETECTOR,
+	AUDIO_ELEMENT_LATENCY,
 };
 
 /* Configuration */
@@ -42,16 +60,34 @@ struct audio_element_config {
 	unsigned int sample_rate;
 
 	union {
+		struct asrc_element_config asrc;
+		struct biquad_element_config biquad;
+		struct detector_element_config detector;
 		struct dtmf_element_config dtmf;
+		struct fir_element_config fir;
+		struct latency_element_config latency;
+		struct mixer_element_config mixer;
 		struct pll_element_config pll;
 		struct routing_element_config routing;
 		struct sai_sink_element_config sai_sink;
 		struct sai_source_element_config sai_source;
 		struct sine_element_config sine;
+		struct src_element_config src;
 	} u;
 };
 
 /* Run Time */
+#ifdef AUDIO_ELEMENT_PROFILE
+#define AUDIO_ELEMENT_PROFILE_LOG2_SIZE	10	/* stats window, 2^n periods */
+#define AUDIO_ELEMENT_PROFILE_SLOTS	32	/* histogram slots, spanning one period */
+
+/* Execution time of the element run function, in cpu counter ticks */
+struct audio_element_profile {
+	struct stats stats;
+	struct hist hist;
+};
+#endif
+
 struct audio_element {
 	void *data;
 
@@ -64,6 +100,13 @@ struct audio_element {
 	void(*exit)(struct audio_element *element);
 	void(*dump)(struct audio_element *element);
 	void(*stats)(struct audio_element *element);
+
+	/* optional, called from interrupt context at each fifo period (see audio_pipeline_pump()) */
+	void(*pump)(struct audio_element *element);
+
+#ifdef AUDIO_ELEMENT_PROFILE
+	struct audio_element_profile profile;
+#endif
 };
 
 struct mailbox;
@@ -72,13 +115,23 @@ int audio_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_elem
 void audio_element_exit(struct audio_element *element);
 void audio_element_dump(struct audio_element *element);
 void audio_element_stats(struct audio_element *element);
+int audio_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
 int audio_element_check_config(struct audio_element_config *config);
 unsigned int audio_element_data_size(struct audio_element_config *config);
 int audio_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
 
+#ifdef AUDIO_ELEMENT_PROFILE
+int audio_element_run_profile(struct audio_element *element);
+void audio_element_profile_dump(struct audio_element *element);
+#endif
+
 static inline int audio_element_run(struct audio_element *element)
 {
+#ifdef AUDIO_ELEMENT_PROFILE
+	return audio_element_run_profile(element);
+#else
 	return element->run(element);
+#endif
 }
 
 static inline void audio_element_reset(struct audio_element *element)
@@ -0,0 +1,334 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/string.h"
+
+#include "audio_element_asrc.h"
+#include "audio_element.h"
+#include "audio_buffer.h"
+#include "audio_src.h"
+#include "hlog.h"
+
+#include "sai_drv.h"
+
+/*
+ * Asynchronous sample rate converter
+ *
+ * The pipeline runs at the src sai rate, the output is consumed at the dst
+ * sai rate. The ratio between both is measured with the sai bit clock
+ * counters (like the pll element), assuming both sai use the same frame
+ * format. Since the start (or the last reset), the dst sai consumed
+ * input frames * dst bit clocks / src bit clocks frames. Each period the
+ * element outputs the difference with the frames it already produced
+ * (period or period +/- 1), so the sink fifo level stays constant, and the
+ * resampling step follows the measured ratio.
+ */
+#define ASRC_SAMPLING_PERIOD_MS	10
+#define ASRC_LOCK_INTERVALS	10		/* bit clock samples before the first estimate */
+#define ASRC_MAX_PPM		1000		/* ratio deviation from nominal */
+#define ASRC_MAX_BCLK		(1ULL << 31)	/* bit clocks before rebasing the measure */
+#define ASRC_LEVEL_SHIFT	20		/* input fifo level correction, 2^-n (about 1 ppm) per sample */
+
+struct asrc_element {
+	struct audio_buffer *in[AUDIO_SRC_MAX_CHANNELS];
+	struct audio_buffer *out[AUDIO_SRC_MAX_CHANNELS];
+
+	void *src_sai;
+	void *dst_sai;
+
+	unsigned int input_rate;
+
+	unsigned int interval;	/* periods between bit clock samples */
+	unsigned int count;
+	unsigned int samples;	/* bit clock samples since origin */
+
+	uint32_t src_bcr;
+	uint32_t dst_bcr;
+	uint64_t src_bclk;	/* since origin */
+	uint64_t dst_bclk;
+
+	uint64_t frames;	/* input frames since origin */
+	uint64_t out_origin;	/* output frames at origin */
+	uint64_t out_frames;	/* output frames produced */
+
+	uint64_t ratio_nominal;	/* output / input frames, Q32 */
+	uint64_t ratio;
+	bool locked;
+
+	struct audio_src src;
+
+	struct {
+		uint64_t underrun;
+		uint64_t unlock;
+	} stats;
+};
+
+static void asrc_element_origin(struct asrc_element *asrc)
+{
+	asrc->samples = 0;
+	asrc->src_bclk = 0;
+	asrc->dst_bclk = 0;
+	asrc->out_origin = asrc->out_frames;
+	asrc->frames = 0;
+	asrc->count = asrc->interval;
+}
+
+static void asrc_element_step(struct asrc_element *asrc)
+{
+	struct audio_src *src = &asrc->src;
+	uint64_t step = UINT64_MAX / asrc->ratio;
+	int level = (int)src->fifo_len - (int)src->prefill;
+
+	/* input fifo level correction, consume faster if input accumulates */
+	audio_src_set_step(src, step + (int64_t)(step >> ASRC_LEVEL_SHIFT) * level);
+}
+
+/* Bit clock ratio estimate, cumulative since the origin */
+static void asrc_element_estimate(struct asrc_element *asrc)
+{
+	uint32_t src_bcr, dst_bcr, mask;
+	uint64_t ratio, delta;
+
+	asrc->count++;
+	if (asrc->count < asrc->interval)
+		return;
+
+	asrc->count = 0;
+
+	mask = DisableGlobalIRQ();
+	src_bcr = __sai_rx_bitclock(asrc->src_sai);
+	dst_bcr = __sai_rx_bitclock(asrc->dst_sai);
+	EnableGlobalIRQ(mask);
+
+	if (asrc->samples) {
+		asrc->src_bclk += src_bcr - asrc->src_bcr;
+		asrc->dst_bclk += dst_bcr - asrc->dst_bcr;
+	} else {
+		/* origin, frames are counted from the first sample */
+		asrc->out_origin = asrc->out_frames;
+		asrc->frames = 0;
+	}
+
+	asrc->src_bcr = src_bcr;
+	asrc->dst_bcr = dst_bcr;
+	asrc->samples++;
+
+	if ((asrc->samples <= ASRC_LOCK_INTERVALS) || !asrc->src_bclk)
+		return;
+
+	ratio = (asrc->dst_bclk << 32) / asrc->src_bclk;
+
+	delta = (ratio > asrc->ratio_nominal) ? ratio - asrc->ratio_nominal : asrc->ratio_nominal - ratio;
+	if (delta > (asrc->ratio_nominal * ASRC_MAX_PPM) / 1000000) {
+		/* dst sai stopped, or different frame formats */
+		if (asrc->locked)
+			asrc->stats.unlock++;
+
+		asrc->locked = false;
+		asrc->ratio = asrc->ratio_nominal;
+		asrc_element_origin(asrc);
+		return;
+	}
+
+	asrc->ratio = ratio;
+	asrc->locked = true;
+
+	/* restart the measure before the bit clock counts overflow the ratio computation */
+	if ((asrc->src_bclk >= ASRC_MAX_BCLK) || (asrc->dst_bclk >= ASRC_MAX_BCLK))
+		asrc_element_origin(asrc);
+}
+
+static int asrc_element_run(struct audio_element *element)
+{
+	struct asrc_element *asrc = element->data;
+	uint64_t target;
+	unsigned int n, done, c;
+
+	asrc_element_estimate(asrc);
+
+	asrc->frames += element->period;
+
+	/* frames consumed by the dst sai since the origin */
+	target = asrc->out_origin + ((asrc->frames * asrc->ratio) >> 32);
+	n = (target > asrc->out_frames) ? target - asrc->out_frames : 0;
+
+	/* bounded burst, the sink fifo is sized for a period */
+	if (n > element->period + 1)
+		n = element->period + 1;
+
+	asrc_element_step(asrc);
+
+	audio_src_write(&asrc->src, asrc->in);
+
+	done = audio_src_read(&asrc->src, asrc->out, n);
+	if (done < n) {
+		asrc->stats.underrun++;
+
+		for (c = 0; c < asrc->src.channels; c++)
+			audio_buf_write_silence(asrc->out[c], n - done);
+	}
+
+	asrc->out_frames += n;
+
+	return 0;
+}
+
+static void asrc_element_reset(struct asrc_element *asrc)
+{
+	unsigned int c;
+
+	audio_src_reset(&asrc->src);
+
+	for (c = 0; c < asrc->src.channels; c++)
+		audio_buf_reset(asrc->out[c]);
+
+	/* clocks are unchanged, keep the current ratio */
+	asrc->out_frames = 0;
+	asrc_element_origin(asrc);
+}
+
+static void asrc_element_reset_element(struct audio_element *element)
+{
+	asrc_element_reset(element->data);
+}
+
+static void asrc_element_exit(struct audio_element *element)
+{
+}
+
+static void asrc_element_dump(struct audio_element *element)
+{
+	struct asrc_element *asrc = element->data;
+	unsigned int c;
+
+	log_info("asrc(%p/%p)\n", asrc, element);
+	log_info("  rate: %u -> %u Hz, %s\n", asrc->input_rate, element->sample_rate,
+		 asrc->locked ? "locked" : "unlocked");
+	audio_src_dump(&asrc->src);
+
+	for (c = 0; c < asrc->src.channels; c++) {
+		audio_buf_dump(asrc->in[c]);
+		audio_buf_dump(asrc->out[c]);
+	}
+}
+
+static void asrc_element_stats(struct audio_element *element)
+{
+	struct asrc_element *asrc = element->data;
+	int64_t ppm = ((int64_t)(asrc->ratio - asrc->ratio_nominal) * 1000000) / (int64_t)asrc->ratio_nominal;
+
+	log_info("asrc(%p), %s, ratio: %lld ppm, underrun: %llu, unlock: %llu, fifo underrun: %llu, overrun: %llu\n",
+		 asrc, asrc->locked ? "locked" : "unlocked", ppm, asrc->stats.underrun, asrc->stats.unlock,
+		 asrc->src.stats.underrun, asrc->src.stats.overrun);
+}
+
+static void asrc_element_src_config(struct audio_element_config *config, struct audio_src_config *src_config)
+{
+	src_config->channels = config->inputs;
+	src_config->input_rate = config->u.asrc.input_rate ? config->u.asrc.input_rate : config->sample_rate;
+	src_config->output_rate = config->sample_rate;
+	src_config->taps = config->u.asrc.taps;
+	src_config->in_period = config->period;
+	src_config->interpolated = true;
+}
+
+int asrc_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_asrc_params asrc;
+
+	if (size != sizeof(asrc)) {
+		log_err("asrc: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&asrc, params, sizeof(asrc));
+
+	config->u.asrc.src_sai_id = asrc.src_sai_id;
+	config->u.asrc.dst_sai_id = asrc.dst_sai_id;
+	config->u.asrc.input_rate = asrc.input_rate;
+	config->u.asrc.taps = asrc.taps;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+int asrc_element_check_config(struct audio_element_config *config)
+{
+	struct audio_src_config src_config;
+
+	if (config->outputs != config->inputs) {
+		log_err("asrc: invalid outputs: %u\n", config->outputs);
+		goto err;
+	}
+
+	if (!__sai_base(config->u.asrc.src_sai_id) || !__sai_base(config->u.asrc.dst_sai_id)) {
+		log_err("asrc: invalid sai: %u, %u\n", config->u.asrc.src_sai_id, config->u.asrc.dst_sai_id);
+		goto err;
+	}
+
+	asrc_element_src_config(config, &src_config);
+
+	if (audio_src_check_config(&src_config) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+unsigned int asrc_element_size(struct audio_element_config *config)
+{
+	struct audio_src_config src_config;
+
+	asrc_element_src_config(config, &src_config);
+
+	return sizeof(struct asrc_element) + audio_src_size(&src_config);
+}
+
+int asrc_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer)
+{
+	struct asrc_element *asrc = element->data;
+	struct audio_src_config src_config;
+	int i;
+
+	element->run = asrc_element_run;
+	element->reset = asrc_element_reset_element;
+	element->exit = asrc_element_exit;
+	element->dump = asrc_element_dump;
+	element->stats = asrc_element_stats;
+
+	memset(&asrc->stats, 0, sizeof(asrc->stats));
+
+	asrc->src_sai = __sai_base(config->u.asrc.src_sai_id);
+	asrc->dst_sai = __sai_base(config->u.asrc.dst_sai_id);
+
+	for (i = 0; i < config->inputs; i++) {
+		asrc->in[i] = &buffer[config->input[i]];
+		asrc->out[i] = &buffer[config->output[i]];
+	}
+
+	asrc_element_src_config(config, &src_config);
+
+	asrc->input_rate = src_config.input_rate;
+	asrc->interval = (ASRC_SAMPLING_PERIOD_MS * src_config.input_rate) / element->period / 1000;
+	if (!asrc->interval)
+		asrc->interval = 1;
+
+	asrc->ratio_nominal = ((uint64_t)src_config.output_rate << 32) / src_config.input_rate;
+	asrc->ratio = asrc->ratio_nominal;
+	asrc->locked = false;
+
+	audio_src_init(&asrc->src, &src_config, asrc + 1);
+
+	asrc_element_reset(asrc);
+
+	asrc_element_dump(element);
+
+	return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_ELEMENT_ASRC_H_
+#define _AUDIO_ELEMENT_ASRC_H_
+
+#include "audio_buffer.h"
+#include "audio_src.h"
+
+/*
+ * Input buffer n is resampled to output buffer n. The input is clocked by
+ * the src sai (the pipeline scheduling source), the output by the dst sai,
+ * typically driven by a different external master clock.
+ */
+struct asrc_element_config {
+	unsigned int src_sai_id;
+	unsigned int dst_sai_id;
+	unsigned int input_rate;	/* nominal input sample rate (0 for the element sample rate) */
+	unsigned int taps;		/* filter taps per phase, multiple of 4 (0 for default) */
+};
+
+struct audio_element_config;
+struct audio_element;
+
+int asrc_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
+int asrc_element_check_config(struct audio_element_config *config);
+unsigned int asrc_element_size(struct audio_element_config *config);
+int asrc_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
+
+#endif /* _AUDIO_ELEMENT_ASRC_H_ */
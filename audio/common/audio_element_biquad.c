@@ -0,0 +1,561 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+#include "os/semaphore.h"
+#include "os/string.h"
+
+#include "audio_element_biquad.h"
+#include "audio_element.h"
+#include "audio_format.h"
+#include "hrpn_ctrl.h"
+#include "hlog.h"
+#include "mailbox.h"
+
+/*
+ * Biquad cascade, direct form 1
+ *
+ * Channels are processed in groups of BIQUAD_LANES, one channel per vector
+ * lane, all sections of a group in a single pass over the period. The last
+ * group is completed with padding lanes (reading its first channel, writing
+ * to a scratch buffer).
+ *
+ * With the int32 format, coefficients are Q28 (range [-8.0, 8.0[) and the
+ * section state is kept with 64bit precision.
+ */
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+typedef int64_t biquad_s_t;
+#define BIQUAD_COEF_SHIFT	28
+#define BIQUAD_COEF_MAX		8.0
+#else
+typedef audio_sample_t biquad_s_t;
+#define BIQUAD_COEF_MAX		1024.0
+#endif
+
+#if defined(__GNUC__) && !defined(AUDIO_FORMAT_NO_VECTOR)
+#define BIQUAD_LANES	AUDIO_FORMAT_VECTOR
+typedef biquad_s_t biquad_v_t __attribute__((vector_size(AUDIO_FORMAT_VECTOR * sizeof(biquad_s_t)), may_alias, aligned(sizeof(biquad_s_t))));
+#define biquad_lane(v, l)	((v)[l])
+#else
+#define BIQUAD_LANES	1
+typedef biquad_s_t biquad_v_t;
+#define biquad_lane(v, l)	(*((void)(l), &(v)))
+#endif
+
+struct biquad_coef {
+	biquad_v_t b0;
+	biquad_v_t b1;
+	biquad_v_t b2;
+	biquad_v_t a1;
+	biquad_v_t a2;
+};
+
+struct biquad_state {
+	biquad_v_t x1;
+	biquad_v_t x2;
+	biquad_v_t y1;
+	biquad_v_t y2;
+};
+
+/*
+ * The coefficients table is double buffered, like the routing table, so that
+ * neither path ever blocks:
+ * - the data path takes the published table (if any), at the start of a period,
+ *   interpolating the coefficients from the ones in use over that period (so that
+ *   filter changes don't cause audible steps), and copies it to its own table at the end
+ * - the control path takes back the published table, if the data path didn't
+ *   take it yet, and updates it in place, or otherwise updates the other table
+ *   (the data path only reads a taken table during the period it takes it). Then
+ *   publishes it.
+ *
+ * Linear interpolation keeps the intermediate filters stable, the stability
+ * domain of (a1, a2) being convex.
+ */
+struct biquad_element {
+	struct biquad_coef *coef[2];	/* groups * sections, control path tables */
+	struct biquad_coef *run;	/* groups * sections, in use by the data path */
+	struct biquad_state *state;	/* groups * sections */
+	struct biquad_coef *ramp;	/* 2 * sections, interpolated coefficients and their increments */
+	struct audio_buffer **in;
+	struct audio_buffer **out;
+	audio_sample_t *scratch;	/* padding lanes output */
+	unsigned int channels;
+	unsigned int sections;
+	unsigned int groups;
+	unsigned int coef_pub;		/* table published by the control path, not yet taken by the data path */
+	unsigned int coef_last;		/* last table updated by the control path */
+	os_sem_t semaphore;		/* serializes control path */
+};
+
+#define BIQUAD_COEF_NONE	2
+
+static void biquad_element_response(struct mailbox *m, uint32_t status)
+{
+	struct hrpn_resp_audio_element_biquad resp;
+
+	if (m) {
+		resp.type = HRPN_RESP_TYPE_AUDIO_ELEMENT_BIQUAD;
+		resp.status = status;
+		mailbox_resp_send(m, &resp, sizeof(resp));
+	}
+}
+
+static inline biquad_s_t biquad_from_double(double v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return (biquad_s_t)(v * (1 << BIQUAD_COEF_SHIFT) + ((v >= 0.0) ? 0.5 : -0.5));
+#else
+	return (biquad_s_t)v;
+#endif
+}
+
+static inline double biquad_to_double(biquad_s_t v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return (double)v / (1 << BIQUAD_COEF_SHIFT);
+#else
+	return (double)v;
+#endif
+}
+
+static inline audio_sample_t biquad_to_sample(biquad_s_t v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	if (v > INT32_MAX)
+		return INT32_MAX;
+	else if (v < -INT32_MAX)
+		return -INT32_MAX;
+
+	return v;
+#else
+	return v;
+#endif
+}
+
+/* Rejects unstable or out of range coefficients (and NaN) */
+static int biquad_coef_check(struct hrpn_audio_biquad_coef *c)
+{
+	if (!(fabs(c->b0) < BIQUAD_COEF_MAX) || !(fabs(c->b1) < BIQUAD_COEF_MAX) ||
+	    !(fabs(c->b2) < BIQUAD_COEF_MAX) || !(fabs(c->a1) < BIQUAD_COEF_MAX) ||
+	    !(fabs(c->a2) < BIQUAD_COEF_MAX))
+		goto err;
+
+	if (!(fabs(c->a2) < 1.0) || !(fabs(c->a1) < 1.0 + c->a2))
+		goto err;
+
+	return 0;
+
+err:
+	log_err("biquad: invalid coefficients %f %f %f %f %f\n", c->b0, c->b1, c->b2, c->a1, c->a2);
+
+	return -1;
+}
+
+static void biquad_coef_set(struct biquad_element *biquad, struct biquad_coef *table, unsigned int channel, unsigned int section, struct hrpn_audio_biquad_coef *c)
+{
+	struct biquad_coef *coef = &table[(channel / BIQUAD_LANES) * biquad->sections + section];
+	unsigned int l = channel % BIQUAD_LANES;
+
+	biquad_lane(coef->b0, l) = biquad_from_double(c->b0);
+	biquad_lane(coef->b1, l) = biquad_from_double(c->b1);
+	biquad_lane(coef->b2, l) = biquad_from_double(c->b2);
+	biquad_lane(coef->a1, l) = biquad_from_double(c->a1);
+	biquad_lane(coef->a2, l) = biquad_from_double(c->a2);
+}
+
+static int biquad_element_coef_update(struct audio_element *element, unsigned int channel, unsigned int section, struct hrpn_audio_biquad_coef *c)
+{
+	struct biquad_element *biquad = element->data;
+	unsigned int next;
+	int i;
+
+	os_sem_take(&biquad->semaphore, 0, OS_SEM_TIMEOUT_MAX);
+
+	next = __atomic_exchange_n(&biquad->coef_pub, BIQUAD_COEF_NONE, __ATOMIC_ACQ_REL);
+
+	/* The data path took the last updated table, update the other one */
+	if (next == BIQUAD_COEF_NONE) {
+		next = biquad->coef_last ^ 1;
+
+		memcpy(biquad->coef[next], biquad->coef[biquad->coef_last], biquad->groups * biquad->sections * sizeof(struct biquad_coef));
+	}
+
+	if (channel == HRPN_AUDIO_ELEMENT_BIQUAD_ALL_CHANNELS) {
+		for (i = 0; i < biquad->channels; i++)
+			biquad_coef_set(biquad, biquad->coef[next], i, section, c);
+	} else {
+		biquad_coef_set(biquad, biquad->coef[next], channel, section, c);
+	}
+
+	biquad->coef_last = next;
+
+	__atomic_store_n(&biquad->coef_pub, next, __ATOMIC_RELEASE);
+
+	os_sem_give(&biquad->semaphore, 0);
+
+	return 0;
+}
+
+int biquad_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_biquad *cmd, unsigned int len, struct mailbox *m)
+{
+	struct biquad_element *biquad;
+	struct hrpn_audio_biquad_coef coef;
+
+	if (!element)
+		goto err;
+
+	if (element->type != AUDIO_ELEMENT_BIQUAD)
+		goto err;
+
+	biquad = element->data;
+
+	switch (cmd->u.common.type) {
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_BIQUAD_SET:
+		if (len != sizeof(struct hrpn_cmd_audio_element_biquad_set))
+			goto err;
+
+		if ((cmd->u.set.channel >= biquad->channels) && (cmd->u.set.channel != HRPN_AUDIO_ELEMENT_BIQUAD_ALL_CHANNELS))
+			goto err;
+
+		if (cmd->u.set.section >= biquad->sections)
+			goto err;
+
+		memcpy(&coef, &cmd->u.set.coef, sizeof(coef));
+
+		if (biquad_coef_check(&coef) < 0)
+			goto err;
+
+		if (biquad_element_coef_update(element, cmd->u.set.channel, cmd->u.set.section, &coef) < 0)
+			goto err;
+
+		break;
+
+	default:
+		goto err;
+		break;
+	}
+
+	biquad_element_response(m, HRPN_RESP_STATUS_SUCCESS);
+
+	return 0;
+
+err:
+	biquad_element_response(m, HRPN_RESP_STATUS_ERROR);
+
+	return -1;
+}
+
+/*
+ * Filters a period, for all the sections of a group. With ramp set, the
+ * coefficients are incremented by delta after each sample.
+ */
+static inline void biquad_process(struct biquad_state *state, struct biquad_coef *coef, struct biquad_coef *delta, bool ramp,
+				  unsigned int sections, audio_sample_t **in, audio_sample_t **out, unsigned int period)
+{
+	struct biquad_state *s;
+	struct biquad_coef *c;
+	biquad_s_t lane[BIQUAD_LANES];
+	biquad_v_t x, y;
+	int i, j, l;
+
+	for (i = 0; i < period; i++) {
+		for (l = 0; l < BIQUAD_LANES; l++)
+			lane[l] = in[l][i];
+
+		memcpy(&x, lane, sizeof(x));
+
+		for (j = 0; j < sections; j++) {
+			s = &state[j];
+			c = &coef[j];
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+			y = (c->b0 * x + c->b1 * s->x1 + c->b2 * s->x2 - c->a1 * s->y1 - c->a2 * s->y2 +
+			     (1 << (BIQUAD_COEF_SHIFT - 1))) >> BIQUAD_COEF_SHIFT;
+#else
+			y = c->b0 * x + c->b1 * s->x1 + c->b2 * s->x2 - c->a1 * s->y1 - c->a2 * s->y2;
+#endif
+			s->x2 = s->x1;
+			s->x1 = x;
+			s->y2 = s->y1;
+			s->y1 = y;
+
+			if (ramp) {
+				c->b0 += delta[j].b0;
+				c->b1 += delta[j].b1;
+				c->b2 += delta[j].b2;
+				c->a1 += delta[j].a1;
+				c->a2 += delta[j].a2;
+			}
+
+			x = y;
+		}
+
+		for (l = 0; l < BIQUAD_LANES; l++)
+			out[l][i] = biquad_to_sample(biquad_lane(x, l));
+	}
+}
+
+static void biquad_ramp(struct biquad_state *state, struct biquad_coef *from, struct biquad_coef *to, struct biquad_coef *ramp,
+			unsigned int sections, audio_sample_t **in, audio_sample_t **out, unsigned int period)
+{
+	struct biquad_coef *coef = ramp;
+	struct biquad_coef *delta = ramp + sections;
+	int j;
+
+	for (j = 0; j < sections; j++) {
+		coef[j] = from[j];
+
+		delta[j].b0 = (to[j].b0 - from[j].b0) / (biquad_s_t)period;
+		delta[j].b1 = (to[j].b1 - from[j].b1) / (biquad_s_t)period;
+		delta[j].b2 = (to[j].b2 - from[j].b2) / (biquad_s_t)period;
+		delta[j].a1 = (to[j].a1 - from[j].a1) / (biquad_s_t)period;
+		delta[j].a2 = (to[j].a2 - from[j].a2) / (biquad_s_t)period;
+	}
+
+	biquad_process(state, coef, delta, true, sections, in, out, period);
+}
+
+static int biquad_element_run(struct audio_element *element)
+{
+	struct biquad_element *biquad = element->data;
+	audio_sample_t *in[BIQUAD_LANES], *out[BIQUAD_LANES];
+	struct biquad_coef *coef = NULL;
+	unsigned int next = BIQUAD_COEF_NONE, c, g, l;
+
+	/* Switch to the published coefficients table, if any */
+	if (__atomic_load_n(&biquad->coef_pub, __ATOMIC_RELAXED) != BIQUAD_COEF_NONE) {
+		next = __atomic_exchange_n(&biquad->coef_pub, BIQUAD_COEF_NONE, __ATOMIC_ACQ_REL);
+		if (next != BIQUAD_COEF_NONE)
+			coef = biquad->coef[next];
+	}
+
+	for (g = 0; g < biquad->groups; g++) {
+		for (l = 0; l < BIQUAD_LANES; l++) {
+			c = g * BIQUAD_LANES + l;
+
+			if (c < biquad->channels) {
+				in[l] = audio_buf_read_addr(biquad->in[c], 0);
+				out[l] = audio_buf_write_addr(biquad->out[c], 0);
+			} else {
+				in[l] = audio_buf_read_addr(biquad->in[g * BIQUAD_LANES], 0);
+				out[l] = biquad->scratch;
+			}
+		}
+
+		if (coef)
+			biquad_ramp(&biquad->state[g * biquad->sections], &biquad->run[g * biquad->sections], &coef[g * biquad->sections],
+				    biquad->ramp, biquad->sections, in, out, element->period);
+		else
+			biquad_process(&biquad->state[g * biquad->sections], &biquad->run[g * biquad->sections], NULL, false,
+				       biquad->sections, in, out, element->period);
+	}
+
+	for (c = 0; c < biquad->channels; c++) {
+		audio_buf_read_update(biquad->in[c], element->period);
+		audio_buf_write_update(biquad->out[c], element->period);
+	}
+
+	/* The taken table is no longer read, after this period */
+	if (coef)
+		memcpy(biquad->run, coef, biquad->groups * biquad->sections * sizeof(struct biquad_coef));
+
+	return 0;
+}
+
+static void biquad_element_reset(struct audio_element *element)
+{
+	struct biquad_element *biquad = element->data;
+	int i;
+
+	memset(biquad->state, 0, biquad->groups * biquad->sections * sizeof(struct biquad_state));
+
+	for (i = 0; i < biquad->channels; i++)
+		audio_buf_reset(biquad->out[i]);
+}
+
+static void biquad_element_exit(struct audio_element *element)
+{
+	struct biquad_element *biquad = element->data;
+
+	os_sem_destroy(&biquad->semaphore);
+}
+
+static void biquad_element_dump(struct audio_element *element)
+{
+	struct biquad_element *biquad = element->data;
+	struct biquad_coef *coef;
+	unsigned int l;
+	int i, j;
+
+	log_info("biquad(%p/%p)\n", biquad, element);
+	log_info("  channels: %u, sections: %u, lanes: %u\n", biquad->channels, biquad->sections, BIQUAD_LANES);
+
+	for (i = 0; i < biquad->channels; i++) {
+		l = i % BIQUAD_LANES;
+
+		for (j = 0; j < biquad->sections; j++) {
+			coef = &biquad->coef[biquad->coef_last][(i / BIQUAD_LANES) * biquad->sections + j];
+
+			log_info("  %u.%u: b %f %f %f, a %f %f\n", i, j,
+				 biquad_to_double(biquad_lane(coef->b0, l)), biquad_to_double(biquad_lane(coef->b1, l)),
+				 biquad_to_double(biquad_lane(coef->b2, l)), biquad_to_double(biquad_lane(coef->a1, l)),
+				 biquad_to_double(biquad_lane(coef->a2, l)));
+		}
+	}
+
+	for (i = 0; i < biquad->channels; i++) {
+		audio_buf_dump(biquad->in[i]);
+		audio_buf_dump(biquad->out[i]);
+	}
+}
+
+int biquad_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_biquad_params biquad;
+
+	if (size < sizeof(biquad)) {
+		log_err("biquad: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&biquad, params, sizeof(biquad));
+
+	if ((biquad.coefs > config->inputs * BIQUAD_MAX_SECTIONS) ||
+	    (size != sizeof(biquad) + biquad.coefs * sizeof(struct hrpn_audio_biquad_coef))) {
+		log_err("biquad: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	/* coefficients are used in place, the parameters must outlive the element */
+	config->u.biquad.sections = biquad.sections;
+	config->u.biquad.coefs = biquad.coefs;
+	config->u.biquad.coef = biquad.coefs ? (uint8_t *)params + sizeof(biquad) : NULL;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+int biquad_element_check_config(struct audio_element_config *config)
+{
+	struct hrpn_audio_biquad_coef coef;
+	unsigned int sections = config->u.biquad.sections;
+	unsigned int coefs = config->u.biquad.coefs;
+	int i;
+
+	if (!config->inputs || (config->outputs != config->inputs)) {
+		log_err("biquad: invalid inputs/outputs: %u/%u\n", config->inputs, config->outputs);
+		goto err;
+	}
+
+	if (!sections || (sections > BIQUAD_MAX_SECTIONS)) {
+		log_err("biquad: invalid sections: %u\n", sections);
+		goto err;
+	}
+
+	if (coefs && (coefs != sections) && (coefs != config->inputs * sections)) {
+		log_err("biquad: invalid coefficients: %u\n", coefs);
+		goto err;
+	}
+
+	for (i = 0; i < coefs; i++) {
+		memcpy(&coef, (struct hrpn_audio_biquad_coef *)config->u.biquad.coef + i, sizeof(coef));
+
+		if (biquad_coef_check(&coef) < 0)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+static unsigned int biquad_element_groups(struct audio_element_config *config)
+{
+	return (config->inputs + BIQUAD_LANES - 1) / BIQUAD_LANES;
+}
+
+unsigned int biquad_element_size(struct audio_element_config *config)
+{
+	unsigned int blocks = biquad_element_groups(config) * config->u.biquad.sections;
+	unsigned int size;
+
+	size = sizeof(struct biquad_element);
+	size += 3 * blocks * sizeof(struct biquad_coef);
+	size += blocks * sizeof(struct biquad_state);
+	size += 2 * config->u.biquad.sections * sizeof(struct biquad_coef);
+	size += 2 * config->inputs * sizeof(struct audio_buffer *);
+	size += config->period * sizeof(audio_sample_t);
+
+	return size;
+}
+
+int biquad_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer)
+{
+	struct biquad_element *biquad = element->data;
+	struct hrpn_audio_biquad_coef coef, *params = config->u.biquad.coef;
+	unsigned int blocks;
+	int i, j;
+
+	if (os_sem_init(&biquad->semaphore, 1))
+		goto err;
+
+	element->run = biquad_element_run;
+	element->reset = biquad_element_reset;
+	element->exit = biquad_element_exit;
+	element->dump = biquad_element_dump;
+
+	biquad->channels = config->inputs;
+	biquad->sections = config->u.biquad.sections;
+	biquad->groups = biquad_element_groups(config);
+	blocks = biquad->groups * biquad->sections;
+
+	biquad->coef[0] = (struct biquad_coef *)(biquad + 1);
+	biquad->coef[1] = biquad->coef[0] + blocks;
+	biquad->run = biquad->coef[1] + blocks;
+	biquad->state = (struct biquad_state *)(biquad->run + blocks);
+	biquad->ramp = (struct biquad_coef *)(biquad->state + blocks);
+	biquad->in = (struct audio_buffer **)(biquad->ramp + 2 * biquad->sections);
+	biquad->out = biquad->in + biquad->channels;
+	biquad->scratch = (audio_sample_t *)(biquad->out + biquad->channels);
+
+	for (i = 0; i < biquad->channels; i++) {
+		biquad->in[i] = &buffer[config->input[i]];
+		biquad->out[i] = &buffer[config->output[i]];
+	}
+
+	/* pass through, for the padding lanes and without coefficients */
+	memset(biquad->coef[0], 0, blocks * sizeof(struct biquad_coef));
+	for (i = 0; i < blocks; i++)
+		biquad->coef[0][i].b0 += biquad_from_double(1.0);
+
+	for (i = 0; i < config->u.biquad.coefs; i++) {
+		memcpy(&coef, &params[i], sizeof(coef));
+
+		if (config->u.biquad.coefs == biquad->sections) {
+			for (j = 0; j < biquad->channels; j++)
+				biquad_coef_set(biquad, biquad->coef[0], j, i, &coef);
+		} else {
+			biquad_coef_set(biquad, biquad->coef[0], i / biquad->sections, i % biquad->sections, &coef);
+		}
+	}
+
+	memcpy(biquad->run, biquad->coef[0], blocks * sizeof(struct biquad_coef));
+
+	biquad->coef_pub = BIQUAD_COEF_NONE;
+	biquad->coef_last = 0;
+
+	memset(biquad->state, 0, blocks * sizeof(struct biquad_state));
+
+	biquad_element_dump(element);
+
+	return 0;
+
+err:
+	return -1;
+}
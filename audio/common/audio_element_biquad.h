@@ -0,0 +1,34 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_ELEMENT_BIQUAD_H_
+#define _AUDIO_ELEMENT_BIQUAD_H_
+
+#include "audio_buffer.h"
+
+#include "hrpn_ctrl_audio_pipeline.h"
+
+#define BIQUAD_MAX_SECTIONS	8
+
+/* Input buffer n is filtered to output buffer n, by a cascade of biquad sections */
+struct biquad_element_config {
+	unsigned int sections;	/* per channel */
+	unsigned int coefs;	/* 0 (pass through), sections (same for all channels) or inputs * sections */
+	void *coef;		/* struct hrpn_audio_biquad_coef records, used in place */
+};
+
+struct audio_element_config;
+struct audio_element;
+
+struct mailbox;
+
+int biquad_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_biquad *cmd, unsigned int len, struct mailbox *m);
+int biquad_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
+int biquad_element_check_config(struct audio_element_config *config);
+unsigned int biquad_element_size(struct audio_element_config *config);
+int biquad_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
+
+#endif /* _AUDIO_ELEMENT_BIQUAD_H_ */
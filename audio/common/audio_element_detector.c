@@ -0,0 +1,617 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+#include "os/string.h"
+
+#include "audio_element_detector.h"
+#include "audio_element.h"
+#include "audio_format.h"
+#include "hrpn_ctrl.h"
+#include "hlog.h"
+#include "mailbox.h"
+
+/*
+ * Tone detector, block Goertzel filters
+ *
+ * Each tone (the 8 DTMF frequencies, then the pilot tones) has a Goertzel
+ * resonator, s[n] = x[n] + c * s[n - 1] - s[n - 2] with c = 2 cos(w), run
+ * over an analysis block. At the end of the block, the tone power is
+ * computed from the last two states and the resonators restart from zero.
+ * The resonators are updated DETECTOR_LANES at a time, one vector
+ * multiply-add per sample, in single precision.
+ *
+ * In a block, a DTMF digit is valid if its row and column tones are above
+ * the threshold, within DETECTOR_TWIST of each other, stronger than the
+ * other tones of their group by DETECTOR_PEAK, and carry most of the block
+ * energy. A pilot tone is present if above the threshold.
+ * A tone starts (or ends) once present (or absent) in DETECTOR_HITS
+ * consecutive blocks. Its start and end are then refined, with one period
+ * resolution, from the input level.
+ *
+ * Tone events are queued for the control path, which reads them with
+ * mailbox commands.
+ */
+#define DETECTOR_DTMF_TONES	8
+#define DETECTOR_TONES		(DETECTOR_DTMF_TONES + DETECTOR_MAX_PILOTS)
+#define DETECTOR_LANES		4
+#define DETECTOR_CHUNK		32	/* input samples converted at once */
+#define DETECTOR_EVENTS		32	/* event queue size, power of 2 */
+#define DETECTOR_HITS		2
+#define DETECTOR_TWIST		6.3f	/* 8 dB, power ratio */
+#define DETECTOR_PEAK		6.3f	/* 8 dB, power ratio */
+#define DETECTOR_TONE_RATIO	0.5f	/* digit tones fraction of the block energy */
+#define DETECTOR_BLOCK_RATE	40	/* default block, 25ms */
+#define DETECTOR_MIN_BLOCK_RATE	50	/* 20ms, DTMF tones resolution */
+
+#if defined(__GNUC__) && !defined(AUDIO_FORMAT_NO_VECTOR)
+#define DETECTOR_VECTOR
+typedef float detector_v_t __attribute__((vector_size(DETECTOR_LANES * sizeof(float)), may_alias, aligned(sizeof(float))));
+#endif
+
+static const unsigned int dtmf_freq[DETECTOR_DTMF_TONES] = {
+	697, 770, 852, 941,		/* rows */
+	1209, 1336, 1477, 1633		/* columns */
+};
+
+static const char dtmf_key[4][4] = {
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'*', '0', '#', 'D'},
+};
+
+struct detector_tone {
+	uint32_t tone;		/* tone being detected, 0 if none */
+	uint64_t start;
+	uint64_t end;
+	unsigned int misses;	/* consecutive blocks without the tone */
+
+	uint32_t candidate;	/* tone present in the last blocks */
+	uint64_t candidate_start;
+	uint64_t candidate_onset;
+	unsigned int hits;	/* consecutive blocks with the candidate */
+};
+
+struct detector_element {
+	struct audio_buffer *in;
+	struct audio_buffer *out;	/* optional, copy of the input */
+
+	unsigned int sample_rate;
+	unsigned int block;
+	unsigned int pos;		/* samples in the current block */
+	unsigned int tones;		/* resonators, DTMF only or with all the pilots */
+	unsigned int pilots;
+	unsigned int pilot[DETECTOR_MAX_PILOTS];
+	int threshold;
+	float level;			/* threshold, tone amplitude squared */
+	float scale;			/* resonator power to tone amplitude squared */
+
+	float coef[DETECTOR_TONES];
+	float s1[DETECTOR_TONES];
+	float s2[DETECTOR_TONES];
+	double energy;			/* current block input energy */
+
+	uint64_t time;			/* samples since the element start */
+	uint64_t quiet_end;		/* end of the last chunk below the activity level */
+	uint64_t active_end;		/* end of the last chunk above the activity level */
+
+	struct detector_tone tone[1 + DETECTOR_MAX_PILOTS];	/* dtmf, then pilots */
+
+	/* single producer (data path), single consumer (control path) queue */
+	struct hrpn_audio_detector_event event[DETECTOR_EVENTS];
+	unsigned int head;
+	unsigned int tail;
+	unsigned int lost;
+};
+
+static inline float detector_from_sample(audio_sample_t v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return (float)v * (1.0f / 2147483648.0f);
+#else
+	return (float)v;
+#endif
+}
+
+static void detector_element_response(struct mailbox *m, struct hrpn_resp_audio_element_detector *resp, uint32_t status)
+{
+	if (m) {
+		resp->type = HRPN_RESP_TYPE_AUDIO_ELEMENT_DETECTOR;
+		resp->status = status;
+		mailbox_resp_send(m, resp, (uint8_t *)&resp->event[resp->events] - (uint8_t *)resp);
+	}
+}
+
+static void detector_event(struct detector_element *det, uint32_t tone, uint64_t start, uint32_t duration)
+{
+	struct hrpn_audio_detector_event *event;
+	unsigned int head = det->head;
+
+	if (head - __atomic_load_n(&det->tail, __ATOMIC_ACQUIRE) >= DETECTOR_EVENTS) {
+		__atomic_fetch_add(&det->lost, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	event = &det->event[head & (DETECTOR_EVENTS - 1)];
+	event->tone = tone;
+	event->start = start;
+	event->duration = duration;
+
+	__atomic_store_n(&det->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void detector_events_read(struct detector_element *det, struct hrpn_resp_audio_element_detector *resp)
+{
+	unsigned int head, tail = det->tail;
+
+	head = __atomic_load_n(&det->head, __ATOMIC_ACQUIRE);
+
+	for (resp->events = 0; (tail != head) && (resp->events < HRPN_AUDIO_DETECTOR_EVENTS_MAX); tail++)
+		resp->event[resp->events++] = det->event[tail & (DETECTOR_EVENTS - 1)];
+
+	__atomic_store_n(&det->tail, tail, __ATOMIC_RELEASE);
+
+	resp->lost = __atomic_exchange_n(&det->lost, 0, __ATOMIC_RELAXED);
+}
+
+int detector_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_detector *cmd, unsigned int len, struct mailbox *m)
+{
+	struct hrpn_resp_audio_element_detector resp;
+
+	resp.events = 0;
+	resp.lost = 0;
+
+	if (!element)
+		goto err;
+
+	if (element->type != AUDIO_ELEMENT_DETECTOR)
+		goto err;
+
+	switch (cmd->u.common.type) {
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_DETECTOR_READ:
+		if (len != sizeof(struct hrpn_cmd_audio_element_detector_read))
+			goto err;
+
+		detector_events_read(element->data, &resp);
+
+		break;
+
+	default:
+		goto err;
+		break;
+	}
+
+	detector_element_response(m, &resp, HRPN_RESP_STATUS_SUCCESS);
+
+	return 0;
+
+err:
+	detector_element_response(m, &resp, HRPN_RESP_STATUS_ERROR);
+
+	return -1;
+}
+
+#if defined(DETECTOR_VECTOR)
+/*
+ * The resonators recursion is latency bound, so all the vectors are updated
+ * in the same samples loop, kept in registers (groups is constant once
+ * inlined, and the groups loop unrolled).
+ * s[n - 2] is subtracted first, out of the s[n - 1] dependency chain.
+ */
+static inline void detector_goertzel_groups(struct detector_element *det, float *x, unsigned int len, const unsigned int groups)
+{
+	detector_v_t c[DETECTOR_TONES / DETECTOR_LANES];
+	detector_v_t s1[DETECTOR_TONES / DETECTOR_LANES];
+	detector_v_t s2[DETECTOR_TONES / DETECTOR_LANES];
+	detector_v_t s0;
+	unsigned int g, i;
+
+	for (g = 0; g < groups; g++) {
+		c[g] = *(detector_v_t *)&det->coef[g * DETECTOR_LANES];
+		s1[g] = *(detector_v_t *)&det->s1[g * DETECTOR_LANES];
+		s2[g] = *(detector_v_t *)&det->s2[g * DETECTOR_LANES];
+	}
+
+	for (i = 0; i < len; i++) {
+#pragma GCC unroll 4
+		for (g = 0; g < groups; g++) {
+			s0 = c[g] * s1[g] + (x[i] - s2[g]);
+			s2[g] = s1[g];
+			s1[g] = s0;
+		}
+	}
+
+	for (g = 0; g < groups; g++) {
+		*(detector_v_t *)&det->s1[g * DETECTOR_LANES] = s1[g];
+		*(detector_v_t *)&det->s2[g * DETECTOR_LANES] = s2[g];
+	}
+}
+#endif
+
+/* Runs all the resonators over len input samples */
+static void detector_goertzel(struct detector_element *det, float *x, unsigned int len)
+{
+#if defined(DETECTOR_VECTOR)
+	if (det->tones > DETECTOR_DTMF_TONES)
+		detector_goertzel_groups(det, x, len, DETECTOR_TONES / DETECTOR_LANES);
+	else
+		detector_goertzel_groups(det, x, len, DETECTOR_DTMF_TONES / DETECTOR_LANES);
+#else
+	unsigned int k, i;
+	float s0, s1, s2;
+
+	for (k = 0; k < det->tones; k++) {
+		s1 = det->s1[k];
+		s2 = det->s2[k];
+
+		for (i = 0; i < len; i++) {
+			s0 = det->coef[k] * s1 + (x[i] - s2);
+			s2 = s1;
+			s1 = s0;
+		}
+
+		det->s1[k] = s1;
+		det->s2[k] = s2;
+	}
+#endif
+}
+
+/* Converts len input samples, returns their energy */
+static float detector_convert(audio_sample_t *in, float *x, unsigned int len)
+{
+	unsigned int i = 0;
+	float e = 0.0f;
+
+#if defined(DETECTOR_VECTOR)
+	{
+		detector_v_t v, ev = {0.0f, 0.0f, 0.0f, 0.0f};
+
+		for (; i + DETECTOR_LANES <= len; i += DETECTOR_LANES) {
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+			v = __builtin_convertvector(*(audio_v4si_t *)&in[i], detector_v_t) * (1.0f / 2147483648.0f);
+#else
+			v = __builtin_convertvector(*(audio_v4s_t *)&in[i], detector_v_t);
+#endif
+			*(detector_v_t *)&x[i] = v;
+			ev += v * v;
+		}
+
+		e = (ev[0] + ev[1]) + (ev[2] + ev[3]);
+	}
+#endif
+
+	for (; i < len; i++) {
+		x[i] = detector_from_sample(in[i]);
+		e += x[i] * x[i];
+	}
+
+	return e;
+}
+
+static unsigned int detector_max(float *amp, unsigned int n)
+{
+	unsigned int i, max = 0;
+
+	for (i = 1; i < n; i++)
+		if (amp[i] > amp[max])
+			max = i;
+
+	return max;
+}
+
+/* Returns the DTMF digit present in the block, or 0 */
+static uint32_t detector_dtmf(struct detector_element *det, float *amp, float power)
+{
+	unsigned int r, c, i;
+
+	r = detector_max(&amp[0], 4);
+	c = detector_max(&amp[4], 4);
+
+	if ((amp[r] < det->level) || (amp[4 + c] < det->level))
+		return 0;
+
+	if ((amp[r] > DETECTOR_TWIST * amp[4 + c]) || (amp[4 + c] > DETECTOR_TWIST * amp[r]))
+		return 0;
+
+	for (i = 0; i < 4; i++) {
+		if ((i != r) && (DETECTOR_PEAK * amp[i] > amp[r]))
+			return 0;
+
+		if ((i != c) && (DETECTOR_PEAK * amp[4 + i] > amp[4 + c]))
+			return 0;
+	}
+
+	/* a sine mean power is half its amplitude squared */
+	if ((amp[r] + amp[4 + c]) * 0.5f < DETECTOR_TONE_RATIO * power)
+		return 0;
+
+	return dtmf_key[r][c];
+}
+
+/*
+ * Updates a tone state, with the tone found (or 0) in the block starting at
+ * start. The tone onset (and end) is the last input level transition close
+ * enough to the block boundaries, or the block boundary itself.
+ */
+static void detector_tone_update(struct detector_element *det, struct detector_tone *t, uint32_t tone, uint64_t start)
+{
+	uint64_t end = start + det->block;
+
+	if (tone && (tone == t->candidate)) {
+		t->hits++;
+	} else {
+		t->candidate = tone;
+		t->candidate_start = start;
+		t->candidate_onset = det->quiet_end;
+		t->hits = tone ? 1 : 0;
+	}
+
+	if (t->tone) {
+		if (tone == t->tone) {
+			t->misses = 0;
+		} else {
+			if (!t->misses) {
+				if ((det->active_end + det->block / 2 > start) && (det->active_end < end))
+					t->end = det->active_end;
+				else
+					t->end = start;
+			}
+
+			if (++t->misses >= DETECTOR_HITS) {
+				detector_event(det, t->tone, t->start, t->end - t->start);
+				t->tone = 0;
+			}
+		}
+	}
+
+	if (!t->tone && (t->hits >= DETECTOR_HITS)) {
+		start = t->candidate_start;
+
+		if ((t->candidate_onset + det->block > start) && (t->candidate_onset <= start + det->block / 2))
+			start = t->candidate_onset;
+
+		t->tone = t->candidate;
+		t->start = start;
+		t->misses = 0;
+
+		detector_event(det, t->tone, t->start, 0);
+	}
+}
+
+static void detector_block(struct detector_element *det)
+{
+	float amp[DETECTOR_TONES];
+	uint64_t start = det->time - det->block;
+	float power;
+	unsigned int k;
+
+	/* |X|^2 = s1^2 + s2^2 - c s1 s2, and a sine of amplitude A has |X| = A block / 2 */
+	for (k = 0; k < det->tones; k++) {
+		amp[k] = (det->s1[k] * det->s1[k] + det->s2[k] * det->s2[k] - det->coef[k] * det->s1[k] * det->s2[k]) * det->scale;
+		det->s1[k] = 0.0f;
+		det->s2[k] = 0.0f;
+	}
+
+	power = det->energy / det->block;
+	det->energy = 0.0;
+
+	detector_tone_update(det, &det->tone[0], detector_dtmf(det, amp, power), start);
+
+	for (k = 0; k < det->pilots; k++)
+		detector_tone_update(det, &det->tone[1 + k],
+				     (amp[DETECTOR_DTMF_TONES + k] >= det->level) ? HRPN_AUDIO_DETECTOR_PILOT(k) : 0, start);
+}
+
+static int detector_element_run(struct audio_element *element)
+{
+	struct detector_element *det = element->data;
+	audio_sample_t *in = audio_buf_read_addr(det->in, 0);
+	float x[DETECTOR_CHUNK], e;
+	unsigned int i, n;
+
+	for (i = 0; i < element->period; i += n) {
+		n = element->period - i;
+		if (n > DETECTOR_CHUNK)
+			n = DETECTOR_CHUNK;
+		if (n > det->block - det->pos)
+			n = det->block - det->pos;
+
+		e = detector_convert(&in[i], x, n);
+
+		detector_goertzel(det, x, n);
+
+		det->energy += e;
+		det->pos += n;
+		det->time += n;
+
+		/* activity level, one tone at the threshold */
+		if (e >= det->level * 0.5f * n)
+			det->active_end = det->time;
+		else
+			det->quiet_end = det->time;
+
+		if (det->pos == det->block) {
+			detector_block(det);
+			det->pos = 0;
+		}
+	}
+
+	if (det->out) {
+		__audio_buf_copy(det->out, det->in, element->period);
+		audio_buf_write_update(det->out, element->period);
+	}
+
+	audio_buf_read_update(det->in, element->period);
+
+	return 0;
+}
+
+static void detector_element_reset(struct audio_element *element)
+{
+	struct detector_element *det = element->data;
+
+	/* restart the analysis, the time reference is kept */
+	memset(det->s1, 0, sizeof(det->s1));
+	memset(det->s2, 0, sizeof(det->s2));
+	memset(det->tone, 0, sizeof(det->tone));
+	det->energy = 0.0;
+	det->pos = 0;
+
+	if (det->out)
+		audio_buf_reset(det->out);
+}
+
+static void detector_element_exit(struct audio_element *element)
+{
+}
+
+static void detector_element_dump(struct audio_element *element)
+{
+	struct detector_element *det = element->data;
+	int i;
+
+	log_info("detector(%p/%p)\n", det, element);
+	log_info("  block: %u, threshold: %d dBFS, time: %llu\n", det->block, det->threshold, (unsigned long long)det->time);
+
+	for (i = 0; i < det->pilots; i++)
+		log_info("  pilot %d: %u Hz\n", i, det->pilot[i]);
+
+	log_info("  events: %u, lost: %u\n", det->head - det->tail, det->lost);
+
+	audio_buf_dump(det->in);
+
+	if (det->out)
+		audio_buf_dump(det->out);
+}
+
+int detector_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_detector_params detector;
+
+	if (size < sizeof(detector)) {
+		log_err("detector: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&detector, params, sizeof(detector));
+
+	if ((detector.pilots > DETECTOR_MAX_PILOTS) ||
+	    (size != sizeof(detector) + detector.pilots * sizeof(uint32_t))) {
+		log_err("detector: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	config->u.detector.pilots = detector.pilots;
+	config->u.detector.block = detector.block;
+	config->u.detector.threshold = detector.threshold;
+	memcpy(config->u.detector.pilot, (uint8_t *)params + sizeof(detector), detector.pilots * sizeof(uint32_t));
+
+	return 0;
+
+err:
+	return -1;
+}
+
+static unsigned int detector_block_size(struct audio_element_config *config)
+{
+	if (config->u.detector.block)
+		return config->u.detector.block;
+
+	return config->sample_rate / DETECTOR_BLOCK_RATE;
+}
+
+static int detector_threshold(struct audio_element_config *config)
+{
+	if (config->u.detector.threshold)
+		return config->u.detector.threshold;
+
+	return DETECTOR_DEFAULT_THRESHOLD;
+}
+
+int detector_element_check_config(struct audio_element_config *config)
+{
+	unsigned int block = detector_block_size(config);
+	int threshold = detector_threshold(config);
+	int i;
+
+	if ((config->inputs != 1) || (config->outputs > 1)) {
+		log_err("detector: invalid inputs/outputs: %u/%u\n", config->inputs, config->outputs);
+		goto err;
+	}
+
+	if (config->sample_rate <= 2 * dtmf_freq[DETECTOR_DTMF_TONES - 1]) {
+		log_err("detector: unsupported sample rate: %u\n", config->sample_rate);
+		goto err;
+	}
+
+	if ((block < config->sample_rate / DETECTOR_MIN_BLOCK_RATE) || (block > config->sample_rate)) {
+		log_err("detector: invalid block: %u\n", block);
+		goto err;
+	}
+
+	if ((threshold < -120) || (threshold > 0)) {
+		log_err("detector: invalid threshold: %d\n", threshold);
+		goto err;
+	}
+
+	for (i = 0; i < config->u.detector.pilots; i++) {
+		if (!config->u.detector.pilot[i] || (2 * config->u.detector.pilot[i] >= config->sample_rate)) {
+			log_err("detector: invalid pilot frequency: %u\n", config->u.detector.pilot[i]);
+			goto err;
+		}
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+unsigned int detector_element_size(struct audio_element_config *config)
+{
+	/* keep the next element data aligned */
+	return (sizeof(struct detector_element) + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+int detector_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer)
+{
+	struct detector_element *det = element->data;
+	unsigned int k;
+
+	element->run = detector_element_run;
+	element->reset = detector_element_reset;
+	element->exit = detector_element_exit;
+	element->dump = detector_element_dump;
+
+	memset(det, 0, sizeof(*det));
+
+	det->in = &buffer[config->input[0]];
+	if (config->outputs)
+		det->out = &buffer[config->output[0]];
+
+	det->sample_rate = config->sample_rate;
+	det->block = detector_block_size(config);
+	det->threshold = detector_threshold(config);
+	det->level = pow(10.0, det->threshold / 10.0);
+	det->scale = 4.0 / ((double)det->block * det->block);
+
+	det->pilots = config->u.detector.pilots;
+	memcpy(det->pilot, config->u.detector.pilot, det->pilots * sizeof(unsigned int));
+
+	/* unused resonators have a null coefficient */
+	det->tones = (det->pilots) ? DETECTOR_TONES : DETECTOR_DTMF_TONES;
+
+	for (k = 0; k < DETECTOR_DTMF_TONES; k++)
+		det->coef[k] = 2.0 * cos(2.0 * M_PI * dtmf_freq[k] / det->sample_rate);
+
+	for (k = 0; k < det->pilots; k++)
+		det->coef[DETECTOR_DTMF_TONES + k] = 2.0 * cos(2.0 * M_PI * det->pilot[k] / det->sample_rate);
+
+	detector_element_dump(element);
+
+	return 0;
+}
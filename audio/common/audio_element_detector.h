@@ -0,0 +1,39 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_ELEMENT_DETECTOR_H_
+#define _AUDIO_ELEMENT_DETECTOR_H_
+
+#include "audio_buffer.h"
+
+#include "hrpn_ctrl_audio_pipeline.h"
+
+#define DETECTOR_MAX_PILOTS		8
+#define DETECTOR_DEFAULT_THRESHOLD	-30	/* dBFS, per tone */
+
+/*
+ * Detects DTMF digits and pilot tones in the input buffer, optionally
+ * forwarded unmodified to the output buffer.
+ */
+struct detector_element_config {
+	unsigned int pilots;
+	unsigned int pilot[DETECTOR_MAX_PILOTS];	/* Hz */
+	unsigned int block;				/* analysis block, in samples, 0 for default */
+	int threshold;					/* dBFS, 0 for default */
+};
+
+struct audio_element_config;
+struct audio_element;
+
+struct mailbox;
+
+int detector_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_detector *cmd, unsigned int len, struct mailbox *m);
+int detector_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
+int detector_element_check_config(struct audio_element_config *config);
+unsigned int detector_element_size(struct audio_element_config *config);
+int detector_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
+
+#endif /* _AUDIO_ELEMENT_DETECTOR_H_ */
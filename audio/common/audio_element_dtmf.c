@@ -4,13 +4,13 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
-#include "os/math.h"
 #include "os/stdint.h"
 #include "os/string.h"
 
 #include "audio_element_dtmf.h"
 #include "audio_element.h"
 #include "audio_format.h"
+#include "audio_osc.h"
 #include "hlog.h"
 
 #define USEC_PER_SEC	1000000
@@ -21,8 +21,8 @@ struct dtmf_element {
 	unsigned int sample_rate;
 
 	double amplitude;
-	double dphase1;
-	double dphase2;
+	struct audio_osc osc1;
+	struct audio_osc osc2;
 
 	unsigned int phase;	/* current phase, in sample units */
 	unsigned int dtmf_samples; /* number of samples to play per dtmf */
@@ -44,16 +44,10 @@ enum {
 
 static void dtmf_generate_sinewave(struct dtmf_element *dtmf, unsigned int samples)
 {
-	double v;
-	audio_sample_t w;
-	int i;
-
-	for (i = 0; i < samples; i++) {
-		v = dtmf->amplitude * (sin((i + dtmf->phase) * dtmf->dphase1) + sin((i + dtmf->phase) * dtmf->dphase2)) / 2.0;
-		w = audio_double_to_sample(v);
+	audio_sample_t *out = audio_buf_write_addr(dtmf->out, 0);
 
-		__audio_buf_write(dtmf->out, i, &w, 1);
-	}
+	audio_osc_generate(&dtmf->osc1, out, samples, dtmf->amplitude / 2.0, false);
+	audio_osc_generate(&dtmf->osc2, out, samples, dtmf->amplitude / 2.0, true);
 
 	audio_buf_write_update(dtmf->out, samples);
 
@@ -168,8 +162,8 @@ static int dtmf_element_run(struct audio_element *element)
 
 			dtmf_get_freqs(dtmf->sequence[dtmf->sequence_id], &freq1, &freq2);
 
-			dtmf->dphase1 = 2.0 * M_PI * freq1 / dtmf->sample_rate;
-			dtmf->dphase2 = 2.0 * M_PI * freq2 / dtmf->sample_rate;
+			audio_osc_init(&dtmf->osc1, freq1, dtmf->sample_rate, 0.0);
+			audio_osc_init(&dtmf->osc2, freq2, dtmf->sample_rate, 0.0);
 		}
 
 		break;
@@ -221,6 +215,37 @@ static void dtmf_element_dump(struct audio_element *element)
 	audio_buf_dump(dtmf->out);
 }
 
+int dtmf_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_dtmf_params dtmf;
+	char *sequence;
+
+	if (size <= sizeof(dtmf)) {
+		log_err("dtmf: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&dtmf, params, sizeof(dtmf));
+
+	/* sequence is used in place, the parameters must outlive the element */
+	sequence = (char *)params + sizeof(dtmf);
+	if (!memchr(sequence, '\0', size - sizeof(dtmf))) {
+		log_err("dtmf: invalid sequence\n");
+		goto err;
+	}
+
+	config->u.dtmf.us = dtmf.us;
+	config->u.dtmf.pause_us = dtmf.pause_us;
+	config->u.dtmf.sequence_pause_us = dtmf.sequence_pause_us;
+	config->u.dtmf.amplitude = dtmf.amplitude;
+	config->u.dtmf.sequence = sequence;
+
+	return 0;
+
+err:
+	return -1;
+}
+
 int dtmf_element_check_config(struct audio_element_config *config)
 {
 	if (config->inputs) {
@@ -279,8 +304,8 @@ int dtmf_element_init(struct audio_element *element, struct audio_element_config
 
 	dtmf_get_freqs(dtmf->sequence[dtmf->sequence_id], &freq1, &freq2);
 
-	dtmf->dphase1 = 2.0 * M_PI * freq1 / dtmf->sample_rate;
-	dtmf->dphase2 = 2.0 * M_PI * freq2 / dtmf->sample_rate;
+	audio_osc_init(&dtmf->osc1, freq1, dtmf->sample_rate, 0.0);
+	audio_osc_init(&dtmf->osc2, freq2, dtmf->sample_rate, 0.0);
 
 	dtmf->state = DTMF_PLAYING;
 
@@ -22,6 +22,7 @@ struct dtmf_element_config {
 struct audio_element_config;
 struct audio_element;
 
+int dtmf_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
 int dtmf_element_check_config(struct audio_element_config *config);
 unsigned int dtmf_element_size(struct audio_element_config *config);
 int dtmf_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
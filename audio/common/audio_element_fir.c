@@ -0,0 +1,335 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+#include "os/string.h"
+
+#include "audio_element_fir.h"
+#include "audio_element.h"
+#include "audio_fft.h"
+#include "audio_format.h"
+#include "hlog.h"
+
+/*
+ * FIR filter, uniformly partitioned overlap-save convolution
+ *
+ * The filter is split in partitions of one period (B taps), the spectrum of
+ * each partition, zero padded to 2B, is computed once at init. Each period,
+ * the spectrum of the last 2B input samples is stored in a frequency domain
+ * delay line (one entry per partition), and the output spectrum is the sum
+ * of the products of the delay line entries with the partitions spectra.
+ * The last B samples of its inverse transform are the output period.
+ *
+ * The output period is computed from the input period, so the element adds
+ * no latency to the pipeline, and the cost grows with taps / B complex
+ * products per bin instead of taps products per sample.
+ *
+ * Processing is single precision floating point, for all sample formats.
+ */
+struct fir_element {
+	struct audio_buffer **in;
+	struct audio_buffer **out;
+	unsigned int channels;
+	unsigned int filters;
+	unsigned int taps;
+	unsigned int block;		/* partition size, element period */
+	unsigned int partitions;
+	unsigned int bins;		/* spectrum entries, per real or imaginary part */
+	unsigned int pos;		/* delay line entry of the current period */
+
+	struct audio_fft fft;
+
+	float *h;			/* partitions spectra, filters * partitions * 2 * bins */
+	float *state;			/* per channel input window (2B) and delay line (partitions * 2 * bins) */
+	float *y;			/* output spectrum (2 * bins) */
+	float *x;			/* output window (2B) */
+};
+
+static inline float fir_from_sample(audio_sample_t v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return (float)v * (1.0f / 2147483648.0f);
+#else
+	return (float)v;
+#endif
+}
+
+static inline audio_sample_t fir_to_sample(float v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	v *= 2147483648.0f;
+
+	if (v >= 2147483647.0f)
+		return INT32_MAX;
+	else if (v <= -2147483647.0f)
+		return -INT32_MAX;
+
+	return (audio_sample_t)v;
+#else
+	return (audio_sample_t)v;
+#endif
+}
+
+static unsigned int fir_state_size(struct fir_element *fir)
+{
+	return 2 * fir->block + fir->partitions * 2 * fir->bins;
+}
+
+static float *fir_window(struct fir_element *fir, unsigned int channel)
+{
+	return fir->state + channel * fir_state_size(fir);
+}
+
+static float *fir_fdl(struct fir_element *fir, unsigned int channel, unsigned int entry)
+{
+	return fir_window(fir, channel) + 2 * fir->block + entry * 2 * fir->bins;
+}
+
+static float *fir_spectrum(struct fir_element *fir, unsigned int channel, unsigned int partition)
+{
+	unsigned int filter = (fir->filters > 1) ? channel : 0;
+
+	return fir->h + (filter * fir->partitions + partition) * 2 * fir->bins;
+}
+
+static int fir_element_run(struct audio_element *element)
+{
+	struct fir_element *fir = element->data;
+	unsigned int block = fir->block, bins = fir->bins;
+	audio_sample_t *in, *out;
+	float *window, *x, *h;
+	unsigned int c, i, p, entry;
+
+	for (c = 0; c < fir->channels; c++) {
+		in = audio_buf_read_addr(fir->in[c], 0);
+		out = audio_buf_write_addr(fir->out[c], 0);
+
+		/* slide the input window by one period */
+		window = fir_window(fir, c);
+		memcpy(window, window + block, block * sizeof(float));
+
+		for (i = 0; i < block; i++)
+			window[block + i] = fir_from_sample(in[i]);
+
+		audio_fft_forward(&fir->fft, window, fir_fdl(fir, c, fir->pos), fir_fdl(fir, c, fir->pos) + bins);
+
+		/* partition p applies to the input spectrum of p periods ago */
+		memset(fir->y, 0, 2 * bins * sizeof(float));
+
+		entry = fir->pos;
+		for (p = 0; p < fir->partitions; p++) {
+			x = fir_fdl(fir, c, entry);
+			h = fir_spectrum(fir, c, p);
+
+			audio_fft_mac(fir->y, fir->y + bins, x, x + bins, h, h + bins, bins);
+
+			entry = entry ? entry - 1 : fir->partitions - 1;
+		}
+
+		audio_fft_inverse(&fir->fft, fir->y, fir->y + bins, fir->x);
+
+		/* the first half is circular convolution aliasing */
+		for (i = 0; i < block; i++)
+			out[i] = fir_to_sample(fir->x[block + i]);
+
+		audio_buf_read_update(fir->in[c], block);
+		audio_buf_write_update(fir->out[c], block);
+	}
+
+	fir->pos = (fir->pos + 1 < fir->partitions) ? fir->pos + 1 : 0;
+
+	return 0;
+}
+
+static void fir_element_reset(struct audio_element *element)
+{
+	struct fir_element *fir = element->data;
+	int i;
+
+	memset(fir->state, 0, fir->channels * fir_state_size(fir) * sizeof(float));
+	fir->pos = 0;
+
+	for (i = 0; i < fir->channels; i++)
+		audio_buf_reset(fir->out[i]);
+}
+
+static void fir_element_exit(struct audio_element *element)
+{
+}
+
+static void fir_element_dump(struct audio_element *element)
+{
+	struct fir_element *fir = element->data;
+	int i;
+
+	log_info("fir(%p/%p)\n", fir, element);
+	log_info("  channels: %u, filters: %u, taps: %u\n", fir->channels, fir->filters, fir->taps);
+	log_info("  partitions: %u x %u, fft: %u, bins: %u\n", fir->partitions, fir->block, fir->fft.size, fir->bins);
+
+	for (i = 0; i < fir->channels; i++) {
+		audio_buf_dump(fir->in[i]);
+		audio_buf_dump(fir->out[i]);
+	}
+}
+
+int fir_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_fir_params fir;
+
+	if (size < sizeof(fir)) {
+		log_err("fir: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&fir, params, sizeof(fir));
+
+	if ((fir.taps > FIR_MAX_TAPS) || (fir.filters > config->inputs) ||
+	    (size != sizeof(fir) + fir.filters * fir.taps * sizeof(float))) {
+		log_err("fir: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	/* coefficients are used in place, the parameters must outlive the element */
+	config->u.fir.taps = fir.taps;
+	config->u.fir.filters = fir.filters;
+	config->u.fir.coef = (uint8_t *)params + sizeof(fir);
+
+	return 0;
+
+err:
+	return -1;
+}
+
+int fir_element_check_config(struct audio_element_config *config)
+{
+	unsigned int taps = config->u.fir.taps;
+	unsigned int filters = config->u.fir.filters;
+	unsigned int period = config->period;
+	float coef;
+	int i;
+
+	if (!config->inputs || (config->outputs != config->inputs)) {
+		log_err("fir: invalid inputs/outputs: %u/%u\n", config->inputs, config->outputs);
+		goto err;
+	}
+
+	if (!taps || (taps > FIR_MAX_TAPS)) {
+		log_err("fir: invalid taps: %u\n", taps);
+		goto err;
+	}
+
+	if ((filters != 1) && (filters != config->inputs)) {
+		log_err("fir: invalid filters: %u\n", filters);
+		goto err;
+	}
+
+	/* the fft size is two periods */
+	if ((period < AUDIO_FFT_MIN_SIZE / 2) || (period > AUDIO_FFT_MAX_SIZE / 2) || (period & (period - 1))) {
+		log_err("fir: unsupported period: %u\n", period);
+		goto err;
+	}
+
+	for (i = 0; i < filters * taps; i++) {
+		memcpy(&coef, (float *)config->u.fir.coef + i, sizeof(coef));
+
+		if (!isfinite(coef)) {
+			log_err("fir: invalid coefficient %u\n", i);
+			goto err;
+		}
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+static void fir_element_geometry(struct fir_element *fir, struct audio_element_config *config)
+{
+	fir->channels = config->inputs;
+	fir->filters = config->u.fir.filters;
+	fir->taps = config->u.fir.taps;
+	fir->block = config->period;
+	fir->partitions = (fir->taps + fir->block - 1) / fir->block;
+	fir->bins = audio_fft_bins(2 * fir->block);
+}
+
+unsigned int fir_element_size(struct audio_element_config *config)
+{
+	struct fir_element fir;
+	unsigned int size;
+
+	fir_element_geometry(&fir, config);
+
+	size = sizeof(struct fir_element);
+	size += 2 * fir.channels * sizeof(struct audio_buffer *);
+	size += audio_fft_storage_size(2 * fir.block);
+	size += fir.filters * fir.partitions * 2 * fir.bins * sizeof(float);
+	size += fir.channels * fir_state_size(&fir) * sizeof(float);
+	size += 2 * fir.bins * sizeof(float);
+	size += 2 * fir.block * sizeof(float);
+
+	/* keep the next element data aligned */
+	return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+int fir_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer)
+{
+	struct fir_element *fir = element->data;
+	float *coef = config->u.fir.coef;
+	float scale, *h;
+	unsigned int f, p, i, n;
+
+	element->run = fir_element_run;
+	element->reset = fir_element_reset;
+	element->exit = fir_element_exit;
+	element->dump = fir_element_dump;
+
+	fir_element_geometry(fir, config);
+
+	fir->in = (struct audio_buffer **)(fir + 1);
+	fir->out = fir->in + fir->channels;
+
+	audio_fft_init(&fir->fft, 2 * fir->block, fir->out + fir->channels);
+
+	fir->h = (float *)((uint8_t *)(fir->out + fir->channels) + audio_fft_storage_size(2 * fir->block));
+	fir->state = fir->h + fir->filters * fir->partitions * 2 * fir->bins;
+	fir->y = fir->state + fir->channels * fir_state_size(fir);
+	fir->x = fir->y + 2 * fir->bins;
+
+	for (i = 0; i < fir->channels; i++) {
+		fir->in[i] = &buffer[config->input[i]];
+		fir->out[i] = &buffer[config->output[i]];
+	}
+
+	/* forward transforms scale by 2, inverse by the fft size */
+	scale = 1.0 / (4.0 * fir->fft.size);
+
+	for (f = 0; f < fir->filters; f++) {
+		for (p = 0; p < fir->partitions; p++) {
+			memset(fir->x, 0, 2 * fir->block * sizeof(float));
+
+			for (i = 0; i < fir->block; i++) {
+				n = p * fir->block + i;
+				if (n >= fir->taps)
+					break;
+
+				memcpy(&fir->x[i], &coef[f * fir->taps + n], sizeof(float));
+				fir->x[i] *= scale;
+			}
+
+			h = fir_spectrum(fir, f, p);
+			audio_fft_forward(&fir->fft, fir->x, h, h + fir->bins);
+		}
+	}
+
+	fir->pos = 0;
+	memset(fir->state, 0, fir->channels * fir_state_size(fir) * sizeof(float));
+
+	fir_element_dump(element);
+
+	return 0;
+}
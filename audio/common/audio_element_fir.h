@@ -0,0 +1,31 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_ELEMENT_FIR_H_
+#define _AUDIO_ELEMENT_FIR_H_
+
+#include "audio_buffer.h"
+
+#include "hrpn_ctrl_audio_pipeline.h"
+
+#define FIR_MAX_TAPS	8192
+
+/* Input buffer n is convolved with a FIR filter to output buffer n */
+struct fir_element_config {
+	unsigned int taps;
+	unsigned int filters;	/* 1 (same for all channels) or inputs */
+	void *coef;		/* filters * taps float coefficients, used in place */
+};
+
+struct audio_element_config;
+struct audio_element;
+
+int fir_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
+int fir_element_check_config(struct audio_element_config *config);
+unsigned int fir_element_size(struct audio_element_config *config);
+int fir_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
+
+#endif /* _AUDIO_ELEMENT_FIR_H_ */
@@ -0,0 +1,552 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+#include "os/semaphore.h"
+#include "os/string.h"
+
+#include "audio_element_latency.h"
+#include "audio_element.h"
+#include "audio_fft.h"
+#include "audio_format.h"
+#include "hrpn_ctrl.h"
+#include "hlog.h"
+#include "mailbox.h"
+#include "stats.h"
+
+/*
+ * Round trip latency measurement
+ *
+ * Every interval, a maximum length sequence (MLS) burst is written to the
+ * output buffer, the rest of the time the output is silent. From the burst
+ * start, the input buffer is cross-correlated with the burst, up to the
+ * maximum latency. The correlation is the convolution with the time reversed
+ * burst, computed as in the fir element (uniformly partitioned overlap-save),
+ * so that the processing cost is the same for every block of input samples
+ * and short periods do not see a full burst length FFT at once.
+ * The latency is the lag of the correlation peak, refined by parabolic
+ * interpolation. A measurement fails if the peak power is not far enough
+ * above the mean correlation power.
+ *
+ * Output and input samples of the same period share the same time index, so
+ * the measured latency includes the whole pipeline, the SAI FIFOs and the
+ * analog path. Results are accumulated in stats (in ns), read by the
+ * control path.
+ */
+#define LATENCY_MLS_ORDER	10
+#define LATENCY_MLS_LENGTH	((1 << LATENCY_MLS_ORDER) - 1)
+#define LATENCY_MLS_TAPS	0x240	/* x^10 + x^7 + 1, Galois form */
+#define LATENCY_BLOCK		256	/* correlation partition size */
+#define LATENCY_PARTITIONS	((LATENCY_MLS_LENGTH + LATENCY_BLOCK - 1) / LATENCY_BLOCK)
+#define LATENCY_MIN_PSR		32.0f	/* correlation peak to mean power, 15 dB */
+#define LATENCY_MAX_RATE	10	/* default max latency, 100ms */
+
+struct latency_element {
+	struct audio_buffer *in;
+	struct audio_buffer *out;
+
+	unsigned int sample_rate;
+	unsigned int interval;		/* in samples */
+	unsigned int max_latency;	/* in samples */
+	audio_sample_t marker;		/* burst amplitude */
+
+	uint64_t time;			/* samples since the element start */
+	uint64_t start;			/* current burst start */
+	unsigned int lfsr;
+
+	unsigned int captured;		/* input samples in the current block */
+	unsigned int blocks;		/* input blocks since the burst start */
+	unsigned int pos;		/* current delay line entry */
+	unsigned int lags;
+	double energy;			/* correlation energy, over all lags */
+	float c_last;			/* previous lag correlation */
+	bool peak_pending;		/* peak_next not known yet */
+	float peak;
+	float peak_prev;
+	float peak_next;
+	unsigned int peak_lag;
+
+	struct audio_fft fft;
+	unsigned int bins;
+	float *h;			/* reversed burst partitions spectra (partitions * 2 * bins) */
+	float *fdl;			/* input spectra delay line (partitions * 2 * bins) */
+	float *window;			/* input, previous and current blocks (2 * block) */
+	float *y;			/* correlation spectrum (2 * bins) */
+	float *c;			/* correlation (2 * block) */
+
+	os_sem_t semaphore;		/* protects the results */
+	struct stats stats;		/* latency, in ns */
+	unsigned int measurements;
+	unsigned int failures;
+	int32_t last;
+};
+
+static void latency_element_response(struct mailbox *m, struct hrpn_resp_audio_element_latency *resp, uint32_t status)
+{
+	if (m) {
+		resp->type = HRPN_RESP_TYPE_AUDIO_ELEMENT_LATENCY;
+		resp->status = status;
+		mailbox_resp_send(m, resp, sizeof(*resp));
+	}
+}
+
+static void latency_element_read(struct latency_element *lat, struct hrpn_resp_audio_element_latency *resp)
+{
+	os_sem_take(&lat->semaphore, 0, OS_SEM_TIMEOUT_MAX);
+
+	resp->sample_rate = lat->sample_rate;
+	resp->measurements = lat->measurements;
+	resp->failures = lat->failures;
+	resp->count = lat->stats.current_count;
+	resp->last = lat->last;
+
+	if (resp->count) {
+		stats_compute(&lat->stats);
+
+		resp->min = lat->stats.min;
+		resp->mean = lat->stats.mean;
+		resp->max = lat->stats.max;
+	}
+
+	if (lat->measurements) {
+		resp->abs_min = lat->stats.abs_min;
+		resp->abs_max = lat->stats.abs_max;
+	}
+
+	stats_reset(&lat->stats);
+
+	os_sem_give(&lat->semaphore, 0);
+}
+
+int latency_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_latency *cmd, unsigned int len, struct mailbox *m)
+{
+	struct hrpn_resp_audio_element_latency resp;
+
+	memset(&resp, 0, sizeof(resp));
+	resp.last = -1;
+
+	if (!element)
+		goto err;
+
+	if (element->type != AUDIO_ELEMENT_LATENCY)
+		goto err;
+
+	switch (cmd->u.common.type) {
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_LATENCY_READ:
+		if (len != sizeof(struct hrpn_cmd_audio_element_latency_read))
+			goto err;
+
+		latency_element_read(element->data, &resp);
+
+		break;
+
+	default:
+		goto err;
+		break;
+	}
+
+	latency_element_response(m, &resp, HRPN_RESP_STATUS_SUCCESS);
+
+	return 0;
+
+err:
+	latency_element_response(m, &resp, HRPN_RESP_STATUS_ERROR);
+
+	return -1;
+}
+
+static inline unsigned int latency_lfsr_next(unsigned int lfsr)
+{
+	return (lfsr >> 1) ^ ((lfsr & 1) ? LATENCY_MLS_TAPS : 0);
+}
+
+static inline float latency_from_sample(audio_sample_t v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return (float)v * (1.0f / 2147483648.0f);
+#else
+	return (float)v;
+#endif
+}
+
+/* Prepares the next measurement, the burst starting at start */
+static void latency_restart(struct latency_element *lat, uint64_t start)
+{
+	lat->start = start;
+	lat->lfsr = 1;
+
+	lat->captured = 0;
+	lat->blocks = 0;
+	lat->pos = 0;
+	lat->lags = 0;
+	lat->energy = 0.0;
+	lat->c_last = 0.0f;
+	lat->peak_pending = false;
+	lat->peak = 0.0f;
+	lat->peak_prev = 0.0f;
+	lat->peak_next = 0.0f;
+	lat->peak_lag = 0;
+
+	/* no input before the burst start */
+	memset(lat->fdl, 0, LATENCY_PARTITIONS * 2 * lat->bins * sizeof(float));
+	memset(lat->window, 0, LATENCY_BLOCK * sizeof(float));
+}
+
+static void latency_result(struct latency_element *lat, uint64_t now)
+{
+	float y0 = fabsf(lat->peak), ym, yp, d, delta = 0.0f;
+	double latency;
+	uint64_t next;
+
+	os_sem_take(&lat->semaphore, 0, OS_SEM_TIMEOUT_MAX);
+
+	if ((lat->energy <= 0.0) || (y0 * y0 * lat->lags < LATENCY_MIN_PSR * lat->energy)) {
+		lat->failures++;
+	} else {
+		/* parabola through the peak and its neighbours, with the peak sign */
+		ym = (lat->peak < 0.0f) ? -lat->peak_prev : lat->peak_prev;
+		yp = (lat->peak < 0.0f) ? -lat->peak_next : lat->peak_next;
+		d = ym - 2.0f * y0 + yp;
+
+		/* no interpolation for a peak at the max latency */
+		if ((d < 0.0f) && !lat->peak_pending)
+			delta = 0.5f * (ym - yp) / d;
+
+		latency = lat->peak_lag + delta;
+
+		stats_update(&lat->stats, (int32_t)(latency * 1000000000.0 / lat->sample_rate));
+		lat->last = (int32_t)(latency * 256.0);
+		lat->measurements++;
+	}
+
+	os_sem_give(&lat->semaphore, 0);
+
+	next = lat->start + lat->interval;
+	if (next < now)
+		next = now;
+
+	latency_restart(lat, next);
+}
+
+static float *latency_fdl(struct latency_element *lat, unsigned int entry)
+{
+	return lat->fdl + entry * 2 * lat->bins;
+}
+
+static float *latency_spectrum(struct latency_element *lat, unsigned int partition)
+{
+	return lat->h + partition * 2 * lat->bins;
+}
+
+/* Correlates the burst with the input, for the lags ending in the current block */
+static void latency_correlate(struct latency_element *lat)
+{
+	unsigned int bins = lat->bins, entry, p, j;
+	double energy = 0.0;
+	float *x, *h, v;
+	int lag;
+
+	audio_fft_forward(&lat->fft, lat->window, latency_fdl(lat, lat->pos), latency_fdl(lat, lat->pos) + bins);
+
+	memset(lat->y, 0, 2 * bins * sizeof(float));
+
+	entry = lat->pos;
+	for (p = 0; p < LATENCY_PARTITIONS; p++) {
+		x = latency_fdl(lat, entry);
+		h = latency_spectrum(lat, p);
+
+		audio_fft_mac(lat->y, lat->y + bins, x, x + bins, h, h + bins, bins);
+
+		entry = entry ? entry - 1 : LATENCY_PARTITIONS - 1;
+	}
+
+	audio_fft_inverse(&lat->fft, lat->y, lat->y + bins, lat->c);
+
+	lat->pos = (lat->pos + 1 < LATENCY_PARTITIONS) ? lat->pos + 1 : 0;
+
+	/*
+	 * Output n of the block (the first half being aliasing) is the
+	 * correlation for the burst ending at input n, i.e the lag is n minus
+	 * the burst length (plus one) since the burst start.
+	 */
+	lag = lat->blocks * LATENCY_BLOCK - (LATENCY_MLS_LENGTH - 1);
+
+	for (j = 0; j < LATENCY_BLOCK; j++, lag++) {
+		if ((lag < 0) || (lag > (int)lat->max_latency))
+			continue;
+
+		v = lat->c[LATENCY_BLOCK + j];
+		energy += v * v;
+
+		if (lat->peak_pending) {
+			lat->peak_next = v;
+			lat->peak_pending = false;
+		}
+
+		if (fabsf(v) > fabsf(lat->peak)) {
+			lat->peak = v;
+			lat->peak_lag = lag;
+			lat->peak_prev = lat->c_last;
+			lat->peak_pending = true;
+		}
+
+		lat->c_last = v;
+		lat->lags++;
+	}
+
+	lat->energy += energy;
+}
+
+static int latency_element_run(struct audio_element *element)
+{
+	struct latency_element *lat = element->data;
+	unsigned int period = element->period;
+	audio_sample_t *in, *out;
+	unsigned int i, j, n;
+	uint64_t t;
+
+	/* burst */
+	if ((lat->time + period <= lat->start) || (lat->time >= lat->start + LATENCY_MLS_LENGTH)) {
+		audio_buf_write_silence(lat->out, period);
+	} else {
+		out = audio_buf_write_addr(lat->out, 0);
+
+		for (i = 0; i < period; i++) {
+			t = lat->time + i;
+
+			if ((t >= lat->start) && (t < lat->start + LATENCY_MLS_LENGTH)) {
+				out[i] = (lat->lfsr & 1) ? lat->marker : -lat->marker;
+				lat->lfsr = latency_lfsr_next(lat->lfsr);
+			} else {
+				out[i] = AUDIO_SAMPLE_SILENCE;
+			}
+		}
+
+		audio_buf_write_update(lat->out, period);
+	}
+
+	/* capture, from the burst start */
+	in = audio_buf_read_addr(lat->in, 0);
+
+	i = (lat->start > lat->time) ? lat->start - lat->time : 0;
+
+	for (; i < period; i += n) {
+		n = period - i;
+		if (n > LATENCY_BLOCK - lat->captured)
+			n = LATENCY_BLOCK - lat->captured;
+
+		for (j = 0; j < n; j++)
+			lat->window[LATENCY_BLOCK + lat->captured + j] = latency_from_sample(in[i + j]);
+
+		lat->captured += n;
+
+		if (lat->captured < LATENCY_BLOCK)
+			continue;
+
+		latency_correlate(lat);
+
+		memcpy(lat->window, lat->window + LATENCY_BLOCK, LATENCY_BLOCK * sizeof(float));
+		lat->captured = 0;
+		lat->blocks++;
+
+		/* all lags are done */
+		if (lat->blocks * LATENCY_BLOCK > lat->max_latency + LATENCY_MLS_LENGTH - 1) {
+			latency_result(lat, lat->time + period);
+			break;
+		}
+	}
+
+	audio_buf_read_update(lat->in, period);
+
+	lat->time += period;
+
+	return 0;
+}
+
+static void latency_element_reset(struct audio_element *element)
+{
+	struct latency_element *lat = element->data;
+
+	/* the current measurement is dropped */
+	latency_restart(lat, lat->time + lat->interval);
+
+	audio_buf_reset(lat->out);
+}
+
+static void latency_element_exit(struct audio_element *element)
+{
+	struct latency_element *lat = element->data;
+
+	os_sem_destroy(&lat->semaphore);
+}
+
+static void latency_element_dump(struct audio_element *element)
+{
+	struct latency_element *lat = element->data;
+
+	log_info("latency(%p/%p)\n", lat, element);
+	log_info("  interval: %u, max latency: %u, mls: %u samples\n", lat->interval, lat->max_latency, LATENCY_MLS_LENGTH);
+	audio_buf_dump(lat->in);
+	audio_buf_dump(lat->out);
+}
+
+static void latency_element_stats(struct audio_element *element)
+{
+	struct latency_element *lat = element->data;
+
+	log_info("latency(%p), measurements: %u, failures: %u, last: %d/256 samples\n",
+		 lat, lat->measurements, lat->failures, lat->last);
+}
+
+int latency_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_latency_params latency;
+
+	if (size != sizeof(latency)) {
+		log_err("latency: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&latency, params, sizeof(latency));
+
+	config->u.latency.interval_ms = latency.interval_ms;
+	config->u.latency.max_latency = latency.max_latency;
+	config->u.latency.amplitude = latency.amplitude;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+static void latency_element_params(struct audio_element_config *config, unsigned int *interval, unsigned int *max_latency, double *amplitude)
+{
+	unsigned int interval_ms = config->u.latency.interval_ms;
+
+	if (!interval_ms)
+		interval_ms = LATENCY_DEFAULT_INTERVAL_MS;
+
+	*interval = ((uint64_t)interval_ms * config->sample_rate) / 1000;
+
+	*max_latency = config->u.latency.max_latency;
+	if (!*max_latency)
+		*max_latency = config->sample_rate / LATENCY_MAX_RATE;
+
+	*amplitude = config->u.latency.amplitude;
+	if (*amplitude == 0.0)
+		*amplitude = LATENCY_DEFAULT_AMPLITUDE;
+}
+
+int latency_element_check_config(struct audio_element_config *config)
+{
+	unsigned int interval, max_latency;
+	double amplitude;
+
+	latency_element_params(config, &interval, &max_latency, &amplitude);
+
+	if ((config->inputs != 1) || (config->outputs != 1)) {
+		log_err("latency: invalid inputs/outputs: %u/%u\n", config->inputs, config->outputs);
+		goto err;
+	}
+
+	if (max_latency > config->sample_rate) {
+		log_err("latency: invalid max latency: %u\n", max_latency);
+		goto err;
+	}
+
+	/* the previous burst must be over, in the input, before the next one */
+	if (interval <= max_latency + LATENCY_MLS_LENGTH) {
+		log_err("latency: invalid interval: %u\n", interval);
+		goto err;
+	}
+
+	if (!(amplitude > 0.0) || (amplitude > 1.0)) {
+		log_err("latency: invalid amplitude: %f\n", amplitude);
+		goto err;
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+unsigned int latency_element_size(struct audio_element_config *config)
+{
+	unsigned int bins = audio_fft_bins(2 * LATENCY_BLOCK);
+	unsigned int size;
+
+	size = sizeof(struct latency_element);
+	size += audio_fft_storage_size(2 * LATENCY_BLOCK);
+	size += (2 * LATENCY_PARTITIONS + 1) * 2 * bins * sizeof(float);
+	size += 2 * 2 * LATENCY_BLOCK * sizeof(float);
+
+	/* keep the next element data aligned */
+	return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+int latency_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer)
+{
+	struct latency_element *lat = element->data;
+	unsigned int lfsr, k, p;
+	double amplitude;
+	float *h;
+
+	if (os_sem_init(&lat->semaphore, 1))
+		goto err;
+
+	element->run = latency_element_run;
+	element->reset = latency_element_reset;
+	element->exit = latency_element_exit;
+	element->dump = latency_element_dump;
+	element->stats = latency_element_stats;
+
+	lat->in = &buffer[config->input[0]];
+	lat->out = &buffer[config->output[0]];
+
+	lat->sample_rate = config->sample_rate;
+	latency_element_params(config, &lat->interval, &lat->max_latency, &amplitude);
+	lat->marker = audio_double_to_sample(amplitude);
+
+	audio_fft_init(&lat->fft, 2 * LATENCY_BLOCK, lat + 1);
+	lat->bins = audio_fft_bins(2 * LATENCY_BLOCK);
+
+	lat->h = (float *)((uint8_t *)(lat + 1) + audio_fft_storage_size(2 * LATENCY_BLOCK));
+	lat->fdl = lat->h + LATENCY_PARTITIONS * 2 * lat->bins;
+	lat->y = lat->fdl + LATENCY_PARTITIONS * 2 * lat->bins;
+	lat->window = lat->y + 2 * lat->bins;
+	lat->c = lat->window + 2 * LATENCY_BLOCK;
+
+	/* time reversed burst, one partition at a time, zero padded to the fft size */
+	for (p = 0; p < LATENCY_PARTITIONS; p++) {
+		memset(lat->c, 0, 2 * LATENCY_BLOCK * sizeof(float));
+
+		for (k = 0, lfsr = 1; k < LATENCY_MLS_LENGTH; k++) {
+			if ((LATENCY_MLS_LENGTH - 1 - k) / LATENCY_BLOCK == p)
+				lat->c[(LATENCY_MLS_LENGTH - 1 - k) % LATENCY_BLOCK] = (lfsr & 1) ? 1.0f : -1.0f;
+
+			lfsr = latency_lfsr_next(lfsr);
+		}
+
+		h = latency_spectrum(lat, p);
+		audio_fft_forward(&lat->fft, lat->c, h, h + lat->bins);
+	}
+
+	stats_init(&lat->stats, 31, "latency", NULL);
+	lat->measurements = 0;
+	lat->failures = 0;
+	lat->last = -1;
+
+	lat->time = 0;
+	latency_restart(lat, lat->interval);
+
+	latency_element_dump(element);
+
+	return 0;
+
+err:
+	return -1;
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_ELEMENT_LATENCY_H_
+#define _AUDIO_ELEMENT_LATENCY_H_
+
+#include "audio_buffer.h"
+
+#include "hrpn_ctrl_audio_pipeline.h"
+
+#define LATENCY_DEFAULT_INTERVAL_MS	1000
+#define LATENCY_DEFAULT_AMPLITUDE	0.25
+
+/*
+ * Injects a marker on the output buffer (sink side) and finds it back in the
+ * input buffer (source side), measuring the round trip latency in samples.
+ */
+struct latency_element_config {
+	unsigned int interval_ms;	/* 0 for default */
+	unsigned int max_latency;	/* in samples, 0 for default */
+	double amplitude;		/* 0 for default */
+};
+
+struct audio_element_config;
+struct audio_element;
+
+struct mailbox;
+
+int latency_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_latency *cmd, unsigned int len, struct mailbox *m);
+int latency_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
+int latency_element_check_config(struct audio_element_config *config);
+unsigned int latency_element_size(struct audio_element_config *config);
+int latency_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
+
+#endif /* _AUDIO_ELEMENT_LATENCY_H_ */
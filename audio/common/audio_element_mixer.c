@@ -0,0 +1,545 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+#include "os/semaphore.h"
+#include "os/string.h"
+
+#include "audio_element_mixer.h"
+#include "audio_element.h"
+#include "audio_format.h"
+#include "hrpn_ctrl.h"
+#include "hlog.h"
+#include "mailbox.h"
+
+/*
+ * Mixing matrix
+ *
+ * Each output is the sum of the inputs with a non zero gain, the others are
+ * skipped, so the cost follows the number of active entries and not the
+ * matrix size. Outputs without any active entry are silent.
+ *
+ * With the int32 format, gains are Q28 (range [-8.0, 8.0[), each product
+ * is rounded to Q31 and accumulated with 64bit precision, so that the sum
+ * saturates instead of wrapping around. Other formats accumulate directly
+ * in the output buffer.
+ */
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+typedef int32_t mixer_gain_t;
+typedef int64_t mixer_acc_t;
+#define MIXER_GAIN_SHIFT	28
+#else
+typedef audio_sample_t mixer_gain_t;
+typedef audio_sample_t mixer_acc_t;
+#endif
+
+#if defined(__GNUC__) && !defined(AUDIO_FORMAT_NO_VECTOR)
+#define MIXER_VECTOR
+#define MIXER_LANES	AUDIO_FORMAT_VECTOR
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+typedef int64_t mixer_v_t __attribute__((vector_size(MIXER_LANES * sizeof(int64_t)), may_alias, aligned(sizeof(int64_t))));
+#define mixer_load(p)	__builtin_convertvector(*(audio_v4si_t *)(p), mixer_v_t)
+#else
+typedef audio_v4s_t mixer_v_t;
+#define mixer_load(p)	(*(audio_v4s_t *)(p))
+#endif
+#endif
+
+/*
+ * Per table, the active entries of each output are listed, for the steady
+ * state (non zero gains) and for the switch from the previous table
+ * (non zero gains in either table).
+ */
+struct mixer_table {
+	mixer_gain_t *gain;	/* outputs * inputs */
+	uint8_t *count;		/* active entries, per output */
+	uint8_t *index;		/* active entries inputs, outputs * inputs */
+	uint8_t *ramp_count;
+	uint8_t *ramp_index;
+};
+
+/*
+ * The gains table is double buffered, like the routing table, so that neither
+ * path ever blocks:
+ * - the data path takes the published table (if any), at the start of a period,
+ *   ramping the gains linearly from the ones in use over that period (so that
+ *   gain changes don't cause zipper noise), and copies its gains at the end
+ * - the control path takes back the published table, if the data path didn't
+ *   take it yet, and updates it in place, or otherwise updates the other table.
+ *   Then publishes it.
+ * Either way, the other table is the last one taken by the data path, the
+ * ramp lists are built against it.
+ */
+struct mixer_element {
+	struct audio_buffer **in;
+	struct audio_buffer **out;
+	mixer_acc_t *acc;		/* int32 format accumulator, one period */
+	mixer_gain_t *gain;		/* outputs * inputs, gains in use by the data path */
+	unsigned int inputs;
+	unsigned int outputs;
+	struct mixer_table table[2];
+	unsigned int table_pub;		/* table published by the control path, not yet taken by the data path */
+	unsigned int table_cur;		/* last table taken by the data path */
+	unsigned int table_last;	/* last table updated by the control path */
+	os_sem_t semaphore;		/* serializes control path */
+};
+
+#define MIXER_TABLE_NONE	2
+
+static void mixer_element_response(struct mailbox *m, uint32_t status)
+{
+	struct hrpn_resp_audio_element_mixer resp;
+
+	if (m) {
+		resp.type = HRPN_RESP_TYPE_AUDIO_ELEMENT_MIXER;
+		resp.status = status;
+		mailbox_resp_send(m, &resp, sizeof(resp));
+	}
+}
+
+static inline mixer_gain_t mixer_from_double(double v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	double q = v * (1 << MIXER_GAIN_SHIFT) + ((v >= 0.0) ? 0.5 : -0.5);
+
+	/* MIXER_GAIN_MAX itself is not representable */
+	if (q > INT32_MAX)
+		return INT32_MAX;
+	else if (q < -INT32_MAX)
+		return -INT32_MAX;
+
+	return (mixer_gain_t)q;
+#else
+	return (mixer_gain_t)v;
+#endif
+}
+
+static inline double mixer_to_double(mixer_gain_t v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return (double)v / (1 << MIXER_GAIN_SHIFT);
+#else
+	return (double)v;
+#endif
+}
+
+static inline mixer_acc_t *mixer_acc(struct mixer_element *mixer, audio_sample_t *out)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return mixer->acc;
+#else
+	return out;
+#endif
+}
+
+static inline void mixer_store(audio_sample_t *out, mixer_acc_t *acc, unsigned int period)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	int i;
+
+	for (i = 0; i < period; i++) {
+		if (acc[i] > INT32_MAX)
+			out[i] = INT32_MAX;
+		else if (acc[i] < -INT32_MAX)
+			out[i] = -INT32_MAX;
+		else
+			out[i] = acc[i];
+	}
+#endif
+}
+
+static int mixer_gain_check(struct mixer_element *mixer, struct hrpn_audio_mixer_gain *gain)
+{
+	if ((gain->input >= mixer->inputs) || (gain->output >= mixer->outputs) ||
+	    !(fabs(gain->gain) <= MIXER_GAIN_MAX)) {
+		log_err("mixer: invalid gain %u -> %u: %f\n", gain->input, gain->output, gain->gain);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Lists the active entries of a table, and of the switch from the previous one */
+static void mixer_table_update(struct mixer_element *mixer, struct mixer_table *table, struct mixer_table *prev)
+{
+	unsigned int o, i, n;
+
+	for (o = 0; o < mixer->outputs; o++) {
+		table->count[o] = 0;
+		table->ramp_count[o] = 0;
+
+		for (i = 0; i < mixer->inputs; i++) {
+			n = o * mixer->inputs + i;
+
+			if (table->gain[n])
+				table->index[o * mixer->inputs + table->count[o]++] = i;
+
+			if (table->gain[n] || prev->gain[n])
+				table->ramp_index[o * mixer->inputs + table->ramp_count[o]++] = i;
+		}
+	}
+}
+
+static int mixer_element_gain_update(struct audio_element *element, struct hrpn_audio_mixer_gain *gain)
+{
+	struct mixer_element *mixer = element->data;
+	unsigned int next;
+
+	os_sem_take(&mixer->semaphore, 0, OS_SEM_TIMEOUT_MAX);
+
+	next = __atomic_exchange_n(&mixer->table_pub, MIXER_TABLE_NONE, __ATOMIC_ACQ_REL);
+
+	/* The data path took the last updated table, update the other one */
+	if (next == MIXER_TABLE_NONE) {
+		next = mixer->table_last ^ 1;
+
+		memcpy(mixer->table[next].gain, mixer->table[mixer->table_last].gain, mixer->outputs * mixer->inputs * sizeof(mixer_gain_t));
+	}
+
+	mixer->table[next].gain[gain->output * mixer->inputs + gain->input] = mixer_from_double(gain->gain);
+
+	/* the data path ramps from the gains of the other table to the new ones */
+	mixer_table_update(mixer, &mixer->table[next], &mixer->table[next ^ 1]);
+
+	mixer->table_last = next;
+
+	__atomic_store_n(&mixer->table_pub, next, __ATOMIC_RELEASE);
+
+	os_sem_give(&mixer->semaphore, 0);
+
+	return 0;
+}
+
+int mixer_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_mixer *cmd, unsigned int len, struct mailbox *m)
+{
+	struct hrpn_audio_mixer_gain gain;
+
+	if (!element)
+		goto err;
+
+	if (element->type != AUDIO_ELEMENT_MIXER)
+		goto err;
+
+	switch (cmd->u.common.type) {
+	case HRPN_CMD_TYPE_AUDIO_ELEMENT_MIXER_SET:
+		if (len != sizeof(struct hrpn_cmd_audio_element_mixer_set))
+			goto err;
+
+		memcpy(&gain, &cmd->u.set.gain, sizeof(gain));
+
+		if (mixer_gain_check(element->data, &gain) < 0)
+			goto err;
+
+		if (mixer_element_gain_update(element, &gain) < 0)
+			goto err;
+
+		break;
+
+	default:
+		goto err;
+		break;
+	}
+
+	mixer_element_response(m, HRPN_RESP_STATUS_SUCCESS);
+
+	return 0;
+
+err:
+	mixer_element_response(m, HRPN_RESP_STATUS_ERROR);
+
+	return -1;
+}
+
+/*
+ * Accumulates an input scaled by a gain, over a period. With ramp set, the
+ * gain steps linearly from "from" to "to", reaching it on the last sample.
+ */
+static inline void mixer_mac(mixer_acc_t *acc, audio_sample_t *in, mixer_gain_t from, mixer_gain_t to,
+			     bool ramp, unsigned int period)
+{
+	mixer_acc_t g = to, d = 0;
+	unsigned int i = 0;
+
+	if (ramp)
+		d = ((mixer_acc_t)to - (mixer_acc_t)from) / (mixer_acc_t)period;
+
+#if defined(MIXER_VECTOR)
+	{
+		const mixer_v_t step = {1, 2, 3, 4};
+		mixer_v_t gv = {g, g, g, g};
+
+		if (ramp)
+			gv = (mixer_acc_t)from + d * step;
+
+		for (; i + MIXER_LANES <= period; i += MIXER_LANES) {
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+			*(mixer_v_t *)&acc[i] += (gv * mixer_load(&in[i]) + (1 << (MIXER_GAIN_SHIFT - 1))) >> MIXER_GAIN_SHIFT;
+#else
+			*(mixer_v_t *)&acc[i] += gv * mixer_load(&in[i]);
+#endif
+			if (ramp)
+				gv += d * MIXER_LANES;
+		}
+	}
+#endif
+
+	for (; i < period; i++) {
+		if (ramp)
+			g = (mixer_acc_t)from + d * (mixer_acc_t)(i + 1);
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+		acc[i] += (g * in[i] + (1 << (MIXER_GAIN_SHIFT - 1))) >> MIXER_GAIN_SHIFT;
+#else
+		acc[i] += g * in[i];
+#endif
+	}
+}
+
+static int mixer_element_run(struct audio_element *element)
+{
+	struct mixer_element *mixer = element->data;
+	struct mixer_table *table;
+	unsigned int next, o, k, i, n, count;
+	audio_sample_t *out;
+	mixer_acc_t *acc;
+	uint8_t *index;
+	bool ramp = false;
+
+	/* Switch to the published gains table, if any */
+	if (__atomic_load_n(&mixer->table_pub, __ATOMIC_RELAXED) != MIXER_TABLE_NONE) {
+		next = __atomic_exchange_n(&mixer->table_pub, MIXER_TABLE_NONE, __ATOMIC_ACQ_REL);
+		if (next != MIXER_TABLE_NONE) {
+			mixer->table_cur = next;
+			ramp = true;
+		}
+	}
+
+	table = &mixer->table[mixer->table_cur];
+
+	for (o = 0; o < mixer->outputs; o++) {
+		if (ramp) {
+			count = table->ramp_count[o];
+			index = &table->ramp_index[o * mixer->inputs];
+		} else {
+			count = table->count[o];
+			index = &table->index[o * mixer->inputs];
+		}
+
+		if (!count) {
+			audio_buf_write_silence(mixer->out[o], element->period);
+			continue;
+		}
+
+		out = audio_buf_write_addr(mixer->out[o], 0);
+		acc = mixer_acc(mixer, out);
+
+		memset(acc, 0, element->period * sizeof(mixer_acc_t));
+
+		for (k = 0; k < count; k++) {
+			i = index[k];
+			n = o * mixer->inputs + i;
+
+			if (ramp)
+				mixer_mac(acc, audio_buf_read_addr(mixer->in[i], 0), mixer->gain[n], table->gain[n], true, element->period);
+			else
+				mixer_mac(acc, audio_buf_read_addr(mixer->in[i], 0), table->gain[n], table->gain[n], false, element->period);
+		}
+
+		mixer_store(out, acc, element->period);
+
+		audio_buf_write_update(mixer->out[o], element->period);
+	}
+
+	for (i = 0; i < mixer->inputs; i++)
+		audio_buf_read_update(mixer->in[i], element->period);
+
+	/* The previous gains are no longer used */
+	if (ramp)
+		memcpy(mixer->gain, table->gain, mixer->outputs * mixer->inputs * sizeof(mixer_gain_t));
+
+	return 0;
+}
+
+static void mixer_element_reset(struct audio_element *element)
+{
+	struct mixer_element *mixer = element->data;
+	int i;
+
+	for (i = 0; i < mixer->outputs; i++)
+		audio_buf_reset(mixer->out[i]);
+}
+
+static void mixer_element_exit(struct audio_element *element)
+{
+	struct mixer_element *mixer = element->data;
+
+	os_sem_destroy(&mixer->semaphore);
+}
+
+static void mixer_element_dump(struct audio_element *element)
+{
+	struct mixer_element *mixer = element->data;
+	struct mixer_table *table = &mixer->table[mixer->table_last];
+	unsigned int o, k, i;
+
+	log_info("mixer(%p/%p)\n", mixer, element);
+	log_info("  inputs: %u, outputs: %u\n", mixer->inputs, mixer->outputs);
+
+	for (o = 0; o < mixer->outputs; o++) {
+		for (k = 0; k < table->count[o]; k++) {
+			i = table->index[o * mixer->inputs + k];
+
+			log_info("  %u -> %u: %f\n", i, o, mixer_to_double(table->gain[o * mixer->inputs + i]));
+		}
+	}
+
+	for (i = 0; i < mixer->inputs; i++)
+		audio_buf_dump(mixer->in[i]);
+
+	for (o = 0; o < mixer->outputs; o++)
+		audio_buf_dump(mixer->out[o]);
+}
+
+int mixer_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_mixer_params mixer;
+
+	if (size < sizeof(mixer)) {
+		log_err("mixer: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&mixer, params, sizeof(mixer));
+
+	if ((mixer.gains > config->inputs * config->outputs) ||
+	    (size != sizeof(mixer) + mixer.gains * sizeof(struct hrpn_audio_mixer_gain))) {
+		log_err("mixer: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	/* gains are used in place, the parameters must outlive the element */
+	config->u.mixer.gains = mixer.gains;
+	config->u.mixer.gain = mixer.gains ? (uint8_t *)params + sizeof(mixer) : NULL;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+int mixer_element_check_config(struct audio_element_config *config)
+{
+	struct hrpn_audio_mixer_gain gain;
+	struct mixer_element mixer;
+	int i;
+
+	if (!config->inputs || !config->outputs) {
+		log_err("mixer: invalid inputs/outputs: %u/%u\n", config->inputs, config->outputs);
+		goto err;
+	}
+
+	mixer.inputs = config->inputs;
+	mixer.outputs = config->outputs;
+
+	for (i = 0; i < config->u.mixer.gains; i++) {
+		memcpy(&gain, (struct hrpn_audio_mixer_gain *)config->u.mixer.gain + i, sizeof(gain));
+
+		if (mixer_gain_check(&mixer, &gain) < 0)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+unsigned int mixer_element_size(struct audio_element_config *config)
+{
+	unsigned int entries = config->inputs * config->outputs;
+	unsigned int size;
+
+	size = sizeof(struct mixer_element);
+	size += (config->inputs + config->outputs) * sizeof(struct audio_buffer *);
+	size += config->period * sizeof(mixer_acc_t);
+	size += 3 * entries * sizeof(mixer_gain_t);
+	size += 2 * 2 * (config->outputs + entries) * sizeof(uint8_t);
+
+	/* keep the next element data aligned */
+	return (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+}
+
+int mixer_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer)
+{
+	struct mixer_element *mixer = element->data;
+	struct hrpn_audio_mixer_gain gain, *params = config->u.mixer.gain;
+	unsigned int entries = config->inputs * config->outputs;
+	struct mixer_table *table;
+	mixer_gain_t *gains;
+	uint8_t *lists;
+	int i;
+
+	if (os_sem_init(&mixer->semaphore, 1))
+		goto err;
+
+	element->run = mixer_element_run;
+	element->reset = mixer_element_reset;
+	element->exit = mixer_element_exit;
+	element->dump = mixer_element_dump;
+
+	mixer->inputs = config->inputs;
+	mixer->outputs = config->outputs;
+
+	mixer->in = (struct audio_buffer **)(mixer + 1);
+	mixer->out = mixer->in + mixer->inputs;
+	mixer->acc = (mixer_acc_t *)(mixer->out + mixer->outputs);
+
+	gains = (mixer_gain_t *)(mixer->acc + config->period);
+	mixer->gain = gains + 2 * entries;
+	lists = (uint8_t *)(gains + 3 * entries);
+
+	for (i = 0; i < 2; i++) {
+		table = &mixer->table[i];
+
+		table->gain = gains + i * entries;
+		table->count = lists;
+		table->ramp_count = table->count + mixer->outputs;
+		table->index = table->ramp_count + mixer->outputs;
+		table->ramp_index = table->index + entries;
+		lists = table->ramp_index + entries;
+	}
+
+	for (i = 0; i < mixer->inputs; i++)
+		mixer->in[i] = &buffer[config->input[i]];
+
+	for (i = 0; i < mixer->outputs; i++)
+		mixer->out[i] = &buffer[config->output[i]];
+
+	table = &mixer->table[0];
+
+	memset(table->gain, 0, entries * sizeof(mixer_gain_t));
+
+	for (i = 0; i < config->u.mixer.gains; i++) {
+		memcpy(&gain, &params[i], sizeof(gain));
+
+		table->gain[gain.output * mixer->inputs + gain.input] = mixer_from_double(gain.gain);
+	}
+
+	mixer_table_update(mixer, table, table);
+
+	memcpy(mixer->gain, table->gain, entries * sizeof(mixer_gain_t));
+
+	mixer->table_pub = MIXER_TABLE_NONE;
+	mixer->table_cur = 0;
+	mixer->table_last = 0;
+
+	mixer_element_dump(element);
+
+	return 0;
+
+err:
+	return -1;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_ELEMENT_MIXER_H_
+#define _AUDIO_ELEMENT_MIXER_H_
+
+#include "audio_buffer.h"
+
+#include "hrpn_ctrl_audio_pipeline.h"
+
+#define MIXER_GAIN_MAX	8.0	/* linear, about +18 dB */
+
+/* Output buffer m is the sum of the input buffers n, scaled by gain[m][n] */
+struct mixer_element_config {
+	unsigned int gains;	/* non zero matrix entries */
+	void *gain;		/* struct hrpn_audio_mixer_gain records, used in place */
+};
+
+struct audio_element_config;
+struct audio_element;
+
+struct mailbox;
+
+int mixer_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_mixer *cmd, unsigned int len, struct mailbox *m);
+int mixer_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
+int mixer_element_check_config(struct audio_element_config *config);
+unsigned int mixer_element_size(struct audio_element_config *config);
+int mixer_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
+
+#endif /* _AUDIO_ELEMENT_MIXER_H_ */
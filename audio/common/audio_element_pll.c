@@ -5,6 +5,7 @@
  */
 
 #include "os/semaphore.h"
+#include "os/string.h"
 
 #include "audio_element_pll.h"
 #include "audio_element.h"
@@ -297,6 +298,8 @@ static void pll_element_exit(struct audio_element *element)
 	struct pll_element *pll = element->data;
 
 	pll_adjust(pll->pll_id, 0);
+
+	os_sem_destroy(&pll->semaphore);
 }
 
 static void pll_element_dump(struct audio_element *element)
@@ -323,6 +326,27 @@ static void pll_element_stats(struct audio_element *element)
 	stats_reset(&pll->stats.bclk_ppb);
 }
 
+int pll_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_pll_params pll;
+
+	if (size != sizeof(pll)) {
+		log_err("pll: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&pll, params, sizeof(pll));
+
+	config->u.pll.src_sai_id = pll.src_sai_id;
+	config->u.pll.dst_sai_id = pll.dst_sai_id;
+	config->u.pll.pll_id = pll.pll_id;
+
+	return 0;
+
+err:
+	return -1;
+}
+
 int pll_element_check_config(struct audio_element_config *config)
 {
 	return 0;
@@ -349,6 +373,8 @@ int pll_element_init(struct audio_element *element, struct audio_element_config
 
 	pll->enabled = true;
 	pll->period = (PLL_SAMPLING_PERIOD_MS * element->sample_rate) / element->period / 1000;
+	if (!pll->period)
+		pll->period = 1;
 	pll->prev_bclk_ppb = 0;
 	pll->_kp = 4;
 	pll->_ki = 64;
@@ -23,6 +23,7 @@ struct audio_element;
 struct mailbox;
 
 int pll_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_pll *cmd, unsigned int len, struct mailbox *m);
+int pll_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
 int pll_element_check_config(struct audio_element_config *config);
 unsigned int pll_element_size(struct audio_element_config *config);
 int pll_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
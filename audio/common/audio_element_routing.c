@@ -5,6 +5,7 @@
  */
 
 #include "os/semaphore.h"
+#include "os/string.h"
 
 #include "audio_element_routing.h"
 #include "audio_element.h"
@@ -13,20 +14,38 @@
 #include "hlog.h"
 #include "mailbox.h"
 
-struct routing_output {
+/* Routing table entry, one per output */
+struct routing_map {
 	unsigned int input;	/* input mapped to this output */
-	struct audio_buffer *buf;
+	bool view;		/* output is a view of the input (no copy) */
 };
 
+/*
+ * The routing table is double buffered, so that neither path ever blocks:
+ * - the data path takes the published table (if any), at the start of a period,
+ *   and switches to it
+ * - the control path takes back the published table, if the data path didn't
+ *   take it yet, and updates it in place (the data path still uses the other one),
+ *   or otherwise updates the table not in use. Then publishes it.
+ * Taking the published table is an atomic exchange, so only one of the paths
+ * gets it (e.g, while the pipeline is stopped, the control path gets it back
+ * for each update).
+ */
 struct routing_element {
 	unsigned int inputs;
 	unsigned int outputs;
 	struct audio_buffer **in;
-	struct routing_output *out;
-	os_sem_t semaphore;
+	struct audio_buffer **out;
+	struct routing_map *map[2];
+	unsigned int map_pub;	/* table published by the control path, not yet taken by the data path */
+	unsigned int map_cur;	/* table in use by the data path */
+	unsigned int map_last;	/* last table updated by the control path */
+	os_sem_t semaphore;	/* serializes control path */
 	struct audio_buffer silence; /* internal buffer with silence, used for "disconnected" outputs */
 };
 
+#define ROUTING_MAP_NONE	2
+
 static void routing_element_response(struct mailbox *m, uint32_t status)
 {
 	struct hrpn_resp_audio_element_routing resp;
@@ -38,6 +57,67 @@ static void routing_element_response(struct mailbox *m, uint32_t status)
 	}
 }
 
+/*
+ * Only the first output mapped to a given input can be a view of it, the
+ * others get a copy (the consumer of a view may modify the samples in place).
+ * The input storage must hold at least two periods, so that the aliased period
+ * is not overwritten by the input producer before the view is consumed.
+ * The internal silence input is never aliased.
+ */
+static void routing_element_update_views(struct routing_element *routing, struct routing_map *map, unsigned int period)
+{
+	unsigned int input;
+	int i, j;
+
+	for (i = 0; i < routing->outputs; i++) {
+		input = map[i].input;
+
+		map[i].view = false;
+
+		if (input == routing->inputs)
+			continue;
+
+		if (routing->in[input]->size < 2 * period)
+			continue;
+
+		for (j = 0; j < i; j++)
+			if (map[j].input == input)
+				break;
+
+		if (j == i)
+			map[i].view = true;
+	}
+}
+
+static int routing_element_map_update(struct audio_element *element, unsigned int output, unsigned int input)
+{
+	struct routing_element *routing = element->data;
+	unsigned int next;
+
+	os_sem_take(&routing->semaphore, 0, OS_SEM_TIMEOUT_MAX);
+
+	next = __atomic_exchange_n(&routing->map_pub, ROUTING_MAP_NONE, __ATOMIC_ACQ_REL);
+
+	/* The data path switched to the last updated table, update the other one */
+	if (next == ROUTING_MAP_NONE) {
+		next = routing->map_last ^ 1;
+
+		memcpy(routing->map[next], routing->map[routing->map_last], routing->outputs * sizeof(struct routing_map));
+	}
+
+	routing->map[next][output].input = input;
+
+	routing_element_update_views(routing, routing->map[next], element->period);
+
+	routing->map_last = next;
+
+	__atomic_store_n(&routing->map_pub, next, __ATOMIC_RELEASE);
+
+	os_sem_give(&routing->semaphore, 0);
+
+	return 0;
+}
+
 int routing_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_element_routing *cmd, unsigned int len, struct mailbox *m)
 {
 	struct routing_element *routing;
@@ -84,11 +164,8 @@ int routing_element_ctrl(struct audio_element *element, struct hrpn_cmd_audio_el
 		break;
 	}
 
-	os_sem_take(&routing->semaphore, 0, OS_SEM_TIMEOUT_MAX);
-
-	routing->out[output].input = input;
-
-	os_sem_give(&routing->semaphore, 0);
+	if (routing_element_map_update(element, output, input) < 0)
+		goto err;
 
 	routing_element_response(m, HRPN_RESP_STATUS_SUCCESS);
 
@@ -104,22 +181,34 @@ static int routing_element_run(struct audio_element *element)
 {
 	struct routing_element *routing = element->data;
 	struct audio_buffer *in, *out;
+	struct routing_map *map;
+	unsigned int next;
 	int i;
 
-	os_sem_take(&routing->semaphore, 0, OS_SEM_TIMEOUT_MAX);
+	/* Switch to the published routing table, if any */
+	if (__atomic_load_n(&routing->map_pub, __ATOMIC_RELAXED) != ROUTING_MAP_NONE) {
+		next = __atomic_exchange_n(&routing->map_pub, ROUTING_MAP_NONE, __ATOMIC_ACQ_REL);
+		if (next != ROUTING_MAP_NONE)
+			routing->map_cur = next;
+	}
 
-	/* Copy data from inputs to outputs */
+	map = routing->map[routing->map_cur];
+
+	/* Forward (view) or copy data from inputs to outputs */
 	for (i = 0; i < routing->outputs; i++) {
-		in = routing->in[routing->out[i].input];
-		out = routing->out[i].buf;
+		in = routing->in[map[i].input];
+		out = routing->out[i];
+
+		if (map[i].view && audio_buf_view(out, in, element->period))
+			continue;
+
+		audio_buf_view_release(out);
 
 		__audio_buf_copy(out, in, element->period);
 
 		audio_buf_write_update(out, element->period);
 	}
 
-	os_sem_give(&routing->semaphore, 0);
-
 	/* Update all read pointers from inputs */
 	for (i = 0; i < routing->inputs; i++) {
 		in = routing->in[i];
@@ -136,7 +225,7 @@ static void routing_element_reset(struct audio_element *element)
 	int i;
 
 	for (i = 0; i < routing->outputs; i++)
-		audio_buf_reset(routing->out[i].buf);
+		audio_buf_reset(routing->out[i]);
 }
 
 static void routing_element_exit(struct audio_element *element)
@@ -149,6 +238,7 @@ static void routing_element_exit(struct audio_element *element)
 static void routing_element_dump(struct audio_element *element)
 {
 	struct routing_element *routing = element->data;
+	struct routing_map *map = routing->map[routing->map_last];
 	int i;
 
 	log_info("routing(%p/%p)\n", routing, element);
@@ -157,13 +247,23 @@ static void routing_element_dump(struct audio_element *element)
 	log_info("  maping:\n");
 
 	for (i = 0; i < routing->outputs; i++)
-		log_info("    %x => %x\n", routing->out[i].input, i);
+		log_info("    %x => %x%s\n", map[i].input, i, map[i].view ? " (view)" : "");
 
 	for (i = 0; i < routing->inputs + 1; i++)
 		audio_buf_dump(routing->in[i]);
 
 	for (i = 0; i < routing->outputs; i++)
-		audio_buf_dump(routing->out[i].buf);
+		audio_buf_dump(routing->out[i]);
+}
+
+int routing_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	if (size) {
+		log_err("routing: invalid parameters size: %u\n", size);
+		return -1;
+	}
+
+	return 0;
 }
 
 int routing_element_check_config(struct audio_element_config *config)
@@ -190,8 +290,9 @@ unsigned int routing_element_size(struct audio_element_config *config)
 
 	size = sizeof(struct routing_element);
 	size += (config->inputs + 1) * sizeof(struct audio_buffer *);
-	size += config->outputs * sizeof(struct routing_output);
+	size += config->outputs * sizeof(struct audio_buffer *);
 	size += sizeof(audio_sample_t) * config->period;
+	size += 2 * config->outputs * sizeof(struct routing_map);
 
 	return size;
 }
@@ -200,7 +301,6 @@ int routing_element_init(struct audio_element *element, struct audio_element_con
 {
 	struct routing_element *routing = element->data;
 	audio_sample_t *silence_storage;
-	audio_sample_t val;
 	int i;
 
 	if (os_sem_init(&routing->semaphore, 1))
@@ -215,8 +315,10 @@ int routing_element_init(struct audio_element *element, struct audio_element_con
 	routing->outputs = config->outputs;
 
 	routing->in = (struct audio_buffer **)((uint8_t *)routing + sizeof(struct routing_element));
-	routing->out = (struct routing_output *)((uint8_t *)routing->in + (config->inputs + 1) * sizeof(struct audio_buffer *));
-	silence_storage = (audio_sample_t *)((uint8_t *)routing->out + config->outputs * sizeof(struct routing_output));
+	routing->out = (struct audio_buffer **)((uint8_t *)routing->in + (config->inputs + 1) * sizeof(struct audio_buffer *));
+	silence_storage = (audio_sample_t *)((uint8_t *)routing->out + config->outputs * sizeof(struct audio_buffer *));
+	routing->map[0] = (struct routing_map *)((uint8_t *)silence_storage + sizeof(audio_sample_t) * config->period);
+	routing->map[1] = routing->map[0] + config->outputs;
 
 	for (i = 0; i < routing->inputs; i++)
 		routing->in[i] = &buffer[config->input[i]];
@@ -225,16 +327,18 @@ int routing_element_init(struct audio_element *element, struct audio_element_con
 
 	for (i = 0; i < routing->outputs; i++) {
 		/* initially all outputs are disconnected, i.e, connected to local silence input */
-		routing->out[i].input = routing->inputs;
+		routing->map[0][i].input = routing->inputs;
+		routing->map[0][i].view = false;
 
-		routing->out[i].buf = &buffer[config->output[i]];
+		routing->out[i] = &buffer[config->output[i]];
 	}
 
-	audio_buf_init(&routing->silence, silence_storage, element->period);
+	routing->map_pub = ROUTING_MAP_NONE;
+	routing->map_cur = 0;
+	routing->map_last = 0;
 
-	val = AUDIO_SAMPLE_SILENCE;
-	for (i = 0; i < element->period; i++)
-		audio_buf_write(&routing->silence, &val, 1);
+	audio_buf_init(&routing->silence, silence_storage, element->period);
+	audio_buf_write_silence(&routing->silence, element->period);
 
 	routing_element_dump(element);
 
@@ -4,19 +4,15 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include "os/string.h"
+
 #include "audio_element_sai_sink.h"
 #include "audio_element.h"
 #include "audio_format.h"
 #include "hlog.h"
 
 #include "sai_drv.h"
-
-#define SAI_TX_FIFO_PERIODS	2
-
-struct sai_sink_map {
-	volatile uint32_t *tx_fifo;	/* sai tx fifo address */
-	struct audio_buffer *in;	/* input audio buffer address */
-};
+#include "sai_sync.h"
 
 struct sai_input {
 	struct audio_buffer *buf;	/* input audio buffer address */
@@ -28,105 +24,299 @@ struct sai_input {
 
 struct sai_line {
 	void *base;
+	volatile uint32_t *tx_fifo;	/* sai tx fifo address */
 	unsigned int id;
 	unsigned int sai_id;
+	struct sai_input *in;	/* line channels, contiguous */
+	unsigned int channels;
 	unsigned int min;
 	unsigned int max;
 	unsigned int underflow;
 	unsigned int overflow;
+	struct sai_sync sync;
+	bool recover;			/* fifo xrun, recovered in the current period */
+	unsigned int level;		/* fifo level, in frames */
+	unsigned int frames;		/* input frames to write */
+	unsigned int silence;		/* silence frames to write, before the input frames */
+	uint32_t *ring;			/* fifo period mode, interleaved frames */
+	unsigned int ring_size;		/* in frames, power of 2 */
+	unsigned int ring_read;		/* in frames, free running, updated by the pump */
+	unsigned int ring_write;	/* in frames, free running, updated by the run */
 };
 
 struct sai_sink_element {
-	unsigned int map_n;
-	struct sai_sink_map *map;
 	unsigned int in_n;
 	struct sai_input *in;
 	unsigned int sai_n;
 	struct sai_line *line;
 	unsigned int line_n;
 	void **base;
+	uint32_t *stage;		/* line fifo block, interleaved frames */
+	unsigned int fifo_period;	/* frames per fifo transfer */
+	bool pump;			/* fifo period mode, fifo period smaller than the period */
 	bool started;
 };
 
-static void sai_sink_element_fifo_write(struct audio_element *element)
+/* Converts the input frames of a line channel, interleaved with the other line channels */
+static void sai_sink_input_stage(struct sai_input *in, unsigned int offset, uint32_t *stage, unsigned int stride, unsigned int frames)
 {
-	struct sai_sink_element *sai = element->data;
-	struct sai_sink_map *map;
-	int i, j;
+	struct audio_buffer *buf = in->buf;
+	unsigned int read, first, i;
+
+	read = (buf->read + offset) & buf->size_mask;
+
+	if (!in->convert) {
+		/* 32bit fifo format samples, aligned on audio_sample_t boundaries */
+		for (i = 0; i < frames; i++)
+			stage[i * stride] = *(uint32_t *)&buf->base[(read + i) & buf->size_mask];
+
+		return;
+	}
+
+	first = buf->size - read;
+	if (first > frames)
+		first = frames;
+
+	audio_convert_to(stage, stride, &buf->base[read], first, in->invert, in->mask, in->shift);
+	if (frames > first)
+		audio_convert_to(&stage[first * stride], stride, buf->base, frames - first, in->invert, in->mask, in->shift);
+}
+
+/*
+ * Stages the line fifo block, as interleaved frames: silence first, then the
+ * input frames, the last ones dropped or the last one repeated.
+ * Returns the block size, in words.
+ */
+static unsigned int sai_sink_line_stage(struct sai_sink_element *sai, struct sai_line *line, unsigned int frames)
+{
+	unsigned int channels = line->channels;
+	unsigned int max = SAI_TX_MAX_FIFO_SIZE / channels;
+	unsigned int silence = line->silence;
+	unsigned int n = line->frames;
+	uint32_t *stage;
+	unsigned int i;
+
+	/* the fifo level checks already guarantee it, never overrun the staging block */
+	if (silence > max)
+		silence = max;
+
+	if (n > max - silence)
+		n = max - silence;
 
-	/* Fill fifo with input buffer data */
+	if (frames > n)
+		frames = n;
+
+	memset(sai->stage, 0, silence * channels * sizeof(uint32_t));
+
+	stage = &sai->stage[silence * channels];
+
+	for (i = 0; i < channels; i++)
+		sai_sink_input_stage(&line->in[i], 0, &stage[i], channels, frames);
+
+	for (i = frames; i < n; i++) {
+		if (frames)
+			memcpy(&stage[i * channels], &stage[(frames - 1) * channels], channels * sizeof(uint32_t));
+		else
+			memset(&stage[i * channels], 0, channels * sizeof(uint32_t));
+	}
+
+	return (silence + n) * channels;
+}
+
+/*
+ * Input frames to write, one period. Inputs written by the same partition may
+ * provide a variable frame count (e.g. asrc, one frame more or less), all the
+ * available ones are then written. Inputs written in parallel (by another
+ * partition) are always read a period at a time.
+ */
+static unsigned int sai_sink_element_frames(struct audio_element *element)
+{
+	struct sai_sink_element *sai = element->data;
+	struct audio_buffer *buf;
+	unsigned int frames = 0, avail, write;
+	int i;
 
 	for (i = 0; i < sai->in_n; i++) {
-		if (sai->in[i].convert)
-				audio_convert_to(audio_buf_read_addr(sai->in[i].buf, 0), element->period, sai->in[i].invert, sai->in[i].mask, sai->in[i].shift);
+		buf = sai->in[i].buf;
+
+		if (buf->parallel)
+			return element->period;
+
+		write = __atomic_load_n(&buf->write, __ATOMIC_ACQUIRE);
+		avail = (write - buf->read) & buf->size_mask;
+
+		if (!i || (avail < frames))
+			frames = avail;
+	}
+
+	return frames;
+}
+
+static void sai_sink_element_fifo_write(struct audio_element *element, unsigned int frames)
+{
+	struct sai_sink_element *sai = element->data;
+	struct sai_line *line;
+	unsigned int skip, len;
+	int i;
+
+	for (i = 0; i < sai->line_n; i++) {
+		line = &sai->line[i];
+
+		/* Fifo xrun recovery and level compensation, not during start (prefill) */
+		line->silence = 0;
+
+		if (line->recover)
+			line->frames = sai_sync_recover(&line->sync, line->level, frames, &line->silence, &skip);
+		else if (sai->started)
+			line->frames = sai_sync_frames(&line->sync, line->level, frames);
+		else
+			line->frames = frames;
+
+		/* Fill fifo with input buffer data, converted and interleaved in one contiguous block */
+		len = sai_sink_line_stage(sai, line, frames);
+
+		__sai_tx_fifo_write(line->tx_fifo, sai->stage, len);
 	}
 
-	for (i = 0; i < element->period; i++) {
-		for (j = 0; j < sai->map_n; j++) {
-			map = &sai->map[j];
+	for (i = 0; i < sai->in_n; i++)
+		audio_buf_read_update(sai->in[i].buf, frames);
+}
+
+/*
+ * Fifo period mode: the input frames are converted and interleaved in a ring
+ * per line, the line fifo is fed from the ring, a fifo period at a time, by
+ * the pump (from the sai interrupt).
+ */
+static void sai_sink_element_ring_write(struct audio_element *element, unsigned int frames)
+{
+	struct sai_sink_element *sai = element->data;
+	unsigned int n, read, write, pos, len, done;
+	struct sai_line *line;
+	int i, j;
+
+	for (i = 0; i < sai->line_n; i++) {
+		line = &sai->line[i];
+
+		write = line->ring_write;
+		read = __atomic_load_n(&line->ring_read, __ATOMIC_ACQUIRE);
 
-			*map->tx_fifo = __audio_buf_read_uint32(map->in, i);
+		n = frames;
+		if (n > line->ring_size - (write - read)) {
+			/* fifo stalled, input frames dropped */
+			line->overflow++;
+			line->sync.dropped += n - (line->ring_size - (write - read));
+			n = line->ring_size - (write - read);
 		}
+
+		/* split (at most once) at the ring wrap point */
+		for (done = 0; done < n; done += len) {
+			pos = (write + done) & (line->ring_size - 1);
+
+			len = line->ring_size - pos;
+			if (len > n - done)
+				len = n - done;
+
+			for (j = 0; j < line->channels; j++)
+				sai_sink_input_stage(&line->in[j], done, &line->ring[pos * line->channels + j], line->channels, len);
+		}
+
+		__atomic_store_n(&line->ring_write, write + n, __ATOMIC_RELEASE);
 	}
 
 	for (i = 0; i < sai->in_n; i++)
-		audio_buf_read_update(sai->in[i].buf, element->period);
+		audio_buf_read_update(sai->in[i].buf, frames);
+}
+
+/* Feeds the line fifo with a fifo period, from the ring or silence if the ring is empty */
+static void sai_sink_line_pump(struct sai_sink_element *sai, struct sai_line *line)
+{
+	unsigned int read, write, i;
+
+	read = line->ring_read;
+	write = __atomic_load_n(&line->ring_write, __ATOMIC_ACQUIRE);
+
+	if (write - read >= sai->fifo_period) {
+		/* the ring size is a multiple of the fifo period, no wrap */
+		__sai_tx_fifo_write(line->tx_fifo, &line->ring[(read & (line->ring_size - 1)) * line->channels],
+				    sai->fifo_period * line->channels);
+
+		__atomic_store_n(&line->ring_read, read + sai->fifo_period, __ATOMIC_RELEASE);
+	} else {
+		/* pipeline late */
+		line->underflow++;
+		line->sync.silence += sai->fifo_period;
+
+		for (i = 0; i < sai->fifo_period * line->channels; i++)
+			*line->tx_fifo = 0;
+	}
+
+	/* The transmitter halts on fifo error, restart it once refilled */
+	if (__sai_tx_error(line->base)) {
+		line->underflow++;
+		__sai_tx_clear_error(line->base);
+	}
+}
+
+static void sai_sink_element_pump(struct audio_element *element)
+{
+	struct sai_sink_element *sai = element->data;
+	int i;
+
+	if (!__atomic_load_n(&sai->started, __ATOMIC_ACQUIRE))
+		return;
+
+	for (i = 0; i < sai->line_n; i++)
+		sai_sink_line_pump(sai, &sai->line[i]);
+}
+
+static void sai_sink_element_write(struct audio_element *element, unsigned int frames)
+{
+	struct sai_sink_element *sai = element->data;
+
+	if (sai->pump)
+		sai_sink_element_ring_write(element, frames);
+	else
+		sai_sink_element_fifo_write(element, frames);
 }
 
 static int sai_sink_element_run(struct audio_element *element)
 {
 	struct sai_sink_element *sai = element->data;
 	struct sai_line *line;
-	unsigned int level;
+	unsigned int level, frames;
 	int i, j;
 
-#if 0
-	/* WIP */
-	switch (sync_mode) {
-	case SYNC_FULL:
-		/* scheduling source is synchronous to audio clock, frame sync and fifo level, e.g:
-		   - SAI IRQ (for a single line)
-		   - SAI IRQ (for multi line, with no individual fifo reset)
-		   sai fifo level is guaranteed, can write fixed amount of samples at each iteration
-		   may check for fifo errors
-		 */
-	case SYNC_PARTIAL:
-		/* scheduling source is synchronous to audio clock, but not frame sync, fifo level, e.g.:
-                   - GPT timer IRQ with audio clock source
-		   - SAI IRQ, for a different SAI instance, using same clock, but not hardware sync mode
-		   - SAI IRQ, for a different SAI instance, but fifo was reset after start 
-		   On first iteration, after start, number of samples may vary, need to compensate.
-		   Need to take into account software jitter for proper compensation.
-                   In following iterations, fifo level should be guaranteed.
-		   May increase end to end latency of up to one sample.
-		*/
-	case SYNC_NONE:
-		/* scheduling source asynchronous to audio clock:
-		   - GPT timer IRQ, with system clock source
-                   - Slave SAI with different audio clock
-		   in this case samples may be accumulating in the playback fifo, need to check level and compensate (drop samples)
-		*/
-	}
-#endif
+	/*
+	 * Counted before the start head silence, which may fill the input
+	 * buffers (a full buffer has read == write, same as an empty one)
+	 */
+	frames = sai_sink_element_frames(element);
 
 	if (sai->started) {
-		/* Check SAI Tx Fifo level */
-		for (i = 0; i < sai->line_n; i++) {
+		/* Check SAI Tx Fifo level, fifo errors handled by the pump in fifo period mode */
+		for (i = 0; (i < sai->line_n) && !sai->pump; i++) {
 			line = &sai->line[i];
 
 			level = __sai_tx_level(line->base, line->id);
 
+			line->recover = false;
+
 			if (level <= line->min) {
 				/* tx underflow */
 				line->underflow++;
-				goto err;
+				line->recover = true;
+			} else if ((level >= line->max) && (line->sync.mode == SAI_SYNC_FULL)) {
+				/* tx overflow, compensated in the other modes */
+				line->overflow++;
+				line->recover = true;
 			}
 
-			if (level >= line->max) {
-				/* tx overflow */
-				line->overflow++;
+			if (!line->recover)
+				sai_sync_recovered(&line->sync);
+			else if (line->sync.recovering >= SAI_SYNC_RECOVERY_MAX)
 				goto err;
-			}
+
+			line->level = level / line->channels;
 		}
 	} else {
 		audio_sample_t val = AUDIO_SAMPLE_SILENCE;
@@ -137,16 +327,30 @@ static int sai_sink_element_run(struct audio_element *element)
 				audio_buf_write_head(sai->in[i].buf, &val, 1);
 		}
 
-		sai_sink_element_fifo_write(element);
+		sai_sink_element_write(element, element->period);
 	}
 
-	sai_sink_element_fifo_write(element);
+	sai_sink_element_write(element, frames);
 
 	if (!sai->started) {
+		/* Prime the fifo with two fifo periods, the pump takes over from the sai interrupt */
+		for (i = 0; (i < sai->line_n) && sai->pump; i++) {
+			sai_sink_line_pump(sai, &sai->line[i]);
+			sai_sink_line_pump(sai, &sai->line[i]);
+		}
+
 		for (i = 0; i < sai->sai_n; i++)
 			__sai_enable_tx(sai->base[i], false);
 
-		sai->started = true;
+		__atomic_store_n(&sai->started, true, __ATOMIC_RELEASE);
+	} else if (!sai->pump) {
+		/* The transmitter halts on fifo error, restart it once refilled */
+		for (i = 0; i < sai->line_n; i++) {
+			line = &sai->line[i];
+
+			if (line->recover && __sai_tx_error(line->base))
+				__sai_tx_clear_error(line->base);
+		}
 	}
 
 	return 0;
@@ -163,7 +367,14 @@ static void sai_sink_element_reset(struct audio_element *element)
 	for (i = 0; i < sai->sai_n; i++)
 		__sai_disable_tx(sai->base[i]);
 
-	sai->started = false;
+	__atomic_store_n(&sai->started, false, __ATOMIC_RELEASE);
+
+	for (i = 0; i < sai->line_n; i++) {
+		sai->line[i].recover = false;
+		sai->line[i].sync.recovering = 0;
+		sai->line[i].ring_read = 0;
+		sai->line[i].ring_write = 0;
+	}
 }
 
 static void sai_sink_element_exit(struct audio_element *element)
@@ -173,17 +384,20 @@ static void sai_sink_element_exit(struct audio_element *element)
 static void sai_sink_element_dump(struct audio_element *element)
 {
 	struct sai_sink_element *sai = element->data;
-	int i;
+	int i, j;
 
 	log_info("sai sink(%p/%p)\n", sai, element);
 	log_info("  inputs: %u\n", sai->in_n);
+	log_info("  fifo period: %u%s\n", sai->fifo_period, sai->pump ? " (pump)" : "");
 	log_info("  mapping:\n");
 
-	for (i = 0; i < sai->map_n; i++)
-		log_info("    %p => %p\n", sai->map[i].in, sai->map[i].tx_fifo);
+	for (i = 0; i < sai->line_n; i++)
+		for (j = 0; j < sai->line[i].channels; j++)
+			log_info("    %p => %p\n", sai->line[i].in[j].buf, sai->line[i].tx_fifo);
 
 	for (i = 0; i < sai->line_n; i++)
-		log_info("line: %u, sai(%u, %u)\n", i, sai->line[i].sai_id, sai->line[i].id);
+		log_info("line: %u, sai(%u, %u), sync: %s\n", i, sai->line[i].sai_id, sai->line[i].id,
+			 sai_sync_mode_name(sai->line[i].sync.mode));
 
 	for (i = 0; i < sai->in_n; i++)
 		audio_buf_dump(sai->in[i].buf);
@@ -192,6 +406,7 @@ static void sai_sink_element_dump(struct audio_element *element)
 static void sai_sink_element_stats(struct audio_element *element)
 {
 	struct sai_sink_element *sai = element->data;
+	struct sai_sync *sync;
 	int i;
 
 	for (i = 0; i < sai->line_n; i++) {
@@ -200,14 +415,26 @@ static void sai_sink_element_stats(struct audio_element *element)
 
 		log_info("  underflow: %u, overflow: %u\n",
 			sai->line[i].underflow, sai->line[i].overflow);
+
+		if (sai->line[i].sync.mode != SAI_SYNC_FULL)
+			log_info("  sync: %s, dropped: %u, repeated: %u\n",
+				 sai_sync_mode_name(sai->line[i].sync.mode),
+				 sai->line[i].sync.dropped, sai->line[i].sync.repeated);
+
+		sync = &sai->line[i].sync;
+		log_info("  recoveries: %u, recovery time (last/max): %u/%u us, silence: %u frames\n",
+			 sync->recoveries,
+			 sai_sync_periods_to_us(sync->recovery_last, element->period, element->sample_rate),
+			 sai_sync_periods_to_us(sync->recovery_max, element->period, element->sample_rate),
+			 sync->silence);
 	}
 }
 
-static unsigned int sai_sink_map_size(struct audio_element_config *config)
+static unsigned int sai_sink_input_size(struct audio_element_config *config)
 {
 	struct sai_tx_config *sai_config;
 	struct sai_tx_line_config *line_config;
-	unsigned int map_size = 0;
+	unsigned int channel_n = 0;
 	int i, j;
 
 	for (i = 0; i < config->u.sai_sink.sai_n; i++) {
@@ -216,11 +443,29 @@ static unsigned int sai_sink_map_size(struct audio_element_config *config)
 		for (j = 0; j < sai_config->line_n; j++) {
 			line_config = &sai_config->line[j];
 
-			map_size += line_config->channel_n;
+			channel_n += line_config->channel_n;
 		}
 	}
 
-	return map_size;
+	return channel_n;
+}
+
+/* Fifo period, frames transferred to the fifo at once */
+static unsigned int sai_sink_fifo_period(struct audio_element_config *config)
+{
+	if (config->u.sai_sink.fifo_period)
+		return config->u.sai_sink.fifo_period;
+
+	return config->period;
+}
+
+/* Ring size, in words, used when the fifo period is smaller than the period */
+static unsigned int sai_sink_ring_size(struct audio_element_config *config)
+{
+	if (sai_sink_fifo_period(config) == config->period)
+		return 0;
+
+	return 2 * config->period * sai_sink_input_size(config);
 }
 
 static unsigned int sai_sink_line_size(struct audio_element_config *config)
@@ -238,10 +483,75 @@ static unsigned int sai_sink_line_size(struct audio_element_config *config)
 	return line_size;
 }
 
+int sai_sink_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct sai_sink_element_config *sai_sink = &config->u.sai_sink;
+	struct hrpn_audio_element_sai_params_line line;
+	struct hrpn_audio_element_sai_params_sai sai;
+	struct hrpn_audio_element_sai_params hdr;
+	uint8_t *p = params;
+	int i, j;
+
+	if (size < sizeof(hdr))
+		goto err_size;
+
+	memcpy(&hdr, p, sizeof(hdr));
+	p += sizeof(hdr);
+	size -= sizeof(hdr);
+
+	if (hdr.sai_n > SAI_TX_MAX_INSTANCE) {
+		log_err("sai sink: invalid sai number: %u\n", hdr.sai_n);
+		goto err;
+	}
+
+	sai_sink->sai_n = hdr.sai_n;
+
+	for (i = 0; i < hdr.sai_n; i++) {
+		if (size < sizeof(sai))
+			goto err_size;
+
+		memcpy(&sai, p, sizeof(sai));
+		p += sizeof(sai);
+		size -= sizeof(sai);
+
+		if (sai.line_n > SAI_TX_INSTANCE_MAX_LINE) {
+			log_err("sai sink: invalid line number: %u\n", sai.line_n);
+			goto err;
+		}
+
+		sai_sink->sai[i].id = sai.id;
+		sai_sink->sai[i].line_n = sai.line_n;
+		sai_sink->sai[i].sync_mode = sai.sync_mode;
+
+		for (j = 0; j < sai.line_n; j++) {
+			if (size < sizeof(line))
+				goto err_size;
+
+			memcpy(&line, p, sizeof(line));
+			p += sizeof(line);
+			size -= sizeof(line);
+
+			sai_sink->sai[i].line[j].id = line.id;
+			sai_sink->sai[i].line[j].channel_n = line.channel_n;
+		}
+	}
+
+	if (size)
+		goto err_size;
+
+	return 0;
+
+err_size:
+	log_err("sai sink: invalid parameters size\n");
+err:
+	return -1;
+}
+
 int sai_sink_element_check_config(struct audio_element_config *config)
 {
 	struct sai_tx_config *sai_config;
 	struct sai_tx_line_config *line_config;
+	unsigned int fifo_period = sai_sink_fifo_period(config);
 	int i, j;
 
 	if (config->outputs) {
@@ -249,12 +559,19 @@ int sai_sink_element_check_config(struct audio_element_config *config)
 		goto err;
 	}
 
-	if (config->inputs != sai_sink_map_size(config)) {
+	/* the ring (two periods) must hold a whole number of fifo periods */
+	if (!fifo_period || (fifo_period > config->period) || (config->period % fifo_period) ||
+	    ((fifo_period < config->period) && (config->period & (config->period - 1)))) {
+		log_err("sai sink: invalid fifo period: %u, period: %u\n", fifo_period, config->period);
+		goto err;
+	}
+
+	if (config->inputs != sai_sink_input_size(config)) {
 		log_err("sai sink: invalid inputs: %u\n", config->inputs);
 		goto err;
 	}
 
-	if (config->u.sai_sink.sai_n > SAI_RX_MAX_INSTANCE) {
+	if (config->u.sai_sink.sai_n > SAI_TX_MAX_INSTANCE) {
 		log_err("sai sink: invalid instances: %u\n", config->u.sai_sink.sai_n);
 		goto err;
 	}
@@ -272,6 +589,18 @@ int sai_sink_element_check_config(struct audio_element_config *config)
 			goto err;
 		}
 
+		if (sai_config->sync_mode >= SAI_SYNC_MAX) {
+			log_err("sai sink: invalid sync mode: %u\n", sai_config->sync_mode);
+			goto err;
+		}
+
+		/* the pump runs from the sai interrupt, at a fixed level */
+		if ((fifo_period < config->period) && (sai_config->sync_mode != SAI_SYNC_FULL)) {
+			log_err("sai sink: sync mode %s not supported, period %u larger than the fifo period %u\n",
+				sai_sync_mode_name(sai_config->sync_mode), config->period, fifo_period);
+			goto err;
+		}
+
 		for (j = 0; j < sai_config->line_n; j++) {
 			line_config = &sai_config->line[j];
 
@@ -280,13 +609,24 @@ int sai_sink_element_check_config(struct audio_element_config *config)
 				goto err;
 			}
 
-			if (line_config->channel_n > SAI_TX_INSTANCE_MAX_CHANNELS) {
+			if (!line_config->channel_n || (line_config->channel_n > SAI_TX_INSTANCE_MAX_CHANNELS)) {
 				log_err("sai sink: invalid channels: %u\n", line_config->channel_n);
 				goto err;
 			}
 
-			if ((SAI_TX_FIFO_PERIODS * line_config->channel_n * config->period) > SAI_TX_MAX_FIFO_SIZE) {
-				log_err("sai sink: invalid tx fifo size: %u\n", SAI_TX_FIFO_PERIODS * line_config->channel_n * config->period);
+			/* the sai lines share the same frame format (I2S or TDM) */
+			if (line_config->channel_n != sai_config->line[0].channel_n) {
+				log_err("sai sink: invalid channels: %u, sai%u line %u has %u\n", line_config->channel_n,
+					sai_config->id, sai_config->line[0].id, sai_config->line[0].channel_n);
+				goto err;
+			}
+
+			/* a line fifo must hold the fifo period (twice, or more with sync compensation) for all the channels */
+			if ((sai_sync_min_size(sai_config->sync_mode, fifo_period) * line_config->channel_n) > SAI_TX_MAX_FIFO_SIZE) {
+				log_err("sai sink: %u channels, fifo period %u: tx fifo too small (%u > %u words)\n",
+					line_config->channel_n, fifo_period,
+					sai_sync_min_size(sai_config->sync_mode, fifo_period) * line_config->channel_n,
+					SAI_TX_MAX_FIFO_SIZE);
 				goto err;
 			}
 		}
@@ -303,9 +643,11 @@ unsigned int sai_sink_element_size(struct audio_element_config *config)
 	unsigned int size;
 
 	size = sizeof(struct sai_sink_element);
-	size += sai_sink_map_size(config) * (sizeof(struct sai_sink_map) + sizeof(struct sai_input));
+	size += sai_sink_input_size(config) * sizeof(struct sai_input);
 	size += sai_sink_line_size(config) * sizeof(struct sai_line);
-	size += config->u.sai_source.sai_n * sizeof(void *);
+	size += config->u.sai_sink.sai_n * sizeof(void *);
+	size += SAI_TX_MAX_FIFO_SIZE * sizeof(uint32_t);
+	size += sai_sink_ring_size(config) * sizeof(uint32_t);
 
 	return size;
 }
@@ -315,9 +657,9 @@ int sai_sink_element_init(struct audio_element *element, struct audio_element_co
 	struct sai_sink_element *sai = element->data;
 	struct sai_tx_config *sai_config;
 	struct sai_tx_line_config *line_config;
-	struct sai_sink_map *map;
 	struct sai_line *line;
-	int i, j, k, l;
+	uint32_t *ring;
+	int i, j, l;
 
 	element->run = sai_sink_element_run;
 	element->reset = sai_sink_element_reset;
@@ -326,16 +668,21 @@ int sai_sink_element_init(struct audio_element *element, struct audio_element_co
 	element->stats = sai_sink_element_stats;
 
 	sai->started = false;
+	sai->fifo_period = sai_sink_fifo_period(config);
+	sai->pump = sai->fifo_period < element->period;
+
+	if (sai->pump)
+		element->pump = sai_sink_element_pump;
 
-	sai->map_n = sai_sink_map_size(config);
-	sai->in_n = sai->map_n;
+	sai->in_n = sai_sink_input_size(config);
 	sai->sai_n = config->u.sai_sink.sai_n;
 	sai->line_n = sai_sink_line_size(config);
 
-	sai->map = (struct sai_sink_map *)((uint8_t *)sai + sizeof(struct sai_sink_element));
-	sai->in = (struct sai_input *)((uint8_t *)sai->map + sai->map_n * sizeof(struct sai_sink_map));
+	sai->in = (struct sai_input *)((uint8_t *)sai + sizeof(struct sai_sink_element));
 	sai->line = (struct sai_line *)((uint8_t *)sai->in + sai->in_n * sizeof(struct sai_input));
 	sai->base = (void **)((uint8_t *)sai->line + sai->line_n * sizeof(struct sai_line));
+	sai->stage = (uint32_t *)((uint8_t *)sai->base + sai->sai_n * sizeof(void *));
+	ring = sai->stage + SAI_TX_MAX_FIFO_SIZE;
 
 	l = 0;
 	line = &sai->line[0];
@@ -350,20 +697,36 @@ int sai_sink_element_init(struct audio_element *element, struct audio_element_co
 			line_config = &sai_config->line[j];
 
 			line->base = sai->base[i];
+			line->tx_fifo = __sai_tx_fifo_addr(sai->base[i], line_config->id);
 			line->id = line_config->id;
 			line->sai_id = sai_config->id;
+			line->channels = line_config->channel_n;
 
 			line->min = 0;
-			line->max = line_config->channel_n * element->period + 1;
-			line++;
+			line->max = line_config->channel_n * (element->period + 1) + 1;
+
+			sai_sync_init(&line->sync, sai_config->sync_mode, true, sai->fifo_period, SAI_TX_MAX_FIFO_SIZE / line_config->channel_n);
+			line->in = &sai->in[l];
+			line->recover = false;
+			line->level = 0;
+			line->frames = 0;
+			line->silence = 0;
+
+			if (sai->pump) {
+				line->ring = ring;
+				line->ring_size = 2 * element->period;
+				ring += line->ring_size * line->channels;
+			} else {
+				line->ring = NULL;
+				line->ring_size = 0;
+			}
 
-			for (k = 0; k < line_config->channel_n; k++) {
-				map = &sai->map[l];
+			line->ring_read = 0;
+			line->ring_write = 0;
 
-				map->tx_fifo = __sai_tx_fifo_addr(sai->base[i], line_config->id);
-				map->in = &buffer[config->input[l]];
-				l++;
-			}
+			l += line_config->channel_n;
+
+			line++;
 		}
 	}
 
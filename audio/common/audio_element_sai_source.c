@@ -4,14 +4,15 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
+#include "os/string.h"
+
 #include "audio_element_sai_source.h"
 #include "audio_element.h"
 #include "audio_format.h"
 #include "hlog.h"
 
 #include "sai_drv.h"
-
-#define SAI_RX_FIFO_PERIODS	2
+#include "sai_sync.h"
 
 /*
  Sai source
@@ -19,7 +20,7 @@
  Read from one (or more) sai instances, with one (or more) physical lines, with one (or more) channels,
  scatter data storing each individual channel in a different output buffer.
  Configuration specifies: sai instances, lines per instance, channels per instance and output buffers
- Runtime specifies: map scatter array (fifo address to read, outbut buffer)
+ Runtime specifies: per line, fifo address to read and output buffers (one per channel)
 
 use case 1
  single line, multiple channels, multiple buffers
@@ -32,11 +33,6 @@ use case 3
 
 */
 
-struct sai_source_map {
-	volatile uint32_t *rx_fifo;	/* sai rx fifo address */
-	struct audio_buffer *out;	/* output audio buffer address */
-};
-
 struct sai_output {
 	struct audio_buffer *buf;
 	bool convert;
@@ -47,101 +43,282 @@ struct sai_output {
 
 struct sai_line {
 	void *base;
+	volatile uint32_t *rx_fifo;	/* sai rx fifo address */
 	unsigned int id;
 	unsigned int sai_id;
+	struct sai_output *out;	/* line channels, contiguous */
+	unsigned int channels;
 	unsigned int min;
 	unsigned int max;
 	unsigned int underflow;
 	unsigned int overflow;
+	struct sai_sync sync;
+	bool recover;			/* fifo xrun, recovered in the current period */
+	unsigned int frames;		/* fifo frames to read */
+	unsigned int silence;		/* silence frames to output, before the fifo frames */
+	unsigned int skip;		/* fifo frames to drop, before the output frames */
+	uint32_t *ring;			/* fifo period mode, interleaved frames */
+	unsigned int ring_size;		/* in frames, power of 2 */
+	unsigned int ring_read;		/* in frames, free running, updated by the run */
+	unsigned int ring_write;	/* in frames, free running, updated by the pump */
 };
 
 struct sai_source_element {
-	unsigned int map_n;
-	struct sai_source_map *map;
 	unsigned int out_n;
 	struct sai_output *out;
 	unsigned int sai_n;
 	struct sai_line *line;
 	unsigned int line_n;
 	void **base;
+	uint32_t *stage;		/* line fifo block, interleaved frames */
+	unsigned int fifo_period;	/* frames per fifo transfer */
+	bool pump;			/* fifo period mode, fifo period smaller than the period */
 	bool started;
 };
 
+/* Converts a line channel fifo frames, interleaved with the other line channels */
+static void sai_source_output_stage(struct sai_output *out, const uint32_t *stage, unsigned int stride, unsigned int offset, unsigned int frames)
+{
+	audio_sample_t *samples = audio_buf_write_addr(out->buf, offset);
+	unsigned int i;
+
+	if (!out->convert) {
+		/* 32bit fifo format samples, aligned on audio_sample_t boundaries */
+		for (i = 0; i < frames; i++)
+			*(uint32_t *)&samples[i] = stage[i * stride];
+
+		return;
+	}
+
+	audio_convert_from(samples, stage, stride, frames, out->invert, out->mask, out->shift);
+}
+
+/*
+ * Reads the line fifo block, as interleaved frames, and outputs silence first,
+ * then the fifo frames (the oldest ones skipped), the last ones dropped or the
+ * last one repeated
+ */
+static void sai_source_line_read(struct sai_source_element *sai, struct sai_line *line, unsigned int period)
+{
+	unsigned int channels = line->channels;
+	unsigned int max = SAI_RX_MAX_FIFO_SIZE / channels;
+	unsigned int n = line->frames;
+	unsigned int silence = line->silence;
+	unsigned int skip = line->skip;
+	unsigned int frames, i, j;
+	struct audio_buffer *buf;
+	audio_sample_t *samples;
+	audio_sample_t last;
+
+	/* the fifo level checks already guarantee it, never overrun the staging block */
+	if (n > max)
+		n = max;
+
+	if (silence > period)
+		silence = period;
+
+	if (skip > n)
+		skip = n;
+
+	frames = n - skip;
+	if (frames > period - silence)
+		frames = period - silence;
+
+	__sai_rx_fifo_read(line->rx_fifo, sai->stage, n * channels);
+
+	for (i = 0; i < channels; i++) {
+		buf = line->out[i].buf;
+		samples = audio_buf_write_addr(buf, 0);
+
+		for (j = 0; j < silence; j++)
+			samples[j] = AUDIO_SAMPLE_SILENCE;
+
+		sai_source_output_stage(&line->out[i], &sai->stage[skip * channels + i], channels, silence, frames);
+
+		if (silence + frames < period) {
+			if (silence + frames)
+				last = samples[silence + frames - 1];
+			else
+				last = buf->base[(buf->write - 1) & buf->size_mask];
+
+			for (j = silence + frames; j < period; j++)
+				samples[j] = last;
+		}
+	}
+}
+
+/*
+ * Fifo period mode: the line fifo is drained in a ring, as interleaved frames,
+ * by the pump (from the sai interrupt), the run converts a period at a time
+ * from the ring.
+ */
+static void sai_source_line_pump(struct sai_line *line)
+{
+	unsigned int read, write, space, n, pos, len, done, i;
+
+	n = __sai_rx_level(line->base, line->id) / line->channels;
+
+	write = line->ring_write;
+	read = __atomic_load_n(&line->ring_read, __ATOMIC_ACQUIRE);
+	space = line->ring_size - (write - read);
+
+	if (n > space) {
+		/* pipeline late, newest fifo frames dropped */
+		line->overflow++;
+		line->sync.dropped += n - space;
+
+		for (i = 0; i < (n - space) * line->channels; i++)
+			(void)*line->rx_fifo;
+
+		n = space;
+	}
+
+	/* split (at most once) at the ring wrap point */
+	for (done = 0; done < n; done += len) {
+		pos = (write + done) & (line->ring_size - 1);
+
+		len = line->ring_size - pos;
+		if (len > n - done)
+			len = n - done;
+
+		__sai_rx_fifo_read(line->rx_fifo, &line->ring[pos * line->channels], len * line->channels);
+	}
+
+	__atomic_store_n(&line->ring_write, write + n, __ATOMIC_RELEASE);
+
+	/* The receiver halts on fifo error, restart it once drained */
+	if (__sai_rx_error(line->base)) {
+		line->overflow++;
+		__sai_rx_clear_error(line->base);
+	}
+}
+
+static void sai_source_element_pump(struct audio_element *element)
+{
+	struct sai_source_element *sai = element->data;
+	int i;
+
+	if (!__atomic_load_n(&sai->started, __ATOMIC_ACQUIRE))
+		return;
+
+	for (i = 0; i < sai->line_n; i++)
+		sai_source_line_pump(&sai->line[i]);
+}
+
+/* Outputs a period from the ring, or silence if the fifo pump is late */
+static void sai_source_line_ring_read(struct sai_line *line, unsigned int period)
+{
+	unsigned int read, write, pos, len, done, i, j;
+	audio_sample_t *samples;
+
+	read = line->ring_read;
+	write = __atomic_load_n(&line->ring_write, __ATOMIC_ACQUIRE);
+
+	if (write - read < period) {
+		line->underflow++;
+		line->sync.silence += period;
+
+		for (i = 0; i < line->channels; i++) {
+			samples = audio_buf_write_addr(line->out[i].buf, 0);
+
+			for (j = 0; j < period; j++)
+				samples[j] = AUDIO_SAMPLE_SILENCE;
+		}
+
+		return;
+	}
+
+	/* split (at most once) at the ring wrap point */
+	for (done = 0; done < period; done += len) {
+		pos = (read + done) & (line->ring_size - 1);
+
+		len = line->ring_size - pos;
+		if (len > period - done)
+			len = period - done;
+
+		for (i = 0; i < line->channels; i++)
+			sai_source_output_stage(&line->out[i], &line->ring[pos * line->channels + i], line->channels, done, len);
+	}
+
+	__atomic_store_n(&line->ring_read, read + period, __ATOMIC_RELEASE);
+}
+
 static int sai_source_element_run(struct audio_element *element)
 {
 	struct sai_source_element *sai = element->data;
-	struct sai_source_map *map;
 	struct sai_line *line;
 	unsigned int level;
-	uint32_t val;
 	int i, j;
 
-#if 0
-	/* WIP */
-	switch (sync_mode) {
-	case SYNC_FULL:
-		/* scheduling source is synchronous to audio clock, frame sync and fifo level, e.g:
-		   - SAI IRQ (for a single line)
-		   - SAI IRQ (for multi line, with no individual fifo reset)
-		   sai fifo level is guaranteed, can read fixed amount of samples at each iteration
-		   may check for fifo errors
-		 */
-	case SYNC_PARTIAL:
-		/* scheduling source is synchronous to audio clock, but not frame sync, fifo level, e.g.:
-                   - GPT timer IRQ with audio clock source
-		   - SAI IRQ, for a different SAI instance, using same clock, but not hardware sync mode
-		   - SAI IRQ, for a different SAI instance, but fifo was reset after start 
-		   On first iteration, after start, number of samples may vary, need to compensate.
-		   Need to take into account software jitter for proper compensation.
-		   In following iterations, fifo level should be guaranteed.
-		   May increase end to end latency of up to one sample.
-		*/
-	case SYNC_NONE:
-		/* scheduling source asynchronous to audio clock:
-		   - GPT timer IRQ, with system clock source
-                   - Slave SAI with different audio clock
-		   in this case samples may be accumulating in the playback fifo, need to check level and compensate (drop samples)
-		*/
-	}
-#endif
-	if (sai->started) {
+	if (sai->started && sai->pump) {
+		for (i = 0; i < sai->line_n; i++)
+			sai_source_line_ring_read(&sai->line[i], element->period);
+
+		for (i = 0; i < sai->out_n; i++)
+			audio_buf_write_update(sai->out[i].buf, element->period);
+
+	} else if (sai->started) {
 		/* Check SAI Rx Fifo level */
 		for (i = 0; i < sai->line_n; i++) {
 			line = &sai->line[i];
 
 			level = __sai_rx_level(line->base, line->id);
 
-			if (level <= line->min) {
-				/* rx underflow */
-				line->underflow++;
-				goto err;
+			line->recover = false;
+
+			if (line->sync.mode == SAI_SYNC_FULL) {
+				if (level <= line->min) {
+					/* rx underflow */
+					line->underflow++;
+					line->recover = true;
+				} else if (level >= line->max) {
+					/* rx overflow */
+					line->overflow++;
+					line->recover = true;
+				}
+			} else {
+				/* underflow compensated, only counted */
+				if (level < line->channels * element->period)
+					line->underflow++;
+
+				if (level >= line->channels * line->sync.size) {
+					line->overflow++;
+					line->recover = true;
+				}
 			}
 
-			if (level >= line->max) {
-				/* rx overflow */
-				line->overflow++;
+			if (!line->recover)
+				sai_sync_recovered(&line->sync);
+			else if (line->sync.recovering >= SAI_SYNC_RECOVERY_MAX)
 				goto err;
-			}
-		}
 
-		/* Fill output buffer with fifo data */
-		for (i = 0; i < element->period; i++) {
-			for (j = 0; j < sai->map_n; j++) {
-				map = &sai->map[j];
+			level /= line->channels;
 
-				val = *map->rx_fifo;
+			line->silence = 0;
+			line->skip = 0;
+
+			if (line->recover)
+				line->frames = sai_sync_recover(&line->sync, level, element->period, &line->silence, &line->skip);
+			else
+				line->frames = sai_sync_frames(&line->sync, level, element->period);
 
-				__audio_buf_write_uint32(map->out, i, val);
-			}
 		}
 
-		for (i = 0; i < sai->out_n; i++) {
-			if (sai->out[i].convert)
-				audio_convert_from(audio_buf_write_addr(sai->out[i].buf, 0), element->period, sai->out[i].invert, sai->out[i].mask, sai->out[i].shift);
+		/* Fill output buffer with fifo data, read in one contiguous block per line */
+		for (i = 0; i < sai->line_n; i++)
+			sai_source_line_read(sai, &sai->line[i], element->period);
 
-			audio_buf_write_update(sai->out[i].buf, element->period);
+		/* The receiver halts on fifo error, restart it once drained */
+		for (i = 0; i < sai->line_n; i++) {
+			line = &sai->line[i];
+
+			if (line->recover && __sai_rx_error(line->base))
+				__sai_rx_clear_error(line->base);
 		}
 
+		for (i = 0; i < sai->out_n; i++)
+			audio_buf_write_update(sai->out[i].buf, element->period);
+
 	} else {
 		audio_sample_t val = AUDIO_SAMPLE_SILENCE;
 
@@ -156,7 +333,7 @@ static int sai_source_element_run(struct audio_element *element)
 		for (i = 0; i < sai->sai_n; i++)
 			__sai_enable_rx(sai->base[i], false);
 
-		sai->started = true;
+		__atomic_store_n(&sai->started, true, __ATOMIC_RELEASE);
 	}
 
 	return 0;
@@ -170,13 +347,20 @@ static void sai_source_element_reset(struct audio_element *element)
 	struct sai_source_element *sai = element->data;
 	int i;
 
+	__atomic_store_n(&sai->started, false, __ATOMIC_RELEASE);
+
 	for (i = 0; i < sai->sai_n; i++)
 		__sai_disable_rx(sai->base[i]);
 
 	for (i = 0; i < sai->out_n; i++)
 		audio_buf_reset(sai->out[i].buf);
 
-	sai->started = false;
+	for (i = 0; i < sai->line_n; i++) {
+		sai->line[i].recover = false;
+		sai->line[i].sync.recovering = 0;
+		sai->line[i].ring_read = 0;
+		sai->line[i].ring_write = 0;
+	}
 }
 
 static void sai_source_element_exit(struct audio_element *element)
@@ -186,17 +370,20 @@ static void sai_source_element_exit(struct audio_element *element)
 static void sai_source_element_dump(struct audio_element *element)
 {
 	struct sai_source_element *sai = element->data;
-	int i;
+	int i, j;
 
 	log_info("sai source(%p/%p)\n", sai, element);
 	log_info("  outputs: %u\n", sai->out_n);
+	log_info("  fifo period: %u%s\n", sai->fifo_period, sai->pump ? " (pump)" : "");
 	log_info("  mapping:\n");
 
-	for (i = 0; i < sai->map_n; i++)
-		log_info("    %p => %p\n", sai->map[i].rx_fifo, sai->map[i].out);
+	for (i = 0; i < sai->line_n; i++)
+		for (j = 0; j < sai->line[i].channels; j++)
+			log_info("    %p => %p\n", sai->line[i].rx_fifo, sai->line[i].out[j].buf);
 
 	for (i = 0; i < sai->line_n; i++)
-		log_info("line: %u, sai(%u, %u)\n", i, sai->line[i].sai_id, sai->line[i].id);
+		log_info("line: %u, sai(%u, %u), sync: %s\n", i, sai->line[i].sai_id, sai->line[i].id,
+			 sai_sync_mode_name(sai->line[i].sync.mode));
 
 	for (i = 0; i < sai->out_n; i++)
 		audio_buf_dump(sai->out[i].buf);
@@ -205,6 +392,7 @@ static void sai_source_element_dump(struct audio_element *element)
 static void sai_source_element_stats(struct audio_element *element)
 {
 	struct sai_source_element *sai = element->data;
+	struct sai_sync *sync;
 	int i;
 
 	for (i = 0; i < sai->line_n; i++) {
@@ -213,14 +401,26 @@ static void sai_source_element_stats(struct audio_element *element)
 
 		log_info("  underflow: %u, overflow: %u\n",
 			sai->line[i].underflow, sai->line[i].overflow);
+
+		if (sai->line[i].sync.mode != SAI_SYNC_FULL)
+			log_info("  sync: %s, dropped: %u, repeated: %u\n",
+				 sai_sync_mode_name(sai->line[i].sync.mode),
+				 sai->line[i].sync.dropped, sai->line[i].sync.repeated);
+
+		sync = &sai->line[i].sync;
+		log_info("  recoveries: %u, recovery time (last/max): %u/%u us, silence: %u frames\n",
+			 sync->recoveries,
+			 sai_sync_periods_to_us(sync->recovery_last, element->period, element->sample_rate),
+			 sai_sync_periods_to_us(sync->recovery_max, element->period, element->sample_rate),
+			 sync->silence);
 	}
 }
 
-static unsigned int sai_source_map_size(struct audio_element_config *config)
+static unsigned int sai_source_output_size(struct audio_element_config *config)
 {
 	struct sai_rx_config *sai_config;
 	struct sai_rx_line_config *line_config;
-	unsigned int map_size = 0;
+	unsigned int channel_n = 0;
 	int i, j;
 
 	for (i = 0; i < config->u.sai_source.sai_n; i++) {
@@ -229,11 +429,29 @@ static unsigned int sai_source_map_size(struct audio_element_config *config)
 		for (j = 0; j < sai_config->line_n; j++) {
 			line_config = &sai_config->line[j];
 
-			map_size += line_config->channel_n;
+			channel_n += line_config->channel_n;
 		}
 	}
 
-	return map_size;
+	return channel_n;
+}
+
+/* Fifo period, frames transferred from the fifo at once */
+static unsigned int sai_source_fifo_period(struct audio_element_config *config)
+{
+	if (config->u.sai_source.fifo_period)
+		return config->u.sai_source.fifo_period;
+
+	return config->period;
+}
+
+/* Ring size, in words, used when the fifo period is smaller than the period */
+static unsigned int sai_source_ring_size(struct audio_element_config *config)
+{
+	if (sai_source_fifo_period(config) == config->period)
+		return 0;
+
+	return 2 * config->period * sai_source_output_size(config);
 }
 
 static unsigned int sai_source_line_size(struct audio_element_config *config)
@@ -251,10 +469,75 @@ static unsigned int sai_source_line_size(struct audio_element_config *config)
 	return line_size;
 }
 
+int sai_source_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct sai_source_element_config *sai_source = &config->u.sai_source;
+	struct hrpn_audio_element_sai_params_line line;
+	struct hrpn_audio_element_sai_params_sai sai;
+	struct hrpn_audio_element_sai_params hdr;
+	uint8_t *p = params;
+	int i, j;
+
+	if (size < sizeof(hdr))
+		goto err_size;
+
+	memcpy(&hdr, p, sizeof(hdr));
+	p += sizeof(hdr);
+	size -= sizeof(hdr);
+
+	if (hdr.sai_n > SAI_RX_MAX_INSTANCE) {
+		log_err("sai source: invalid sai number: %u\n", hdr.sai_n);
+		goto err;
+	}
+
+	sai_source->sai_n = hdr.sai_n;
+
+	for (i = 0; i < hdr.sai_n; i++) {
+		if (size < sizeof(sai))
+			goto err_size;
+
+		memcpy(&sai, p, sizeof(sai));
+		p += sizeof(sai);
+		size -= sizeof(sai);
+
+		if (sai.line_n > SAI_RX_INSTANCE_MAX_LINE) {
+			log_err("sai source: invalid line number: %u\n", sai.line_n);
+			goto err;
+		}
+
+		sai_source->sai[i].id = sai.id;
+		sai_source->sai[i].line_n = sai.line_n;
+		sai_source->sai[i].sync_mode = sai.sync_mode;
+
+		for (j = 0; j < sai.line_n; j++) {
+			if (size < sizeof(line))
+				goto err_size;
+
+			memcpy(&line, p, sizeof(line));
+			p += sizeof(line);
+			size -= sizeof(line);
+
+			sai_source->sai[i].line[j].id = line.id;
+			sai_source->sai[i].line[j].channel_n = line.channel_n;
+		}
+	}
+
+	if (size)
+		goto err_size;
+
+	return 0;
+
+err_size:
+	log_err("sai source: invalid parameters size\n");
+err:
+	return -1;
+}
+
 int sai_source_element_check_config(struct audio_element_config *config)
 {
 	struct sai_rx_config *sai_config;
 	struct sai_rx_line_config *line_config;
+	unsigned int fifo_period = sai_source_fifo_period(config);
 	int i, j;
 
 	if (config->inputs) {
@@ -262,7 +545,14 @@ int sai_source_element_check_config(struct audio_element_config *config)
 		goto err;
 	}
 
-	if (config->outputs != sai_source_map_size(config)) {
+	/* the ring (two periods) wraps on a power of 2 */
+	if (!fifo_period || (fifo_period > config->period) || (config->period % fifo_period) ||
+	    ((fifo_period < config->period) && (config->period & (config->period - 1)))) {
+		log_err("sai source: invalid fifo period: %u, period: %u\n", fifo_period, config->period);
+		goto err;
+	}
+
+	if (config->outputs != sai_source_output_size(config)) {
 		log_err("sai source: invalid outputs: %u\n", config->outputs);
 		goto err;
 	}
@@ -285,6 +575,18 @@ int sai_source_element_check_config(struct audio_element_config *config)
 			goto err;
 		}
 
+		if (sai_config->sync_mode >= SAI_SYNC_MAX) {
+			log_err("sai source: invalid sync mode: %u\n", sai_config->sync_mode);
+			goto err;
+		}
+
+		/* the pump runs from the sai interrupt, at a fixed level */
+		if ((fifo_period < config->period) && (sai_config->sync_mode != SAI_SYNC_FULL)) {
+			log_err("sai source: sync mode %s not supported, period %u larger than the fifo period %u\n",
+				sai_sync_mode_name(sai_config->sync_mode), config->period, fifo_period);
+			goto err;
+		}
+
 		for (j = 0; j < sai_config->line_n; j++) {
 			line_config = &sai_config->line[j];
 
@@ -293,17 +595,26 @@ int sai_source_element_check_config(struct audio_element_config *config)
 				goto err;
 			}
 
-			if (line_config->channel_n > SAI_RX_INSTANCE_MAX_CHANNELS) {
+			if (!line_config->channel_n || (line_config->channel_n > SAI_RX_INSTANCE_MAX_CHANNELS)) {
 				log_err("sai source: invalid channels: %u\n", line_config->channel_n);
 				goto err;
 			}
 
-			if ((SAI_RX_FIFO_PERIODS * line_config->channel_n * config->period) > SAI_RX_MAX_FIFO_SIZE) {
-				log_err("sai source: invalid rx fifo size: %u\n",
-					SAI_RX_FIFO_PERIODS * line_config->channel_n * config->period);
+			/* the sai lines share the same frame format (I2S or TDM) */
+			if (line_config->channel_n != sai_config->line[0].channel_n) {
+				log_err("sai source: invalid channels: %u, sai%u line %u has %u\n", line_config->channel_n,
+					sai_config->id, sai_config->line[0].id, sai_config->line[0].channel_n);
 				goto err;
 			}
 
+			/* a line fifo must hold the fifo period (twice, or more with sync compensation) for all the channels */
+			if ((sai_sync_min_size(sai_config->sync_mode, fifo_period) * line_config->channel_n) > SAI_RX_MAX_FIFO_SIZE) {
+				log_err("sai source: %u channels, fifo period %u: rx fifo too small (%u > %u words)\n",
+					line_config->channel_n, fifo_period,
+					sai_sync_min_size(sai_config->sync_mode, fifo_period) * line_config->channel_n,
+					SAI_RX_MAX_FIFO_SIZE);
+				goto err;
+			}
 		}
 	}
 
@@ -318,9 +629,11 @@ unsigned int sai_source_element_size(struct audio_element_config *config)
 	unsigned int size;
 
 	size = sizeof(struct sai_source_element);
-	size += sai_source_map_size(config) * (sizeof(struct sai_source_map) + sizeof(struct sai_output));
+	size += sai_source_output_size(config) * sizeof(struct sai_output);
 	size += sai_source_line_size(config) * sizeof(struct sai_line);
 	size += config->u.sai_source.sai_n * sizeof(void *);
+	size += SAI_RX_MAX_FIFO_SIZE * sizeof(uint32_t);
+	size += sai_source_ring_size(config) * sizeof(uint32_t);
 
 	return size;
 }
@@ -330,9 +643,9 @@ int sai_source_element_init(struct audio_element *element, struct audio_element_
 	struct sai_source_element *sai = element->data;
 	struct sai_rx_config *sai_config;
 	struct sai_rx_line_config *line_config;
-	struct sai_source_map *map;
 	struct sai_line *line;
-	int i, j, k, l;
+	uint32_t *ring;
+	int i, j, l;
 
 	element->run = sai_source_element_run;
 	element->reset = sai_source_element_reset;
@@ -341,16 +654,21 @@ int sai_source_element_init(struct audio_element *element, struct audio_element_
 	element->stats = sai_source_element_stats;
 
 	sai->started = false;
+	sai->fifo_period = sai_source_fifo_period(config);
+	sai->pump = sai->fifo_period < element->period;
+
+	if (sai->pump)
+		element->pump = sai_source_element_pump;
 
-	sai->map_n = sai_source_map_size(config);
-	sai->out_n = sai->map_n;
+	sai->out_n = sai_source_output_size(config);
 	sai->sai_n = config->u.sai_source.sai_n;
 	sai->line_n = sai_source_line_size(config);
 
-	sai->map = (struct sai_source_map *)((uint8_t *)sai + sizeof(struct sai_source_element));
-	sai->out = (struct sai_output *)((uint8_t *)sai->map + sai->map_n * sizeof(struct sai_source_map));
+	sai->out = (struct sai_output *)((uint8_t *)sai + sizeof(struct sai_source_element));
 	sai->line = (struct sai_line *)((uint8_t *)sai->out + sai->out_n * sizeof(struct sai_output));
 	sai->base = (void **)((uint8_t *)sai->line + sai->line_n * sizeof(struct sai_line));
+	sai->stage = (uint32_t *)((uint8_t *)sai->base + sai->sai_n * sizeof(void *));
+	ring = sai->stage + SAI_RX_MAX_FIFO_SIZE;
 
 	l = 0;
 	line = &sai->line[0];
@@ -365,20 +683,36 @@ int sai_source_element_init(struct audio_element *element, struct audio_element_
 			line_config = &sai_config->line[j];
 
 			line->base = sai->base[i];
+			line->rx_fifo = __sai_rx_fifo_addr(sai->base[i], line_config->id);
 			line->id = line_config->id;
 			line->sai_id = sai_config->id;
+			line->channels = line_config->channel_n;
 
 			line->min = line_config->channel_n * element->period - 1;
 			line->max = 2 * line_config->channel_n * element->period;
-			line++;
-
-			for (k = 0; k < line_config->channel_n; k++) {
-				map = &sai->map[l];
 
-				map->rx_fifo = __sai_rx_fifo_addr(sai->base[i], line_config->id);
-				map->out = &buffer[config->output[l]];
-				l++;
+			sai_sync_init(&line->sync, sai_config->sync_mode, false, sai->fifo_period, SAI_RX_MAX_FIFO_SIZE / line_config->channel_n);
+			line->out = &sai->out[l];
+			line->recover = false;
+			line->frames = 0;
+			line->silence = 0;
+			line->skip = 0;
+
+			if (sai->pump) {
+				line->ring = ring;
+				line->ring_size = 2 * element->period;
+				ring += line->ring_size * line->channels;
+			} else {
+				line->ring = NULL;
+				line->ring_size = 0;
 			}
+
+			line->ring_read = 0;
+			line->ring_write = 0;
+
+			l += line_config->channel_n;
+
+			line++;
 		}
 	}
 
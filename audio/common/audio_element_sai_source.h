@@ -12,7 +12,7 @@
 #define SAI_RX_MAX_INSTANCE		6
 #define SAI_RX_MAX_ID			8
 #define SAI_RX_INSTANCE_MAX_LINE	8
-#define SAI_RX_INSTANCE_MAX_CHANNELS	8
+#define SAI_RX_INSTANCE_MAX_CHANNELS	16	/* TDM16 */
 #define SAI_RX_MAX_FIFO_SIZE		128
 
 /* Fixed mapping between sai instances/lines/channels and output buffers
@@ -28,9 +28,13 @@
 struct sai_source_element_config {
 	unsigned int sai_n;			/* number of sai instances */
 
+	unsigned int fifo_period;		/* frames per fifo transfer, 0 for the period (set by play_pipeline) */
+
 	struct sai_rx_config {
 		unsigned int id;		/* sai instance */
 
+		unsigned int sync_mode;		/* enum sai_sync_mode, to the pipeline scheduling source */
+
 		unsigned int line_n;		/* number of physical lines for the sai instance */
 
 		struct sai_rx_line_config {
@@ -44,6 +48,7 @@ struct sai_source_element_config {
 struct audio_element_config;
 struct audio_element;
 
+int sai_source_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
 int sai_source_element_check_config(struct audio_element_config *config);
 unsigned int sai_source_element_size(struct audio_element_config *config);
 int sai_source_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
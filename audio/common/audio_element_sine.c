@@ -4,37 +4,29 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 
-#include "os/math.h"
+#include "os/string.h"
 
 #include "audio_element_sine.h"
 #include "audio_element.h"
 #include "audio_buffer.h"
 #include "audio_format.h"
+#include "audio_osc.h"
 #include "hlog.h"
 
 struct sine_element {
 	struct audio_buffer *out;
 
-	unsigned int phase;
+	struct audio_osc osc;
 
 	double amplitude; /* sine amplitude, ]0, 1] */
-	double dphase; /* change of phase per sample */
+	double freq;
 };
 
 static int sine_element_run(struct audio_element *element)
 {
 	struct sine_element *sine = element->data;
-        double v;
-	audio_sample_t w;
-	int i;
 
-	for (i = 0; i < element->period; i++) {
-		v = sine->amplitude * sin(sine->phase * sine->dphase);
-		w = audio_double_to_sample(v);
-
-		__audio_buf_write(sine->out, i, &w, 1);
-		sine->phase++;
-	}
+	audio_osc_generate(&sine->osc, audio_buf_write_addr(sine->out, 0), element->period, sine->amplitude, false);
 
 	audio_buf_write_update(sine->out, element->period);
 
@@ -57,10 +49,30 @@ static void sine_element_dump(struct audio_element *element)
 	struct sine_element *sine = element->data;
 
 	log_info("sine(%p/%p)\n", sine, element);
-	log_info("  phase: %u, amplitude: %f\n", sine->phase, sine->amplitude);
+	log_info("  freq: %f, phase: %f, amplitude: %f\n", sine->freq, audio_osc_phase(&sine->osc), sine->amplitude);
 	audio_buf_dump(sine->out);
 }
 
+int sine_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_sine_params sine;
+
+	if (size != sizeof(sine)) {
+		log_err("sine: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&sine, params, sizeof(sine));
+
+	config->u.sine.freq = sine.freq;
+	config->u.sine.amplitude = sine.amplitude;
+
+	return 0;
+
+err:
+	return -1;
+}
+
 int sine_element_check_config(struct audio_element_config *config)
 {
 	if (config->inputs) {
@@ -101,9 +113,9 @@ int sine_element_init(struct audio_element *element, struct audio_element_config
 	element->exit = sine_element_exit;
 	element->dump = sine_element_dump;
 
-	sine->dphase = 2.0 * M_PI * config->u.sine.freq / config->sample_rate;
+	sine->freq = config->u.sine.freq;
 	sine->amplitude = config->u.sine.amplitude;
-	sine->phase = 0;
+	audio_osc_init(&sine->osc, sine->freq, config->sample_rate, 0.0);
 	sine->out = &buffer[config->output[0]];
 
 	sine_element_dump(element);
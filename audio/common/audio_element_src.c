@@ -0,0 +1,176 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/string.h"
+
+#include "audio_element_src.h"
+#include "audio_element.h"
+#include "audio_buffer.h"
+#include "audio_src.h"
+#include "hlog.h"
+
+/*
+ * Sample rate converter, between a fixed input rate and the element rate
+ * (see audio_src.h). Each period, all the available input samples are
+ * converted and a period of output samples is produced, completed with
+ * silence if not enough input was received.
+ */
+struct src_element {
+	struct audio_buffer *in[AUDIO_SRC_MAX_CHANNELS];
+	struct audio_buffer *out[AUDIO_SRC_MAX_CHANNELS];
+
+	unsigned int input_rate;
+
+	struct audio_src src;
+};
+
+static void src_element_src_config(struct audio_element_config *config, struct audio_src_config *src_config)
+{
+	unsigned int input_rate = config->u.src.input_rate;
+
+	src_config->channels = config->inputs;
+	src_config->input_rate = input_rate;
+	src_config->output_rate = config->sample_rate;
+	src_config->taps = config->u.src.taps;
+	src_config->interpolated = false;
+
+	/* input samples per period, rounded up */
+	if (config->sample_rate)
+		src_config->in_period = ((uint64_t)config->period * input_rate + config->sample_rate - 1) / config->sample_rate;
+	else
+		src_config->in_period = 0;
+}
+
+static int src_element_run(struct audio_element *element)
+{
+	struct src_element *src = element->data;
+	unsigned int n, c;
+
+	audio_src_write(&src->src, src->in);
+
+	n = audio_src_read(&src->src, src->out, element->period);
+
+	if (n < element->period)
+		for (c = 0; c < src->src.channels; c++)
+			audio_buf_write_silence(src->out[c], element->period - n);
+
+	return 0;
+}
+
+static void src_element_reset(struct audio_element *element)
+{
+	struct src_element *src = element->data;
+	unsigned int c;
+
+	audio_src_reset(&src->src);
+
+	for (c = 0; c < src->src.channels; c++)
+		audio_buf_reset(src->out[c]);
+}
+
+static void src_element_exit(struct audio_element *element)
+{
+}
+
+static void src_element_dump(struct audio_element *element)
+{
+	struct src_element *src = element->data;
+	unsigned int c;
+
+	log_info("src(%p/%p)\n", src, element);
+	log_info("  rate: %u -> %u Hz\n", src->input_rate, element->sample_rate);
+	audio_src_dump(&src->src);
+
+	for (c = 0; c < src->src.channels; c++) {
+		audio_buf_dump(src->in[c]);
+		audio_buf_dump(src->out[c]);
+	}
+}
+
+static void src_element_stats(struct audio_element *element)
+{
+	struct src_element *src = element->data;
+
+	log_info("src(%p), underrun: %llu, overrun: %llu\n",
+		 src, src->src.stats.underrun, src->src.stats.overrun);
+}
+
+int src_element_config_load(struct audio_element_config *config, void *params, unsigned int size)
+{
+	struct hrpn_audio_element_src_params src;
+
+	if (size != sizeof(src)) {
+		log_err("src: invalid parameters size: %u\n", size);
+		goto err;
+	}
+
+	memcpy(&src, params, sizeof(src));
+
+	config->u.src.input_rate = src.input_rate;
+	config->u.src.taps = src.taps;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+int src_element_check_config(struct audio_element_config *config)
+{
+	struct audio_src_config src_config;
+
+	if (config->outputs != config->inputs) {
+		log_err("src: invalid outputs: %u\n", config->outputs);
+		goto err;
+	}
+
+	src_element_src_config(config, &src_config);
+
+	if (audio_src_check_config(&src_config) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+unsigned int src_element_size(struct audio_element_config *config)
+{
+	struct audio_src_config src_config;
+
+	src_element_src_config(config, &src_config);
+
+	return sizeof(struct src_element) + audio_src_size(&src_config);
+}
+
+int src_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer)
+{
+	struct src_element *src = element->data;
+	struct audio_src_config src_config;
+	int i;
+
+	element->run = src_element_run;
+	element->reset = src_element_reset;
+	element->exit = src_element_exit;
+	element->dump = src_element_dump;
+	element->stats = src_element_stats;
+
+	src->input_rate = config->u.src.input_rate;
+
+	for (i = 0; i < config->inputs; i++) {
+		src->in[i] = &buffer[config->input[i]];
+		src->out[i] = &buffer[config->output[i]];
+	}
+
+	src_element_src_config(config, &src_config);
+
+	audio_src_init(&src->src, &src_config, src + 1);
+
+	src_element_dump(element);
+
+	return 0;
+}
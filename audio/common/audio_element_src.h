@@ -0,0 +1,27 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_ELEMENT_SRC_H_
+#define _AUDIO_ELEMENT_SRC_H_
+
+#include "audio_buffer.h"
+#include "audio_src.h"
+
+/* Input buffer n is resampled to output buffer n, at the element sample rate */
+struct src_element_config {
+	unsigned int input_rate;	/* input sample rate */
+	unsigned int taps;		/* filter taps per phase, multiple of 4 (0 for default) */
+};
+
+struct audio_element_config;
+struct audio_element;
+
+int src_element_config_load(struct audio_element_config *config, void *params, unsigned int size);
+int src_element_check_config(struct audio_element_config *config);
+unsigned int src_element_size(struct audio_element_config *config);
+int src_element_init(struct audio_element *element, struct audio_element_config *config, struct audio_buffer *buffer);
+
+#endif /* _AUDIO_ELEMENT_SRC_H_ */
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+
+#include "audio_fft.h"
+#include "audio_format.h"
+
+/*
+ * Butterfly stages with a half size of at least AUDIO_FFT_LANES, and the
+ * spectra products, are processed a vector at a time (4 single precision
+ * lanes, one Neon register on arm64). The first two stages are merged in
+ * a scalar radix-4 pass, their twiddles being trivial.
+ */
+#if defined(__GNUC__) && !defined(AUDIO_FORMAT_NO_VECTOR)
+#define AUDIO_FFT_LANES	4
+typedef float fft_v_t __attribute__((vector_size(AUDIO_FFT_LANES * sizeof(float)), may_alias, aligned(sizeof(float))));
+#else
+#define AUDIO_FFT_LANES	1
+typedef float fft_v_t;
+#endif
+
+#define fft_v(p)	(*(fft_v_t *)(p))
+
+unsigned int audio_fft_bins(unsigned int size)
+{
+	return (size / 2 + 1 + AUDIO_FFT_LANES - 1) & ~(AUDIO_FFT_LANES - 1);
+}
+
+unsigned int audio_fft_storage_size(unsigned int size)
+{
+	unsigned int points = size / 2;
+
+	/* twiddles, split twiddles, work buffer, bit reversal table */
+	return (2 * points + 2 * (points + 1) + 2 * points) * sizeof(float) + points * sizeof(uint16_t);
+}
+
+void audio_fft_init(struct audio_fft *fft, unsigned int size, void *storage)
+{
+	unsigned int points = size / 2;
+	unsigned int bits, h, k, i;
+
+	fft->size = size;
+	fft->points = points;
+	fft->bins = audio_fft_bins(size);
+
+	fft->tw_re = storage;
+	fft->tw_im = fft->tw_re + points;
+	fft->split_re = fft->tw_im + points;
+	fft->split_im = fft->split_re + points + 1;
+	fft->z_re = fft->split_im + points + 1;
+	fft->z_im = fft->z_re + points;
+	fft->rev = (uint16_t *)(fft->z_im + points);
+
+	fft->tw_re[0] = 1.0;
+	fft->tw_im[0] = 0.0;
+
+	for (h = 1; h < points; h <<= 1) {
+		for (k = 0; k < h; k++) {
+			fft->tw_re[h + k] = cos(M_PI * k / h);
+			fft->tw_im[h + k] = -sin(M_PI * k / h);
+		}
+	}
+
+	for (k = 0; k <= points; k++) {
+		fft->split_re[k] = cos(M_PI * k / points);
+		fft->split_im[k] = -sin(M_PI * k / points);
+	}
+
+	for (bits = 0; (1U << bits) < points; bits++)
+		;
+
+	for (i = 0; i < points; i++) {
+		fft->rev[i] = 0;
+
+		for (k = 0; k < bits; k++)
+			if (i & (1 << k))
+				fft->rev[i] |= 1 << (bits - 1 - k);
+	}
+}
+
+/* In place complex FFT of the work buffer, loaded in bit reversed order */
+static void audio_fft_complex(struct audio_fft *fft)
+{
+	float *re = fft->z_re, *im = fft->z_im;
+	unsigned int points = fft->points;
+	unsigned int g, h, k;
+
+	if (points < 4) {
+		/* points == 2 */
+		float tr = re[1], ti = im[1];
+
+		re[1] = re[0] - tr;
+		im[1] = im[0] - ti;
+		re[0] += tr;
+		im[0] += ti;
+
+		return;
+	}
+
+	/* radix-4 pass, stages h = 1 (w = 1) and h = 2 (w = 1, -i) */
+	for (g = 0; g < points; g += 4) {
+		float b0r = re[g] + re[g + 1], b0i = im[g] + im[g + 1];
+		float b1r = re[g] - re[g + 1], b1i = im[g] - im[g + 1];
+		float b2r = re[g + 2] + re[g + 3], b2i = im[g + 2] + im[g + 3];
+		float b3r = re[g + 2] - re[g + 3], b3i = im[g + 2] - im[g + 3];
+
+		re[g] = b0r + b2r;
+		im[g] = b0i + b2i;
+		re[g + 2] = b0r - b2r;
+		im[g + 2] = b0i - b2i;
+
+		/* -i * b3 = (b3i, -b3r) */
+		re[g + 1] = b1r + b3i;
+		im[g + 1] = b1i - b3r;
+		re[g + 3] = b1r - b3i;
+		im[g + 3] = b1i + b3r;
+	}
+
+	for (h = 4; h < points; h <<= 1) {
+		for (g = 0; g < points; g += 2 * h) {
+			for (k = 0; k < h; k += AUDIO_FFT_LANES) {
+				fft_v_t wr = fft_v(&fft->tw_re[h + k]), wi = fft_v(&fft->tw_im[h + k]);
+				fft_v_t ar = fft_v(&re[g + k]), ai = fft_v(&im[g + k]);
+				fft_v_t br = fft_v(&re[g + h + k]), bi = fft_v(&im[g + h + k]);
+				fft_v_t tr = br * wr - bi * wi;
+				fft_v_t ti = br * wi + bi * wr;
+
+				fft_v(&re[g + h + k]) = ar - tr;
+				fft_v(&im[g + h + k]) = ai - ti;
+				fft_v(&re[g + k]) = ar + tr;
+				fft_v(&im[g + k]) = ai + ti;
+			}
+		}
+	}
+}
+
+/*
+ * Real input x[n] (size samples), packed as z[n] = x[2n] + i x[2n + 1].
+ * With Z the FFT of z, and W = exp(-i pi / points):
+ * 2 X[k] = Z[k] + conj(Z[points - k]) - i W^k (Z[k] - conj(Z[points - k]))
+ */
+void audio_fft_forward(struct audio_fft *fft, const float *x, float *re, float *im)
+{
+	unsigned int points = fft->points;
+	float *zr = fft->z_re, *zi = fft->z_im;
+	unsigned int n, k, k2;
+
+	for (n = 0; n < points; n++) {
+		zr[fft->rev[n]] = x[2 * n];
+		zi[fft->rev[n]] = x[2 * n + 1];
+	}
+
+	audio_fft_complex(fft);
+
+	for (k = 0; k <= points; k++) {
+		unsigned int k1 = k & (points - 1);
+		float e_re, e_im, o_re, o_im;
+
+		k2 = (points - k) & (points - 1);
+
+		e_re = zr[k1] + zr[k2];
+		e_im = zi[k1] - zi[k2];
+
+		/* -i * (Z[k] - conj(Z[points - k])) */
+		o_re = zi[k1] + zi[k2];
+		o_im = zr[k2] - zr[k1];
+
+		re[k] = e_re + fft->split_re[k] * o_re - fft->split_im[k] * o_im;
+		im[k] = e_im + fft->split_re[k] * o_im + fft->split_im[k] * o_re;
+	}
+
+	for (k = points + 1; k < fft->bins; k++) {
+		re[k] = 0.0;
+		im[k] = 0.0;
+	}
+}
+
+/*
+ * Inverse of the above, the packed spectrum being
+ * 2 Z[k] = X[k] + conj(X[points - k]) + i conj(W^k) (X[k] - conj(X[points - k]))
+ * and the inverse complex FFT computed as conj(FFT(conj(Z))).
+ */
+void audio_fft_inverse(struct audio_fft *fft, const float *re, const float *im, float *x)
+{
+	unsigned int points = fft->points;
+	float *zr = fft->z_re, *zi = fft->z_im;
+	unsigned int n, k;
+
+	for (k = 0; k < points; k++) {
+		unsigned int k2 = points - k;
+		float wr = fft->split_re[k], wi = fft->split_im[k];
+		float e_re, e_im, d_re, d_im, o_re, o_im;
+
+		e_re = re[k] + re[k2];
+		e_im = im[k] - im[k2];
+		d_re = re[k] - re[k2];
+		d_im = im[k] + im[k2];
+
+		o_re = d_re * wr + d_im * wi;
+		o_im = d_im * wr - d_re * wi;
+
+		zr[fft->rev[k]] = e_re - o_im;
+		zi[fft->rev[k]] = -(e_im + o_re);
+	}
+
+	audio_fft_complex(fft);
+
+	for (n = 0; n < points; n++) {
+		x[2 * n] = zr[n];
+		x[2 * n + 1] = -zi[n];
+	}
+}
+
+/* Complex multiply accumulate of spectra, y += x * h, bins a multiple of the vector size */
+void audio_fft_mac(float *y_re, float *y_im, const float *x_re, const float *x_im,
+		   const float *h_re, const float *h_im, unsigned int bins)
+{
+	unsigned int k;
+
+	for (k = 0; k < bins; k += AUDIO_FFT_LANES) {
+		fft_v_t xr = fft_v(&x_re[k]), xi = fft_v(&x_im[k]);
+		fft_v_t hr = fft_v(&h_re[k]), hi = fft_v(&h_im[k]);
+
+		fft_v(&y_re[k]) += xr * hr - xi * hi;
+		fft_v(&y_im[k]) += xr * hi + xi * hr;
+	}
+}
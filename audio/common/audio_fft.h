@@ -0,0 +1,48 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_FFT_H_
+#define _AUDIO_FFT_H_
+
+#include "os/stdint.h"
+
+/*
+ * Real FFT, single precision, used by the fir and latency elements
+ *
+ * A real signal of "size" samples (power of 2) is transformed through a
+ * radix-2 complex FFT of size / 2 points, followed by a split step. The
+ * spectrum holds size / 2 + 1 bins (DC to Nyquist), stored as separate real
+ * and imaginary arrays of audio_fft_bins() entries, the padding bins being
+ * kept at zero (so that spectra can be processed a vector at a time).
+ *
+ * Transforms are not normalized: forward scales by 2, inverse by size.
+ */
+#define AUDIO_FFT_MIN_SIZE	4
+#define AUDIO_FFT_MAX_SIZE	2048
+
+struct audio_fft {
+	unsigned int size;	/* real samples */
+	unsigned int points;	/* complex FFT points, size / 2 */
+	unsigned int bins;
+
+	float *tw_re;		/* complex FFT twiddles, stage h at [h, 2h[ */
+	float *tw_im;
+	float *split_re;	/* split step twiddles, points + 1 */
+	float *split_im;
+	uint16_t *rev;		/* bit reversal permutation */
+	float *z_re;		/* complex FFT work buffer */
+	float *z_im;
+};
+
+unsigned int audio_fft_bins(unsigned int size);
+unsigned int audio_fft_storage_size(unsigned int size);
+void audio_fft_init(struct audio_fft *fft, unsigned int size, void *storage);
+void audio_fft_forward(struct audio_fft *fft, const float *x, float *re, float *im);
+void audio_fft_inverse(struct audio_fft *fft, const float *re, const float *im, float *x);
+void audio_fft_mac(float *y_re, float *y_im, const float *x_re, const float *x_im,
+		   const float *h_re, const float *h_im, unsigned int bins);
+
+#endif /* _AUDIO_FFT_H_ */
@@ -6,47 +6,119 @@
 #ifndef _AUDIO_FORMAT_H_
 #define _AUDIO_FORMAT_H_
 
-/* Audio samples in double floating point format, and [-1.0, 1.0] range.
- * If the format is changed, most of the functions below need to be adjusted.
+#include "os/stdint.h"
+#include "os/stdbool.h"
+
+/* Audio sample format, selected at build time:
+ * - AUDIO_SAMPLE_FORMAT_DOUBLE: double floating point, [-1.0, 1.0] range (default)
+ * - AUDIO_SAMPLE_FORMAT_FLOAT: single floating point, [-1.0, 1.0] range
+ * - AUDIO_SAMPLE_FORMAT_INT32: 32bit signed integer, Q31 fixed point
+ *
+ * If a format is added, most of the functions below need to be adjusted.
  * Using a format with less than 32bit (default hardware fifo width) would
  * require more extensives adjustments.
  */
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+
+typedef int32_t audio_sample_t;
+
+#define AUDIO_SAMPLE_FORMAT_NAME	"int32 (Q31)"
+#define AUDIO_SAMPLE_SILENCE	((audio_sample_t)0)
+#define AUDIO_SAMPLE_SCALE	2147483647.0	/* 2^31 - 1 */
+#define AUDIO_SAMPLE_INT32_MIN	(-0x7fffffff)	/* -1.0 */
+
+#elif defined(AUDIO_SAMPLE_FORMAT_FLOAT)
+
+typedef float audio_sample_t;
+
+#define AUDIO_SAMPLE_FORMAT_NAME	"float"
+#define AUDIO_SAMPLE_SILENCE	((audio_sample_t)0.0)
+#define AUDIO_SAMPLE_SCALE	((audio_sample_t)2147483647.0)	/* 2^31 - 1, rounded to 2^31 */
+#define AUDIO_SAMPLE_INT32_MIN	(-0x7fffffff - 1)	/* -1.0 */
+
+#else
+
+#ifndef AUDIO_SAMPLE_FORMAT_DOUBLE
+#define AUDIO_SAMPLE_FORMAT_DOUBLE
+#endif
+
 typedef double audio_sample_t;
 
+#define AUDIO_SAMPLE_FORMAT_NAME	"double"
 #define AUDIO_SAMPLE_SILENCE	((audio_sample_t)0.0)
 #define AUDIO_SAMPLE_SCALE	((audio_sample_t)2147483647.0)	/* 2^31 - 1 */
+#define AUDIO_SAMPLE_INT32_MIN	(-0x7fffffff)	/* -1.0 */
+
+#endif
 
 static inline int32_t audio_sample_to_int32(audio_sample_t v)
 {
-	/* [-1.0, 1.0] -> [-0x7fffffff, 0x7fffffff] */
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return v;
+#else
+	/*
+	 * Saturate, out of range values can't be converted (and 2^31 - 1 can't
+	 * be represented in single precision)
+	 */
+	if (v >= (audio_sample_t)1.0)
+		return 0x7fffffff;
+
+	if (v <= (audio_sample_t)-1.0)
+		return AUDIO_SAMPLE_INT32_MIN;
+
+	/* ]-1.0, 1.0[ -> ]-0x80000000, 0x7fffffff[ (float), ]-0x7fffffff, 0x7fffffff[ (double) */
 	return (int32_t)(v * AUDIO_SAMPLE_SCALE);
+#endif
 }
 
 static inline audio_sample_t audio_int32_to_sample(int32_t v)
 {
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return v;
+#else
 	/* [-0x7fffffff, 0x7fffffff] -> [-1.0, 1.0] */
 	return (audio_sample_t)v / AUDIO_SAMPLE_SCALE;
+#endif
 }
 
 static inline audio_sample_t audio_double_to_sample(double v)
 {
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	/* saturate, out of range values can't be converted */
+	if (v >= 1.0)
+		return 0x7fffffff;
+
+	if (v <= -1.0)
+		return AUDIO_SAMPLE_INT32_MIN;
+
+	/* ]-1.0, 1.0[ -> ]-0x7fffffff, 0x7fffffff[ */
+	return (audio_sample_t)(v * AUDIO_SAMPLE_SCALE);
+#else
 	return (audio_sample_t)v;
+#endif
+}
+
+static inline double audio_sample_to_double(audio_sample_t v)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return (double)v / AUDIO_SAMPLE_SCALE;
+#else
+	return (double)v;
+#endif
 }
 
 static inline void audio_invert_int32(int32_t *val)
 {
-	/* FIXME */
+	*val = (int32_t)__builtin_bswap32((uint32_t)*val);
 }
 
 /*
  * Generic audio format conversion (from SAI to internal format)
  *
- * When this function is called, the "samples" input/output buffer
- * is full of 32bit fifo format samples (typically 32bit signed integer).
- * The 32bit samples are aligned on audio_sample_t boundaries (so
- * possibly with gaps between samples).
- *
- * On exit all samples are converted, in place, to audio_sample_t format.
+ * The "fifo" input block holds 32bit fifo format samples (typically 32bit
+ * signed integer), "stride" words apart (e.g the channel count of a block
+ * of interleaved frames, as read from a sai line fifo).
+ * The "samples" output buffer is contiguous, in audio_sample_t format.
  *
  * It implements:
  * - 32bit inversion of input
@@ -54,13 +126,13 @@ static inline void audio_invert_int32(int32_t *val)
  * - output = (input & mask) << shift
  * - conversion to audio_sample_t
  */
-static inline void audio_convert_from(audio_sample_t *samples, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
+static inline void audio_convert_from_scalar(audio_sample_t *samples, const uint32_t *fifo, unsigned int stride, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
 {
 	int32_t val;
 	int i;
 
 	for (i = 0; i < len; i++) {
-		val = *((int32_t *)&samples[i]);
+		val = (int32_t)fifo[i * stride];
 
 		if (invert)
 			audio_invert_int32(&val);
@@ -73,10 +145,11 @@ static inline void audio_convert_from(audio_sample_t *samples, unsigned int len,
 
 /* Generic audio format conversion (from internal to SAI format)
  *
- * When this function exits, the "samples" input/output buffer
- * is full of 32bit fifo format samples (typically 32bit signed integer).
- * The 32bit samples are aligned on audio_sample_t boundaries (so
- * possibly with gaps between samples).
+ * The "samples" input buffer is contiguous, in audio_sample_t format, and
+ * left unmodified.
+ * The "fifo" output block receives 32bit fifo format samples (typically 32bit
+ * signed integer), "stride" words apart (e.g the channel count of a block
+ * of interleaved frames, as written to a sai line fifo).
  *
  * It implements:
  * - conversion from audio_sample_t
@@ -85,23 +158,156 @@ static inline void audio_convert_from(audio_sample_t *samples, unsigned int len,
  * - 32bit inversion of output
  * if invert is true, for endianess conversion.
  */
-static inline void audio_convert_to(audio_sample_t *samples, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
+static inline void audio_convert_to_scalar(uint32_t *fifo, unsigned int stride, const audio_sample_t *samples, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
 {
-	audio_sample_t *sample;
-	int32_t *val;
+	int32_t val;
 	int i;
 
 	for (i = 0; i < len; i++) {
-		sample = &samples[i];
-		val = (int32_t *)sample;
-
-		*val = audio_sample_to_int32(*sample);
+		val = audio_sample_to_int32(samples[i]);
 
-		*val = (*val >> shift) & mask;
+		val = (val >> shift) & mask;
 
 		if (invert)
-			audio_invert_int32(val);
+			audio_invert_int32(&val);
+
+		fifo[i * stride] = (uint32_t)val;
+	}
+}
+
+#if defined(__GNUC__) && !defined(AUDIO_FORMAT_NO_VECTOR)
+/*
+ * Vectorized format conversion, 4 samples at a time.
+ * Uses the compiler generic vector extensions, which are mapped to NEON
+ * (Advanced SIMD) instructions on Cortex-A. Results are bit exact with
+ * the scalar implementation above.
+ * The vector types below alias the audio sample storage, so they are only
+ * aligned to the audio sample size (or to 32bit for the fifo blocks).
+ */
+#define AUDIO_FORMAT_VECTOR	4
+
+typedef int32_t audio_v4si_t __attribute__((vector_size(16), may_alias, aligned(sizeof(audio_sample_t))));
+typedef uint32_t audio_v4su_t __attribute__((vector_size(16), may_alias, aligned(sizeof(audio_sample_t))));
+typedef uint32_t audio_v4fu_t __attribute__((vector_size(16), may_alias, aligned(sizeof(uint32_t))));
+typedef uint8_t audio_v16qu_t __attribute__((vector_size(16)));
+
+#if defined(AUDIO_SAMPLE_FORMAT_DOUBLE)
+typedef double audio_v4s_t __attribute__((vector_size(32), may_alias, aligned(sizeof(audio_sample_t))));
+typedef int64_t audio_v4sm_t __attribute__((vector_size(32)));	/* audio_v4s_t comparison mask */
+#elif defined(AUDIO_SAMPLE_FORMAT_FLOAT)
+typedef float audio_v4s_t __attribute__((vector_size(16), may_alias, aligned(sizeof(audio_sample_t))));
+typedef int32_t audio_v4sm_t __attribute__((vector_size(16)));	/* audio_v4s_t comparison mask */
+#endif
+
+static inline audio_v4su_t audio_invert_v4su(audio_v4su_t v)
+{
+	const audio_v16qu_t rev32 = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+
+	return (audio_v4su_t)__builtin_shuffle((audio_v16qu_t)v, rev32);
+}
+
+/* Load 4 contiguous fifo samples */
+static inline audio_v4su_t audio_fifo_load_v4(const uint32_t *fifo)
+{
+	return (audio_v4su_t)*(const audio_v4fu_t *)fifo;
+}
+
+/* Store 4 fifo samples, stride words apart */
+static inline void audio_fifo_store_v4(uint32_t *fifo, unsigned int stride, audio_v4su_t v)
+{
+	if (stride == 1) {
+		*(audio_v4fu_t *)fifo = (audio_v4fu_t)v;
+	} else {
+		fifo[0] = v[0];
+		fifo[stride] = v[1];
+		fifo[2 * stride] = v[2];
+		fifo[3 * stride] = v[3];
 	}
 }
 
+static inline void audio_convert_from_v4(audio_sample_t *samples, audio_v4su_t val, bool invert, uint32_t mask, uint32_t shift)
+{
+	if (invert)
+		val = audio_invert_v4su(val);
+
+	val = (val & mask) << shift;
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	*(audio_v4su_t *)samples = val;
+#else
+	*(audio_v4s_t *)samples = __builtin_convertvector((audio_v4si_t)val, audio_v4s_t) / AUDIO_SAMPLE_SCALE;
+#endif
+}
+
+static inline audio_v4su_t audio_convert_to_v4(const audio_sample_t *samples, bool invert, uint32_t mask, uint32_t shift)
+{
+	audio_v4si_t val;
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	val = *(const audio_v4si_t *)samples;
+#else
+	audio_v4s_t v = *(const audio_v4s_t *)samples;
+	audio_v4sm_t hi = (v >= (audio_sample_t)1.0);
+	audio_v4sm_t lo = (v <= (audio_sample_t)-1.0);
+	audio_v4si_t sat_hi, sat_lo;
+
+	/* same saturation as audio_sample_to_int32(), out of range lanes are zeroed before conversion */
+	v = (audio_v4s_t)((audio_v4sm_t)v & ~(hi | lo));
+	val = __builtin_convertvector(v * AUDIO_SAMPLE_SCALE, audio_v4si_t);
+
+	sat_hi = __builtin_convertvector(hi, audio_v4si_t);
+	sat_lo = __builtin_convertvector(lo, audio_v4si_t);
+	val = (val & ~(sat_hi | sat_lo)) | (0x7fffffff & sat_hi) | (AUDIO_SAMPLE_INT32_MIN & sat_lo);
+#endif
+
+	val = (audio_v4si_t)((audio_v4su_t)(val >> shift) & mask);
+
+	if (invert)
+		val = (audio_v4si_t)audio_invert_v4su((audio_v4su_t)val);
+
+	return (audio_v4su_t)val;
+}
+
+static inline void audio_convert_from(audio_sample_t *samples, const uint32_t *fifo, unsigned int stride, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
+{
+	unsigned int i;
+
+	/* Vector loads gathered from strided words are slower than the scalar loop */
+	if (stride != 1) {
+		audio_convert_from_scalar(samples, fifo, stride, len, invert, mask, shift);
+		return;
+	}
+
+	for (i = 0; i + AUDIO_FORMAT_VECTOR <= len; i += AUDIO_FORMAT_VECTOR)
+		audio_convert_from_v4(&samples[i], audio_fifo_load_v4(&fifo[i]), invert, mask, shift);
+
+	if (i < len)
+		audio_convert_from_scalar(&samples[i], &fifo[i], 1, len - i, invert, mask, shift);
+}
+
+static inline void audio_convert_to(uint32_t *fifo, unsigned int stride, const audio_sample_t *samples, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
+{
+	unsigned int i;
+
+	for (i = 0; i + AUDIO_FORMAT_VECTOR <= len; i += AUDIO_FORMAT_VECTOR)
+		audio_fifo_store_v4(&fifo[i * stride], stride, audio_convert_to_v4(&samples[i], invert, mask, shift));
+
+	if (i < len)
+		audio_convert_to_scalar(&fifo[i * stride], stride, &samples[i], len - i, invert, mask, shift);
+}
+
+#else
+
+static inline void audio_convert_from(audio_sample_t *samples, const uint32_t *fifo, unsigned int stride, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
+{
+	audio_convert_from_scalar(samples, fifo, stride, len, invert, mask, shift);
+}
+
+static inline void audio_convert_to(uint32_t *fifo, unsigned int stride, const audio_sample_t *samples, unsigned int len, bool invert, uint32_t mask, uint32_t shift)
+{
+	audio_convert_to_scalar(fifo, stride, samples, len, invert, mask, shift);
+}
+
+#endif /* __GNUC__ && !AUDIO_FORMAT_NO_VECTOR */
+
 #endif /* _AUDIO_FORMAT_H_ */
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/string.h"
+
+#include "audio_graph.h"
+#include "audio_worker.h"
+#include "hlog.h"
+
+#define DEQUE_SIZE	AUDIO_GRAPH_MAX_NODES
+#define DEQUE_MASK	(DEQUE_SIZE - 1)
+#define DEQUE_EMPTY	(-1)
+
+#if AUDIO_WORKERS > 0
+#define GRAPH_CPUS	(AUDIO_WORKERS + 1)
+#else
+#define GRAPH_CPUS	1
+#endif
+
+/*
+ * Work stealing deque (Chase-Lev), of ready nodes.
+ * The owner pushes/pops at the bottom, others steal from the top.
+ * Each node is pushed at most once per period, so the fixed size deque
+ * never overflows (it's emptied at the start of each period).
+ */
+struct audio_graph_deque {
+	long top;
+	long bottom;
+	uint8_t node[DEQUE_SIZE];
+} __attribute__((aligned(64)));
+
+struct audio_graph_cpu {
+	struct audio_graph *graph;
+	unsigned int id;
+};
+
+static struct audio_graph_deque deque_table[GRAPH_CPUS];
+static struct audio_graph_cpu cpu_table[GRAPH_CPUS];
+
+static void deque_reset(struct audio_graph_deque *deque)
+{
+	deque->top = 0;
+	deque->bottom = 0;
+}
+
+static void deque_push(struct audio_graph_deque *deque, unsigned int node)
+{
+	long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&deque->node[b & DEQUE_MASK], node, __ATOMIC_RELAXED);
+	__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELEASE);
+}
+
+static int deque_pop(struct audio_graph_deque *deque)
+{
+	long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+	long t;
+	int node;
+
+	__atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+	if (t > b) {
+		/* empty */
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+		return DEQUE_EMPTY;
+	}
+
+	node = __atomic_load_n(&deque->node[b & DEQUE_MASK], __ATOMIC_RELAXED);
+
+	if (t == b) {
+		/* last node, race against thieves */
+		if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			node = DEQUE_EMPTY;
+
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+
+	return node;
+}
+
+static int deque_steal(struct audio_graph_deque *deque)
+{
+	long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	long b;
+	int node;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+	if (t >= b)
+		return DEQUE_EMPTY;
+
+	node = __atomic_load_n(&deque->node[t & DEQUE_MASK], __ATOMIC_RELAXED);
+
+	if (!__atomic_compare_exchange_n(&deque->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return DEQUE_EMPTY;
+
+	return node;
+}
+
+void audio_graph_init(struct audio_graph *graph, struct audio_graph_node *node, unsigned int nodes)
+{
+	graph->nodes = nodes;
+	graph->node = node;
+	graph->workers = 0;
+}
+
+void audio_graph_add_edge(struct audio_graph *graph, unsigned int from, unsigned int to)
+{
+	struct audio_graph_node *node = &graph->node[from];
+
+	if (node->succ & (1ULL << to))
+		return;
+
+	node->succ |= 1ULL << to;
+	graph->node[to].preds++;
+}
+
+/*
+ * Estimated execution time of the graph on a given number of cpus:
+ * the longest of the critical path and the total execution time split evenly.
+ */
+uint64_t audio_graph_cost(struct audio_graph *graph, unsigned int cpus)
+{
+	uint64_t total = 0, path = 0;
+	struct audio_graph_node *node;
+	uint64_t succ;
+	int i, j;
+
+	for (i = 0; i < graph->nodes; i++)
+		graph->node[i].finish = 0;
+
+	/* nodes are in topological order */
+	for (i = 0; i < graph->nodes; i++) {
+		node = &graph->node[i];
+
+		node->finish += node->cost;
+		total += node->cost;
+
+		if (node->finish > path)
+			path = node->finish;
+
+		for (succ = node->succ; succ; succ &= succ - 1) {
+			j = __builtin_ctzll(succ);
+
+			if (node->finish > graph->node[j].finish)
+				graph->node[j].finish = node->finish;
+		}
+	}
+
+	total /= cpus;
+
+	return (path > total) ? path : total;
+}
+
+static void audio_graph_node_done(struct audio_graph *graph, struct audio_graph_deque *deque, struct audio_graph_node *node)
+{
+	uint64_t succ;
+	int i;
+
+	for (succ = node->succ; succ; succ &= succ - 1) {
+		i = __builtin_ctzll(succ);
+
+		if (!__atomic_sub_fetch(&graph->node[i].pending, 1, __ATOMIC_ACQ_REL))
+			deque_push(deque, i);
+	}
+
+	__atomic_add_fetch(&graph->done, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Runs ready nodes, until all are done. Busy waits for other cpus to make
+ * nodes ready, each cpu (data task or worker) has its own core.
+ */
+static int audio_graph_cpu_run(void *data)
+{
+	struct audio_graph_cpu *cpu = data;
+	struct audio_graph *graph = cpu->graph;
+	struct audio_graph_deque *deque = &deque_table[cpu->id];
+	unsigned int cpus = graph->workers + 1;
+	struct audio_graph_node *node;
+	int i, n;
+
+	while (__atomic_load_n(&graph->done, __ATOMIC_ACQUIRE) < graph->nodes) {
+		n = deque_pop(deque);
+
+		for (i = 1; (n == DEQUE_EMPTY) && (i < cpus); i++)
+			n = deque_steal(&deque_table[(cpu->id + i) % cpus]);
+
+		if (n == DEQUE_EMPTY)
+			continue;
+
+		node = &graph->node[n];
+
+		if (audio_element_run(node->element))
+			__atomic_store_n(&graph->rc, -1, __ATOMIC_RELAXED);
+
+		audio_graph_node_done(graph, deque, node);
+	}
+
+	return 0;
+}
+
+int audio_graph_run(struct audio_graph *graph)
+{
+	unsigned int cpus = graph->workers + 1;
+	unsigned int roots = 0;
+	int i;
+
+	graph->done = 0;
+	graph->rc = 0;
+
+	for (i = 0; i < cpus; i++) {
+		deque_reset(&deque_table[i]);
+		cpu_table[i].graph = graph;
+		cpu_table[i].id = i;
+	}
+
+	/* Spread the nodes without predecessors on all cpus */
+	for (i = 0; i < graph->nodes; i++) {
+		graph->node[i].pending = graph->node[i].preds;
+
+		if (!graph->node[i].preds)
+			deque_push(&deque_table[roots++ % cpus], i);
+	}
+
+	for (i = 1; i < cpus; i++)
+		audio_worker_start(i - 1, audio_graph_cpu_run, &cpu_table[i]);
+
+	audio_graph_cpu_run(&cpu_table[0]);
+
+	for (i = 1; i < cpus; i++)
+		audio_worker_wait(i - 1);
+
+	return graph->rc;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_GRAPH_H_
+#define _AUDIO_GRAPH_H_
+
+#include "os/stdint.h"
+
+#include "audio_element.h"
+
+/*
+ * Elements dependency graph
+ *
+ * Nodes are the pipeline elements, in topological (stage) order, an edge
+ * links an element writing a buffer to the elements reading it.
+ * Independent elements can run in parallel, on the data task and the audio
+ * workers: each has a deque of ready elements, and steals from the others
+ * when its own deque is empty.
+ */
+#define AUDIO_GRAPH_MAX_NODES	64	/* size of a successors mask */
+
+struct audio_graph_node {
+	struct audio_element *element;
+	uint64_t succ;		/* successors mask */
+	unsigned int preds;	/* number of predecessors */
+	unsigned int pending;	/* predecessors not yet run, in the current period */
+	uint64_t cost;		/* execution time */
+	uint64_t finish;	/* estimated finish time, relative to period start */
+};
+
+struct audio_graph {
+	unsigned int nodes;
+	struct audio_graph_node *node;
+	unsigned int workers;	/* audio workers used, in addition to the data task */
+	unsigned int done;	/* nodes run, in the current period */
+	int rc;
+};
+
+void audio_graph_init(struct audio_graph *graph, struct audio_graph_node *node, unsigned int nodes);
+void audio_graph_add_edge(struct audio_graph *graph, unsigned int from, unsigned int to);
+uint64_t audio_graph_cost(struct audio_graph *graph, unsigned int cpus);
+int audio_graph_run(struct audio_graph *graph);
+
+#endif /* _AUDIO_GRAPH_H_ */
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+
+#include "audio_osc.h"
+
+/*
+ * The lanes are processed as two vectors of two doubles (one Neon register
+ * each), wider vectors being split through memory by the compiler.
+ */
+#if defined(__GNUC__) && !defined(AUDIO_FORMAT_NO_VECTOR) && (AUDIO_OSC_LANES == 4)
+#define AUDIO_OSC_VECTOR
+typedef double osc_v_t __attribute__((vector_size(2 * sizeof(double)), may_alias, aligned(sizeof(double))));
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+typedef int32_t osc_out_t __attribute__((vector_size(2 * sizeof(int32_t)), may_alias, aligned(sizeof(int32_t))));
+#elif defined(AUDIO_SAMPLE_FORMAT_FLOAT)
+typedef float osc_out_t __attribute__((vector_size(2 * sizeof(float)), may_alias, aligned(sizeof(float))));
+#else
+typedef osc_v_t osc_out_t;
+#endif
+
+static inline void osc_store(audio_sample_t *out, osc_v_t v, bool add)
+{
+	osc_out_t s = __builtin_convertvector(v, osc_out_t);
+
+	if (add)
+		*(osc_out_t *)out += s;
+	else
+		*(osc_out_t *)out = s;
+}
+#endif
+
+void audio_osc_init(struct audio_osc *osc, double freq, unsigned int sample_rate, double phase)
+{
+	double dphase = 2.0 * M_PI * freq / sample_rate;
+	int l;
+
+	for (l = 0; l < AUDIO_OSC_LANES; l++) {
+		osc->re[l] = cos(phase + l * dphase);
+		osc->im[l] = sin(phase + l * dphase);
+	}
+
+	osc->rot_re = cos(AUDIO_OSC_LANES * dphase);
+	osc->rot_im = sin(AUDIO_OSC_LANES * dphase);
+	osc->step_re = cos(dphase);
+	osc->step_im = sin(dphase);
+}
+
+/* Current phase, in radians ]-pi, pi] */
+double audio_osc_phase(struct audio_osc *osc)
+{
+	return atan2(osc->im[0], osc->re[0]);
+}
+
+static void audio_osc_rotate(struct audio_osc *osc, double rot_re, double rot_im)
+{
+	double re;
+	int l;
+
+	for (l = 0; l < AUDIO_OSC_LANES; l++) {
+		re = osc->re[l] * rot_re - osc->im[l] * rot_im;
+		osc->im[l] = osc->re[l] * rot_im + osc->im[l] * rot_re;
+		osc->re[l] = re;
+	}
+}
+
+/* First order correction of the phasors magnitude, |z| ~ 1 */
+static void audio_osc_normalize(struct audio_osc *osc)
+{
+	double g;
+	int l;
+
+	for (l = 0; l < AUDIO_OSC_LANES; l++) {
+		g = (3.0 - (osc->re[l] * osc->re[l] + osc->im[l] * osc->im[l])) * 0.5;
+
+		osc->re[l] *= g;
+		osc->im[l] *= g;
+	}
+}
+
+/* Writes (or adds to the output, with add set) len samples of amplitude * sin() */
+void audio_osc_generate(struct audio_osc *osc, audio_sample_t *out, unsigned int len, double amplitude, bool add)
+{
+	unsigned int i = 0, n;
+	audio_sample_t w;
+	int l;
+
+#if defined(AUDIO_OSC_VECTOR)
+	{
+		osc_v_t re0 = *(osc_v_t *)&osc->re[0], re1 = *(osc_v_t *)&osc->re[2];
+		osc_v_t im0 = *(osc_v_t *)&osc->im[0], im1 = *(osc_v_t *)&osc->im[2];
+		double rot_re = osc->rot_re, rot_im = osc->rot_im;
+		osc_v_t t0, t1;
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+		double a = amplitude * AUDIO_SAMPLE_SCALE;
+#else
+		double a = amplitude;
+#endif
+
+		for (; i + AUDIO_OSC_LANES <= len; i += AUDIO_OSC_LANES) {
+			osc_store(&out[i], im0 * a, add);
+			osc_store(&out[i + 2], im1 * a, add);
+
+			t0 = re0 * rot_re - im0 * rot_im;
+			t1 = re1 * rot_re - im1 * rot_im;
+			im0 = re0 * rot_im + im0 * rot_re;
+			im1 = re1 * rot_im + im1 * rot_re;
+			re0 = t0;
+			re1 = t1;
+		}
+
+		*(osc_v_t *)&osc->re[0] = re0;
+		*(osc_v_t *)&osc->re[2] = re1;
+		*(osc_v_t *)&osc->im[0] = im0;
+		*(osc_v_t *)&osc->im[2] = im1;
+	}
+#else
+	for (; i + AUDIO_OSC_LANES <= len; i += AUDIO_OSC_LANES) {
+		for (l = 0; l < AUDIO_OSC_LANES; l++) {
+			w = audio_double_to_sample(amplitude * osc->im[l]);
+
+			if (add)
+				out[i + l] += w;
+			else
+				out[i + l] = w;
+		}
+
+		audio_osc_rotate(osc, osc->rot_re, osc->rot_im);
+	}
+#endif
+
+	/* last samples, from the first lanes */
+	n = len - i;
+	if (n) {
+		for (l = 0; l < n; l++) {
+			w = audio_double_to_sample(amplitude * osc->im[l]);
+
+			if (add)
+				out[i + l] += w;
+			else
+				out[i + l] = w;
+		}
+
+		for (l = 0; l < n; l++)
+			audio_osc_rotate(osc, osc->step_re, osc->step_im);
+	}
+
+	audio_osc_normalize(osc);
+}
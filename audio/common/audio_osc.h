@@ -0,0 +1,39 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_OSC_H_
+#define _AUDIO_OSC_H_
+
+#include "os/stdbool.h"
+
+#include "audio_format.h"
+
+/*
+ * Sine oscillator, used by the sine and dtmf sources
+ *
+ * The oscillator is a complex phasor, rotated by the phase increment at
+ * each sample, the sine being its imaginary part. AUDIO_OSC_LANES phasors,
+ * spaced by one sample, are rotated together by AUDIO_OSC_LANES increments,
+ * producing that many consecutive samples per step (one vector operation).
+ * The phasors magnitude is renormalized after each call, so rounding errors
+ * don't accumulate over long runs.
+ */
+#define AUDIO_OSC_LANES	4
+
+struct audio_osc {
+	double re[AUDIO_OSC_LANES];	/* phasor of lane l: exp(i (phase + l * dphase)) */
+	double im[AUDIO_OSC_LANES];
+	double rot_re;			/* exp(i AUDIO_OSC_LANES * dphase) */
+	double rot_im;
+	double step_re;			/* exp(i dphase) */
+	double step_im;
+};
+
+void audio_osc_init(struct audio_osc *osc, double freq, unsigned int sample_rate, double phase);
+void audio_osc_generate(struct audio_osc *osc, audio_sample_t *out, unsigned int len, double amplitude, bool add);
+double audio_osc_phase(struct audio_osc *osc);
+
+#endif /* _AUDIO_OSC_H_ */
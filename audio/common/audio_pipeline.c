@@ -8,6 +8,8 @@
 #include "os/string.h"
 
 #include "audio_pipeline.h"
+#include "audio_worker.h"
+#include "cpu.h"
 #include "hrpn_ctrl.h"
 #include "hlog.h"
 #include "mailbox.h"
@@ -24,6 +26,7 @@ static int audio_pipeline_table_add(struct audio_pipeline *pipeline)
 	for (i = 0; i < MAX_PIPELINES; i++) {
 		if (!pipeline_table[i]) {
 			pipeline_table[i] = pipeline;
+			pipeline->id = i;
 			goto done;
 		}
 	}
@@ -87,6 +90,55 @@ static void audio_pipeline_response(struct mailbox *m, uint32_t status)
 	}
 }
 
+#ifdef AUDIO_ELEMENT_PROFILE
+/* Element id, for its type (as used by element control commands) */
+static unsigned int audio_pipeline_element_id(struct audio_pipeline *pipeline, unsigned int n)
+{
+	unsigned int id = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (pipeline->element[i].type == pipeline->element[n].type)
+			id++;
+
+	return id;
+}
+
+static void audio_pipeline_profile(struct audio_pipeline *pipeline, unsigned int first, struct mailbox *m)
+{
+	struct hrpn_resp_audio_pipeline_profile resp;
+	struct hrpn_resp_audio_pipeline_profile_entry *entry;
+	struct audio_element *element;
+	int i;
+
+	/* detailed profile (with histograms) on the local console, once */
+	if (!first)
+		for (i = 0; i < pipeline->elements; i++)
+			audio_element_profile_dump(&pipeline->element[i]);
+
+	resp.type = HRPN_RESP_TYPE_AUDIO_PIPELINE;
+	resp.status = HRPN_RESP_STATUS_SUCCESS;
+	resp.counter_freq = os_cpu_counter_freq();
+	resp.elements = pipeline->elements;
+	resp.entries = 0;
+
+	for (i = first; (i < pipeline->elements) && (resp.entries < HRPN_AUDIO_PIPELINE_PROFILE_ENTRIES); i++) {
+		element = &pipeline->element[i];
+		entry = &resp.entry[resp.entries++];
+
+		entry->element.type = element->type;
+		entry->element.id = audio_pipeline_element_id(pipeline, i);
+		entry->min = element->profile.stats.min;
+		entry->mean = element->profile.stats.mean;
+		entry->max = element->profile.stats.max;
+		entry->abs_max = element->profile.stats.abs_max;
+	}
+
+	if (m)
+		mailbox_resp_send(m, &resp, sizeof(resp));
+}
+#endif
+
 int audio_pipeline_ctrl(struct hrpn_cmd_audio_pipeline *cmd, unsigned int len, struct mailbox *m)
 {
 	struct audio_pipeline *pipeline = NULL;
@@ -111,6 +163,21 @@ int audio_pipeline_ctrl(struct hrpn_cmd_audio_pipeline *cmd, unsigned int len, s
 
 		break;
 
+	case HRPN_CMD_TYPE_AUDIO_PIPELINE_PROFILE:
+		if (len != sizeof(struct hrpn_cmd_audio_pipeline_profile))
+			goto err;
+
+		if (!pipeline)
+			goto err;
+
+#ifdef AUDIO_ELEMENT_PROFILE
+		audio_pipeline_profile(pipeline, cmd->u.audio_pipeline_profile.element, m);
+#else
+		log_info("pipeline(%p): element profiling not enabled\n", pipeline);
+		goto err;
+#endif
+		break;
+
 	default:
 		if (pipeline && (len >= sizeof(struct hrpn_cmd_audio_element_common)))
 			element = audio_pipeline_element_find(pipeline, cmd->u.element.u.common.element.type, cmd->u.element.u.common.element.id);
@@ -347,37 +414,328 @@ err:
 	return -1;
 }
 
-static unsigned int audio_buffer_storage_size(struct audio_pipeline_config *config)
+/*
+ * Buffers storage, as allocated. Same as the configuration, unless storage
+ * is reused (the configuration itself is never modified).
+ */
+struct audio_storage_layout {
+	unsigned int storage[AUDIO_PIPELINE_MAX_BUFFERS];	/* per buffer, storage used */
+	unsigned int periods[AUDIO_PIPELINE_MAX_BUFFERS];	/* per storage, size (0 if not allocated) */
+};
+
+static void audio_storage_layout_init(struct audio_pipeline_config *config, struct audio_storage_layout *layout)
+{
+	int i;
+
+	for (i = 0; i < config->buffers; i++)
+		layout->storage[i] = config->buffer[i].storage;
+
+	for (i = 0; i < config->buffer_storage; i++)
+		layout->periods[i] = config->storage[i].periods;
+}
+
+static unsigned int audio_storage_layout_count(struct audio_pipeline_config *config, struct audio_storage_layout *layout, unsigned int storage)
+{
+	int count = 0;
+	int i;
+
+	for (i = 0; i < config->buffers; i++) {
+		if (layout->storage[i] == storage)
+			count++;
+	}
+
+	return count;
+}
+
+/* Size of a single buffer storage, in bytes, rounded up to keep all storage cache line aligned */
+static unsigned int audio_buffer_storage_size_one(struct audio_pipeline_config *config, struct audio_storage_layout *layout, unsigned int id)
+{
+	unsigned int size = layout->periods[id] * config->period * sizeof(audio_sample_t);
+
+	return (size + AUDIO_BUFFER_ALIGN - 1) & ~(AUDIO_BUFFER_ALIGN - 1);
+}
+
+static unsigned int audio_buffer_storage_size(struct audio_pipeline_config *config, struct audio_storage_layout *layout)
 {
 	unsigned int size = 0;
 	int i;
 
 	for (i = 0; i < config->buffer_storage; i++) {
 		if (!config->storage[i].base)
-			size += config->storage[i].periods * config->period * sizeof(audio_sample_t);
+			size += audio_buffer_storage_size_one(config, layout, i);
 	}
 
+	/* padding for storage base alignment */
+	size += AUDIO_BUFFER_ALIGN - 1;
+
 	return size;
 }
 
-static unsigned int audio_buffer_storage_off(struct audio_pipeline_config *config, unsigned int id)
+static unsigned int audio_buffer_storage_off(struct audio_pipeline_config *config, struct audio_storage_layout *layout, unsigned int id)
 {
 	unsigned int offset = 0;
 	int i;
 
 	for (i = 0; i < id; i++) {
 		if (!config->storage[i].base)
-			offset += config->storage[i].periods * config->period;
+			offset += audio_buffer_storage_size_one(config, layout, i) / sizeof(audio_sample_t);
 	}
 
 	return offset;
 }
 
+/* Elements that can forward an input buffer storage to their outputs (as buffer views) */
+static bool audio_element_views(struct audio_element_config *config)
+{
+	return config->type == AUDIO_ELEMENT_ROUTING;
+}
+
+/*
+ * Elements reading exactly one period from each input and writing exactly one
+ * period to each output, at each run, without checking the buffers level.
+ * Others read or write a variable number of frames (sample rate converters,
+ * sai sink inputs written serially), or write start silence to their inputs
+ * or outputs (sai sink and source).
+ */
+static bool audio_element_period_io(struct audio_element_config *config)
+{
+	switch (config->type) {
+	case AUDIO_ELEMENT_DTMF_SOURCE:
+	case AUDIO_ELEMENT_SINE_SOURCE:
+	case AUDIO_ELEMENT_ROUTING:
+	case AUDIO_ELEMENT_MIXER:
+	case AUDIO_ELEMENT_BIQUAD:
+	case AUDIO_ELEMENT_FIR:
+	case AUDIO_ELEMENT_DETECTOR:
+	case AUDIO_ELEMENT_LATENCY:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/*
+ * Buffer storage reuse
+ *
+ * A buffer written and read only by period io elements is empty at the end of
+ * each period, so its storage only holds live data from the stage writing it
+ * to the last stage reading it (or reading a view of it).
+ * Storages with disjoint live ranges are packed in the same memory, by
+ * remapping their buffers to a single storage (like register allocation).
+ *
+ * Storages are left untouched if they have a fixed base address, are larger
+ * than the default size, or have a buffer never written, never read or
+ * accessed by any other element (e.g, all buffers connected to the sai).
+ * This only saves memory for pipelines with several processing stages between
+ * the sai source and sink, and is skipped with audio workers.
+ */
+struct audio_storage_plan {
+	uint8_t producer[AUDIO_PIPELINE_MAX_BUFFERS];	/* per buffer, stage writing it */
+	uint8_t consumer[AUDIO_PIPELINE_MAX_BUFFERS];	/* per buffer, last stage reading it */
+	bool carry[AUDIO_PIPELINE_MAX_BUFFERS];		/* per buffer, may hold frames across periods */
+	uint8_t first[AUDIO_PIPELINE_MAX_BUFFERS];	/* per storage, live range */
+	uint8_t last[AUDIO_PIPELINE_MAX_BUFFERS];
+	bool fixed[AUDIO_PIPELINE_MAX_BUFFERS];	/* per storage, excluded from reuse */
+	unsigned int map[AUDIO_PIPELINE_MAX_BUFFERS];	/* per storage, storage actually used */
+};
+
+static void audio_pipeline_storage_ranges(struct audio_pipeline_config *config, struct audio_storage_plan *plan)
+{
+	struct audio_element_config *element_config;
+	unsigned int in, out;
+	int i, j, k, l;
+
+	for (i = 0; i < config->buffers; i++) {
+		plan->producer[i] = AUDIO_PIPELINE_NO_STAGE;
+		plan->consumer[i] = AUDIO_PIPELINE_NO_STAGE;
+		plan->carry[i] = false;
+	}
+
+	for (i = 0; i < config->stages; i++) {
+		for (j = 0; j < config->stage[i].elements; j++) {
+			element_config = &config->stage[i].element[j];
+
+			for (k = 0; k < element_config->outputs; k++) {
+				plan->producer[element_config->output[k]] = i;
+
+				if (!audio_element_period_io(element_config))
+					plan->carry[element_config->output[k]] = true;
+			}
+
+			for (k = 0; k < element_config->inputs; k++) {
+				plan->consumer[element_config->input[k]] = i;
+
+				if (!audio_element_period_io(element_config))
+					plan->carry[element_config->input[k]] = true;
+			}
+		}
+	}
+
+	/*
+	 * Inputs storage may be read through output views, until the outputs are read
+	 * (and across periods, if the outputs are)
+	 */
+	for (i = config->stages - 1; i >= 0; i--) {
+		for (j = 0; j < config->stage[i].elements; j++) {
+			element_config = &config->stage[i].element[j];
+
+			if (!audio_element_views(element_config))
+				continue;
+
+			for (k = 0; k < element_config->inputs; k++) {
+				in = element_config->input[k];
+
+				for (l = 0; l < element_config->outputs; l++) {
+					out = element_config->output[l];
+
+					if ((plan->consumer[out] != AUDIO_PIPELINE_NO_STAGE) && (plan->consumer[out] > plan->consumer[in]))
+						plan->consumer[in] = plan->consumer[out];
+
+					if (plan->carry[out])
+						plan->carry[in] = true;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < config->buffer_storage; i++) {
+		plan->first[i] = AUDIO_PIPELINE_NO_STAGE;
+		plan->last[i] = 0;
+		plan->fixed[i] = (config->storage[i].base != NULL) || !audio_pipeline_count_buffers(config, i) ||
+				 (config->storage[i].periods > STORAGE_DEFAULT_PERIODS);
+		plan->map[i] = i;
+	}
+
+	for (i = 0; i < config->buffers; i++) {
+		j = config->buffer[i].storage;
+
+		if ((plan->producer[i] == AUDIO_PIPELINE_NO_STAGE) || (plan->consumer[i] == AUDIO_PIPELINE_NO_STAGE) ||
+		    plan->carry[i]) {
+			plan->fixed[j] = true;
+			continue;
+		}
+
+		if (plan->producer[i] < plan->first[j])
+			plan->first[j] = plan->producer[i];
+
+		if (plan->consumer[i] > plan->last[j])
+			plan->last[j] = plan->consumer[i];
+	}
+}
+
+/* Among the storages free at the given stage, select the one closest in size */
+static int audio_pipeline_storage_find(struct audio_pipeline_config *config, struct audio_storage_layout *layout,
+				       struct audio_storage_plan *plan, unsigned int id, unsigned int stage)
+{
+	unsigned int periods = layout->periods[id];
+	int best = -1;
+	int i;
+
+	for (i = 0; i < config->buffer_storage; i++) {
+		if (plan->fixed[i] || (plan->map[i] != i) || (i == id))
+			continue;
+
+		if (plan->last[i] >= stage)
+			continue;
+
+		if (best < 0) {
+			best = i;
+			continue;
+		}
+
+		if (layout->periods[best] >= periods) {
+			if ((layout->periods[i] >= periods) && (layout->periods[i] < layout->periods[best]))
+				best = i;
+		} else if (layout->periods[i] > layout->periods[best]) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/* Plans the storage reuse, in the layout (initialized from the configuration) */
+static void audio_pipeline_storage_reuse(struct audio_pipeline_config *config, struct audio_storage_layout *layout)
+{
+	struct audio_storage_plan *plan;
+	unsigned int size, reused = 0;
+	int i, stage, storage;
+
+	plan = os_malloc(sizeof(struct audio_storage_plan));
+	if (!plan) {
+		log_warn("pipeline: storage reuse plan allocation failed\n");
+		return;
+	}
+
+	audio_pipeline_storage_ranges(config, plan);
+
+	size = audio_buffer_storage_size(config, layout);
+
+	/* Greedy packing, by live range start */
+	for (stage = 0; stage < config->stages; stage++) {
+		for (i = 0; i < config->buffer_storage; i++) {
+			if (plan->fixed[i] || (plan->first[i] != stage))
+				continue;
+
+			storage = audio_pipeline_storage_find(config, layout, plan, i, stage);
+			if (storage < 0)
+				continue;
+
+			plan->map[i] = storage;
+			plan->last[storage] = plan->last[i];
+
+			if (layout->periods[i] > layout->periods[storage])
+				layout->periods[storage] = layout->periods[i];
+
+			/* no memory allocated for the reused storage */
+			layout->periods[i] = 0;
+			reused++;
+		}
+	}
+
+	if (reused) {
+		for (i = 0; i < config->buffers; i++)
+			layout->storage[i] = plan->map[layout->storage[i]];
+
+		log_info("pipeline: %u storage reused, storage size %u -> %u bytes\n",
+			 reused, size, audio_buffer_storage_size(config, layout));
+	}
+
+	os_free(plan);
+}
+
 static unsigned int audio_buffer_size(struct audio_pipeline_config *config)
 {
 	return config->buffers * sizeof(struct audio_buffer);
 }
 
+static unsigned int audio_element_count(struct audio_pipeline_config *config)
+{
+	unsigned int count = 0;
+	int i;
+
+	for (i = 0; i < config->stages; i++)
+		count += config->stage[i].elements;
+
+	return count;
+}
+
+static unsigned int audio_graph_node_size(struct audio_pipeline_config *config)
+{
+	return audio_element_count(config) * sizeof(struct audio_graph_node);
+}
+
+static unsigned int audio_plan_size(struct audio_pipeline_config *config)
+{
+	return audio_element_count(config) * sizeof(struct audio_pipeline_plan_entry);
+}
+
+static unsigned int audio_buffer_info_size(struct audio_pipeline_config *config)
+{
+	return config->buffers * sizeof(struct audio_pipeline_buffer_info);
+}
+
 static unsigned int audio_element_data_size_total(struct audio_pipeline_config *config)
 {
 	struct audio_pipeline_stage_config *stage_config;
@@ -417,7 +775,7 @@ static unsigned int audio_stage_size(struct audio_pipeline_config *config)
 	return config->stages * sizeof(struct audio_pipeline_stage);
 }
 
-static struct audio_pipeline *audio_pipeline_alloc(struct audio_pipeline_config *config)
+static struct audio_pipeline *audio_pipeline_alloc(struct audio_pipeline_config *config, struct audio_storage_layout *layout)
 {
 	struct audio_pipeline *pipeline;
 	unsigned int size;
@@ -427,7 +785,10 @@ static struct audio_pipeline *audio_pipeline_alloc(struct audio_pipeline_config
 	size += audio_element_size(config);
 	size += audio_element_data_size_total(config);
 	size += audio_buffer_size(config);
-	size += audio_buffer_storage_size(config);
+	size += audio_graph_node_size(config);
+	size += audio_plan_size(config);
+	size += audio_buffer_info_size(config);
+	size += audio_buffer_storage_size(config, layout);
 
 	pipeline = os_malloc(size);
 	if (!pipeline)
@@ -446,9 +807,58 @@ static void audio_pipeline_free(struct audio_pipeline *pipeline)
 	os_free(pipeline);
 }
 
-static void audio_pipeline_buffer_init(struct audio_pipeline *pipeline, struct audio_pipeline_config *config)
+static void audio_pipeline_buffer_info_init(struct audio_pipeline *pipeline, struct audio_pipeline_config *config,
+					    struct audio_storage_layout *layout)
+{
+	struct audio_pipeline_stage_config *stage_config;
+	struct audio_element_config *element_config;
+	struct audio_pipeline_buffer_info *info;
+	int i, j, k;
+
+	for (i = 0; i < config->buffers; i++) {
+		info = &pipeline->buffer_info[i];
+
+		info->producer = AUDIO_PIPELINE_NO_STAGE;
+		info->consumer_first = AUDIO_PIPELINE_NO_STAGE;
+		info->consumer_last = AUDIO_PIPELINE_NO_STAGE;
+		info->shared = audio_storage_layout_count(config, layout, layout->storage[i]) > 1;
+		info->period = true;
+	}
+
+	for (i = 0; i < config->stages; i++) {
+		stage_config = &config->stage[i];
+
+		for (j = 0; j < stage_config->elements; j++) {
+			element_config = &stage_config->element[j];
+
+			for (k = 0; k < element_config->outputs; k++) {
+				info = &pipeline->buffer_info[element_config->output[k]];
+
+				info->producer = i;
+
+				if (!audio_element_period_io(element_config))
+					info->period = false;
+			}
+
+			for (k = 0; k < element_config->inputs; k++) {
+				info = &pipeline->buffer_info[element_config->input[k]];
+
+				if (info->consumer_first == AUDIO_PIPELINE_NO_STAGE)
+					info->consumer_first = i;
+
+				info->consumer_last = i;
+
+				if (!audio_element_period_io(element_config))
+					info->period = false;
+			}
+		}
+	}
+}
+
+static void audio_pipeline_buffer_init(struct audio_pipeline *pipeline, struct audio_pipeline_config *config,
+				       struct audio_storage_layout *layout)
 {
-	uint8_t *stage_base, *element_base, *element_data_base, *buffer_base, *buffer_storage_base;
+	uint8_t *stage_base, *element_base, *element_data_base, *buffer_base, *graph_node_base, *plan_base, *buffer_info_base, *buffer_storage_base;
 	unsigned int storage_id;
 	audio_sample_t *base;
 	unsigned int size;
@@ -459,20 +869,110 @@ static void audio_pipeline_buffer_init(struct audio_pipeline *pipeline, struct a
 	element_data_base = ((uint8_t *)element_base + audio_element_size(config));
 
 	buffer_base = ((uint8_t *)element_data_base + audio_element_data_size_total(config));
-	buffer_storage_base = ((uint8_t *)buffer_base + audio_buffer_size(config));
+	graph_node_base = ((uint8_t *)buffer_base + audio_buffer_size(config));
+	plan_base = ((uint8_t *)graph_node_base + audio_graph_node_size(config));
+	buffer_info_base = ((uint8_t *)plan_base + audio_plan_size(config));
+	buffer_storage_base = ((uint8_t *)buffer_info_base + audio_buffer_info_size(config));
+	buffer_storage_base = (uint8_t *)(((uintptr_t)buffer_storage_base + AUDIO_BUFFER_ALIGN - 1) & ~(uintptr_t)(AUDIO_BUFFER_ALIGN - 1));
 
+	pipeline->buffers = config->buffers;
 	pipeline->buffer = (struct audio_buffer *)buffer_base;
+	pipeline->buffer_info = (struct audio_pipeline_buffer_info *)buffer_info_base;
+	pipeline->plan = (struct audio_pipeline_plan_entry *)plan_base;
+
+	audio_pipeline_buffer_info_init(pipeline, config, layout);
+
+	audio_graph_init(&pipeline->graph, (struct audio_graph_node *)graph_node_base, audio_element_count(config));
 
 	for (i = 0; i < config->buffers; i++) {
-		storage_id = config->buffer[i].storage;
+		storage_id = layout->storage[i];
 
-		base = (audio_sample_t *)buffer_storage_base + audio_buffer_storage_off(config, storage_id);
-		size = config->storage[storage_id].periods * config->period;
+		base = (audio_sample_t *)buffer_storage_base + audio_buffer_storage_off(config, layout, storage_id);
+		size = layout->periods[storage_id] * config->period;
 
 		audio_buf_init(&pipeline->buffer[i], base, size);
 	}
 }
 
+static bool audio_element_storage_used(struct audio_storage_layout *layout, struct audio_element_config *element_config, unsigned int storage)
+{
+	int k;
+
+	for (k = 0; k < element_config->inputs; k++)
+		if (layout->storage[element_config->input[k]] == storage)
+			return true;
+
+	for (k = 0; k < element_config->outputs; k++)
+		if (layout->storage[element_config->output[k]] == storage)
+			return true;
+
+	return false;
+}
+
+/* Two elements depend on each other if they access a common buffer storage */
+static bool audio_element_depends(struct audio_storage_layout *layout, struct audio_element_config *from, struct audio_element_config *to)
+{
+	int k;
+
+	for (k = 0; k < from->inputs; k++)
+		if (audio_element_storage_used(layout, to, layout->storage[from->input[k]]))
+			return true;
+
+	for (k = 0; k < from->outputs; k++)
+		if (audio_element_storage_used(layout, to, layout->storage[from->output[k]]))
+			return true;
+
+	return false;
+}
+
+/*
+ * Build the elements dependency graph. Elements without any buffer (e.g, controlling hardware)
+ * keep the stages ordering and depend on all the elements of the previous stages.
+ */
+static void audio_pipeline_graph_build(struct audio_pipeline *pipeline, struct audio_pipeline_config *config,
+				       struct audio_storage_layout *layout)
+{
+	struct audio_element_config *from, *to;
+	unsigned int from_stage, to_stage;
+	unsigned int i, j, n, m;
+
+	for (i = 0, n = 0; i < config->stages; i++) {
+		for (j = 0; j < config->stage[i].elements; j++, n++)
+			pipeline->graph.node[n].element = &pipeline->stage[i].element[j];
+	}
+
+	for (from_stage = 0, n = 0; from_stage < config->stages; from_stage++) {
+		for (i = 0; i < config->stage[from_stage].elements; i++, n++) {
+			from = &config->stage[from_stage].element[i];
+
+			m = n + 1;
+			for (to_stage = from_stage; to_stage < config->stages; to_stage++) {
+				for (j = (to_stage == from_stage) ? i + 1 : 0; j < config->stage[to_stage].elements; j++, m++) {
+					to = &config->stage[to_stage].element[j];
+
+					if (audio_element_depends(layout, from, to) ||
+					    ((to_stage > from_stage) && !to->inputs && !to->outputs))
+						audio_graph_add_edge(&pipeline->graph, n, m);
+				}
+			}
+		}
+	}
+}
+
+static void audio_pipeline_plan_build(struct audio_pipeline *pipeline)
+{
+	int i;
+
+	for (i = 0; i < pipeline->elements; i++) {
+#ifdef AUDIO_ELEMENT_PROFILE
+		pipeline->plan[i].run = audio_element_run_profile;
+#else
+		pipeline->plan[i].run = pipeline->element[i].run;
+#endif
+		pipeline->plan[i].element = &pipeline->element[i];
+	}
+}
+
 static void audio_stage_init(struct audio_pipeline *pipeline, struct audio_pipeline_config *config)
 {
 	struct audio_pipeline_stage_config *stage_config;
@@ -488,6 +988,8 @@ static void audio_stage_init(struct audio_pipeline *pipeline, struct audio_pipel
 
 	pipeline->stages = config->stages;
 	pipeline->stage = (struct audio_pipeline_stage *)stage_base;
+	pipeline->elements = audio_element_count(config);
+	pipeline->element = (struct audio_element *)element_base;
 
 	for (i = 0; i < pipeline->stages; i++) {
 		stage = &pipeline->stage[i];
@@ -510,6 +1012,7 @@ static void audio_stage_init(struct audio_pipeline *pipeline, struct audio_pipel
 
 static struct audio_pipeline *audio_pipeline_create(struct audio_pipeline_config *config)
 {
+	struct audio_storage_layout *layout;
 	struct audio_pipeline *pipeline;
 
 	log_info("enter\n");
@@ -517,18 +1020,51 @@ static struct audio_pipeline *audio_pipeline_create(struct audio_pipeline_config
 	if (audio_pipeline_config_check(config) < 0)
 		goto err;
 
-	pipeline = audio_pipeline_alloc(config);
-	if (!pipeline)
+	layout = os_malloc(sizeof(struct audio_storage_layout));
+	if (!layout)
 		goto err;
 
+	audio_storage_layout_init(config, layout);
+
+	/*
+	 * Pipelined stage partitions run different stages in parallel,
+	 * each needs its own storage.
+	 */
+	if (!audio_worker_count())
+		audio_pipeline_storage_reuse(config, layout);
+
+	pipeline = audio_pipeline_alloc(config, layout);
+	if (!pipeline)
+		goto err_alloc;
+
 	audio_stage_init(pipeline, config);
 
-	audio_pipeline_buffer_init(pipeline, config);
+	audio_pipeline_buffer_init(pipeline, config, layout);
+
+	audio_pipeline_graph_build(pipeline, config, layout);
+
+	os_free(layout);
+
+	pipeline->period = config->period;
+
+	/* Serial execution, until stages execution time is known */
+	pipeline->partitions = 1;
+	pipeline->partition[0].pipeline = pipeline;
+	pipeline->partition[0].stage = 0;
+	pipeline->partition[0].stages = pipeline->stages;
+	pipeline->partition[0].entry = 0;
+	pipeline->partition[0].entries = pipeline->elements;
+
+	if (audio_worker_count() && (pipeline->stages > 1))
+		pipeline->calibration = AUDIO_PIPELINE_CALIBRATION_PERIODS;
 
 	log_info("done\n");
 
 	return pipeline;
 
+err_alloc:
+	os_free(layout);
+
 err:
 	return NULL;
 }
@@ -597,7 +1133,7 @@ struct audio_pipeline *audio_pipeline_init(struct audio_pipeline_config *config)
 	struct audio_element *element;
 	int i, j;
 
-	log_info("enter\n");
+	log_info("enter, sample format: %s\n", AUDIO_SAMPLE_FORMAT_NAME);
 
 	if (audio_pipeline_early_config_check(config) < 0)
 		goto err_config;
@@ -624,12 +1160,21 @@ struct audio_pipeline *audio_pipeline_init(struct audio_pipeline_config *config)
 		}
 	}
 
+	audio_pipeline_plan_build(pipeline);
+
 	log_info("done\n");
 
 	return pipeline;
 
 err_init:
-	/* call exit for all already initialized elements */
+	/* call exit for all already initialized elements, releasing their os resources */
+	while (j-- > 0)
+		audio_element_exit(&pipeline->stage[i].element[j]);
+
+	while (i-- > 0)
+		for (j = 0; j < pipeline->stage[i].elements; j++)
+			audio_element_exit(&pipeline->stage[i].element[j]);
+
 	audio_pipeline_table_del(pipeline);
 
 err_add:
@@ -640,61 +1185,321 @@ err_config:
 	return NULL;
 }
 
-int audio_pipeline_run(struct audio_pipeline *pipeline)
+static int audio_pipeline_run_plan(struct audio_pipeline_plan_entry *entry, unsigned int entries)
 {
-	struct audio_pipeline_stage *stage;
-	struct audio_element *element;
-	int i, j;
+	struct audio_pipeline_plan_entry *end = entry + entries;
 
-	for (i = 0; i < pipeline->stages; i++) {
-		stage = &pipeline->stage[i];
+	for (; entry < end; entry++)
+		if (entry->run(entry->element))
+			goto err;
 
-		for (j = 0; j < stage->elements; j++) {
-			element = &stage->element[j];
+	return 0;
 
-			if (audio_element_run(element))
-				goto err;
+err:
+	return -1;
+}
+
+static int audio_pipeline_run_partition(void *data)
+{
+	struct audio_pipeline_partition *partition = data;
+
+	return audio_pipeline_run_plan(&partition->pipeline->plan[partition->entry], partition->entries);
+}
+
+static unsigned int audio_pipeline_stage_partition(unsigned int cut, unsigned int stage)
+{
+	return __builtin_popcount(cut & ((1U << stage) - 1));
+}
+
+/*
+ * Checks if the pipeline can be split in partitions at the given boundaries.
+ * All the readers of a buffer must be in the same partition, and a buffer
+ * crossing partitions must not share its storage and must be able to hold
+ * the additional periods of latency.
+ * Its indexes are only updated by one side each (read by the readers, write by
+ * the writer), without synchronization, so the writer and the readers must
+ * access exactly one period per run and never check the buffer level (a
+ * buffer holding the latency plus the period being written is full, and looks
+ * empty).
+ */
+static bool audio_pipeline_cut_valid(struct audio_pipeline *pipeline, unsigned int cut)
+{
+	struct audio_pipeline_buffer_info *info;
+	unsigned int producer, consumer;
+	int i;
+
+	for (i = 0; i < pipeline->buffers; i++) {
+		info = &pipeline->buffer_info[i];
+
+		if ((info->producer == AUDIO_PIPELINE_NO_STAGE) || (info->consumer_first == AUDIO_PIPELINE_NO_STAGE))
+			continue;
+
+		producer = audio_pipeline_stage_partition(cut, info->producer);
+		consumer = audio_pipeline_stage_partition(cut, info->consumer_first);
+
+		if (audio_pipeline_stage_partition(cut, info->consumer_last) != consumer)
+			return false;
+
+		if (consumer == producer)
+			continue;
+
+		if (info->shared || !info->period)
+			return false;
+
+		if (pipeline->buffer[i].size < (consumer - producer + 1) * pipeline->period)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Add one period of silence per partition boundary, to all buffers crossing
+ * partitions. Also marks the buffers as accessed in parallel.
+ */
+static void audio_pipeline_partition_latency(struct audio_pipeline *pipeline)
+{
+	struct audio_pipeline_buffer_info *info;
+	struct audio_buffer *buffer;
+	unsigned int producer, consumer;
+	int i;
+
+	for (i = 0; i < pipeline->buffers; i++) {
+		info = &pipeline->buffer_info[i];
+		buffer = &pipeline->buffer[i];
+
+		if ((info->producer == AUDIO_PIPELINE_NO_STAGE) || (info->consumer_first == AUDIO_PIPELINE_NO_STAGE))
+			continue;
+
+		producer = audio_pipeline_stage_partition(pipeline->cut, info->producer);
+		consumer = audio_pipeline_stage_partition(pipeline->cut, info->consumer_first);
+
+		if (consumer == producer)
+			continue;
+
+		audio_buf_reset(buffer);
+		buffer->parallel = true;
+		audio_buf_write_silence(buffer, (consumer - producer) * pipeline->period);
+	}
+}
+
+/*
+ * Split the pipeline stages in partitions, based on the measured stages
+ * execution time. Selects the partitioning, with at most one partition per
+ * worker (plus the data task), that minimizes the longest partition
+ * execution time.
+ */
+static unsigned int audio_pipeline_schedule_partitions(struct audio_pipeline *pipeline, uint64_t *best_cost)
+{
+	uint64_t cost, cost_max;
+	unsigned int cut, best_cut = 0;
+	unsigned int partitions;
+	int i;
+
+	for (cut = 1; cut < (1U << (pipeline->stages - 1)); cut++) {
+		partitions = __builtin_popcount(cut) + 1;
+
+		if (partitions > audio_worker_count() + 1)
+			continue;
+
+		if (!audio_pipeline_cut_valid(pipeline, cut))
+			continue;
+
+		cost_max = 0;
+		cost = 0;
+		for (i = 0; i < pipeline->stages; i++) {
+			cost += pipeline->stage_cost[i];
+
+			if ((i == pipeline->stages - 1) || (cut & (1U << i))) {
+				if (cost > cost_max)
+					cost_max = cost;
+
+				cost = 0;
+			}
+		}
+
+		if (cost_max < *best_cost) {
+			*best_cost = cost_max;
+			best_cut = cut;
+		}
+	}
+
+	return best_cut;
+}
+
+static void audio_pipeline_set_partitions(struct audio_pipeline *pipeline, unsigned int cut)
+{
+	int i, p, n;
+
+	pipeline->cut = cut;
+	pipeline->partitions = __builtin_popcount(cut) + 1;
+
+	for (i = 0, p = 0, n = 0; i < pipeline->stages; i++) {
+		if (!i || (cut & (1U << (i - 1)))) {
+			if (i)
+				p++;
+
+			pipeline->partition[p].pipeline = pipeline;
+			pipeline->partition[p].stage = i;
+			pipeline->partition[p].stages = 0;
+			pipeline->partition[p].entry = n;
+			pipeline->partition[p].entries = 0;
+		}
+
+		pipeline->partition[p].stages++;
+		pipeline->partition[p].entries += pipeline->stage[i].elements;
+		n += pipeline->stage[i].elements;
+	}
+
+	audio_pipeline_partition_latency(pipeline);
+}
+
+/*
+ * Select the execution mode, based on the measured elements execution time:
+ * - graph, if running independent elements in parallel is faster than serial
+ *   execution and as fast as stage partitions (it adds no latency)
+ * - stage partitions, if faster than serial execution
+ * - serial otherwise
+ */
+static void audio_pipeline_schedule(struct audio_pipeline *pipeline)
+{
+	struct audio_graph *graph = &pipeline->graph;
+	uint64_t graph_cost, partition_cost, total = 0;
+	unsigned int cut;
+	int i, j, n;
+
+	for (i = 0, n = 0; i < pipeline->stages; i++) {
+		pipeline->stage_cost[i] = 0;
+
+		for (j = 0; j < pipeline->stage[i].elements; j++, n++) {
+			graph->node[n].cost /= AUDIO_PIPELINE_CALIBRATION_PERIODS;
+			pipeline->stage_cost[i] += graph->node[n].cost;
 		}
+
+		total += pipeline->stage_cost[i];
+
+		log_info("pipeline(%p): stage(%u) cost %llu\n", pipeline, i, pipeline->stage_cost[i]);
+	}
+
+	partition_cost = total;
+	cut = audio_pipeline_schedule_partitions(pipeline, &partition_cost);
+
+	graph_cost = audio_graph_cost(graph, audio_worker_count() + 1);
+
+	if ((graph_cost < total) && (graph_cost <= partition_cost)) {
+		graph->workers = audio_worker_count();
+		pipeline->mode = AUDIO_PIPELINE_RUN_GRAPH;
+
+		log_info("pipeline(%p): graph execution, %u workers, cost %llu/%llu\n",
+			 pipeline, graph->workers, graph_cost, total);
+	} else if (cut) {
+		audio_pipeline_set_partitions(pipeline, cut);
+		pipeline->mode = AUDIO_PIPELINE_RUN_PARTITIONS;
+
+		log_info("pipeline(%p): parallel execution, %u partitions, cost %llu/%llu\n",
+			 pipeline, pipeline->partitions, partition_cost, total);
+	} else {
+		log_info("pipeline(%p): serial execution\n", pipeline);
+	}
+}
+
+static int audio_pipeline_run_parallel(struct audio_pipeline *pipeline)
+{
+	int rc = 0;
+	int i;
+
+	for (i = 1; i < pipeline->partitions; i++)
+		audio_worker_start(i - 1, audio_pipeline_run_partition, &pipeline->partition[i]);
+
+	if (audio_pipeline_run_partition(&pipeline->partition[0]) < 0)
+		rc = -1;
+
+	for (i = 1; i < pipeline->partitions; i++)
+		if (audio_worker_wait(i - 1) < 0)
+			rc = -1;
+
+	return rc;
+}
+
+static int audio_pipeline_run_calibrate(struct audio_pipeline *pipeline)
+{
+	struct audio_graph_node *node;
+	uint64_t start;
+	int i;
+
+	for (i = 0; i < pipeline->graph.nodes; i++) {
+		node = &pipeline->graph.node[i];
+
+		start = os_cpu_counter();
+
+		if (audio_element_run(node->element))
+			goto err;
+
+		node->cost += os_cpu_counter() - start;
 	}
 
+	if (!--pipeline->calibration)
+		audio_pipeline_schedule(pipeline);
+
 	return 0;
 
 err:
 	return -1;
 }
 
-void audio_pipeline_reset(struct audio_pipeline *pipeline)
+int audio_pipeline_run(struct audio_pipeline *pipeline)
 {
-	struct audio_pipeline_stage *stage;
-	struct audio_element *element;
-	int i, j;
+	switch (pipeline->mode) {
+	case AUDIO_PIPELINE_RUN_PARTITIONS:
+		return audio_pipeline_run_parallel(pipeline);
 
-	for (i = 0; i < pipeline->stages; i++) {
-		stage = &pipeline->stage[i];
+	case AUDIO_PIPELINE_RUN_GRAPH:
+		return audio_graph_run(&pipeline->graph);
 
-		for (j = 0; j < stage->elements; j++) {
-			element = &stage->element[j];
+	case AUDIO_PIPELINE_RUN_SERIAL:
+	default:
+		if (pipeline->calibration)
+			return audio_pipeline_run_calibrate(pipeline);
 
-			audio_element_reset(element);
-		}
+		return audio_pipeline_run_plan(pipeline->plan, pipeline->elements);
 	}
 }
 
-void audio_pipeline_exit(struct audio_pipeline *pipeline)
+/*
+ * Periods larger than the sai fifos are transferred in smaller fifo periods,
+ * from the sai interrupt, while the pipeline runs a period at a time.
+ * Called from interrupt context, concurrently to audio_pipeline_run().
+ */
+void audio_pipeline_pump(struct audio_pipeline *pipeline)
 {
-	struct audio_pipeline_stage *stage;
 	struct audio_element *element;
-	int i, j;
+	int i;
 
-	for (i = 0; i < pipeline->stages; i++) {
-		stage = &pipeline->stage[i];
+	for (i = 0; i < pipeline->elements; i++) {
+		element = &pipeline->element[i];
 
-		for (j = 0; j < stage->elements; j++) {
-			element = &stage->element[j];
-
-			audio_element_exit(element);
-		}
+		if (element->pump)
+			element->pump(element);
 	}
+}
+
+void audio_pipeline_reset(struct audio_pipeline *pipeline)
+{
+	int i;
+
+	for (i = 0; i < pipeline->elements; i++)
+		audio_element_reset(&pipeline->element[i]);
+
+	if (pipeline->mode == AUDIO_PIPELINE_RUN_PARTITIONS)
+		audio_pipeline_partition_latency(pipeline);
+}
+
+void audio_pipeline_exit(struct audio_pipeline *pipeline)
+{
+	int i;
+
+	for (i = 0; i < pipeline->elements; i++)
+		audio_element_exit(&pipeline->element[i]);
 
 	audio_pipeline_table_del(pipeline);
 	audio_pipeline_free(pipeline);
@@ -702,34 +1507,23 @@ void audio_pipeline_exit(struct audio_pipeline *pipeline)
 
 void audio_pipeline_dump(struct audio_pipeline *pipeline)
 {
-	struct audio_pipeline_stage *stage;
-	struct audio_element *element;
-	int i, j;
+	int i;
 
-	for (i = 0; i < pipeline->stages; i++) {
-		stage = &pipeline->stage[i];
+	log_info("pipeline(%p): mode: %u, partitions: %u, graph workers: %u\n", pipeline,
+		 pipeline->mode, pipeline->partitions, pipeline->graph.workers);
 
-		for (j = 0; j < stage->elements; j++) {
-			element = &stage->element[j];
+	for (i = 0; i < pipeline->partitions; i++)
+		log_info("  partition(%u): stages %u-%u\n", i, pipeline->partition[i].stage,
+			 pipeline->partition[i].stage + pipeline->partition[i].stages - 1);
 
-			audio_element_dump(element);
-		}
-	}
+	for (i = 0; i < pipeline->elements; i++)
+		audio_element_dump(&pipeline->element[i]);
 }
 
 void audio_pipeline_stats(struct audio_pipeline *pipeline)
 {
-	struct audio_pipeline_stage *stage;
-	struct audio_element *element;
-	int i, j;
-
-	for (i = 0; i < pipeline->stages; i++) {
-		stage = &pipeline->stage[i];
-
-		for (j = 0; j < stage->elements; j++) {
-			element = &stage->element[j];
+	int i;
 
-			audio_element_stats(element);
-		}
-	}
+	for (i = 0; i < pipeline->elements; i++)
+		audio_element_stats(&pipeline->element[i]);
 }
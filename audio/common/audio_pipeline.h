@@ -9,11 +9,26 @@
 
 #include "audio_element.h"
 #include "audio_buffer.h"
+#include "audio_graph.h"
 
 #define AUDIO_PIPELINE_MAX_STAGES	4
 #define AUDIO_PIPELINE_MAX_ELEMENTS	16
 #define AUDIO_PIPELINE_MAX_BUFFERS	256
 
+#if (AUDIO_PIPELINE_MAX_STAGES * AUDIO_PIPELINE_MAX_ELEMENTS) > AUDIO_GRAPH_MAX_NODES
+#error "too many pipeline elements for graph execution"
+#endif
+
+/* Number of periods used to measure elements execution time, before scheduling them on workers */
+#define AUDIO_PIPELINE_CALIBRATION_PERIODS	1024
+
+/* Execution modes */
+enum {
+	AUDIO_PIPELINE_RUN_SERIAL = 0,
+	AUDIO_PIPELINE_RUN_PARTITIONS,	/* stage partitions in parallel, with latency */
+	AUDIO_PIPELINE_RUN_GRAPH,	/* independent elements in parallel */
+};
+
 /* Configuration */
 struct audio_pipeline_stage_config {
 	unsigned int elements;
@@ -55,6 +70,15 @@ struct audio_pipeline_config {
  * buffer[1]
  * ...
  * buffer[k]
+ * graph_node[0]
+ * ...
+ * graph_node[m + ... + l]
+ * plan[0]
+ * ...
+ * plan[m + ... + l]
+ * buffer_info[0]
+ * ...
+ * buffer_info[k]
  * buffer storage
  */
 struct audio_pipeline_stage {
@@ -62,17 +86,82 @@ struct audio_pipeline_stage {
 	struct audio_element *element;
 };
 
+/*
+ * Execution plan, flat list of all the elements run functions in execution
+ * order (stage order), built once all elements are initialized.
+ * With AUDIO_ELEMENT_PROFILE, all entries run the profiling wrapper instead.
+ */
+struct audio_pipeline_plan_entry {
+	int (*run)(struct audio_element *element);
+	struct audio_element *element;
+};
+
+#define AUDIO_PIPELINE_NO_STAGE	0xff
+
+/* Stages accessing a buffer */
+struct audio_pipeline_buffer_info {
+	uint8_t producer;	/* stage writing the buffer */
+	uint8_t consumer_first;	/* first stage reading the buffer */
+	uint8_t consumer_last;	/* last stage reading the buffer */
+	bool shared;		/* buffer storage shared with other buffers */
+	bool period;		/* writer and readers access exactly one period per run */
+};
+
+/*
+ * Parallel execution
+ *
+ * Pipeline stages are split in partitions (groups of contiguous stages).
+ * The first partition is run by the data task, the others by audio workers,
+ * all in parallel, once per period. Partition n processes the data produced
+ * by partition n - 1 in the previous period, so each partition boundary adds
+ * a period of latency to the buffers crossing it.
+ */
+struct audio_pipeline_partition {
+	struct audio_pipeline *pipeline;
+	unsigned int stage;	/* first stage */
+	unsigned int stages;
+	unsigned int entry;	/* first plan entry */
+	unsigned int entries;
+};
+
 struct audio_pipeline {
+	unsigned int id;	/* pipeline table index, used by control commands */
+
 	unsigned int stages;
 
 	struct audio_pipeline_stage *stage;
 
+	unsigned int elements;	/* all stages elements */
+
+	struct audio_element *element;
+
+	struct audio_pipeline_plan_entry *plan;
+
+	unsigned int buffers;
+
 	struct audio_buffer *buffer;
+
+	struct audio_pipeline_buffer_info *buffer_info;
+
+	unsigned int period;
+
+	unsigned int mode;
+
+	unsigned int partitions;	/* 1 for serial execution */
+	unsigned int cut;		/* partition boundaries, bit n set if stage n + 1 starts a partition */
+	struct audio_pipeline_partition partition[AUDIO_PIPELINE_MAX_STAGES];
+
+	struct audio_graph graph;	/* elements dependencies, and execution time */
+
+	unsigned int calibration;	/* remaining periods of elements execution time measurement */
+	uint64_t stage_cost[AUDIO_PIPELINE_MAX_STAGES];
 };
 
 int audio_pipeline_ctrl(struct hrpn_cmd_audio_pipeline *cmd, unsigned int len, struct mailbox *m);
+int audio_pipeline_config_load(struct audio_pipeline_config *config, void *data, unsigned int size);
 struct audio_pipeline *audio_pipeline_init(struct audio_pipeline_config *config);
 int audio_pipeline_run(struct audio_pipeline *pipeline);
+void audio_pipeline_pump(struct audio_pipeline *pipeline);
 void audio_pipeline_exit(struct audio_pipeline *pipeline);
 void audio_pipeline_reset(struct audio_pipeline *pipeline);
 void audio_pipeline_dump(struct audio_pipeline *pipeline);
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/string.h"
+
+#include "audio_pipeline.h"
+#include "hrpn_ctrl.h"
+#include "hlog.h"
+
+/* Binary configuration parser (see hrpn_ctrl_audio_pipeline.h for the format) */
+struct audio_pipeline_load {
+	uint8_t *p;
+	unsigned int left;	/* in bytes */
+};
+
+static void *audio_pipeline_load_get(struct audio_pipeline_load *load, unsigned int size)
+{
+	void *p = load->p;
+
+	if ((size > load->left) || (size & 3))
+		return NULL;
+
+	load->p += size;
+	load->left -= size;
+
+	return p;
+}
+
+static int audio_pipeline_load_u32(struct audio_pipeline_load *load, unsigned int *val)
+{
+	uint32_t *p = audio_pipeline_load_get(load, sizeof(uint32_t));
+
+	if (!p)
+		return -1;
+
+	*val = *p;
+
+	return 0;
+}
+
+static int audio_pipeline_load_element(struct audio_pipeline_load *load, struct audio_element_config *config)
+{
+	struct hrpn_audio_pipeline_config_element *element;
+	void *params;
+	int i;
+
+	element = audio_pipeline_load_get(load, sizeof(*element));
+	if (!element)
+		goto err;
+
+	if ((element->inputs > AUDIO_ELEMENT_MAX_INPUTS) || (element->outputs > AUDIO_ELEMENT_MAX_OUTPUTS)) {
+		log_err("element: too many inputs/outputs %u/%u\n", element->inputs, element->outputs);
+		goto err;
+	}
+
+	config->type = element->type;
+	config->period = element->period;
+	config->sample_rate = element->sample_rate;
+	config->inputs = element->inputs;
+	config->outputs = element->outputs;
+
+	for (i = 0; i < config->inputs; i++)
+		if (audio_pipeline_load_u32(load, &config->input[i]) < 0)
+			goto err;
+
+	for (i = 0; i < config->outputs; i++)
+		if (audio_pipeline_load_u32(load, &config->output[i]) < 0)
+			goto err;
+
+	params = audio_pipeline_load_get(load, element->params_size);
+	if (!params)
+		goto err;
+
+	if (audio_element_config_load(config, params, element->params_size) < 0) {
+		log_err("element: invalid type %u parameters\n", config->type);
+		goto err;
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+/*
+ * Fills a pipeline configuration from a binary description. Element
+ * parameters may be referenced in place, so the binary data must outlive
+ * the pipeline configuration. The configuration itself is validated by
+ * audio_pipeline_init().
+ */
+int audio_pipeline_config_load(struct audio_pipeline_config *config, void *data, unsigned int size)
+{
+	struct hrpn_audio_pipeline_config_header *header = data;
+	struct audio_pipeline_load load;
+	struct audio_pipeline_stage_config *stage_config;
+	uint32_t checksum = 0;
+	uint32_t *p;
+	int i, j;
+
+	if ((size < sizeof(*header)) || (size & 3)) {
+		log_err("pipeline: invalid configuration size %u\n", size);
+		goto err;
+	}
+
+	if (header->magic != HRPN_AUDIO_PIPELINE_CONFIG_MAGIC) {
+		log_err("pipeline: invalid configuration magic 0x%x\n", header->magic);
+		goto err;
+	}
+
+	if (header->version != HRPN_AUDIO_PIPELINE_CONFIG_VERSION) {
+		log_err("pipeline: unsupported configuration version %u\n", header->version);
+		goto err;
+	}
+
+	if (header->size != size) {
+		log_err("pipeline: configuration size mismatch %u/%u\n", header->size, size);
+		goto err;
+	}
+
+	for (p = (uint32_t *)(header + 1); p < (uint32_t *)((uint8_t *)data + size); p++)
+		checksum += *p;
+
+	if (checksum != header->checksum) {
+		log_err("pipeline: invalid configuration checksum 0x%x/0x%x\n", checksum, header->checksum);
+		goto err;
+	}
+
+	if (!memchr(header->name, '\0', sizeof(header->name))) {
+		log_err("pipeline: invalid configuration name\n");
+		goto err;
+	}
+
+	if ((header->stages > AUDIO_PIPELINE_MAX_STAGES) ||
+	    (header->buffers > AUDIO_PIPELINE_MAX_BUFFERS) ||
+	    (header->buffer_storage > AUDIO_PIPELINE_MAX_BUFFERS)) {
+		log_err("pipeline: too many stages/buffers/storage %u/%u/%u\n",
+			header->stages, header->buffers, header->buffer_storage);
+		goto err;
+	}
+
+	memset(config, 0, sizeof(*config));
+
+	config->name = header->name;
+	config->stages = header->stages;
+	config->buffers = header->buffers;
+	config->buffer_storage = header->buffer_storage;
+
+	load.p = (uint8_t *)(header + 1);
+	load.left = size - sizeof(*header);
+
+	for (i = 0; i < config->stages; i++) {
+		stage_config = &config->stage[i];
+
+		if (audio_pipeline_load_u32(&load, &stage_config->elements) < 0)
+			goto err_truncated;
+
+		if (stage_config->elements > AUDIO_PIPELINE_MAX_ELEMENTS) {
+			log_err("stage(%u): too many elements %u\n", i, stage_config->elements);
+			goto err;
+		}
+
+		for (j = 0; j < stage_config->elements; j++) {
+			if (audio_pipeline_load_element(&load, &stage_config->element[j]) < 0) {
+				log_err("stage(%u), element(%u): invalid configuration\n", i, j);
+				goto err;
+			}
+		}
+	}
+
+	for (i = 0; i < config->buffers; i++)
+		if (audio_pipeline_load_u32(&load, &config->buffer[i].storage) < 0)
+			goto err_truncated;
+
+	for (i = 0; i < config->buffer_storage; i++)
+		if (audio_pipeline_load_u32(&load, &config->storage[i].periods) < 0)
+			goto err_truncated;
+
+	if (load.left) {
+		log_err("pipeline: %u trailing configuration bytes\n", load.left);
+		goto err;
+	}
+
+	log_info("pipeline: loaded configuration %s\n", config->name);
+
+	return 0;
+
+err_truncated:
+	log_err("pipeline: truncated configuration\n");
+err:
+	return -1;
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/math.h"
+#include "os/string.h"
+
+#include "audio_src.h"
+#include "audio_format.h"
+#include "hlog.h"
+
+#define AUDIO_SRC_CUTOFF	0.9	/* fraction of the lowest Nyquist frequency */
+#define AUDIO_SRC_KAISER_BETA	8.0
+#define AUDIO_SRC_FIFO_PERIODS	4	/* fifo size, in input periods (plus the filter length) */
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+typedef int64_t src_acc_t;	/* Q62 */
+#else
+typedef audio_sample_t src_acc_t;
+#endif
+
+#if defined(__GNUC__) && !defined(AUDIO_FORMAT_NO_VECTOR)
+/* Vectorized dot products, taps is a multiple of AUDIO_FORMAT_VECTOR */
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+typedef int64_t src_v4di_t __attribute__((vector_size(32)));
+
+static inline src_acc_t src_dot(audio_sample_t *x, audio_sample_t *c, unsigned int taps)
+{
+	src_v4di_t acc = {0, 0, 0, 0};
+	unsigned int i;
+
+	for (i = 0; i < taps; i += AUDIO_FORMAT_VECTOR)
+		acc += __builtin_convertvector(*(audio_v4si_t *)&x[i], src_v4di_t) *
+		       __builtin_convertvector(*(audio_v4si_t *)&c[i], src_v4di_t);
+
+	return acc[0] + acc[1] + acc[2] + acc[3];
+}
+#else
+static inline src_acc_t src_dot(audio_sample_t *x, audio_sample_t *c, unsigned int taps)
+{
+	audio_v4s_t acc = {0, 0, 0, 0};
+	unsigned int i;
+
+	for (i = 0; i < taps; i += AUDIO_FORMAT_VECTOR)
+		acc += *(audio_v4s_t *)&x[i] * *(audio_v4s_t *)&c[i];
+
+	return acc[0] + acc[1] + acc[2] + acc[3];
+}
+#endif
+#else
+static inline src_acc_t src_dot(audio_sample_t *x, audio_sample_t *c, unsigned int taps)
+{
+	src_acc_t acc = 0;
+	unsigned int i;
+
+	for (i = 0; i < taps; i++)
+		acc += (src_acc_t)x[i] * c[i];
+
+	return acc;
+}
+#endif /* __GNUC__ && !AUDIO_FORMAT_NO_VECTOR */
+
+/* a0 + (a1 - a0) * frac, with frac a Q32 fraction */
+static inline src_acc_t src_lerp(src_acc_t a0, src_acc_t a1, uint32_t frac)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	return a0 + ((a1 - a0) >> 16) * (int64_t)(frac >> 16);
+#else
+	return a0 + (a1 - a0) * (audio_sample_t)(frac * (1.0 / 4294967296.0));
+#endif
+}
+
+static inline audio_sample_t src_acc_to_sample(src_acc_t acc)
+{
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	acc >>= 31;
+
+	if (acc > INT32_MAX)
+		return INT32_MAX;
+	else if (acc < -INT32_MAX)
+		return -INT32_MAX;
+
+	return acc;
+#else
+	return acc;
+#endif
+}
+
+static unsigned int src_gcd(unsigned int a, unsigned int b)
+{
+	unsigned int t;
+
+	while (b) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* Filter geometry, only depends on the configuration */
+static void src_geometry(struct audio_src *src, struct audio_src_config *config)
+{
+	unsigned int gcd = src_gcd(config->input_rate, config->output_rate);
+
+	src->channels = config->channels;
+	src->taps = config->taps ? config->taps : AUDIO_SRC_DEFAULT_TAPS;
+
+	if (!config->interpolated && (config->output_rate / gcd <= AUDIO_SRC_MAX_PHASES)) {
+		src->fixed = true;
+		src->phases = config->output_rate / gcd;
+		src->step = config->input_rate / gcd;
+	} else {
+		src->fixed = false;
+		src->phases = AUDIO_SRC_ARBITRARY_PHASES;
+		src->step = 0;
+	}
+
+	src->step_q32 = ((uint64_t)config->input_rate << 32) / config->output_rate;
+
+	src->prefill = src->taps + config->in_period;
+	src->fifo_size = src->taps + AUDIO_SRC_FIFO_PERIODS * config->in_period;
+}
+
+static double src_bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for (k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+/* Filter coefficient for the input sample at distance x (in input samples) of the output */
+static double src_filter(double x, double cutoff, unsigned int taps)
+{
+	double r = x / (taps / 2);
+	double h, w;
+
+	if (fabs(r) >= 1.0)
+		return 0.0;
+
+	w = src_bessel_i0(AUDIO_SRC_KAISER_BETA * sqrt(1.0 - r * r)) / src_bessel_i0(AUDIO_SRC_KAISER_BETA);
+
+	if (x == 0.0)
+		h = 2.0 * cutoff;
+	else
+		h = sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+
+	return h * w;
+}
+
+/*
+ * Phase p (0 to phases, included) coefficient j applies to fifo sample pos + j,
+ * for an output at pos + taps / 2 - 1 + p / phases. Each phase is normalized
+ * to unity DC gain.
+ */
+static void src_filter_init(struct audio_src *src, double cutoff)
+{
+	unsigned int taps = src->taps;
+	unsigned int phases = src->phases;
+	audio_sample_t *c;
+	double x, sum;
+	int p, j;
+
+	for (p = 0; p <= phases; p++) {
+		c = &src->coef[p * taps];
+
+		sum = 0.0;
+		for (j = 0; j < taps; j++) {
+			x = taps / 2 - 1 + (double)p / phases - j;
+			sum += src_filter(x, cutoff, taps);
+		}
+
+		for (j = 0; j < taps; j++) {
+			x = taps / 2 - 1 + (double)p / phases - j;
+			c[j] = audio_double_to_sample(src_filter(x, cutoff, taps) / sum);
+		}
+	}
+}
+
+static inline audio_sample_t src_output(struct audio_src *src, unsigned int channel)
+{
+	audio_sample_t *x = &src->fifo[channel][src->pos];
+	src_acc_t acc0, acc1;
+	uint64_t phase;
+
+	if (src->fixed)
+		return src_acc_to_sample(src_dot(x, &src->coef[src->frac * src->taps], src->taps));
+
+	/* phase index and interpolation factor, from the fractional position */
+	phase = (uint64_t)src->frac * src->phases;
+
+	acc0 = src_dot(x, &src->coef[(phase >> 32) * src->taps], src->taps);
+	acc1 = src_dot(x, &src->coef[((phase >> 32) + 1) * src->taps], src->taps);
+
+	return src_acc_to_sample(src_lerp(acc0, acc1, (uint32_t)phase));
+}
+
+static inline void src_advance(struct audio_src *src)
+{
+	uint64_t t;
+
+	if (src->fixed) {
+		src->frac += src->step;
+		src->pos += src->frac / src->phases;
+		src->frac %= src->phases;
+	} else {
+		t = src->frac + src->step_q32;
+		src->pos += t >> 32;
+		src->frac = (uint32_t)t;
+	}
+}
+
+/* Appends all the available input samples to the fifo */
+void audio_src_write(struct audio_src *src, struct audio_buffer **in)
+{
+	unsigned int avail, n, c;
+
+	avail = audio_buf_avail(in[0]);
+	n = avail;
+
+	if (n > src->fifo_size - src->fifo_len) {
+		n = src->fifo_size - src->fifo_len;
+		src->stats.overrun++;
+	}
+
+	for (c = 0; c < src->channels; c++) {
+		audio_buf_read(in[c], &src->fifo[c][src->fifo_len], n);
+
+		/* drop the samples not fitting in the fifo */
+		audio_buf_read_update(in[c], avail - n);
+	}
+
+	src->fifo_len += n;
+}
+
+/* Produces up to len output samples, returns the number of samples produced */
+unsigned int audio_src_read(struct audio_src *src, struct audio_buffer **out, unsigned int len)
+{
+	struct audio_buffer *buf;
+	unsigned int i, c, n;
+
+	for (i = 0; i < len; i++) {
+		if (src->pos + src->taps > src->fifo_len) {
+			src->stats.underrun++;
+			break;
+		}
+
+		for (c = 0; c < src->channels; c++) {
+			buf = out[c];
+			buf->base[(buf->write + i) & buf->size_mask] = src_output(src, c);
+		}
+
+		src_advance(src);
+	}
+
+	for (c = 0; c < src->channels; c++)
+		audio_buf_write_update(out[c], i);
+
+	/* discard the consumed input samples, keep the filter history */
+	n = src->pos;
+	if (n > src->fifo_len)
+		n = src->fifo_len;
+
+	if (n) {
+		for (c = 0; c < src->channels; c++)
+			memmove(src->fifo[c], &src->fifo[c][n], (src->fifo_len - n) * sizeof(audio_sample_t));
+
+		src->fifo_len -= n;
+		src->pos -= n;
+	}
+
+	return i;
+}
+
+void audio_src_reset(struct audio_src *src)
+{
+	unsigned int c;
+
+	for (c = 0; c < src->channels; c++)
+		memset(src->fifo[c], 0, src->prefill * sizeof(audio_sample_t));
+
+	src->fifo_len = src->prefill;
+	src->pos = 0;
+	src->frac = 0;
+}
+
+void audio_src_dump(struct audio_src *src)
+{
+	log_info("  channels: %u, taps: %u, phases: %u (%s)\n",
+		 src->channels, src->taps, src->phases, src->fixed ? "fixed" : "interpolated");
+	log_info("  fifo: %u/%u, pos: %u, underrun: %llu, overrun: %llu\n",
+		 src->fifo_len, src->fifo_size, src->pos, src->stats.underrun, src->stats.overrun);
+}
+
+int audio_src_check_config(struct audio_src_config *config)
+{
+	unsigned int taps = config->taps;
+
+	if (!config->channels || (config->channels > AUDIO_SRC_MAX_CHANNELS)) {
+		log_err("src: invalid channels: %u\n", config->channels);
+		goto err;
+	}
+
+	if (!config->input_rate || !config->output_rate ||
+	    (config->input_rate > AUDIO_SRC_MAX_RATIO * config->output_rate) ||
+	    (config->output_rate > AUDIO_SRC_MAX_RATIO * config->input_rate)) {
+		log_err("src: invalid rates: %u -> %u (Hz)\n", config->input_rate, config->output_rate);
+		goto err;
+	}
+
+	if (taps && ((taps < AUDIO_SRC_MIN_TAPS) || (taps > AUDIO_SRC_MAX_TAPS) || (taps % 4))) {
+		log_err("src: invalid taps: %u\n", taps);
+		goto err;
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+/* Size of the coefficients and fifo storage */
+unsigned int audio_src_size(struct audio_src_config *config)
+{
+	struct audio_src src;
+
+	src_geometry(&src, config);
+
+	return ((src.phases + 1) * src.taps + src.channels * src.fifo_size) * sizeof(audio_sample_t);
+}
+
+void audio_src_init(struct audio_src *src, struct audio_src_config *config, void *storage)
+{
+	double cutoff;
+	int c;
+
+	memset(src, 0, sizeof(*src));
+
+	src_geometry(src, config);
+
+	src->coef = storage;
+
+	for (c = 0; c < src->channels; c++)
+		src->fifo[c] = src->coef + (src->phases + 1) * src->taps + c * src->fifo_size;
+
+	/* cutoff relative to the input sample rate */
+	cutoff = 0.5 * AUDIO_SRC_CUTOFF;
+	if (config->output_rate < config->input_rate)
+		cutoff = cutoff * config->output_rate / config->input_rate;
+
+	src_filter_init(src, cutoff);
+
+	audio_src_reset(src);
+}
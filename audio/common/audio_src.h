@@ -0,0 +1,88 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_SRC_H_
+#define _AUDIO_SRC_H_
+
+#include "os/stdint.h"
+#include "os/stdbool.h"
+
+#include "audio_buffer.h"
+
+/*
+ * Polyphase sample rate converter, used by the src and asrc elements
+ *
+ * The input samples are resampled with a windowed sinc (Kaiser) low pass
+ * filter, split in phases of "taps" coefficients each. Each output sample
+ * is the dot product of the last "taps" input samples with the filter phase
+ * matching the output fractional position:
+ * - fixed ratios (output_rate / gcd <= AUDIO_SRC_MAX_PHASES): one phase per
+ *   output position, exact stepping through the phases,
+ * - other ratios, or if the ratio can be adjusted at run time:
+ *   AUDIO_SRC_ARBITRARY_PHASES phases, with linear interpolation between
+ *   the two phases around the output position.
+ *
+ * Input samples are appended to an internal fifo (one per channel), output
+ * samples are produced as long as the fifo holds enough input. The fifo
+ * absorbs the variations of the number of input samples per period, its
+ * fill level starts at one input period plus the filter length.
+ */
+#define AUDIO_SRC_MAX_CHANNELS		8
+#define AUDIO_SRC_MAX_PHASES		160	/* fixed ratio filter phases, e.g 160 for 44.1 kHz -> 48 kHz */
+#define AUDIO_SRC_ARBITRARY_PHASES	128	/* filter phases for other ratios, interpolated */
+#define AUDIO_SRC_MIN_TAPS		8
+#define AUDIO_SRC_MAX_TAPS		64
+#define AUDIO_SRC_DEFAULT_TAPS		32
+#define AUDIO_SRC_MAX_RATIO		8	/* between input and output sample rates */
+
+struct audio_src_config {
+	unsigned int channels;
+	unsigned int input_rate;
+	unsigned int output_rate;
+	unsigned int taps;		/* filter taps per phase, multiple of 4 (0 for default) */
+	unsigned int in_period;		/* maximum input samples per period */
+	bool interpolated;		/* ratio adjustable at run time */
+};
+
+struct audio_src {
+	unsigned int channels;
+	unsigned int taps;
+	unsigned int phases;
+	bool fixed;
+	unsigned int step;	/* fixed ratio, phases per output sample */
+	uint64_t step_q32;	/* input samples per output sample, Q32 */
+
+	/* position of the next output sample, relative to the fifo start */
+	unsigned int pos;	/* in input samples */
+	uint32_t frac;		/* fixed ratio: phase, otherwise Q32 fraction of input sample */
+
+	audio_sample_t *coef;	/* (phases + 1) * taps */
+	audio_sample_t *fifo[AUDIO_SRC_MAX_CHANNELS];
+	unsigned int fifo_len;	/* in samples, same for all channels */
+	unsigned int fifo_size;
+	unsigned int prefill;
+
+	struct {
+		uint64_t underrun;
+		uint64_t overrun;
+	} stats;
+};
+
+int audio_src_check_config(struct audio_src_config *config);
+unsigned int audio_src_size(struct audio_src_config *config);
+void audio_src_init(struct audio_src *src, struct audio_src_config *config, void *storage);
+void audio_src_reset(struct audio_src *src);
+void audio_src_write(struct audio_src *src, struct audio_buffer **in);
+unsigned int audio_src_read(struct audio_src *src, struct audio_buffer **out, unsigned int len);
+void audio_src_dump(struct audio_src *src);
+
+/* Interpolated converter only, ratio in input samples per output sample (Q32) */
+static inline void audio_src_set_step(struct audio_src *src, uint64_t step_q32)
+{
+	src->step_q32 = step_q32;
+}
+
+#endif /* _AUDIO_SRC_H_ */
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/semaphore.h"
+
+#include "audio_worker.h"
+#include "hlog.h"
+
+/* Workers run in parallel with the data task, each one needs its own cpu core */
+#if (AUDIO_WORKERS > 0) && defined(FSL_RTOS_FREE_RTOS)
+#error "audio workers not supported with FreeRTOS (single core)"
+#endif
+
+/*
+ * Audio workers
+ *
+ * Each worker is an OS task (created by the application main) which waits
+ * for a job from the data task, runs it and signals its completion.
+ * The data task starts jobs on some workers, runs its own job and then waits
+ * for all started jobs to complete (fork/join, once per period).
+ */
+struct audio_worker {
+	unsigned int id;
+	os_sem_t start;
+	os_sem_t done;
+	int (*func)(void *data);
+	void *data;
+	int rc;
+};
+
+#if AUDIO_WORKERS > 0
+static struct audio_worker worker_table[AUDIO_WORKERS];
+#else
+static struct audio_worker worker_table[1];
+#endif
+
+static unsigned int worker_n;
+
+void *audio_worker_init(unsigned int id)
+{
+#if AUDIO_WORKERS > 0
+	struct audio_worker *worker;
+
+	if (id >= AUDIO_WORKERS || id != worker_n) {
+		log_err("worker(%u): invalid id\n", id);
+		goto err;
+	}
+
+	worker = &worker_table[id];
+
+	worker->id = id;
+
+	if (os_sem_init(&worker->start, 0))
+		goto err;
+
+	if (os_sem_init(&worker->done, 0))
+		goto err_done;
+
+	worker_n++;
+
+	log_info("worker(%u): initialized\n", id);
+
+	return worker;
+
+err_done:
+	os_sem_destroy(&worker->start);
+
+err:
+	return NULL;
+#else
+	log_err("worker(%u): audio workers disabled\n", id);
+
+	return NULL;
+#endif
+}
+
+void audio_worker_loop(void *context)
+{
+	struct audio_worker *worker = context;
+
+	do {
+		os_sem_take(&worker->start, 0, OS_SEM_TIMEOUT_MAX);
+
+		worker->rc = worker->func(worker->data);
+
+		os_sem_give(&worker->done, 0);
+	} while (1);
+}
+
+unsigned int audio_worker_count(void)
+{
+	return worker_n;
+}
+
+int audio_worker_start(unsigned int id, int (*func)(void *data), void *data)
+{
+	struct audio_worker *worker;
+
+	if (id >= worker_n)
+		return -1;
+
+	worker = &worker_table[id];
+
+	worker->func = func;
+	worker->data = data;
+
+	return os_sem_give(&worker->start, 0);
+}
+
+int audio_worker_wait(unsigned int id)
+{
+	struct audio_worker *worker;
+
+	if (id >= worker_n)
+		return -1;
+
+	worker = &worker_table[id];
+
+	os_sem_take(&worker->done, 0, OS_SEM_TIMEOUT_MAX);
+
+	return worker->rc;
+}
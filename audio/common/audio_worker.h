@@ -0,0 +1,25 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _AUDIO_WORKER_H_
+#define _AUDIO_WORKER_H_
+
+/*
+ * Number of audio worker tasks, in addition to the data task, used to
+ * run pipelines in parallel (0, the default, disables parallel execution).
+ * Each worker task is ideally running on a different cpu core.
+ */
+#ifndef AUDIO_WORKERS
+#define AUDIO_WORKERS	0
+#endif
+
+void *audio_worker_init(unsigned int id);
+void audio_worker_loop(void *context);
+unsigned int audio_worker_count(void);
+int audio_worker_start(unsigned int id, int (*func)(void *data), void *data);
+int audio_worker_wait(unsigned int id);
+
+#endif /* _AUDIO_WORKER_H_ */
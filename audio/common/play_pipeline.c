@@ -8,6 +8,7 @@
 #include "os/stdlib.h"
 
 #include "app_board.h"
+#include "cpu.h"
 
 #include "audio_pipeline.h"
 #include "audio.h"
@@ -22,34 +23,65 @@
 #define DEFAULT_SAMPLE_RATE	48000
 #define USE_TX_IRQ		1
 
-static const int supported_period[] = {2, 4, 8, 16, 32};
+static const int supported_period[] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024};
 static const uint32_t supported_rate[] = {44100, 48000, 88200, 96000, 176400, 192000};
 
+/* SAI interfaces used by all running pipelines, bit n set for SAIn */
+static uint32_t sai_used_mask;
+
 struct pipeline_ctx {
 	void (*event_send)(void *, uint8_t);
 	void *event_data;
 
 	struct sai_device dev[SAI_TX_MAX_INSTANCE];
+	unsigned int irq_dev;		/* first SAI used, IRQ source */
+	uint32_t sai_mask;		/* SAI interfaces used, bit n set for SAIn */
 	struct audio_pipeline *pipeline;
 	sai_word_width_t bit_width;
 	sai_sample_rate_t sample_rate;
-	uint32_t chan_numbers;
-	uint8_t period;
+	unsigned int period;
+
+	/*
+	 * Frames transferred per SAI interrupt. Periods too large for the SAI
+	 * fifos are split in fifo periods, pumped from the interrupt, and the
+	 * pipeline runs every period / fifo_period interrupts.
+	 */
+	unsigned int fifo_period;
+	unsigned int fifo_ticks;	/* interrupts in the current period */
+	bool pumping;			/* pipeline started, fifo pump enabled */
+
+	/* per active SAI, same index as dev[] */
+	struct {
+		uint32_t chan_numbers;	/* per frame, TDM mode above 2 */
+		uint32_t tx_line_mask;	/* data lines used, bit n set for line n */
+		uint32_t rx_line_mask;
+	} sai[SAI_TX_MAX_INSTANCE];
 
 	struct {
 		uint64_t callback;
 		uint64_t run;
 		uint64_t err;
+		uint64_t run_ticks;	/* pipeline run time, in cpu counter ticks */
+		uint64_t run_max;
 	} stats;
 };
 
 void play_pipeline_stats(void *handle)
 {
 	struct pipeline_ctx *ctx = handle;
+	uint64_t period_ticks;
 
 	log_info("callback: %llu, run: %llu, err: %llu\n", ctx->stats.callback, ctx->stats.run,
 		ctx->stats.err);
 
+	/* cpu load, in 1/1000 of the period */
+	period_ticks = ((uint64_t)ctx->period * os_cpu_counter_freq()) / ctx->sample_rate;
+	if (ctx->stats.run && period_ticks)
+		log_info("period: %u frames, fifo period: %u frames, cpu load (mean/max): %llu/%llu\n",
+			ctx->period, ctx->fifo_period,
+			(ctx->stats.run_ticks * 1000) / (ctx->stats.run * period_ticks),
+			(ctx->stats.run_max * 1000) / period_ticks);
+
 	audio_pipeline_stats(ctx->pipeline);
 }
 
@@ -57,10 +89,25 @@ static void rx_callback(uint8_t status, void *user_data)
 {
 	struct pipeline_ctx *ctx = (struct pipeline_ctx*)user_data;
 
+	/* Fifo period mode, the interrupt stays enabled while the pipeline runs */
+	if (ctx->pumping) {
+		audio_pipeline_pump(ctx->pipeline);
+
+		if (++ctx->fifo_ticks < ctx->period / ctx->fifo_period)
+			return;
+
+		ctx->fifo_ticks = 0;
+		ctx->stats.callback++;
+
+		ctx->event_send(ctx->event_data, status);
+
+		return;
+	}
+
 #if USE_TX_IRQ
-	sai_disable_irq(&ctx->dev[0], false, true);
+	sai_disable_irq(&ctx->dev[ctx->irq_dev], false, true);
 #else
-	sai_disable_irq(&ctx->dev[0], true, false);
+	sai_disable_irq(&ctx->dev[ctx->irq_dev], true, false);
 #endif
 
 	ctx->stats.callback++;
@@ -71,22 +118,49 @@ static void rx_callback(uint8_t status, void *user_data)
 int play_pipeline_run(void *handle, struct event *e)
 {
 	struct pipeline_ctx *ctx = handle;
+	uint64_t start, ticks;
 	int err;
 
 	ctx->stats.run++;
 
+	start = os_cpu_counter();
+
 	err = audio_pipeline_run(ctx->pipeline);
 	if (err) {
 		ctx->stats.err++;
+
+		/* Stop the fifo pump, restarted with the pipeline */
+		if (ctx->pumping) {
+#if USE_TX_IRQ
+			sai_disable_irq(&ctx->dev[ctx->irq_dev], false, true);
+#else
+			sai_disable_irq(&ctx->dev[ctx->irq_dev], true, false);
+#endif
+			ctx->pumping = false;
+		}
+
 		audio_pipeline_reset(ctx->pipeline);
 		err = audio_pipeline_run(ctx->pipeline);
 		os_assert(!err, "pipeline couldn't restart");
 	}
 
+	ticks = os_cpu_counter() - start;
+	ctx->stats.run_ticks += ticks;
+	if (ticks > ctx->stats.run_max)
+		ctx->stats.run_max = ticks;
+
+	if (ctx->fifo_period < ctx->period) {
+		if (ctx->pumping)
+			return err;
+
+		ctx->fifo_ticks = 0;
+		ctx->pumping = true;
+	}
+
 #if USE_TX_IRQ
-	sai_enable_irq(&ctx->dev[0], false, true);
+	sai_enable_irq(&ctx->dev[ctx->irq_dev], false, true);
 #else
-	sai_enable_irq(&ctx->dev[0], true, false);
+	sai_enable_irq(&ctx->dev[ctx->irq_dev], true, false);
 #endif
 
 	return err;
@@ -98,7 +172,7 @@ static void pll_adjust_disable(struct pipeline_ctx *ctx)
 
 	/* need to disable PLL audio element */
 	cmd.u.common.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_PLL_DISABLE;
-	cmd.u.common.pipeline.id = 0;
+	cmd.u.common.pipeline.id = ctx->pipeline->id;
 	cmd.u.common.element.type = AUDIO_ELEMENT_PLL;
 	cmd.u.common.element.id = 0;
 
@@ -111,7 +185,7 @@ static void pll_adjust_set_pll_id(struct pipeline_ctx *ctx, uint32_t pll_id)
 
 	/* PLL element needs to know the sampling rate to determine the input PLL */
 	cmd.u.common.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_PLL_ID;
-	cmd.u.common.pipeline.id = 0;
+	cmd.u.common.pipeline.id = ctx->pipeline->id;
 	cmd.u.common.element.type = AUDIO_ELEMENT_PLL;
 	cmd.u.common.element.id = 0;
 	cmd.pll_id = pll_id;
@@ -119,23 +193,179 @@ static void pll_adjust_set_pll_id(struct pipeline_ctx *ctx, uint32_t pll_id)
 	audio_pipeline_ctrl((struct hrpn_cmd_audio_pipeline *)&cmd, sizeof(cmd), NULL);
 }
 
+static bool sai_used(struct pipeline_ctx *ctx, int i)
+{
+	return ctx->sai_mask & (1 << get_sai_id(sai_active_list[i].sai_base));
+}
+
+static void sai_mask_set(uint32_t *mask, unsigned int sai_id)
+{
+	if (sai_id < 32)
+		*mask |= 1 << sai_id;
+}
+
+/* Returns the SAI interfaces used by the pipeline elements, bit n set for SAIn */
+static uint32_t sai_pipeline_mask(struct audio_pipeline_config *config)
+{
+	struct audio_element_config *element;
+	uint32_t mask = 0;
+	int i, j, k;
+
+	for (i = 0; i < config->stages; i++) {
+		for (j = 0; j < config->stage[i].elements; j++) {
+			element = &config->stage[i].element[j];
+
+			if (element->type == AUDIO_ELEMENT_SAI_SINK) {
+				for (k = 0; k < element->u.sai_sink.sai_n; k++)
+					sai_mask_set(&mask, element->u.sai_sink.sai[k].id);
+			} else if (element->type == AUDIO_ELEMENT_SAI_SOURCE) {
+				for (k = 0; k < element->u.sai_source.sai_n; k++)
+					sai_mask_set(&mask, element->u.sai_source.sai[k].id);
+			}
+		}
+	}
+
+	return mask;
+}
+
+/*
+ * Returns the frame format (channels) and the data lines used by the pipeline
+ * elements, for SAI sai_id. All the lines, transmit and receive, share the
+ * same frame format (I2S or TDM), so they must have the same channel count.
+ */
+static int sai_pipeline_lines(struct audio_pipeline_config *config, unsigned int sai_id,
+			      uint32_t *chan_numbers, uint32_t *tx_line_mask, uint32_t *rx_line_mask)
+{
+	struct audio_element_config *element;
+	struct sai_tx_config *tx;
+	struct sai_rx_config *rx;
+	unsigned int channels = 0;
+	int i, j, k, l;
+
+	*tx_line_mask = 0;
+	*rx_line_mask = 0;
+
+	for (i = 0; i < config->stages; i++) {
+		for (j = 0; j < config->stage[i].elements; j++) {
+			element = &config->stage[i].element[j];
+
+			if (element->type == AUDIO_ELEMENT_SAI_SINK) {
+				for (k = 0; k < element->u.sai_sink.sai_n; k++) {
+					tx = &element->u.sai_sink.sai[k];
+					if (tx->id != sai_id)
+						continue;
+
+					for (l = 0; l < tx->line_n; l++) {
+						if (channels && (tx->line[l].channel_n != channels))
+							goto err;
+
+						channels = tx->line[l].channel_n;
+						*tx_line_mask |= 1 << tx->line[l].id;
+					}
+				}
+			} else if (element->type == AUDIO_ELEMENT_SAI_SOURCE) {
+				for (k = 0; k < element->u.sai_source.sai_n; k++) {
+					rx = &element->u.sai_source.sai[k];
+					if (rx->id != sai_id)
+						continue;
+
+					for (l = 0; l < rx->line_n; l++) {
+						if (channels && (rx->line[l].channel_n != channels))
+							goto err;
+
+						channels = rx->line[l].channel_n;
+						*rx_line_mask |= 1 << rx->line[l].id;
+					}
+				}
+			}
+		}
+	}
+
+	/* Stereo I2S by default, lines not used by the pipeline keep the default data line */
+	if (channels < DEMO_AUDIO_DATA_CHANNEL)
+		channels = DEMO_AUDIO_DATA_CHANNEL;
+
+	if (!*tx_line_mask)
+		*tx_line_mask = 1U << DEMO_SAI_CHANNEL;
+
+	if (!*rx_line_mask)
+		*rx_line_mask = 1U << DEMO_SAI_CHANNEL;
+
+	*chan_numbers = channels;
+
+	return 0;
+
+err:
+	log_err("SAI%u: lines with different channel counts\n", sai_id);
+
+	return -1;
+}
+
+/*
+ * Selects the active SAI interfaces used by the pipeline. Concurrent pipelines
+ * run at independent periods and sample rates, so they can't share a SAI.
+ */
+static int sai_select(struct pipeline_ctx *ctx, struct audio_pipeline_config *config)
+{
+	uint32_t mask = sai_pipeline_mask(config);
+	int i;
+
+	ctx->sai_mask = 0;
+
+	for (i = 0; i < sai_active_list_nelems; i++) {
+		if (!(mask & (1 << get_sai_id(sai_active_list[i].sai_base))))
+			continue;
+
+		if (sai_pipeline_lines(config, get_sai_id(sai_active_list[i].sai_base), &ctx->sai[i].chan_numbers,
+				       &ctx->sai[i].tx_line_mask, &ctx->sai[i].rx_line_mask) < 0)
+			goto err;
+
+		if (!ctx->sai_mask)
+			ctx->irq_dev = i;
+
+		ctx->sai_mask |= 1 << get_sai_id(sai_active_list[i].sai_base);
+	}
+
+	if (!ctx->sai_mask) {
+		log_err("No active SAI used by the pipeline\n");
+		goto err;
+	}
+
+	if (ctx->sai_mask & sai_used_mask) {
+		log_err("SAI already used by a running pipeline (0x%x)\n", ctx->sai_mask & sai_used_mask);
+		goto err;
+	}
+
+	sai_used_mask |= ctx->sai_mask;
+
+	return 0;
+
+err:
+	return -1;
+}
+
 static void sai_setup(struct pipeline_ctx *ctx)
 {
 	struct sai_cfg sai_config;
 	bool pll_disable = true;
 	int i;
 
-	/* Configure each active SAI */
+	/* Configure each active SAI used by the pipeline */
 	for (i = 0; i < sai_active_list_nelems; i++) {
 		uint32_t sai_clock_root, pll_id;
 		int sai_id;
 		enum codec_id cid;
 		int32_t ret;
 
+		if (!sai_used(ctx, i))
+			continue;
+
 		sai_config.sai_base = sai_active_list[i].sai_base;
 		sai_config.bit_width = ctx->bit_width;
 		sai_config.sample_rate = ctx->sample_rate;
-		sai_config.chan_numbers = ctx->chan_numbers;
+		sai_config.chan_numbers = ctx->sai[i].chan_numbers;
+		sai_config.tx_line_mask = ctx->sai[i].tx_line_mask;
+		sai_config.rx_line_mask = ctx->sai[i].rx_line_mask;
 
 		sai_id = get_sai_id(sai_active_list[i].sai_base);
 		os_assert(sai_id, "SAI%d enabled but not supported in this platform!", i);
@@ -147,7 +377,7 @@ static void sai_setup(struct pipeline_ctx *ctx)
 		sai_config.rx_sync_mode = sai_active_list[i].rx_sync_mode;
 		sai_config.msel = sai_active_list[i].msel;
 
-		if (i == 0) {
+		if (i == ctx->irq_dev) {
 			/* First SAI instance used as IRQ source */
 			sai_config.rx_callback = rx_callback;
 			sai_config.rx_user_data = ctx;
@@ -162,7 +392,7 @@ static void sai_setup(struct pipeline_ctx *ctx)
 		cid = sai_active_list[i].cid;
 		ret = codec_setup(cid);
 		if (ret != kStatus_Success) {
-			if ((i == 0) && (sai_active_list[i].masterSlave == kSAI_Slave)) {
+			if ((i == ctx->irq_dev) && (sai_active_list[i].masterSlave == kSAI_Slave)) {
 				/* First SAI in the list manages interrupts: it cannot be
 				 * slave if no codec is connected
 				 */
@@ -179,11 +409,11 @@ static void sai_setup(struct pipeline_ctx *ctx)
 		if (sai_config.masterSlave == kSAI_Slave)
 			pll_disable = false;
 
-		/* Set FIFO water mark to be period size of all channels*/
+		/* Set FIFO water mark to be fifo period size of all channels*/
 #if USE_TX_IRQ
-		sai_config.fifo_water_mark = ctx->period * ctx->chan_numbers - 1;
+		sai_config.fifo_water_mark = ctx->fifo_period * ctx->sai[i].chan_numbers - 1;
 #else
-		sai_config.fifo_water_mark = ctx->period * ctx->chan_numbers;
+		sai_config.fifo_water_mark = ctx->fifo_period * ctx->sai[i].chan_numbers;
 #endif
 
 		sai_drv_setup(&ctx->dev[i], &sai_config);
@@ -196,14 +426,60 @@ static void sai_setup(struct pipeline_ctx *ctx)
 		pll_adjust_disable(ctx);
 }
 
+/*
+ * Selects the fifo period, the largest one (up to the period) with two fifo
+ * periods of all the channels fitting in the SAI line fifos. The sai sink and
+ * source elements transfer the larger periods through a ring, a fifo period
+ * at a time, from the SAI interrupt.
+ */
+static void fifo_period_select(struct pipeline_ctx *ctx)
+{
+	uint32_t channels = 0;
+	int i;
+
+	for (i = 0; i < sai_active_list_nelems; i++)
+		if (sai_used(ctx, i) && (ctx->sai[i].chan_numbers > channels))
+			channels = ctx->sai[i].chan_numbers;
+
+	ctx->fifo_period = ctx->period;
+
+	while ((ctx->fifo_period > 1) && (2 * ctx->fifo_period * channels > SAI_TX_MAX_FIFO_SIZE))
+		ctx->fifo_period /= 2;
+}
+
+/*
+ * Sets the fifo period of the sai sink and source elements. config must be
+ * the pipeline private copy, with its own element configurations: the
+ * configurations shared between instances are never written.
+ */
+static void fifo_period_set(struct pipeline_ctx *ctx, struct audio_pipeline_config *config)
+{
+	struct audio_element_config *element;
+	int i, j;
+
+	for (i = 0; i < config->stages; i++) {
+		for (j = 0; j < config->stage[i].elements; j++) {
+			element = &config->stage[i].element[j];
+
+			if (element->type == AUDIO_ELEMENT_SAI_SINK)
+				element->u.sai_sink.fifo_period = ctx->fifo_period;
+			else if (element->type == AUDIO_ELEMENT_SAI_SOURCE)
+				element->u.sai_source.fifo_period = ctx->fifo_period;
+		}
+	}
+}
+
 static void sai_close(struct pipeline_ctx *ctx)
 {
 	int i;
 
-	/* Close each active SAI */
+	/* Close each active SAI used by the pipeline */
 	for (i = 0; i < sai_active_list_nelems; i++) {
-		sai_drv_exit(&ctx->dev[i]);
+		if (sai_used(ctx, i))
+			sai_drv_exit(&ctx->dev[i]);
 	}
+
+	sai_used_mask &= ~ctx->sai_mask;
 }
 
 void *play_pipeline_init(void *parameters)
@@ -215,6 +491,11 @@ void *play_pipeline_init(void *parameters)
 	size_t period = DEFAULT_PERIOD;
 	uint32_t rate = DEFAULT_SAMPLE_RATE;
 
+	if (!play_cfg->cfg) {
+		log_err("No pipeline configuration\n");
+		goto err;
+	}
+
 	if (assign_nonzero_valid_val(period, cfg->period, supported_period) != 0) {
 		log_err("Period %d frames is not supported\n", cfg->period);
 		goto err;
@@ -229,6 +510,11 @@ void *play_pipeline_init(void *parameters)
 	os_assert(ctx, "Audio pipeline failed with memory allocation error");
 	memset(ctx, 0, sizeof(struct pipeline_ctx));
 
+	/*
+	 * Private copy of the configuration (element configurations included),
+	 * updated by the pipeline init: the source one may be shared with
+	 * another instance.
+	 */
 	pipeline_cfg = (struct audio_pipeline_config *)(ctx + 1);
 
 	memcpy(pipeline_cfg, play_cfg->cfg, sizeof(struct audio_pipeline_config));
@@ -237,24 +523,36 @@ void *play_pipeline_init(void *parameters)
 	pipeline_cfg->sample_rate = rate;
 	pipeline_cfg->period = period;
 
+	if (sai_select(ctx, pipeline_cfg) < 0)
+		goto err_init;
+
+	ctx->period = period;
+	fifo_period_select(ctx);
+	fifo_period_set(ctx, pipeline_cfg);
+
 	ctx->pipeline = audio_pipeline_init(pipeline_cfg);
 	if (!ctx->pipeline)
-		goto err_init;
+		goto err_pipeline;
 
 	ctx->sample_rate = rate;
-	ctx->chan_numbers = DEMO_AUDIO_DATA_CHANNEL;
 	ctx->bit_width = DEMO_AUDIO_BIT_WIDTH;
-	ctx->period = period;
 	ctx->event_send = cfg->event_send;
 	ctx->event_data = cfg->event_data;
 
 	sai_setup(ctx);
 
-	log_info("Starting %s (Sample Rate: %d Hz, Period: %u frames)\n",
-			pipeline_cfg->name, rate, (uint32_t)period);
+	/* effective configuration */
+	cfg->rate = rate;
+	cfg->period = period;
+
+	log_info("Starting %s (pipeline: %u, Sample Rate: %d Hz, Period: %u frames, Fifo period: %u frames)\n",
+			pipeline_cfg->name, ctx->pipeline->id, rate, (uint32_t)period, ctx->fifo_period);
 
 	return ctx;
 
+err_pipeline:
+	sai_used_mask &= ~ctx->sai_mask;
+
 err_init:
 	os_free(ctx);
 
@@ -267,12 +565,23 @@ void play_pipeline_exit(void *handle)
 	struct pipeline_ctx *ctx = handle;
 	int i;
 
+	/* Stop the fifo pump before the pipeline goes away */
+	if (ctx->pumping) {
+#if USE_TX_IRQ
+		sai_disable_irq(&ctx->dev[ctx->irq_dev], false, true);
+#else
+		sai_disable_irq(&ctx->dev[ctx->irq_dev], true, false);
+#endif
+		ctx->pumping = false;
+	}
+
 	audio_pipeline_exit(ctx->pipeline);
 
 	sai_close(ctx);
 
 	for (i = 0; i < sai_active_list_nelems; i++)
-		codec_close(sai_active_list[i].cid);
+		if (sai_used(ctx, i))
+			codec_close(sai_active_list[i].cid);
 
 	os_free(ctx);
 
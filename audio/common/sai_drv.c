@@ -306,6 +306,26 @@ uint32_t get_sai_id(I2S_Type *base)
 	return i;
 }
 
+/* Enables the data lines set in mask (bit n set for line n) */
+static void sai_config_lines(sai_transceiver_t *config, uint32_t mask)
+{
+	uint32_t i;
+
+	config->channelMask = mask;
+	config->channelNums = 0;
+
+	for (i = 0; i < 32; i++) {
+		if (!(mask & (1U << i)))
+			continue;
+
+		if (!config->channelNums)
+			config->startChannel = i;
+
+		config->endChannel = i;
+		config->channelNums++;
+	}
+}
+
 int sai_drv_setup(struct sai_device *dev, struct sai_cfg *sai_config)
 {
 	sai_transceiver_t config;
@@ -319,9 +339,17 @@ int sai_drv_setup(struct sai_device *dev, struct sai_cfg *sai_config)
 	/* SAI init */
 	SAI_Init(sai);
 
-	/* I2S mode configurations */
-	SAI_GetClassicI2SConfig(&config, sai_config->bit_width, kSAI_Stereo,
-			1U << DEMO_SAI_CHANNEL);
+	/*
+	 * I2S mode configurations up to 2 channels per frame, TDM mode
+	 * (one bit clock wide frame sync) above
+	 */
+	if (sai_config->chan_numbers > 2)
+		SAI_GetTDMConfig(&config, kSAI_FrameSyncLenOneBitClk, sai_config->bit_width,
+				sai_config->chan_numbers, sai_config->tx_line_mask);
+	else
+		SAI_GetClassicI2SConfig(&config, sai_config->bit_width, kSAI_Stereo,
+				sai_config->tx_line_mask);
+
 	config.syncMode            = sai_config->tx_sync_mode;
 	config.masterSlave         = sai_config->masterSlave;
 	config.bitClock.bclkSource = sai_config->msel;
@@ -331,6 +359,7 @@ int sai_drv_setup(struct sai_device *dev, struct sai_cfg *sai_config)
 
 	SAI_TransferTxSetConfig(sai, &dev->sai_tx_handle, &config);
 	config.syncMode = sai_config->rx_sync_mode;
+	sai_config_lines(&config, sai_config->rx_line_mask);
 	SAI_TransferRxSetConfig(sai, &dev->sai_rx_handle, &config);
 
 	/* Set FIFO to continue from next frame on error */
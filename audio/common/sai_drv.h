@@ -41,7 +41,9 @@ struct sai_cfg {
 	void *tx_user_data;
 	sai_word_width_t bit_width;
 	sai_sample_rate_t sample_rate;
-	uint32_t chan_numbers;
+	uint32_t chan_numbers;		/* per frame, TDM mode above 2 */
+	uint32_t tx_line_mask;		/* data lines used, bit n set for line n */
+	uint32_t rx_line_mask;
 	uint32_t source_clock_hz;
 	sai_sync_mode_t rx_sync_mode;
 	sai_sync_mode_t tx_sync_mode;
@@ -150,6 +152,16 @@ static inline bool __sai_tx_error(void *base)
 	return (((((I2S_Type *)base)->TCSR) & (uint32_t)I2S_TCSR_FEF_MASK) != 0U);
 }
 
+static inline void __sai_rx_clear_error(void *base)
+{
+	SAI_RxClearStatusFlags(base, I2S_RCSR_FEF_MASK);
+}
+
+static inline void __sai_tx_clear_error(void *base)
+{
+	SAI_TxClearStatusFlags(base, I2S_TCSR_FEF_MASK);
+}
+
 static inline unsigned int __sai_rx_level(void *base, unsigned int line)
 {
 	uint8_t wfp, rfp;
@@ -186,6 +198,42 @@ static inline void *__sai_tx_fifo_addr(void *base, unsigned int line)
 	return (void *)SAI_TxGetDataRegisterAddress(base, line);
 }
 
+/*
+ * Line fifo block transfers, from/to a block of interleaved frames.
+ * The data register only accepts single 32bit accesses, so these are
+ * back to back register accesses, unrolled, with no other memory access
+ * than the contiguous block.
+ */
+static inline void __sai_rx_fifo_read(volatile uint32_t *fifo, uint32_t *data, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		data[i] = *fifo;
+		data[i + 1] = *fifo;
+		data[i + 2] = *fifo;
+		data[i + 3] = *fifo;
+	}
+
+	for (; i < len; i++)
+		data[i] = *fifo;
+}
+
+static inline void __sai_tx_fifo_write(volatile uint32_t *fifo, const uint32_t *data, unsigned int len)
+{
+	unsigned int i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		*fifo = data[i];
+		*fifo = data[i + 1];
+		*fifo = data[i + 2];
+		*fifo = data[i + 3];
+	}
+
+	for (; i < len; i++)
+		*fifo = data[i];
+}
+
 static inline uint32_t __sai_rx_bitclock(void *base)
 {
 	return ((I2S_Type *)base)->RBCR;
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "os/stdint.h"
+
+#include "sai_sync.h"
+
+static unsigned int sai_sync_window(unsigned int mode)
+{
+	switch (mode) {
+	case SAI_SYNC_PARTIAL:
+		/* scheduling jitter */
+		return SAI_SYNC_PARTIAL_WINDOW;
+
+	case SAI_SYNC_NONE:
+		/* scheduling jitter and frame phase drift */
+		return SAI_SYNC_NONE_WINDOW;
+
+	case SAI_SYNC_FULL:
+	default:
+		return 0;
+	}
+}
+
+/* Minimum fifo size (in frames) to run with the given mode and period */
+unsigned int sai_sync_min_size(unsigned int mode, unsigned int period)
+{
+	unsigned int window = sai_sync_window(mode);
+	unsigned int size = 2 * period;	/* fifo water mark at one period */
+
+	/* the target level, its deviation window and one period must fit */
+	if ((mode != SAI_SYNC_FULL) && (size < period + 3 * window + 1))
+		size = period + 3 * window + 1;
+
+	return size;
+}
+
+void sai_sync_init(struct sai_sync *sync, unsigned int mode, bool tx, unsigned int period, unsigned int size)
+{
+	sync->mode = mode;
+	sync->tx = tx;
+	sync->size = size;
+	sync->window = sai_sync_window(mode);
+
+	if (tx) {
+		/*
+		 * Lowest level, just before the write: one period as in full
+		 * synchronization mode, if the fifo is large enough, keeping
+		 * the deviation window at least one frame above empty.
+		 */
+		sync->target = period;
+
+		if (sync->target + period + sync->window > size)
+			sync->target = size - period - sync->window;
+
+		if (sync->target < 2 * sync->window + 1)
+			sync->target = 2 * sync->window + 1;
+	} else {
+		/* Highest level, just before the read */
+		sync->target = period + sync->window;
+	}
+
+	sync->dropped = 0;
+	sync->repeated = 0;
+	sync->silence = 0;
+
+	sync->recoveries = 0;
+	sync->recovering = 0;
+	sync->recovery_last = 0;
+	sync->recovery_max = 0;
+}
+
+/*
+ * Returns the number of frames to transfer to (tx) or from (rx) the fifo,
+ * given the current fifo level and the number of frames available in (tx) or
+ * expected by (rx) the audio buffers. The difference is compensated by the
+ * caller, repeating or dropping frames.
+ */
+unsigned int sai_sync_frames(struct sai_sync *sync, unsigned int level, unsigned int frames)
+{
+	int error, n;
+
+	if (sync->mode == SAI_SYNC_FULL)
+		return frames;
+
+	/* positive error, more frames must be transferred */
+	if (sync->tx)
+		error = (int)sync->target - (int)level;
+	else
+		error = (int)level - (int)sync->target;
+
+	if ((error <= (int)sync->window) && (error >= -(int)sync->window))
+		error = 0;
+	else if (sync->mode == SAI_SYNC_NONE)
+		error = (error > 0) ? 1 : -1;
+
+	n = frames + error;
+
+	/* never write more than the fifo free space or read more than the level */
+	if (sync->tx) {
+		if (level > sync->size)
+			n = 0;
+		else if (n > (int)(sync->size - level))
+			n = sync->size - level;
+	} else {
+		if (n > (int)level)
+			n = level;
+	}
+
+	if (n < 0)
+		n = 0;
+
+	if (n > (int)frames) {
+		if (sync->tx)
+			sync->repeated += n - frames;
+		else
+			sync->dropped += n - frames;
+	} else {
+		if (sync->tx)
+			sync->dropped += frames - n;
+		else
+			sync->repeated += frames - n;
+	}
+
+	return n;
+}
+
+/*
+ * Fifo xrun recovery, brings the fifo level back to target in one period.
+ * Returns the number of frames to transfer to (tx) or from (rx) the fifo, as
+ * sai_sync_frames(). In addition, silence frames are written before the
+ * input frames (tx) or output before the fifo frames (rx), and skip fifo
+ * frames (the oldest ones) are dropped before the output frames (rx).
+ */
+unsigned int sai_sync_recover(struct sai_sync *sync, unsigned int level, unsigned int frames, unsigned int *silence, unsigned int *skip)
+{
+	unsigned int n = frames, space;
+
+	*silence = 0;
+	*skip = 0;
+
+	if (!sync->recovering)
+		sync->recoveries++;
+
+	sync->recovering++;
+
+	if (sync->tx) {
+		if (level < sync->target)
+			*silence = sync->target - level;
+		else if (level - sync->target < frames)
+			n = frames - (level - sync->target);
+		else
+			n = 0;
+
+		space = (level < sync->size) ? sync->size - level : 0;
+
+		if (*silence > space)
+			*silence = space;
+
+		if (n > space - *silence)
+			n = space - *silence;
+
+		sync->dropped += frames - n;
+	} else {
+		if (level < frames) {
+			n = level;
+			*silence = frames - n;
+		} else if (level > sync->target) {
+			*skip = level - sync->target;
+			n = *skip + frames;
+		}
+
+		sync->dropped += *skip;
+	}
+
+	sync->silence += *silence;
+
+	return n;
+}
+
+/* Fifo level back in range, ends the current recovery */
+void sai_sync_recovered(struct sai_sync *sync)
+{
+	if (!sync->recovering)
+		return;
+
+	sync->recovery_last = sync->recovering;
+	if (sync->recovery_last > sync->recovery_max)
+		sync->recovery_max = sync->recovery_last;
+
+	sync->recovering = 0;
+}
+
+unsigned int sai_sync_periods_to_us(unsigned int periods, unsigned int period, unsigned int sample_rate)
+{
+	if (!sample_rate)
+		return 0;
+
+	return ((uint64_t)periods * period * 1000000) / sample_rate;
+}
+
+const char *sai_sync_mode_name(unsigned int mode)
+{
+	switch (mode) {
+	case SAI_SYNC_FULL:
+		return "full";
+
+	case SAI_SYNC_PARTIAL:
+		return "partial";
+
+	case SAI_SYNC_NONE:
+		return "none";
+
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#ifndef _SAI_SYNC_H_
+#define _SAI_SYNC_H_
+
+#include "os/stdbool.h"
+
+/*
+ * Synchronization between the pipeline scheduling source and a sai fifo
+ *
+ * SAI_SYNC_FULL: the scheduling source is synchronous to the sai audio
+ * clock, frame sync and fifo level (e.g. the sai own IRQ, or a sai in
+ * hardware synchronous mode). The fifo level is guaranteed, a fixed number
+ * of frames is transferred at each period and fifo errors are fatal.
+ *
+ * SAI_SYNC_PARTIAL: the scheduling source is synchronous to the sai audio
+ * clock, but not to its frame sync or fifo level (e.g. a GPT timer clocked
+ * from the audio clock, or the IRQ of another sai, using the same clock,
+ * not in hardware synchronous mode). The fifo level after start is
+ * arbitrary and is brought back to the target level at once, afterwards it
+ * only varies by the scheduling jitter.
+ *
+ * SAI_SYNC_NONE: the scheduling source is asynchronous to the sai audio
+ * clock (e.g. a GPT timer clocked from the system clock, or a slave sai with
+ * a different audio clock). The fifo level drifts and is brought back to the
+ * target level one frame per period.
+ *
+ * In the last two modes, the fifo level is compensated by transferring more
+ * or less frames than the period (dropping or repeating frames).
+ *
+ * In all modes, a fifo xrun is recovered in place: silence is inserted or
+ * frames are dropped to bring the level back to target, in one period, the
+ * other lines and elements are not affected. Recovery only fails (and the
+ * caller falls back to a pipeline reset) if the line stays in error for
+ * SAI_SYNC_RECOVERY_MAX periods.
+ */
+enum sai_sync_mode {
+	SAI_SYNC_FULL = 0,
+	SAI_SYNC_PARTIAL,
+	SAI_SYNC_NONE,
+	SAI_SYNC_MAX
+};
+
+#define SAI_SYNC_PARTIAL_WINDOW		1	/* tolerated level deviation, in frames */
+#define SAI_SYNC_NONE_WINDOW		2
+#define SAI_SYNC_RECOVERY_MAX		4	/* consecutive periods in error */
+
+struct sai_sync {
+	unsigned int mode;
+	bool tx;
+	unsigned int size;		/* fifo size, in frames */
+	unsigned int target;		/* fifo level before the transfer, in frames */
+	unsigned int window;		/* tolerated level deviation, in frames */
+
+	unsigned int dropped;		/* in frames */
+	unsigned int repeated;		/* in frames */
+	unsigned int silence;		/* inserted on recovery, in frames */
+
+	unsigned int recoveries;
+	unsigned int recovering;	/* consecutive periods in error */
+	unsigned int recovery_last;	/* in periods */
+	unsigned int recovery_max;	/* in periods */
+};
+
+void sai_sync_init(struct sai_sync *sync, unsigned int mode, bool tx, unsigned int period, unsigned int size);
+unsigned int sai_sync_frames(struct sai_sync *sync, unsigned int level, unsigned int frames);
+unsigned int sai_sync_recover(struct sai_sync *sync, unsigned int level, unsigned int frames, unsigned int *silence, unsigned int *skip);
+void sai_sync_recovered(struct sai_sync *sync);
+unsigned int sai_sync_min_size(unsigned int mode, unsigned int period);
+unsigned int sai_sync_periods_to_us(unsigned int periods, unsigned int period, unsigned int sample_rate);
+const char *sai_sync_mode_name(unsigned int mode);
+
+#endif /* _SAI_SYNC_H_ */
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host benchmark: time per period of the sample format dependent data path,
+ * for the build time sample format. For each channel: the sai source
+ * conversion from the interleaved fifo words, a routing copy to another
+ * buffer and the sai sink conversion to the interleaved fifo words.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_format.h"
+
+#define CHANNELS	8
+#define PERIOD_MAX	512
+#define RUN_NS		200000000ULL	/* per period size */
+
+static uint32_t fifo_rx[PERIOD_MAX * CHANNELS];
+static uint32_t fifo_tx[PERIOD_MAX * CHANNELS];
+static audio_sample_t in[CHANNELS][PERIOD_MAX];
+static audio_sample_t out[CHANNELS][PERIOD_MAX];
+
+static uint64_t time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void period_run(unsigned int period)
+{
+	int c;
+
+	for (c = 0; c < CHANNELS; c++)
+		audio_convert_from(in[c], &fifo_rx[c], CHANNELS, period, false, 0xffffffff, 0);
+
+	for (c = 0; c < CHANNELS; c++)
+		memcpy(out[c], in[c], period * sizeof(audio_sample_t));
+
+	for (c = 0; c < CHANNELS; c++)
+		audio_convert_to(&fifo_tx[c], CHANNELS, out[c], period, false, 0xffffffff, 0);
+}
+
+int main(void)
+{
+	static const unsigned int period[] = {8, 32, 128, 512};
+	uint32_t seed = 0x12345678;
+	uint64_t start, elapsed;
+	unsigned int p, n;
+	int i;
+
+	for (i = 0; i < PERIOD_MAX * CHANNELS; i++) {
+		seed = seed * 1664525 + 1013904223;
+		fifo_rx[i] = seed;
+	}
+
+	for (p = 0; p < sizeof(period) / sizeof(period[0]); p++) {
+		/* warm up */
+		for (n = 0; n < 1000; n++)
+			period_run(period[p]);
+
+		start = time_ns();
+		n = 0;
+
+		do {
+			period_run(period[p]);
+			n++;
+
+			elapsed = time_ns() - start;
+		} while (elapsed < RUN_NS);
+
+		printf("%s: period %3u, %u channels: %8.1f ns/period, %5.2f ns/sample\n",
+		       AUDIO_SAMPLE_FORMAT_NAME, period[p], CHANNELS, (double)elapsed / n,
+		       (double)elapsed / n / (period[p] * CHANNELS));
+	}
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: the vectorized fifo format conversions are bit exact with the
+ * scalar ones, for the build time sample format, all the fifo word formats
+ * (width, endianness), strides and lengths (including tails shorter than the
+ * vector width), and the saturation edges. Out of range samples saturate.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_format.h"
+
+#define MAX_LEN		37
+#define MAX_STRIDE	16
+
+static const struct {
+	uint32_t mask;
+	uint32_t shift;
+} word_format[] = {
+	{0xffffffff, 0},	/* 32bit */
+	{0x00ffffff, 8},	/* 24bit, lsb aligned */
+	{0x0000ffff, 16},	/* 16bit, lsb aligned */
+};
+
+static const unsigned int stride[] = {1, 2, 3, 8, 16};
+
+static uint32_t fifo_in[MAX_LEN * MAX_STRIDE];
+static audio_sample_t samples_in[MAX_LEN];
+
+/* Fifo words, with the int32 edges first */
+static void fifo_init(void)
+{
+	uint32_t seed = 0x12345678;
+	int i;
+
+	for (i = 0; i < MAX_LEN * MAX_STRIDE; i++) {
+		seed = seed * 1664525 + 1013904223;
+		fifo_in[i] = seed;
+	}
+
+	fifo_in[0] = (uint32_t)INT32_MIN;
+	fifo_in[1] = (uint32_t)INT32_MAX;
+	fifo_in[2] = 0;
+	fifo_in[3] = (uint32_t)-1;
+}
+
+/* Samples in [-1.0, 1.0], with the saturation edges and out of range values first */
+static void samples_init(void)
+{
+	uint32_t seed = 0x9abcdef0;
+	int i;
+
+	for (i = 0; i < MAX_LEN; i++) {
+		seed = seed * 1664525 + 1013904223;
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+		samples_in[i] = (int32_t)seed;
+#else
+		samples_in[i] = (audio_sample_t)((int32_t)seed / 2147483648.0);
+#endif
+	}
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	samples_in[0] = INT32_MIN;
+	samples_in[1] = INT32_MAX;
+	samples_in[2] = INT32_MIN + 1;
+#else
+	samples_in[0] = (audio_sample_t)1.0;
+	samples_in[1] = (audio_sample_t)-1.0;
+	samples_in[2] = (audio_sample_t)0.99999999;
+	samples_in[4] = (audio_sample_t)1.5;
+	samples_in[5] = (audio_sample_t)-1.5;
+	samples_in[6] = (audio_sample_t)-1e30;
+#endif
+	samples_in[3] = AUDIO_SAMPLE_SILENCE;
+}
+
+static int test_convert_from(unsigned int len, unsigned int stride, bool invert, uint32_t mask, uint32_t shift)
+{
+	audio_sample_t ref[MAX_LEN + 1], out[MAX_LEN + 1];
+
+	memset(ref, 0x5a, sizeof(ref));
+	memset(out, 0x5a, sizeof(out));
+
+	audio_convert_from_scalar(ref, fifo_in, stride, len, invert, mask, shift);
+	audio_convert_from(out, fifo_in, stride, len, invert, mask, shift);
+
+	/* one extra sample, not written */
+	if (memcmp(ref, out, sizeof(ref))) {
+		printf("convert_from: len %u, stride %u, invert %u, mask 0x%08x, shift %u: mismatch\n",
+		       len, stride, invert, mask, shift);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int test_convert_to(unsigned int len, unsigned int stride, bool invert, uint32_t mask, uint32_t shift)
+{
+	uint32_t ref[MAX_LEN * MAX_STRIDE], out[MAX_LEN * MAX_STRIDE];
+	audio_sample_t samples[MAX_LEN];
+
+	memcpy(samples, samples_in, sizeof(samples));
+	memset(ref, 0x5a, sizeof(ref));
+	memset(out, 0x5a, sizeof(out));
+
+	audio_convert_to_scalar(ref, stride, samples, len, invert, mask, shift);
+	audio_convert_to(out, stride, samples, len, invert, mask, shift);
+
+	/* words between the strided ones, and past the end, not written */
+	if (memcmp(ref, out, sizeof(ref))) {
+		printf("convert_to: len %u, stride %u, invert %u, mask 0x%08x, shift %u: mismatch\n",
+		       len, stride, invert, mask, shift);
+		return -1;
+	}
+
+	/* input left unmodified */
+	if (memcmp(samples, samples_in, sizeof(samples))) {
+		printf("convert_to: len %u, stride %u: input modified\n", len, stride);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Values out of the [-1.0, 1.0] range saturate, on both sides */
+static int test_saturation(void)
+{
+	static const double value[] = {1.0, 1.5, 1e30, -1.0, -1.5, -1e30};
+	int32_t val, expected;
+	int i;
+
+	for (i = 0; i < sizeof(value) / sizeof(value[0]); i++) {
+		val = audio_sample_to_int32(audio_double_to_sample(value[i]));
+		expected = (value[i] > 0) ? 0x7fffffff : AUDIO_SAMPLE_INT32_MIN;
+
+		if (val != expected) {
+			printf("saturation: %g: 0x%08x, expected 0x%08x\n", value[i], val, expected);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	unsigned int len, s, f, invert, tests = 0, err = 0;
+
+	fifo_init();
+	samples_init();
+
+	if (test_saturation())
+		err++;
+
+	tests++;
+
+	for (f = 0; f < sizeof(word_format) / sizeof(word_format[0]); f++) {
+		for (s = 0; s < sizeof(stride) / sizeof(stride[0]); s++) {
+			for (invert = 0; invert < 2; invert++) {
+				for (len = 0; len <= MAX_LEN; len++) {
+					if (test_convert_from(len, stride[s], invert, word_format[f].mask, word_format[f].shift))
+						err++;
+
+					if (test_convert_to(len, stride[s], invert, word_format[f].mask, word_format[f].shift))
+						err++;
+
+					tests += 2;
+				}
+			}
+		}
+	}
+
+#if defined(AUDIO_FORMAT_VECTOR)
+	printf("%s, vector width %u: %u tests, %u errors\n", AUDIO_SAMPLE_FORMAT_NAME, AUDIO_FORMAT_VECTOR, tests, err);
+#else
+	printf("%s, scalar: %u tests, %u errors\n", AUDIO_SAMPLE_FORMAT_NAME, tests, err);
+#endif
+
+	return err ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host benchmark: biquad element time per sample and section, for the build
+ * time sample format, with and without a coefficients update (ramp) in every
+ * period.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "audio_element_biquad.h"
+#include "hlog.h"
+#include "hrpn_ctrl.h"
+#include "test_element.h"
+
+#define RATE		48000
+#define PERIOD		32
+#define RUN_NS		200000000ULL	/* per configuration */
+
+static void lowpass(struct hrpn_audio_biquad_coef *c, double f0)
+{
+	double w0 = 2.0 * M_PI * f0 / RATE;
+	double alpha = sin(w0) / (2.0 * M_SQRT1_2);
+	double a0 = 1.0 + alpha;
+
+	c->b0 = (1.0 - cos(w0)) / 2.0 / a0;
+	c->b1 = (1.0 - cos(w0)) / a0;
+	c->b2 = c->b0;
+	c->a1 = -2.0 * cos(w0) / a0;
+	c->a2 = (1.0 - alpha) / a0;
+}
+
+static double bench(unsigned int channels, unsigned int sections, bool update)
+{
+	struct hrpn_cmd_audio_element_biquad cmd;
+	struct test_element t;
+	uint64_t start, elapsed;
+	uint32_t seed = 1;
+	unsigned int n;
+	int i;
+
+	t.config.type = AUDIO_ELEMENT_BIQUAD;
+	t.config.inputs = channels;
+	t.config.outputs = channels;
+	t.config.period = PERIOD;
+	t.config.sample_rate = RATE;
+	t.config.u.biquad.sections = sections;
+	t.config.u.biquad.coefs = 0;
+	t.config.u.biquad.coef = NULL;
+
+	if (test_element_init(&t, 2, biquad_element_size, biquad_element_init) < 0)
+		return 0.0;
+
+	cmd.u.set.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_BIQUAD_SET;
+	cmd.u.set.channel = HRPN_AUDIO_ELEMENT_BIQUAD_ALL_CHANNELS;
+
+	for (i = 0; i < sections; i++) {
+		cmd.u.set.section = i;
+		lowpass(&cmd.u.set.coef, 8000.0 + 1000.0 * i);
+		biquad_element_ctrl(&t.element, &cmd, sizeof(cmd.u.set), NULL);
+	}
+
+	cmd.u.set.section = 0;
+
+	/* input buffers storage, written once */
+	for (i = 0; i < channels * 2 * PERIOD; i++) {
+		seed = seed * 1664525 + 1013904223;
+		t.storage[i] = audio_double_to_sample(0.1 * ((double)(int32_t)seed / 2147483648.0));
+	}
+
+	start = test_time_ns();
+	n = 0;
+
+	do {
+		if (update) {
+			lowpass(&cmd.u.set.coef, (n & 1) ? 8000.0 : 4000.0);
+			biquad_element_ctrl(&t.element, &cmd, sizeof(cmd.u.set), NULL);
+		}
+
+		test_element_run(&t);
+		n++;
+
+		elapsed = test_time_ns() - start;
+	} while (elapsed < RUN_NS);
+
+	test_element_exit(&t);
+
+	return (double)elapsed / n / (PERIOD * channels * sections);
+}
+
+int main(void)
+{
+	static const unsigned int channels[] = {1, 4, 8};
+	static const unsigned int sections[] = {1, 4, 8};
+	unsigned int c, s;
+
+	hlog_level_config_set(LOG_ERR);
+
+	for (c = 0; c < sizeof(channels) / sizeof(channels[0]); c++)
+		for (s = 0; s < sizeof(sections) / sizeof(sections[0]); s++)
+			printf("%s: period %u, %u channels, %u sections: %5.2f ns/sample/section, %5.2f with a ramp\n",
+			       AUDIO_SAMPLE_FORMAT_NAME, PERIOD, channels[c], sections[s],
+			       bench(channels[c], sections[s], false), bench(channels[c], sections[s], true));
+
+	return 0;
+}
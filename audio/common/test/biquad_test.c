@@ -0,0 +1,297 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: biquad element, for the build time sample format.
+ *
+ * Covers the accuracy against a double precision reference (per channel
+ * coefficients, all lanes and the padding lane group), the coefficients ramp
+ * on update (no step, exact endpoints) and the updates while the pipeline is
+ * stopped (never wait for the data path, last one applied).
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "audio_element_biquad.h"
+#include "hlog.h"
+#include "hrpn_ctrl.h"
+#include "test_element.h"
+
+#define RATE		48000
+#define PERIOD		32
+#define PERIODS		200
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+#define ERROR_MAX_DB	-125.0
+#define RAMP_TOLERANCE	1e-8
+#elif defined(AUDIO_SAMPLE_FORMAT_FLOAT)
+#define ERROR_MAX_DB	-90.0
+#define RAMP_TOLERANCE	1e-6
+#else
+#define ERROR_MAX_DB	-200.0
+#define RAMP_TOLERANCE	1e-12
+#endif
+
+/* Peaking equalizer, audio eq cookbook */
+static void peak(struct hrpn_audio_biquad_coef *c, double f0, double gain_db, double q)
+{
+	double a = pow(10.0, gain_db / 40.0);
+	double w0 = 2.0 * M_PI * f0 / RATE;
+	double alpha = sin(w0) / (2.0 * q);
+	double a0 = 1.0 + alpha / a;
+
+	c->b0 = (1.0 + alpha * a) / a0;
+	c->b1 = -2.0 * cos(w0) / a0;
+	c->b2 = (1.0 - alpha * a) / a0;
+	c->a1 = -2.0 * cos(w0) / a0;
+	c->a2 = (1.0 - alpha / a) / a0;
+}
+
+static void gain(struct hrpn_audio_biquad_coef *c, double g)
+{
+	c->b0 = g;
+	c->b1 = 0.0;
+	c->b2 = 0.0;
+	c->a1 = 0.0;
+	c->a2 = 0.0;
+}
+
+static int biquad_init(struct test_element *t, unsigned int channels, unsigned int sections,
+		       struct hrpn_audio_biquad_coef *coef, unsigned int coefs)
+{
+	t->config.type = AUDIO_ELEMENT_BIQUAD;
+	t->config.inputs = channels;
+	t->config.outputs = channels;
+	t->config.period = PERIOD;
+	t->config.sample_rate = RATE;
+	t->config.u.biquad.sections = sections;
+	t->config.u.biquad.coefs = coefs;
+	t->config.u.biquad.coef = coef;
+
+	if (biquad_element_check_config(&t->config) < 0)
+		return -1;
+
+	return test_element_init(t, 2, biquad_element_size, biquad_element_init);
+}
+
+static int biquad_set(struct test_element *t, unsigned int channel, unsigned int section, struct hrpn_audio_biquad_coef *c)
+{
+	struct hrpn_cmd_audio_element_biquad cmd;
+
+	cmd.u.set.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_BIQUAD_SET;
+	cmd.u.set.channel = channel;
+	cmd.u.set.section = section;
+	cmd.u.set.coef = *c;
+
+	return biquad_element_ctrl(&t->element, &cmd, sizeof(cmd.u.set), NULL);
+}
+
+/*
+ * 5 channels (one full group and a padded one, with vectors), 4 sections
+ * each, against direct form 1 in double precision. The error is relative
+ * to the output power, over all channels.
+ */
+static int test_accuracy(void)
+{
+	struct hrpn_audio_biquad_coef coef[5 * 4];
+	double x1[5][4] = {{0}}, x2[5][4] = {{0}}, y1[5][4] = {{0}}, y2[5][4] = {{0}};
+	double x, y, err = 0.0, ref = 0.0, db;
+	struct hrpn_audio_biquad_coef *c;
+	struct test_element t;
+	uint32_t seed = 1;
+	audio_sample_t in[5][PERIOD];
+	int p, i, ch, s;
+
+	for (ch = 0; ch < 5; ch++)
+		for (s = 0; s < 4; s++)
+			peak(&coef[ch * 4 + s], 200.0 * (ch + 1) * (s + 1), (s & 1) ? -6.0 : 6.0, 0.7 + 0.3 * s);
+
+	if (biquad_init(&t, 5, 4, coef, 5 * 4) < 0)
+		return -1;
+
+	for (p = 0; p < PERIODS; p++) {
+		for (ch = 0; ch < 5; ch++) {
+			for (i = 0; i < PERIOD; i++) {
+				seed = seed * 1664525 + 1013904223;
+				in[ch][i] = audio_double_to_sample(0.1 * ((double)(int32_t)seed / 2147483648.0));
+				test_element_in(&t, ch)[i] = in[ch][i];
+			}
+		}
+
+		if (test_element_run(&t) < 0)
+			goto err;
+
+		for (ch = 0; ch < 5; ch++) {
+			for (i = 0; i < PERIOD; i++) {
+				x = audio_sample_to_double(in[ch][i]);
+
+				for (s = 0; s < 4; s++) {
+					c = &coef[ch * 4 + s];
+					y = c->b0 * x + c->b1 * x1[ch][s] + c->b2 * x2[ch][s] - c->a1 * y1[ch][s] - c->a2 * y2[ch][s];
+					x2[ch][s] = x1[ch][s];
+					x1[ch][s] = x;
+					y2[ch][s] = y1[ch][s];
+					y1[ch][s] = y;
+					x = y;
+				}
+
+				err += pow(audio_sample_to_double(test_element_out(&t, ch)[i]) - x, 2);
+				ref += x * x;
+			}
+		}
+	}
+
+	test_element_exit(&t);
+
+	db = 10.0 * log10(err / ref);
+
+	printf("accuracy: error %.1f dB (max %.1f dB)\n", db, ERROR_MAX_DB);
+
+	return (db <= ERROR_MAX_DB) ? 0 : -1;
+
+err:
+	test_element_exit(&t);
+
+	return -1;
+}
+
+/* Constant input through a gain section, output of the period after the update */
+static int ramp_period(struct test_element *t, double x, audio_sample_t *out)
+{
+	int ch, i;
+
+	for (ch = 0; ch < t->config.inputs; ch++)
+		for (i = 0; i < PERIOD; i++)
+			test_element_in(t, ch)[i] = audio_double_to_sample(x);
+
+	if (test_element_run(t) < 0)
+		return -1;
+
+	for (i = 0; i < PERIOD; i++)
+		out[i] = test_element_out(t, 0)[i];
+
+	return 0;
+}
+
+/*
+ * Gain update: the output ramps linearly over one period, starting from the
+ * previous gain (no step) and reaching the new one at the next period.
+ */
+static int test_ramp(void)
+{
+	struct hrpn_audio_biquad_coef c;
+	audio_sample_t out[PERIOD];
+	struct test_element t;
+	double x = 0.5, from = 1.0, to = 0.25, expected;
+	int i, err = 0;
+
+	if (biquad_init(&t, 2, 1, NULL, 0) < 0)
+		return -1;
+
+	if (ramp_period(&t, x, out) < 0)
+		goto err;
+
+	gain(&c, to);
+
+	if (biquad_set(&t, HRPN_AUDIO_ELEMENT_BIQUAD_ALL_CHANNELS, 0, &c) < 0)
+		goto err;
+
+	if (ramp_period(&t, x, out) < 0)
+		goto err;
+
+	for (i = 0; i < PERIOD; i++) {
+		expected = x * (from + (to - from) * i / PERIOD);
+
+		if (fabs(audio_sample_to_double(out[i]) - expected) > RAMP_TOLERANCE) {
+			printf("ramp: sample %d: %.9f, expected %.9f\n", i, audio_sample_to_double(out[i]), expected);
+			err++;
+		}
+	}
+
+	if (ramp_period(&t, x, out) < 0)
+		goto err;
+
+	for (i = 0; i < PERIOD; i++) {
+		if (fabs(audio_sample_to_double(out[i]) - x * to) > RAMP_TOLERANCE) {
+			printf("ramp end: sample %d: %.9f, expected %.9f\n", i, audio_sample_to_double(out[i]), x * to);
+			err++;
+		}
+	}
+
+	test_element_exit(&t);
+
+	printf("ramp: %d errors\n", err);
+
+	return err ? -1 : 0;
+
+err:
+	test_element_exit(&t);
+
+	return -1;
+}
+
+/* Updates without any run in between all succeed, the first run ramps to the last one */
+static int test_stopped(void)
+{
+	struct hrpn_audio_biquad_coef c;
+	audio_sample_t out[PERIOD];
+	struct test_element t;
+	double x = 0.5;
+	int i, err = 0;
+
+	if (biquad_init(&t, 2, 1, NULL, 0) < 0)
+		return -1;
+
+	for (i = 1; i <= 1000; i++) {
+		gain(&c, 1.0 / i);
+
+		if (biquad_set(&t, i & 1, 0, &c) < 0)
+			err++;
+	}
+
+	if ((ramp_period(&t, x, out) < 0) || (ramp_period(&t, x, out) < 0))
+		goto err;
+
+	/* channel 0 got the even updates */
+	if (fabs(audio_sample_to_double(out[0]) - x / 1000) > RAMP_TOLERANCE) {
+		printf("stopped: %.9f, expected %.9f\n", audio_sample_to_double(out[0]), x / 1000);
+		err++;
+	}
+
+	test_element_exit(&t);
+
+	printf("stopped: %d errors\n", err);
+
+	return err ? -1 : 0;
+
+err:
+	test_element_exit(&t);
+
+	return -1;
+}
+
+int main(void)
+{
+	unsigned int err = 0;
+
+	hlog_level_config_set(LOG_ERR);
+
+	printf("biquad: %s\n", AUDIO_SAMPLE_FORMAT_NAME);
+
+	if (test_accuracy() < 0)
+		err++;
+
+	if (test_ramp() < 0)
+		err++;
+
+	if (test_stopped() < 0)
+		err++;
+
+	printf("biquad: %u errors\n", err);
+
+	return err ? 1 : 0;
+}
@@ -0,0 +1,324 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: tone detector element, for the build time sample format.
+ *
+ * Covers the detection thresholds (tones a few dB above the configured level
+ * detected, a few dB below rejected), the DTMF digits (all keys, start and
+ * end timing, twist and energy ratio rejection, in noise) and the pilot tones
+ * (in noise, no false detection in noise alone).
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "audio_element_detector.h"
+#include "hlog.h"
+#include "hrpn_ctrl.h"
+#include "mailbox.h"
+#include "test_element.h"
+
+#define RATE		48000
+#define PERIOD		32
+#define THRESHOLD	-30		/* dBFS */
+#define MARGIN		2.0		/* dB, around the threshold */
+#define GAP		(RATE / 10)	/* silence before and after each tone */
+#define TONE		(RATE / 12)	/* 83ms tones */
+#define TIMING_MAX	(2 * PERIOD)	/* start and end error, in samples */
+#define BLOCK		(RATE / 40)	/* default analysis block */
+#define PILOT		1000		/* Hz */
+
+static const unsigned int dtmf_row[4] = {697, 770, 852, 941};
+static const unsigned int dtmf_col[4] = {1209, 1336, 1477, 1633};
+static const char dtmf_key[4][4] = {
+	{'1', '2', '3', 'A'},
+	{'4', '5', '6', 'B'},
+	{'7', '8', '9', 'C'},
+	{'*', '0', '#', 'D'},
+};
+
+/* Up to two tones, in [start, end), plus uniform noise, from the element start */
+struct signal {
+	double freq[2];
+	double amp[2];		/* dBFS, per tone */
+	unsigned long start;
+	unsigned long end;
+	double noise;		/* rms, dBFS, or 0 for none */
+};
+
+struct detector_test {
+	struct test_element t;
+	struct mailbox m;
+	struct hrpn_resp_audio_element_detector resp;
+	unsigned long time;	/* samples since the element start */
+	long timing_max;	/* start and end error, in samples */
+	uint32_t seed;
+};
+
+static int detector_init(struct detector_test *d, unsigned int pilots)
+{
+	struct test_element *t = &d->t;
+
+	t->config.type = AUDIO_ELEMENT_DETECTOR;
+	t->config.inputs = 1;
+	t->config.outputs = 0;
+	t->config.period = PERIOD;
+	t->config.sample_rate = RATE;
+	t->config.u.detector.pilots = pilots;
+	t->config.u.detector.pilot[0] = PILOT;
+	t->config.u.detector.block = 0;
+	t->config.u.detector.threshold = THRESHOLD;
+
+	if (detector_element_check_config(&t->config) < 0)
+		return -1;
+
+	d->m.resp = &d->resp;
+	d->time = 0;
+	d->timing_max = TIMING_MAX;
+	d->seed = 1;
+
+	return test_element_init(t, 2, detector_element_size, detector_element_init);
+}
+
+static double signal_sample(struct detector_test *d, struct signal *s, unsigned long n)
+{
+	double x = 0.0;
+	int k;
+
+	if ((n >= s->start) && (n < s->end))
+		for (k = 0; k < 2; k++)
+			if (s->freq[k])
+				x += pow(10.0, s->amp[k] / 20.0) * sin(2.0 * M_PI * s->freq[k] * (n - s->start) / RATE);
+
+	if (s->noise) {
+		/* uniform in [-1, 1), rms 1 / sqrt(3) */
+		d->seed = d->seed * 1664525 + 1013904223;
+		x += sqrt(3.0) * pow(10.0, s->noise / 20.0) * ((double)(int32_t)d->seed / 2147483648.0);
+	}
+
+	return x;
+}
+
+/* Runs the element until the signal end, plus the gap */
+static int detector_run(struct detector_test *d, struct signal *s)
+{
+	audio_sample_t *in;
+	int i;
+
+	while (d->time < s->end + GAP) {
+		in = test_element_in(&d->t, 0);
+
+		for (i = 0; i < PERIOD; i++)
+			in[i] = audio_double_to_sample(signal_sample(d, s, d->time + i));
+
+		if (test_element_run(&d->t) < 0)
+			return -1;
+
+		d->time += PERIOD;
+	}
+
+	return 0;
+}
+
+static int detector_read(struct detector_test *d)
+{
+	struct hrpn_cmd_audio_element_detector cmd;
+
+	cmd.u.read.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_DETECTOR_READ;
+
+	if ((detector_element_ctrl(&d->t.element, &cmd, sizeof(cmd.u.read), &d->m) < 0) ||
+	    (d->resp.status != HRPN_RESP_STATUS_SUCCESS) || d->resp.lost)
+		return -1;
+
+	return d->resp.events;
+}
+
+static bool timing_check(struct detector_test *d, long value, long expected)
+{
+	return labs(value - expected) <= d->timing_max;
+}
+
+/*
+ * One tone (or digit) burst, after a gap: returns 1 if reported with the
+ * expected start and duration, 0 if not reported at all, -1 otherwise.
+ */
+static int tone_burst(struct detector_test *d, struct signal *s, uint32_t tone)
+{
+	struct hrpn_audio_detector_event *e = d->resp.event;
+	int events;
+
+	s->start = d->time + GAP + 11;	/* not period aligned */
+	s->end = s->start + TONE;
+
+	if (detector_run(d, s) < 0)
+		return -1;
+
+	events = detector_read(d);
+	if (!events)
+		return 0;
+
+	if ((events != 2) || (e[0].tone != tone) || (e[1].tone != tone) || e[0].duration ||
+	    (e[0].start != e[1].start) || !timing_check(d, e[1].start, s->start) ||
+	    !timing_check(d, e[1].duration, TONE)) {
+		printf("tone 0x%x: %d events, first 0x%x at %llu, expected at %lu\n", tone, events,
+		       events ? e[0].tone : 0, events ? (unsigned long long)e[0].start : 0, s->start);
+		return -1;
+	}
+
+	return 1;
+}
+
+/* All the keys, at -20 dBFS per tone, in -40 dBFS noise */
+static int test_dtmf_keys(void)
+{
+	struct detector_test d;
+	struct signal s = {0};
+	int r, c, err = 0;
+
+	if (detector_init(&d, 0) < 0)
+		return -1;
+
+	s.amp[0] = s.amp[1] = -20.0;
+	s.noise = -40.0;
+
+	for (r = 0; r < 4; r++) {
+		for (c = 0; c < 4; c++) {
+			s.freq[0] = dtmf_row[r];
+			s.freq[1] = dtmf_col[c];
+
+			if (tone_burst(&d, &s, dtmf_key[r][c]) != 1)
+				err++;
+		}
+	}
+
+	test_element_exit(&d.t);
+
+	printf("dtmf keys: %d errors\n", err);
+
+	return err ? -1 : 0;
+}
+
+/*
+ * A digit, or a pilot, at amp (dBFS per tone), with the column tone twist dB
+ * below the row one and noise: returns 1 if detected, 0 if not, -1 on error.
+ */
+static int detect(unsigned int pilots, double amp, double twist, double noise)
+{
+	struct detector_test d;
+	struct signal s = {0};
+	int ret;
+
+	if (detector_init(&d, pilots) < 0)
+		return -1;
+
+	/* noise above the activity level, start and end on the blocks boundaries */
+	s.noise = noise;
+	if (noise > THRESHOLD)
+		d.timing_max = BLOCK;
+
+	if (pilots) {
+		s.freq[0] = PILOT;
+		s.amp[0] = amp;
+		ret = tone_burst(&d, &s, HRPN_AUDIO_DETECTOR_PILOT(0));
+	} else {
+		s.freq[0] = dtmf_row[1];
+		s.freq[1] = dtmf_col[2];
+		s.amp[0] = amp;
+		s.amp[1] = amp - twist;
+		ret = tone_burst(&d, &s, '6');
+	}
+
+	test_element_exit(&d.t);
+
+	return ret;
+}
+
+static int test_detect(const char *name, unsigned int pilots, double amp, double twist, double noise, int expected)
+{
+	int ret = detect(pilots, amp, twist, noise);
+
+	printf("%s: %s\n", name, (ret < 0) ? "error" : (ret ? "detected" : "rejected"));
+
+	return (ret == expected) ? 0 : -1;
+}
+
+/* Noise alone, several seconds with the pilot resonator, no event */
+static int test_noise(void)
+{
+	struct detector_test d;
+	struct signal s = {0};
+	int events;
+
+	if (detector_init(&d, 1) < 0)
+		return -1;
+
+	s.noise = -16.0;
+	s.end = 5 * RATE;
+
+	if (detector_run(&d, &s) < 0)
+		events = -1;
+	else
+		events = detector_read(&d);
+
+	test_element_exit(&d.t);
+
+	printf("noise: %d events\n", events);
+
+	return events ? -1 : 0;
+}
+
+int main(void)
+{
+	unsigned int err = 0;
+
+	hlog_level_config_set(LOG_ERR);
+
+	printf("detector: %s\n", AUDIO_SAMPLE_FORMAT_NAME);
+
+	if (test_dtmf_keys() < 0)
+		err++;
+
+	/* threshold, per tone */
+	if (test_detect("dtmf above threshold", 0, THRESHOLD + MARGIN, 0.0, 0.0, 1) < 0)
+		err++;
+
+	if (test_detect("dtmf below threshold", 0, THRESHOLD - MARGIN, 0.0, 0.0, 0) < 0)
+		err++;
+
+	if (test_detect("dtmf column below threshold", 0, THRESHOLD + 6.0, 6.0 + MARGIN, 0.0, 0) < 0)
+		err++;
+
+	if (test_detect("pilot above threshold", 1, THRESHOLD + MARGIN, 0.0, 0.0, 1) < 0)
+		err++;
+
+	if (test_detect("pilot below threshold", 1, THRESHOLD - MARGIN, 0.0, 0.0, 0) < 0)
+		err++;
+
+	/* twist, 8 dB */
+	if (test_detect("dtmf 6 dB twist", 0, -10.0, 6.0, 0.0, 1) < 0)
+		err++;
+
+	if (test_detect("dtmf 10 dB twist", 0, -10.0, 10.0, 0.0, 0) < 0)
+		err++;
+
+	/* digit tones under half the block energy */
+	if (test_detect("dtmf in -26 dBFS noise", 0, -20.0, 0.0, -26.0, 1) < 0)
+		err++;
+
+	if (test_detect("dtmf in -16 dBFS noise", 0, -20.0, 0.0, -16.0, 0) < 0)
+		err++;
+
+	if (test_detect("pilot in -26 dBFS noise", 1, -20.0, 0.0, -26.0, 1) < 0)
+		err++;
+
+	if (test_noise() < 0)
+		err++;
+
+	printf("detector: %u errors\n", err);
+
+	return err ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host benchmark: fir element time per sample, for the build time sample
+ * format, against the taps and the period (partition size), next to a direct
+ * form convolution.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_element_fir.h"
+#include "hlog.h"
+#include "test_element.h"
+
+#define RATE		48000
+#define RUN_NS		200000000ULL	/* per configuration */
+
+static uint32_t seed = 1;
+static volatile float direct_out;
+
+static float noise(void)
+{
+	seed = seed * 1664525 + 1013904223;
+
+	return (float)((double)(int32_t)seed / 2147483648.0);
+}
+
+/* Mono, in ns per sample, or 0 on error */
+static double bench(unsigned int period, unsigned int taps)
+{
+	struct test_element t;
+	uint64_t start, elapsed;
+	unsigned int n;
+	float *coef;
+	int i;
+
+	coef = malloc(taps * sizeof(float));
+	if (!coef)
+		return 0.0;
+
+	for (i = 0; i < taps; i++)
+		coef[i] = noise() / taps;
+
+	t.config.type = AUDIO_ELEMENT_FIR;
+	t.config.inputs = 1;
+	t.config.outputs = 1;
+	t.config.period = period;
+	t.config.sample_rate = RATE;
+	t.config.u.fir.taps = taps;
+	t.config.u.fir.filters = 1;
+	t.config.u.fir.coef = coef;
+
+	if (test_element_init(&t, 2, fir_element_size, fir_element_init) < 0) {
+		free(coef);
+		return 0.0;
+	}
+
+	/* input buffer storage, written once */
+	for (i = 0; i < 2 * period; i++)
+		t.storage[i] = audio_double_to_sample(0.5 * noise());
+
+	start = test_time_ns();
+	n = 0;
+
+	do {
+		for (i = 0; i < 64; i++)
+			test_element_run(&t);
+
+		n += 64;
+
+		elapsed = test_time_ns() - start;
+	} while (elapsed < RUN_NS);
+
+	test_element_exit(&t);
+	free(coef);
+
+	return (double)elapsed / ((uint64_t)n * period);
+}
+
+/* Direct form, single precision, in ns per sample */
+static double bench_direct(unsigned int taps)
+{
+	uint64_t start, elapsed;
+	float *coef, *x, y = 0.0f;
+	unsigned int n = 0, len = 2 * taps, i, k;
+
+	coef = malloc(taps * sizeof(float));
+	x = malloc(len * sizeof(float));
+	if (!coef || !x) {
+		free(coef);
+		free(x);
+		return 0.0;
+	}
+
+	for (i = 0; i < taps; i++) {
+		coef[i] = noise() / taps;
+		x[i] = x[taps + i] = noise();
+	}
+
+	start = test_time_ns();
+
+	do {
+		for (i = 0; i < 64; i++, n++)
+			for (k = 0; k < taps; k++)
+				y += coef[k] * x[(n % taps) + taps - k];
+
+		elapsed = test_time_ns() - start;
+	} while (elapsed < RUN_NS);
+
+	direct_out = y;
+
+	free(coef);
+	free(x);
+
+	return (double)elapsed / n;
+}
+
+int main(void)
+{
+	static const unsigned int period[] = {8, 32, 128};
+	static const unsigned int taps[] = {256, 1024, 4096, 8192};
+	unsigned int p, n;
+
+	hlog_level_config_set(LOG_ERR);
+
+	for (n = 0; n < sizeof(taps) / sizeof(taps[0]); n++) {
+		for (p = 0; p < sizeof(period) / sizeof(period[0]); p++)
+			printf("%s: period %3u, %4u taps: %7.2f ns/sample\n",
+			       AUDIO_SAMPLE_FORMAT_NAME, period[p], taps[n], bench(period[p], taps[n]));
+
+		printf("direct form: %4u taps: %7.2f ns/sample\n", taps[n], bench_direct(taps[n]));
+	}
+
+	return 0;
+}
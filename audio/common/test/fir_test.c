@@ -0,0 +1,140 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: fir element, for the build time sample format.
+ *
+ * Covers the accuracy against a direct form convolution in double precision,
+ * for filters shorter than, equal to and longer than one partition (period),
+ * a filter per channel or shared by all the channels.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_element_fir.h"
+#include "hlog.h"
+#include "test_element.h"
+
+#define RATE		48000
+#define CHANNELS	2
+#define SAMPLES		8192	/* per configuration */
+
+#define ERROR_MAX_DB	-110.0	/* single precision processing, all sample formats */
+
+static uint32_t seed = 1;
+
+static double noise(void)
+{
+	seed = seed * 1664525 + 1013904223;
+
+	return (double)(int32_t)seed / 2147483648.0;
+}
+
+/* Output error power relative to the output power, in dB, or 0 on error */
+static double accuracy(unsigned int period, unsigned int taps, unsigned int filters)
+{
+	struct test_element t;
+	float *coef;
+	double *x, y, err = 0.0, ref = 0.0;
+	unsigned int c, f, k, n, i;
+
+	coef = malloc(filters * taps * sizeof(float));
+	x = malloc(CHANNELS * SAMPLES * sizeof(double));
+	if (!coef || !x)
+		goto err_alloc;
+
+	/* decaying noise, as a reverb impulse response */
+	for (f = 0; f < filters; f++)
+		for (k = 0; k < taps; k++)
+			coef[f * taps + k] = noise() * exp(-4.0 * k / taps) / sqrt(taps);
+
+	t.config.type = AUDIO_ELEMENT_FIR;
+	t.config.inputs = CHANNELS;
+	t.config.outputs = CHANNELS;
+	t.config.period = period;
+	t.config.sample_rate = RATE;
+	t.config.u.fir.taps = taps;
+	t.config.u.fir.filters = filters;
+	t.config.u.fir.coef = coef;
+
+	if (fir_element_check_config(&t.config) < 0)
+		goto err_alloc;
+
+	if (test_element_init(&t, 2, fir_element_size, fir_element_init) < 0)
+		goto err_alloc;
+
+	for (n = 0; n < SAMPLES; n += period) {
+		for (c = 0; c < CHANNELS; c++) {
+			for (i = 0; i < period; i++) {
+				x[c * SAMPLES + n + i] = audio_sample_to_double(audio_double_to_sample(0.5 * noise()));
+				test_element_in(&t, c)[i] = audio_double_to_sample(x[c * SAMPLES + n + i]);
+			}
+		}
+
+		if (test_element_run(&t) < 0)
+			goto err;
+
+		for (c = 0; c < CHANNELS; c++) {
+			f = (filters == 1) ? 0 : c;
+
+			for (i = 0; i < period; i++) {
+				y = 0.0;
+				for (k = 0; (k < taps) && (k <= n + i); k++)
+					y += coef[f * taps + k] * x[c * SAMPLES + n + i - k];
+
+				err += pow(audio_sample_to_double(test_element_out(&t, c)[i]) - y, 2);
+				ref += y * y;
+			}
+		}
+	}
+
+	test_element_exit(&t);
+	free(x);
+	free(coef);
+
+	return 10.0 * log10(err / ref);
+
+err:
+	test_element_exit(&t);
+
+err_alloc:
+	free(x);
+	free(coef);
+
+	return 0.0;
+}
+
+int main(void)
+{
+	static const unsigned int period[] = {2, 8, 32, 256};
+	static const unsigned int taps[] = {1, 7, 32, 100, 1024, 4096};
+	unsigned int p, n, filters, err = 0;
+	double db;
+
+	hlog_level_config_set(LOG_ERR);
+
+	printf("fir: %s\n", AUDIO_SAMPLE_FORMAT_NAME);
+
+	for (p = 0; p < sizeof(period) / sizeof(period[0]); p++) {
+		for (n = 0; n < sizeof(taps) / sizeof(taps[0]); n++) {
+			for (filters = 1; filters <= CHANNELS; filters += CHANNELS - 1) {
+				db = accuracy(period[p], taps[n], filters);
+
+				if (db > ERROR_MAX_DB) {
+					printf("period %u, %u taps, %u filters: error %.1f dB (max %.1f dB)\n",
+					       period[p], taps[n], filters, db, ERROR_MAX_DB);
+					err++;
+				}
+			}
+		}
+	}
+
+	printf("fir: %u errors\n", err);
+
+	return err ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_LIMITS_H_
+#define _HOST_LIMITS_H_
+
+#include <limits.h>
+
+#endif /* #ifndef _HOST_LIMITS_H_ */
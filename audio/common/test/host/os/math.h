@@ -0,0 +1,11 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_MATH_H_
+#define _HOST_MATH_H_
+
+#include <math.h>
+
+#endif /* #ifndef _HOST_MATH_H_ */
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_SEMAPHORE_H_
+#define _HOST_SEMAPHORE_H_
+
+#include <errno.h>
+#include <semaphore.h>
+#include <time.h>
+
+#include "os/limits.h"
+#include "os/stdint.h"
+
+#define OS_SEM_TIMEOUT_MAX    UINT_MAX
+
+/* Ignored, there is no interrupt context on the host */
+#define OS_SEM_FLAGS_ISR_CONTEXT    (1 << 0)
+
+typedef sem_t os_sem_t;
+
+static inline int os_sem_init(os_sem_t *sem, uint32_t init_count)
+{
+    return sem_init(sem, 0, init_count);
+}
+
+static inline int os_sem_destroy(os_sem_t *sem)
+{
+    return sem_destroy(sem);
+}
+
+static inline int os_sem_give(os_sem_t *sem, uint32_t flags)
+{
+    return sem_post(sem);
+}
+
+static inline int os_sem_take(os_sem_t *sem, uint32_t flags, uint32_t timeout_ms)
+{
+    struct timespec ts;
+    int rc;
+
+    if (timeout_ms == OS_SEM_TIMEOUT_MAX) {
+        while ((rc = sem_wait(sem)) && (errno == EINTR))
+            ;
+
+        return rc;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    while ((rc = sem_timedwait(sem, &ts)) && (errno == EINTR))
+        ;
+
+    return rc;
+}
+
+#endif /* #ifndef _HOST_SEMAPHORE_H_ */
@@ -0,0 +1,11 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_STDBOOL_H_
+#define _HOST_STDBOOL_H_
+
+#include <stdbool.h>
+
+#endif /* #ifndef _HOST_STDBOOL_H_ */
@@ -0,0 +1,11 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_STDINT_H_
+#define _HOST_STDINT_H_
+
+#include <stdint.h>
+
+#endif /* #ifndef _HOST_STDINT_H_ */
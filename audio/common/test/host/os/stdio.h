@@ -0,0 +1,29 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_STDIO_H_
+#define _HOST_STDIO_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+
+static inline int os_printf(const char *fmt_s, ...)
+{
+    int rc;
+    va_list ap;
+
+    va_start(ap, fmt_s);
+    rc = vprintf(fmt_s, ap);
+    va_end(ap);
+
+    return rc;
+}
+
+static inline int os_vprintf(const char *fmt_s, va_list ap)
+{
+    return vprintf(fmt_s, ap);
+}
+
+#endif /* #ifndef _HOST_STDIO_H_ */
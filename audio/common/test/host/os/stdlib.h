@@ -0,0 +1,21 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_STDLIB_H_
+#define _HOST_STDLIB_H_
+
+#include <stdlib.h>
+
+static inline void *os_malloc(size_t size)
+{
+	return malloc(size);
+}
+
+static inline void os_free(void *ptr)
+{
+	free(ptr);
+}
+
+#endif /* #ifndef _HOST_STDLIB_H_ */
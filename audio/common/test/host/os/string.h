@@ -0,0 +1,11 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_STRING_H_
+#define _HOST_STRING_H_
+
+#include <string.h>
+
+#endif /* #ifndef _HOST_STRING_H_ */
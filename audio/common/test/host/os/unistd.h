@@ -0,0 +1,20 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_UNISTD_H_
+#define _HOST_UNISTD_H_
+
+#include <time.h>
+
+#include "os/stdint.h"
+
+static inline int os_msleep(int32_t msec)
+{
+    struct timespec ts = {msec / 1000, (msec % 1000) * 1000000};
+
+    return nanosleep(&ts, NULL);
+}
+
+#endif /* #ifndef _HOST_UNISTD_H_ */
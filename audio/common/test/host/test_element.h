@@ -0,0 +1,121 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef _HOST_TEST_ELEMENT_H_
+#define _HOST_TEST_ELEMENT_H_
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "audio_element.h"
+
+#define TEST_ELEMENT_MAX_BUFFERS	32
+
+/*
+ * Element under test, with its own input and output buffers. The caller
+ * fills the configuration (except the buffer indexes), then writes the
+ * inputs, runs the element and reads the outputs, one period at a time.
+ */
+struct test_element {
+	struct audio_element element;
+	struct audio_element_config config;
+	struct audio_buffer buffer[TEST_ELEMENT_MAX_BUFFERS];
+	audio_sample_t *storage;
+	bool outputs;	/* output periods not consumed yet */
+};
+
+/* Buffers of periods (power of two) periods, periods never wrap */
+static inline int test_element_init(struct test_element *t, unsigned int periods,
+				    unsigned int (*size)(struct audio_element_config *),
+				    int (*init)(struct audio_element *, struct audio_element_config *, struct audio_buffer *))
+{
+	unsigned int buffers = t->config.inputs + t->config.outputs;
+	unsigned int len = periods * t->config.period;
+	int i;
+
+	if (buffers > TEST_ELEMENT_MAX_BUFFERS)
+		return -1;
+
+	t->storage = calloc(buffers * len, sizeof(audio_sample_t));
+	if (!t->storage)
+		return -1;
+
+	for (i = 0; i < buffers; i++)
+		audio_buf_init(&t->buffer[i], t->storage + i * len, len);
+
+	for (i = 0; i < t->config.inputs; i++)
+		t->config.input[i] = i;
+
+	for (i = 0; i < t->config.outputs; i++)
+		t->config.output[i] = t->config.inputs + i;
+
+	t->outputs = false;
+
+	t->element.type = t->config.type;
+	t->element.period = t->config.period;
+	t->element.sample_rate = t->config.sample_rate;
+	t->element.data = calloc(1, size(&t->config));
+	if (!t->element.data)
+		goto err;
+
+	if (init(&t->element, &t->config, t->buffer) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	free(t->element.data);
+	free(t->storage);
+
+	return -1;
+}
+
+static inline void test_element_exit(struct test_element *t)
+{
+	if (t->element.exit)
+		t->element.exit(&t->element);
+
+	free(t->element.data);
+	free(t->storage);
+}
+
+/* Input period write address, the period is committed by test_element_run() */
+static inline audio_sample_t *test_element_in(struct test_element *t, unsigned int input)
+{
+	return audio_buf_write_addr(&t->buffer[input], 0);
+}
+
+/* Output period read address, valid until the next test_element_run() */
+static inline audio_sample_t *test_element_out(struct test_element *t, unsigned int output)
+{
+	return audio_buf_read_addr(&t->buffer[t->config.inputs + output], 0);
+}
+
+/* Consumes the previous output periods, commits one period to all inputs and runs the element */
+static inline int test_element_run(struct test_element *t)
+{
+	int i;
+
+	for (i = 0; (i < t->config.outputs) && t->outputs; i++)
+		audio_buf_read_update(&t->buffer[t->config.inputs + i], t->config.period);
+
+	for (i = 0; i < t->config.inputs; i++)
+		audio_buf_write_update(&t->buffer[i], t->config.period);
+
+	t->outputs = true;
+
+	return t->element.run(&t->element);
+}
+
+static inline uint64_t test_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* _HOST_TEST_ELEMENT_H_ */
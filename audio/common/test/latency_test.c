@@ -0,0 +1,242 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: latency element, for the build time sample format.
+ *
+ * The element output is looped back to its input through a known delay
+ * (integer, or fractional with linear interpolation), an attenuation and
+ * noise. Covers the measured latency against the delay for several periods,
+ * from one period up to the max latency, and the failed measurements without
+ * loopback.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_element_latency.h"
+#include "hlog.h"
+#include "hrpn_ctrl.h"
+#include "mailbox.h"
+#include "test_element.h"
+
+#define RATE		48000
+#define INTERVAL_MS	200
+#define MAX_LATENCY	4800		/* samples */
+#define MEASUREMENTS	5
+#define GAIN		0.5		/* loopback attenuation */
+#define HISTORY		8192		/* output samples kept, power of 2 */
+#define ERROR_MAX	0.01		/* samples, integer delays */
+#define ERROR_MAX_FRAC	0.2		/* samples, fractional delays (parabolic peak interpolation) */
+
+struct latency_test {
+	struct test_element t;
+	struct mailbox m;
+	struct hrpn_resp_audio_element_latency resp;
+	double history[HISTORY];	/* output samples, by time */
+	unsigned long time;		/* samples since the element start */
+	uint32_t seed;
+};
+
+static int latency_init(struct latency_test *l, unsigned int period)
+{
+	struct test_element *t = &l->t;
+
+	t->config.type = AUDIO_ELEMENT_LATENCY;
+	t->config.inputs = 1;
+	t->config.outputs = 1;
+	t->config.period = period;
+	t->config.sample_rate = RATE;
+	t->config.u.latency.interval_ms = INTERVAL_MS;
+	t->config.u.latency.max_latency = MAX_LATENCY;
+	t->config.u.latency.amplitude = 0.0;
+
+	if (latency_element_check_config(&t->config) < 0)
+		return -1;
+
+	memset(l->history, 0, sizeof(l->history));
+	l->m.resp = &l->resp;
+	l->time = 0;
+	l->seed = 1;
+
+	return test_element_init(t, 2, latency_element_size, latency_element_init);
+}
+
+/* Output at time n - delay, interpolated, for delay at least one period */
+static double loopback(struct latency_test *l, unsigned long n, double delay)
+{
+	double d = floor(delay), frac = delay - d, x0, x1;
+
+	if (n < d + 1)
+		return 0.0;
+
+	x0 = l->history[(n - (unsigned long)d) & (HISTORY - 1)];
+	x1 = l->history[(n - (unsigned long)d - 1) & (HISTORY - 1)];
+
+	return GAIN * ((1.0 - frac) * x0 + frac * x1);
+}
+
+/* Runs the element for the measurements, with its output looped back if delay is not negative */
+static int latency_run(struct latency_test *l, double delay, double noise)
+{
+	unsigned int period = l->t.config.period;
+	unsigned long end = (unsigned long)MEASUREMENTS * INTERVAL_MS * RATE / 1000 + MAX_LATENCY + 2048;
+	audio_sample_t *in, *out;
+	double x;
+	int i;
+
+	while (l->time < end) {
+		in = test_element_in(&l->t, 0);
+
+		for (i = 0; i < period; i++) {
+			x = (delay >= 0.0) ? loopback(l, l->time + i, delay) : 0.0;
+
+			if (noise) {
+				l->seed = l->seed * 1664525 + 1013904223;
+				x += sqrt(3.0) * pow(10.0, noise / 20.0) * ((double)(int32_t)l->seed / 2147483648.0);
+			}
+
+			in[i] = audio_double_to_sample(x);
+		}
+
+		if (test_element_run(&l->t) < 0)
+			return -1;
+
+		out = test_element_out(&l->t, 0);
+
+		for (i = 0; i < period; i++)
+			l->history[(l->time + i) & (HISTORY - 1)] = audio_sample_to_double(out[i]);
+
+		l->time += period;
+	}
+
+	return 0;
+}
+
+static int latency_read(struct latency_test *l)
+{
+	struct hrpn_cmd_audio_element_latency cmd;
+
+	cmd.u.read.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_LATENCY_READ;
+
+	if ((latency_element_ctrl(&l->t.element, &cmd, sizeof(cmd.u.read), &l->m) < 0) ||
+	    (l->resp.status != HRPN_RESP_STATUS_SUCCESS))
+		return -1;
+
+	return 0;
+}
+
+/* All the measurements succeed, min and max within the error of the delay */
+static int test_delay(unsigned int period, double delay, double noise)
+{
+	double error = (delay == floor(delay)) ? ERROR_MAX : ERROR_MAX_FRAC;
+	double min, max, last;
+	struct latency_test *l;
+	int err = 0;
+
+	/* large, keep it off the stack */
+	l = calloc(1, sizeof(*l));
+	if (!l)
+		return -1;
+
+	if (latency_init(l, period) < 0) {
+		free(l);
+		return -1;
+	}
+
+	if ((latency_run(l, delay, noise) < 0) || (latency_read(l) < 0)) {
+		err++;
+		goto out;
+	}
+
+	min = l->resp.min * (double)RATE / 1000000000.0;
+	max = l->resp.max * (double)RATE / 1000000000.0;
+	last = l->resp.last / 256.0;
+
+	printf("period %u, delay %.2f, noise %.0f dBFS: %u measurements, %u failures, min %.3f, max %.3f, last %.3f\n",
+	       period, delay, noise, l->resp.measurements, l->resp.failures, min, max, last);
+
+	/* the ns results are truncated, up to one ns */
+	if ((l->resp.measurements != MEASUREMENTS) || l->resp.failures ||
+	    (fabs(min - delay) > error + RATE / 1e9) || (fabs(max - delay) > error + RATE / 1e9) ||
+	    (fabs(last - delay) > error + 1.0 / 256))
+		err++;
+
+out:
+	test_element_exit(&l->t);
+	free(l);
+
+	return err ? -1 : 0;
+}
+
+/* Without loopback, in noise: all the measurements fail */
+static int test_no_loopback(void)
+{
+	struct latency_test *l;
+	int err = 0;
+
+	l = calloc(1, sizeof(*l));
+	if (!l)
+		return -1;
+
+	if (latency_init(l, 32) < 0) {
+		free(l);
+		return -1;
+	}
+
+	if ((latency_run(l, -1.0, -40.0) < 0) || (latency_read(l) < 0)) {
+		err++;
+		goto out;
+	}
+
+	printf("no loopback: %u measurements, %u failures, last %d\n",
+	       l->resp.measurements, l->resp.failures, l->resp.last);
+
+	if (l->resp.measurements || (l->resp.failures != MEASUREMENTS) || (l->resp.last != -1))
+		err++;
+
+out:
+	test_element_exit(&l->t);
+	free(l);
+
+	return err ? -1 : 0;
+}
+
+int main(void)
+{
+	static const unsigned int period[] = {1, 8, 32, 128};
+	static const double delay[] = {1003.0, 1003.25, 1003.5, 2500.75};
+	unsigned int p, d, err = 0;
+
+	hlog_level_config_set(LOG_ERR);
+
+	printf("latency: %s\n", AUDIO_SAMPLE_FORMAT_NAME);
+
+	for (p = 0; p < sizeof(period) / sizeof(period[0]); p++) {
+		/* shortest loopback, one period */
+		if (test_delay(period[p], period[p], 0.0) < 0)
+			err++;
+
+		for (d = 0; d < sizeof(delay) / sizeof(delay[0]); d++)
+			if (test_delay(period[p], delay[d], 0.0) < 0)
+				err++;
+	}
+
+	if (test_delay(32, 1003.25, -40.0) < 0)
+		err++;
+
+	if (test_delay(32, MAX_LATENCY, -40.0) < 0)
+		err++;
+
+	if (test_no_loopback() < 0)
+		err++;
+
+	printf("latency: %u errors\n", err);
+
+	return err ? 1 : 0;
+}
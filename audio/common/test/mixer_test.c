@@ -0,0 +1,335 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: mixer element, for the build time sample format.
+ *
+ * Covers the gain ramp on update (starting from the previous gain, reaching
+ * the new one on the last sample of the period, for entries switched on and
+ * off), the int32 saturation, the updates while the pipeline is stopped and
+ * the updates from the control path while the data path runs (a second
+ * thread): with constant inputs the outputs never step, each sample moves at
+ * most by the largest ramp increment.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_element_mixer.h"
+#include "hlog.h"
+#include "hrpn_ctrl.h"
+#include "test_element.h"
+
+#define RATE		48000
+#define PERIOD		32
+#define INPUTS		4
+#define OUTPUTS		2
+#define UPDATES		200000
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+#define TOLERANCE	(2.0 * PERIOD / (1 << 28))	/* Q28 ramp increment truncation */
+#elif defined(AUDIO_SAMPLE_FORMAT_FLOAT)
+#define TOLERANCE	1e-6
+#else
+#define TOLERANCE	1e-12
+#endif
+
+struct mixer_test {
+	struct test_element t;
+	bool stop;
+	unsigned int periods;
+	unsigned int errors;
+};
+
+/* Constant input values */
+static double input_value(unsigned int input)
+{
+	return 0.1 * (input + 1);
+}
+
+static int mixer_init(struct test_element *t, struct hrpn_audio_mixer_gain *gain, unsigned int gains)
+{
+	int i, j;
+
+	t->config.type = AUDIO_ELEMENT_MIXER;
+	t->config.inputs = INPUTS;
+	t->config.outputs = OUTPUTS;
+	t->config.period = PERIOD;
+	t->config.sample_rate = RATE;
+	t->config.u.mixer.gains = gains;
+	t->config.u.mixer.gain = gain;
+
+	if (mixer_element_check_config(&t->config) < 0)
+		return -1;
+
+	if (test_element_init(t, 2, mixer_element_size, mixer_element_init) < 0)
+		return -1;
+
+	/* both periods of the input buffers storage */
+	for (i = 0; i < INPUTS; i++)
+		for (j = 0; j < 2 * PERIOD; j++)
+			t->storage[i * 2 * PERIOD + j] = audio_double_to_sample(input_value(i));
+
+	return 0;
+}
+
+static int mixer_set(struct test_element *t, unsigned int input, unsigned int output, double gain)
+{
+	struct hrpn_cmd_audio_element_mixer cmd;
+
+	cmd.u.set.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_MIXER_SET;
+	cmd.u.set.gain.input = input;
+	cmd.u.set.gain.output = output;
+	cmd.u.set.gain.gain = gain;
+
+	return mixer_element_ctrl(&t->element, &cmd, sizeof(cmd.u.set), NULL);
+}
+
+static double out_value(struct test_element *t, unsigned int output, unsigned int i)
+{
+	return audio_sample_to_double(test_element_out(t, output)[i]);
+}
+
+/*
+ * Ramps of an entry from "from" to "to", alone on its output: starts one
+ * increment away from the previous gain, ends on the new gain.
+ */
+static int test_ramp(double from, double to)
+{
+	struct hrpn_audio_mixer_gain gain = {1, 0, from};
+	struct test_element t;
+	double x = input_value(1), expected;
+	int i, err = 0;
+
+	if (mixer_init(&t, &gain, from ? 1 : 0) < 0)
+		return -1;
+
+	if ((test_element_run(&t) < 0) || (mixer_set(&t, 1, 0, to) < 0) || (test_element_run(&t) < 0))
+		goto err;
+
+	for (i = 0; i < PERIOD; i++) {
+		expected = x * (from + (to - from) * (i + 1) / PERIOD);
+
+		if (fabs(out_value(&t, 0, i) - expected) > TOLERANCE) {
+			printf("ramp %.2f -> %.2f: sample %d: %.9f, expected %.9f\n", from, to, i, out_value(&t, 0, i), expected);
+			err++;
+		}
+	}
+
+	if (test_element_run(&t) < 0)
+		goto err;
+
+	for (i = 0; i < PERIOD; i++) {
+		if (fabs(out_value(&t, 0, i) - x * to) > TOLERANCE) {
+			printf("ramp %.2f -> %.2f end: sample %d: %.9f, expected %.9f\n", from, to, i, out_value(&t, 0, i), x * to);
+			err++;
+		}
+	}
+
+	test_element_exit(&t);
+
+	printf("ramp %.2f -> %.2f: %d errors\n", from, to, err);
+
+	return err ? -1 : 0;
+
+err:
+	test_element_exit(&t);
+
+	return -1;
+}
+
+/* Sum above full scale, saturated (int32) instead of wrapping around */
+static int test_saturation(void)
+{
+	struct hrpn_audio_mixer_gain gain[INPUTS];
+	struct test_element t;
+	double expected, v;
+	int i, err = 0;
+
+	for (i = 0; i < INPUTS; i++) {
+		gain[i].input = i;
+		gain[i].output = 0;
+		gain[i].gain = MIXER_GAIN_MAX;
+	}
+
+	if (mixer_init(&t, gain, INPUTS) < 0)
+		return -1;
+
+	if (test_element_run(&t) < 0)
+		goto err;
+
+#if defined(AUDIO_SAMPLE_FORMAT_INT32)
+	expected = 1.0;
+#else
+	expected = 0.0;
+	for (i = 0; i < INPUTS; i++)
+		expected += MIXER_GAIN_MAX * input_value(i);
+#endif
+
+	v = out_value(&t, 0, 0);
+
+	for (i = 0; i < PERIOD; i++)
+		if (fabs(out_value(&t, 0, i) - expected) > 1e-6)
+			err++;
+
+	test_element_exit(&t);
+
+	printf("saturation: %.6f, expected %.6f, %d errors\n", v, expected, err);
+
+	return err ? -1 : 0;
+
+err:
+	test_element_exit(&t);
+
+	return -1;
+}
+
+/* Updates without any run in between all succeed, the first run ramps to the last one */
+static int test_stopped(void)
+{
+	struct test_element t;
+	double expected = 0.0;
+	int i, err = 0;
+
+	if (mixer_init(&t, NULL, 0) < 0)
+		return -1;
+
+	for (i = 0; i < 1000; i++)
+		if (mixer_set(&t, i % INPUTS, 0, (i % 7) / 7.0) < 0)
+			err++;
+
+	for (i = 1000 - INPUTS; i < 1000; i++)
+		expected += input_value(i % INPUTS) * (i % 7) / 7.0;
+
+	if ((test_element_run(&t) < 0) || (test_element_run(&t) < 0))
+		goto err;
+
+	if (fabs(out_value(&t, 0, 0) - expected) > 1e-6) {
+		printf("stopped: %.9f, expected %.9f\n", out_value(&t, 0, 0), expected);
+		err++;
+	}
+
+	test_element_exit(&t);
+
+	printf("stopped: %d errors\n", err);
+
+	return err ? -1 : 0;
+
+err:
+	test_element_exit(&t);
+
+	return -1;
+}
+
+static void *data_thread(void *arg)
+{
+	struct mixer_test *m = arg;
+	double last[OUTPUTS] = {0}, step = 0.0, v;
+	int o, i;
+
+	/* gains in [0, 1], all entries changing at once */
+	for (i = 0; i < INPUTS; i++)
+		step += input_value(i) / PERIOD;
+
+	while (!__atomic_load_n(&m->stop, __ATOMIC_ACQUIRE)) {
+		if (test_element_run(&m->t) < 0) {
+			m->errors++;
+			break;
+		}
+
+		for (o = 0; o < OUTPUTS; o++) {
+			for (i = 0; i < PERIOD; i++) {
+				v = out_value(&m->t, o, i);
+
+				if (fabs(v - last[o]) > step + 1e-6) {
+					printf("running: period %u, output %d, sample %d: step %.9f (max %.9f)\n",
+					       m->periods, o, i, v - last[o], step);
+					m->errors++;
+					return NULL;
+				}
+
+				last[o] = v;
+			}
+		}
+
+		m->periods++;
+	}
+
+	return NULL;
+}
+
+static int test_running(void)
+{
+	static const double gains[] = {0.0, 0.5, 1.0};
+	struct mixer_test m;
+	pthread_t thread;
+	unsigned int i, errors = 0;
+
+	if (mixer_init(&m.t, NULL, 0) < 0)
+		return -1;
+
+	m.stop = false;
+	m.periods = 0;
+	m.errors = 0;
+
+	if (pthread_create(&thread, NULL, data_thread, &m)) {
+		test_element_exit(&m.t);
+		return -1;
+	}
+
+	srand(1);
+
+	for (i = 0; i < UPDATES; i++)
+		if (mixer_set(&m.t, rand() % INPUTS, rand() % OUTPUTS, gains[rand() % 3]) < 0)
+			errors++;
+
+	__atomic_store_n(&m.stop, true, __ATOMIC_RELEASE);
+	pthread_join(thread, NULL);
+
+	errors += m.errors;
+
+	printf("running: %u updates, %u periods, %u errors\n", UPDATES, m.periods, errors);
+
+	test_element_exit(&m.t);
+
+	return errors ? -1 : 0;
+}
+
+int main(void)
+{
+	unsigned int err = 0;
+
+	hlog_level_config_set(LOG_ERR);
+
+	printf("mixer: %s\n", AUDIO_SAMPLE_FORMAT_NAME);
+
+	if (test_ramp(1.0, 0.25) < 0)
+		err++;
+
+	if (test_ramp(0.0, 1.0) < 0)
+		err++;
+
+	if (test_ramp(1.0, 0.0) < 0)
+		err++;
+
+	if (test_ramp(-2.0, 4.0) < 0)
+		err++;
+
+	if (test_saturation() < 0)
+		err++;
+
+	if (test_stopped() < 0)
+		err++;
+
+	if (test_running() < 0)
+		err++;
+
+	printf("mixer: %u errors\n", err);
+
+	return err ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: sine oscillator, for the build time sample format, against
+ * libm sin().
+ *
+ * Covers the samples accuracy (frequencies up to Nyquist, all the call
+ * lengths handled by the vector and tail paths, output added or written),
+ * and the phase drift and magnitude after a long run.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "audio_osc.h"
+
+#define RATE		48000
+#define AMPLITUDE	0.5
+#define SAMPLES		(1 << 20)	/* per frequency and call length */
+#define DRIFT_SAMPLES	(20 * 60 * RATE)	/* 20 minutes */
+
+#if defined(AUDIO_SAMPLE_FORMAT_FLOAT)
+#define ERROR_MAX	1e-7	/* float output rounding, 2^-24 */
+#else
+#define ERROR_MAX	1e-8
+#endif
+#define DRIFT_MAX	1e-6	/* radians */
+
+/* Expected sample n, phase reduced in long double precision */
+static double expected(double freq, double phase, unsigned long n)
+{
+	long double p = (long double)n * freq / RATE;
+
+	p -= floorl(p);
+
+	return AMPLITUDE * sin(phase + 2.0 * M_PI * (double)p);
+}
+
+static int test_accuracy(double freq, unsigned int len, bool add)
+{
+	audio_sample_t out[64];
+	struct audio_osc osc;
+	double phase = 0.3, e, max = 0.0, base = add ? 0.25 : 0.0;
+	unsigned long n = 0;
+	int i;
+
+	audio_osc_init(&osc, freq, RATE, phase);
+
+	while (n < SAMPLES) {
+		for (i = 0; i < len; i++)
+			out[i] = audio_double_to_sample(base);
+
+		audio_osc_generate(&osc, out, len, AMPLITUDE, add);
+
+		for (i = 0; i < len; i++, n++) {
+			e = fabs(audio_sample_to_double(out[i]) - base - expected(freq, phase, n));
+			if (e > max)
+				max = e;
+		}
+	}
+
+	if (max > ERROR_MAX) {
+		printf("accuracy: %.1f Hz, length %u%s: max error %.3g (max %.3g)\n",
+		       freq, len, add ? ", add" : "", max, ERROR_MAX);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Phase and magnitude of the phasor after a long run, at the end of each call */
+static int test_drift(double freq, unsigned int len)
+{
+	audio_sample_t out[64];
+	struct audio_osc osc;
+	long double p;
+	double drift, mag;
+	unsigned long n;
+
+	audio_osc_init(&osc, freq, RATE, 0.0);
+
+	for (n = 0; n < DRIFT_SAMPLES; n += len)
+		audio_osc_generate(&osc, out, len, AMPLITUDE, false);
+
+	p = (long double)n * freq / RATE;
+	p -= floorl(p);
+
+	drift = remainder(audio_osc_phase(&osc) - 2.0 * M_PI * (double)p, 2.0 * M_PI);
+	mag = hypot(osc.re[0], osc.im[0]);
+
+	printf("drift: %.1f Hz, length %u: %.3g rad, magnitude error %.3g after %lu samples\n",
+	       freq, len, drift, mag - 1.0, n);
+
+	if ((fabs(drift) > DRIFT_MAX) || (fabs(mag - 1.0) > 1e-12))
+		return -1;
+
+	return 0;
+}
+
+int main(void)
+{
+	static const double freq[] = {1.0, 440.0, 1000.3, 12345.6, 23999.0};
+	static const unsigned int len[] = {1, 3, 32, 37};
+	unsigned int f, l, tests = 0, err = 0;
+
+	printf("osc: %s\n", AUDIO_SAMPLE_FORMAT_NAME);
+
+	for (f = 0; f < sizeof(freq) / sizeof(freq[0]); f++) {
+		for (l = 0; l < sizeof(len) / sizeof(len[0]); l++) {
+			if (test_accuracy(freq[f], len[l], false) < 0)
+				err++;
+
+			tests++;
+		}
+
+		if (test_accuracy(freq[f], 32, true) < 0)
+			err++;
+
+		tests++;
+	}
+
+	if (test_drift(997.0, 32) < 0)
+		err++;
+
+	if (test_drift(1000.3, 3) < 0)
+		err++;
+
+	tests += 2;
+
+	printf("osc: %u tests, %u errors\n", tests, err);
+
+	return err ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: routing element control updates. Connects and disconnects
+ * outputs from the control path (this thread), while the data path (a second
+ * thread) runs the element, as the control and data tasks do.
+ *
+ * Covers the updates never failing, each output period coming from a single
+ * input (or silence), the last update always applied by the next period, and
+ * the updates while the pipeline is stopped (data path not running).
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_element.h"
+#include "audio_element_routing.h"
+#include "hlog.h"
+#include "hrpn_ctrl.h"
+
+#define INPUTS		4
+#define OUTPUTS		4
+#define PERIOD		16
+#define UPDATES		200000
+#define STOPPED_UPDATES	1000
+
+struct routing_test {
+	struct audio_element element;
+	struct audio_element_config config;
+	struct audio_buffer buffer[INPUTS + OUTPUTS];
+	audio_sample_t storage[INPUTS + OUTPUTS][4 * PERIOD];
+	unsigned int map[OUTPUTS];	/* last update, input for each output (INPUTS if disconnected) */
+	bool stop;
+	unsigned int periods;
+	unsigned int errors;
+};
+
+/* Input samples value, unique per input, silence for the disconnected outputs */
+static audio_sample_t input_value(unsigned int input)
+{
+	return (audio_sample_t)(input + 1);
+}
+
+static int test_init(struct routing_test *t)
+{
+	int i;
+
+	t->config.type = AUDIO_ELEMENT_ROUTING;
+	t->config.inputs = INPUTS;
+	t->config.outputs = OUTPUTS;
+	t->config.period = PERIOD;
+	t->config.sample_rate = 48000;
+
+	/* input storage of two periods, so that outputs can be views of it */
+	for (i = 0; i < INPUTS; i++) {
+		t->config.input[i] = i;
+		audio_buf_init(&t->buffer[i], t->storage[i], 2 * PERIOD);
+	}
+
+	for (i = 0; i < OUTPUTS; i++) {
+		t->config.output[i] = INPUTS + i;
+		audio_buf_init(&t->buffer[INPUTS + i], t->storage[INPUTS + i], 4 * PERIOD);
+		t->map[i] = INPUTS;
+	}
+
+	t->element.type = AUDIO_ELEMENT_ROUTING;
+	t->element.period = PERIOD;
+	t->element.sample_rate = t->config.sample_rate;
+	t->element.data = malloc(routing_element_size(&t->config));
+	if (!t->element.data)
+		return -1;
+
+	t->stop = false;
+	t->periods = 0;
+	t->errors = 0;
+
+	return routing_element_init(&t->element, &t->config, t->buffer);
+}
+
+static void test_exit(struct routing_test *t)
+{
+	t->element.exit(&t->element);
+	free(t->element.data);
+}
+
+static int test_update(struct routing_test *t, unsigned int output, unsigned int input)
+{
+	struct hrpn_cmd_audio_element_routing cmd;
+	unsigned int len;
+
+	if (input < INPUTS) {
+		cmd.u.connect.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_ROUTING_CONNECT;
+		cmd.u.connect.output = output;
+		cmd.u.connect.input = input;
+		len = sizeof(cmd.u.connect);
+	} else {
+		cmd.u.disconnect.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_ROUTING_DISCONNECT;
+		cmd.u.disconnect.output = output;
+		len = sizeof(cmd.u.disconnect);
+	}
+
+	if (routing_element_ctrl(&t->element, &cmd, len, NULL) < 0) {
+		printf("update: output %u, input %u failed\n", output, input);
+		return -1;
+	}
+
+	t->map[output] = input;
+
+	return 0;
+}
+
+/*
+ * One period: fills the inputs, runs the element and checks each output
+ * period comes from a single input, or from the expected one if map is set.
+ */
+static int test_period(struct routing_test *t, unsigned int *map)
+{
+	audio_sample_t *out;
+	unsigned int input;
+	int i, j;
+
+	/* periods never wrap, buffer sizes are multiples of the period */
+	for (i = 0; i < INPUTS; i++) {
+		for (j = 0; j < PERIOD; j++)
+			*audio_buf_write_addr(&t->buffer[i], j) = input_value(i);
+
+		audio_buf_write_update(&t->buffer[i], PERIOD);
+	}
+
+	if (t->element.run(&t->element) < 0)
+		return -1;
+
+	for (i = 0; i < OUTPUTS; i++) {
+		out = audio_buf_read_addr(&t->buffer[INPUTS + i], 0);
+
+		if (out[0] == AUDIO_SAMPLE_SILENCE)
+			input = INPUTS;
+		else
+			input = (unsigned int)out[0] - 1;
+
+		if ((input > INPUTS) || (map && (input != map[i])))
+			goto err;
+
+		for (j = 1; j < PERIOD; j++)
+			if (out[j] != out[0])
+				goto err;
+
+		audio_buf_read_update(&t->buffer[INPUTS + i], PERIOD);
+	}
+
+	t->periods++;
+
+	return 0;
+
+err:
+	printf("period %u: output %d mixes inputs, or from the wrong input (expected %u)\n",
+	       t->periods, i, map ? map[i] : INPUTS);
+
+	return -1;
+}
+
+static void *data_thread(void *arg)
+{
+	struct routing_test *t = arg;
+
+	while (!__atomic_load_n(&t->stop, __ATOMIC_ACQUIRE)) {
+		if (test_period(t, NULL) < 0) {
+			t->errors++;
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Pipeline running: random updates from the control path, all succeed and
+ * the last one is applied by the next period.
+ */
+static int test_running(void)
+{
+	struct routing_test t;
+	pthread_t thread;
+	unsigned int i, errors = 0;
+
+	if (test_init(&t) < 0)
+		return -1;
+
+	if (pthread_create(&thread, NULL, data_thread, &t)) {
+		test_exit(&t);
+		return -1;
+	}
+
+	srand(1);
+
+	for (i = 0; i < UPDATES; i++)
+		if (test_update(&t, rand() % OUTPUTS, rand() % (INPUTS + 1)) < 0)
+			errors++;
+
+	__atomic_store_n(&t.stop, true, __ATOMIC_RELEASE);
+	pthread_join(thread, NULL);
+
+	errors += t.errors;
+
+	if (test_period(&t, t.map) < 0)
+		errors++;
+
+	printf("running: %u updates, %u periods, %u errors\n", UPDATES, t.periods, errors);
+
+	test_exit(&t);
+
+	return errors ? -1 : 0;
+}
+
+/*
+ * Pipeline stopped: the data path never takes the updated tables, updates
+ * still succeed and the last one is applied by the first period.
+ */
+static int test_stopped(void)
+{
+	struct routing_test t;
+	unsigned int i, errors = 0;
+
+	if (test_init(&t) < 0)
+		return -1;
+
+	for (i = 0; i < STOPPED_UPDATES; i++)
+		if (test_update(&t, i % OUTPUTS, (i / OUTPUTS) % (INPUTS + 1)) < 0)
+			errors++;
+
+	if (test_period(&t, t.map) < 0)
+		errors++;
+
+	/* and again, once the data path took the table */
+	for (i = 0; i < OUTPUTS; i++)
+		if (test_update(&t, i, (i + 1) % (INPUTS + 1)) < 0)
+			errors++;
+
+	if (test_period(&t, t.map) < 0)
+		errors++;
+
+	printf("stopped: %u updates, %u errors\n", STOPPED_UPDATES + OUTPUTS, errors);
+
+	test_exit(&t);
+
+	return errors ? -1 : 0;
+}
+
+int main(void)
+{
+	unsigned int err = 0;
+
+	hlog_level_config_set(LOG_ERR);
+
+	if (test_stopped() < 0)
+		err++;
+
+	if (test_running() < 0)
+		err++;
+
+	printf("routing: %u errors\n", err);
+
+	return err ? 1 : 0;
+}
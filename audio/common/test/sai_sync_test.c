@@ -0,0 +1,343 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host test: sai fifo level synchronization, against a simulated fifo. The
+ * sai drains (tx) or fills (rx) the fifo at its own rate, the pipeline runs
+ * once per period and transfers the frames returned by sai_sync_frames(), or
+ * sai_sync_recover() on fifo xrun, as the sai sink and source elements do.
+ *
+ * Covers the sai clock drifting in both directions (none mode), an arbitrary
+ * start level with scheduling jitter (partial mode), and the recovery after
+ * a pipeline stall causing a fifo xrun (all modes).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sai_sync.h"
+
+#define FIFO_SIZE	64	/* 128 words sai fifo, two channels */
+#define PERIODS		20000
+#define RATE_ONE	(1 << 16)
+
+struct fifo {
+	struct sai_sync sync;
+	unsigned int period;
+	unsigned int level;	/* in frames */
+	unsigned int before;	/* level just before the last transfer, in frames */
+	unsigned int rate;	/* sai frames per period, Q16 */
+	unsigned int phase;	/* Q16 */
+	int jitter;		/* alternating scheduling jitter, in frames */
+	unsigned int xrun;	/* fifo xruns detected */
+	unsigned int failed;	/* recovery failures */
+};
+
+static const char *dir_name[] = {"rx", "tx"};
+
+static void fifo_init(struct fifo *f, unsigned int mode, bool tx, unsigned int period, unsigned int rate)
+{
+	sai_sync_init(&f->sync, mode, tx, period, FIFO_SIZE);
+
+	f->period = period;
+	f->rate = rate;
+	f->phase = 0;
+	f->jitter = 0;
+	f->xrun = 0;
+	f->failed = 0;
+
+	/* level after the previous transfer, at target before the next one */
+	if (tx)
+		f->level = f->sync.target + period;
+	else
+		f->level = f->sync.target - period;
+}
+
+/* Frames transferred by the sai since the previous pipeline run */
+static unsigned int fifo_sai_frames(struct fifo *f)
+{
+	unsigned int n;
+
+	f->phase += f->rate * f->period;
+	n = f->phase >> 16;
+	f->phase &= RATE_ONE - 1;
+
+	if (f->jitter) {
+		n += f->jitter;
+		f->jitter = -f->jitter;
+	}
+
+	return n;
+}
+
+static void fifo_xrun(struct fifo *f, bool xrun)
+{
+	if (!xrun) {
+		sai_sync_recovered(&f->sync);
+		return;
+	}
+
+	f->xrun++;
+
+	if (f->sync.recovering >= SAI_SYNC_RECOVERY_MAX)
+		f->failed++;
+}
+
+/* One period: the sai drains the fifo, then the pipeline writes to it (unless stalled) */
+static void fifo_tx_period(struct fifo *f, bool stalled)
+{
+	unsigned int drain, n, silence, skip;
+	bool xrun;
+
+	drain = fifo_sai_frames(f);
+	f->level = (drain < f->level) ? f->level - drain : 0;
+
+	if (stalled)
+		return;
+
+	f->before = f->level;
+	xrun = !f->level;
+
+	fifo_xrun(f, xrun);
+
+	if (xrun) {
+		n = sai_sync_recover(&f->sync, f->level, f->period, &silence, &skip);
+		n += silence;
+	} else {
+		n = sai_sync_frames(&f->sync, f->level, f->period);
+	}
+
+	f->level += n;
+}
+
+/* One period: the sai fills the fifo (dropping frames when full), then the pipeline reads from it (unless stalled) */
+static void fifo_rx_period(struct fifo *f, bool stalled)
+{
+	unsigned int fill, n, silence, skip;
+	bool xrun;
+
+	fill = fifo_sai_frames(f);
+	f->level = (f->level + fill < FIFO_SIZE) ? f->level + fill : FIFO_SIZE;
+
+	if (stalled)
+		return;
+
+	f->before = f->level;
+	xrun = (f->level >= FIFO_SIZE);
+
+	fifo_xrun(f, xrun);
+
+	if (xrun)
+		n = sai_sync_recover(&f->sync, f->level, f->period, &silence, &skip);
+	else
+		n = sai_sync_frames(&f->sync, f->level, f->period);
+
+	f->level -= (n < f->level) ? n : f->level;
+}
+
+static void fifo_period(struct fifo *f, bool stalled)
+{
+	if (f->sync.tx)
+		fifo_tx_period(f, stalled);
+	else
+		fifo_rx_period(f, stalled);
+}
+
+/* Fifo level just before the transfer, within the window around the target */
+static bool fifo_in_window(struct fifo *f, unsigned int margin)
+{
+	int error = (int)f->before - (int)f->sync.target;
+
+	return abs(error) <= (int)(f->sync.window + margin);
+}
+
+/*
+ * None mode, sai clock faster (rate > 1) or slower than the scheduling
+ * source: the level is kept in range and the drift is compensated, in a
+ * single direction, one frame at a time.
+ */
+static int test_drift(bool tx, unsigned int period, unsigned int rate)
+{
+	struct fifo f;
+	unsigned int compensated, other, drift;
+	int i;
+
+	fifo_init(&f, SAI_SYNC_NONE, tx, period, rate);
+
+	for (i = 0; i < PERIODS; i++) {
+		fifo_period(&f, false);
+
+		/* one frame per period of correction, plus the rounding of the drift */
+		if (!fifo_in_window(&f, 1) || f.xrun) {
+			printf("drift %s: period %u, rate 0x%x: level %u out of range (target %u) at period %d\n",
+			       dir_name[tx], period, rate, f.before, f.sync.target, i);
+			return -1;
+		}
+	}
+
+	drift = ((unsigned long long)abs((int)rate - RATE_ONE) * period * PERIODS) >> 16;
+
+	/* a faster sai drains (tx) or fills (rx) the fifo faster, frames are repeated (tx) or dropped (rx) */
+	if ((rate > RATE_ONE) == tx) {
+		compensated = f.sync.repeated;
+		other = f.sync.dropped;
+	} else {
+		compensated = f.sync.dropped;
+		other = f.sync.repeated;
+	}
+
+	if (other || (abs((int)compensated - (int)drift) > (int)(f.sync.window + 2))) {
+		printf("drift %s: period %u, rate 0x%x: compensated %u/%u frames, expected %u/0\n",
+		       dir_name[tx], period, rate, compensated, other, drift);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Partial mode, arbitrary level (above or below the target) at start: brought
+ * back to target in one period (tx, a level above target by more than a
+ * period takes more, frames can only be dropped from the input), afterwards
+ * the scheduling jitter is tolerated without any compensation.
+ */
+static int test_offset(bool tx, unsigned int period, int offset)
+{
+	struct fifo f;
+	unsigned int compensated, expected, settle = 1;
+	int i;
+
+	fifo_init(&f, SAI_SYNC_PARTIAL, tx, period, RATE_ONE);
+
+	/* start level out of the fifo range */
+	if (((int)f.sync.target + offset <= 0) || (!tx && ((int)f.sync.target + offset < (int)period)))
+		return 0;
+
+	/* level after the previous transfer, target + offset before the next one */
+	if (tx)
+		f.level = f.sync.target + offset + period;
+	else
+		f.level = f.sync.target + offset - period;
+
+	if (tx && (offset > 0))
+		settle = (offset + period - 1) / period;
+
+	for (i = 0; i < PERIODS; i++) {
+		fifo_period(&f, false);
+
+		/* the first transfers compensate the offset */
+		if (((i >= settle) && !fifo_in_window(&f, 0)) || f.xrun) {
+			printf("offset %s: period %u, offset %d: level %u out of range (target %u) at period %d\n",
+			       dir_name[tx], period, offset, f.before, f.sync.target, i);
+			return -1;
+		}
+
+		if (i + 1 >= settle)
+			f.jitter = f.jitter ? f.jitter : SAI_SYNC_PARTIAL_WINDOW;
+	}
+
+	/* in multiple steps, the last one may stop in the window */
+	compensated = f.sync.dropped + f.sync.repeated;
+	expected = (abs(offset) > SAI_SYNC_PARTIAL_WINDOW) ? abs(offset) : 0;
+
+	if ((compensated > expected) || (compensated + (settle > 1 ? SAI_SYNC_PARTIAL_WINDOW : 0) < expected)) {
+		printf("offset %s: period %u, offset %d: compensated %u frames, expected %u\n",
+		       dir_name[tx], period, offset, compensated, expected);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Pipeline stalled long enough to empty (tx) or overflow (rx) the fifo: a
+ * single xrun, recovered in one period, then back to the target level.
+ */
+static int test_recovery(unsigned int mode, bool tx, unsigned int period)
+{
+	unsigned int stall = FIFO_SIZE / period + 1;
+	struct fifo f;
+	int i;
+
+	fifo_init(&f, mode, tx, period, RATE_ONE);
+
+	for (i = 0; i < 100; i++)
+		fifo_period(&f, false);
+
+	for (i = 0; i < stall; i++)
+		fifo_period(&f, true);
+
+	/* recovery period */
+	fifo_period(&f, false);
+
+	for (i = 0; i < 100; i++) {
+		fifo_period(&f, false);
+
+		if (!fifo_in_window(&f, 0))
+			break;
+	}
+
+	if ((i < 100) || (f.xrun != 1) || f.failed || (f.sync.recoveries != 1) || (f.sync.recovery_last != 1)) {
+		printf("recovery %s %s: period %u: level %u (target %u), xruns %u, recoveries %u, recovery time %u periods\n",
+		       sai_sync_mode_name(mode), dir_name[tx], period, f.before, f.sync.target, f.xrun,
+		       f.sync.recoveries, f.sync.recovery_last);
+		return -1;
+	}
+
+	/* tx, the fifo is refilled with silence up to the target */
+	if (tx && (f.sync.silence != f.sync.target)) {
+		printf("recovery %s tx: period %u: %u silence frames, expected %u\n",
+		       sai_sync_mode_name(mode), period, f.sync.silence, f.sync.target);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	static const unsigned int period[] = {1, 2, 4, 8, 16, 32};
+	static const unsigned int rate[] = {RATE_ONE + 655, RATE_ONE - 655, RATE_ONE + 13, RATE_ONE - 13};	/* +-1%, +-200ppm */
+	static const int offset[] = {-8, -2, 0, 2, 8};
+	unsigned int p, r, o, mode, tests = 0, err = 0;
+	int tx;
+
+	for (p = 0; p < sizeof(period) / sizeof(period[0]); p++) {
+		for (tx = 0; tx < 2; tx++) {
+			if (sai_sync_min_size(SAI_SYNC_NONE, period[p]) <= FIFO_SIZE) {
+				for (r = 0; r < sizeof(rate) / sizeof(rate[0]); r++) {
+					if (test_drift(tx, period[p], rate[r]))
+						err++;
+
+					tests++;
+				}
+			}
+
+			if (sai_sync_min_size(SAI_SYNC_PARTIAL, period[p]) <= FIFO_SIZE) {
+				for (o = 0; o < sizeof(offset) / sizeof(offset[0]); o++) {
+					if (test_offset(tx, period[p], offset[o]))
+						err++;
+
+					tests++;
+				}
+			}
+
+			for (mode = SAI_SYNC_FULL; mode < SAI_SYNC_MAX; mode++) {
+				if (sai_sync_min_size(mode, period[p]) > FIFO_SIZE)
+					continue;
+
+				if (test_recovery(mode, tx, period[p]))
+					err++;
+
+				tests++;
+			}
+		}
+	}
+
+	printf("sai sync: %u tests, %u errors\n", tests, err);
+
+	return err ? 1 : 0;
+}
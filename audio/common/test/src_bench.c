@@ -0,0 +1,222 @@
+/*
+ * Copyright 2022 NXP
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+/*
+ * Host benchmark: src element time per output sample and THD+N of a 15 kHz
+ * tone, for the build time sample format, against the filter taps.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_element_src.h"
+#include "hlog.h"
+#include "test_element.h"
+
+#define PERIOD		32
+#define FREQ		15000.0
+#define AMPLITUDE	0.5
+#define SETTLE		4096		/* output samples skipped before the THD+N */
+#define SAMPLES		48000		/* output samples, THD+N */
+#define RUN_NS		200000000ULL	/* timing, per configuration */
+
+struct src_bench {
+	struct test_element t;
+	unsigned int input_rate;
+	unsigned long in;		/* input samples written */
+	unsigned long periods;		/* output periods */
+	audio_sample_t *tone;		/* input tone, one second */
+};
+
+/* Input samples of the next period, the average input rate matching the output rate exactly */
+static unsigned int input_len(struct src_bench *b)
+{
+	unsigned int rate = b->t.config.sample_rate;
+
+	return ((b->periods + 1) * PERIOD * b->input_rate) / rate - (b->periods * PERIOD * b->input_rate) / rate;
+}
+
+/* Writes the input samples (the tone from its start, wrapping after one second) and runs the element */
+static int src_run(struct src_bench *b)
+{
+	struct test_element *t = &b->t;
+	unsigned int n = input_len(b), pos, len;
+
+	while (n) {
+		pos = b->in % b->input_rate;
+		len = (n < b->input_rate - pos) ? n : b->input_rate - pos;
+
+		audio_buf_write(&t->buffer[0], &b->tone[pos], len);
+
+		b->in += len;
+		n -= len;
+	}
+
+	if (b->periods)
+		audio_buf_read_update(&t->buffer[1], PERIOD);
+
+	b->periods++;
+
+	return t->element.run(&t->element);
+}
+
+static int src_init(struct src_bench *b, unsigned int input_rate, unsigned int output_rate, unsigned int taps)
+{
+	struct test_element *t = &b->t;
+	unsigned int i;
+
+	t->config.type = AUDIO_ELEMENT_SRC;
+	t->config.inputs = 1;
+	t->config.outputs = 1;
+	t->config.period = PERIOD;
+	t->config.sample_rate = output_rate;
+	t->config.u.src.input_rate = input_rate;
+	t->config.u.src.taps = taps;
+
+	if (src_element_check_config(&t->config) < 0)
+		return -1;
+
+	b->tone = malloc(input_rate * sizeof(audio_sample_t));
+	if (!b->tone)
+		return -1;
+
+	for (i = 0; i < input_rate; i++)
+		b->tone[i] = audio_double_to_sample(AMPLITUDE * sin(2.0 * M_PI * FREQ * i / input_rate));
+
+	b->input_rate = input_rate;
+	b->in = 0;
+	b->periods = 0;
+
+	/* input periods of up to AUDIO_SRC_MAX_RATIO * PERIOD samples */
+	if (test_element_init(t, 16, src_element_size, src_element_init) < 0) {
+		free(b->tone);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void src_exit(struct src_bench *b)
+{
+	test_element_exit(&b->t);
+	free(b->tone);
+}
+
+static unsigned int gcd(unsigned int a, unsigned int b)
+{
+	unsigned int r;
+
+	while (b) {
+		r = a % b;
+		a = b;
+		b = r;
+	}
+
+	return a;
+}
+
+/*
+ * Residual power, after removing the best fit tone and DC, relative to the
+ * tone power. Over a whole number of tone periods, the sine, cosine and DC
+ * are orthogonal and the fit is a projection.
+ */
+static double thd_n(double *y, unsigned int len, unsigned int rate)
+{
+	unsigned int cycle = rate / gcd((unsigned int)FREQ, rate);
+	double w = 2.0 * M_PI * FREQ / rate, a = 0.0, b = 0.0, c = 0.0, r = 0.0, e;
+	unsigned int i;
+
+	len -= len % cycle;
+
+	for (i = 0; i < len; i++) {
+		a += y[i] * cos(w * i);
+		b += y[i] * sin(w * i);
+		c += y[i];
+	}
+
+	a *= 2.0 / len;
+	b *= 2.0 / len;
+	c /= len;
+
+	for (i = 0; i < len; i++) {
+		e = y[i] - a * cos(w * i) - b * sin(w * i) - c;
+		r += e * e;
+	}
+
+	return 10.0 * log10(r / len / ((a * a + b * b) / 2.0));
+}
+
+static int bench(unsigned int input_rate, unsigned int output_rate, unsigned int taps, double *ns, double *db)
+{
+	struct src_bench b;
+	uint64_t start, elapsed;
+	unsigned long periods;
+	double *y;
+	int i, n;
+
+	y = malloc(SAMPLES * sizeof(double));
+	if (!y)
+		return -1;
+
+	if (src_init(&b, input_rate, output_rate, taps) < 0) {
+		free(y);
+		return -1;
+	}
+
+	for (n = 0; n < SETTLE / PERIOD; n++)
+		src_run(&b);
+
+	for (n = 0; n < SAMPLES / PERIOD; n++) {
+		src_run(&b);
+
+		for (i = 0; i < PERIOD; i++)
+			y[n * PERIOD + i] = audio_sample_to_double(test_element_out(&b.t, 0)[i]);
+	}
+
+	*db = thd_n(y, SAMPLES, output_rate);
+
+	periods = b.periods;
+	start = test_time_ns();
+
+	do {
+		for (n = 0; n < 64; n++)
+			src_run(&b);
+
+		elapsed = test_time_ns() - start;
+	} while (elapsed < RUN_NS);
+
+	*ns = (double)elapsed / ((b.periods - periods) * PERIOD);
+
+	src_exit(&b);
+	free(y);
+
+	return 0;
+}
+
+int main(void)
+{
+	static const unsigned int rate[][2] = {{44100, 48000}, {48000, 44100}, {44100, 47950}};
+	static const unsigned int taps[] = {8, 16, 32, 64};
+	double ns, db;
+	unsigned int r, n;
+
+	hlog_level_config_set(LOG_ERR);
+
+	for (r = 0; r < sizeof(rate) / sizeof(rate[0]); r++) {
+		for (n = 0; n < sizeof(taps) / sizeof(taps[0]); n++) {
+			if (bench(rate[r][0], rate[r][1], taps[n], &ns, &db) < 0) {
+				printf("%u -> %u Hz, %u taps: error\n", rate[r][0], rate[r][1], taps[n]);
+				return 1;
+			}
+
+			printf("%s: period %u, %u -> %u Hz, %2u taps: %6.2f ns/output sample, THD+N %6.1f dB\n",
+			       AUDIO_SAMPLE_FORMAT_NAME, PERIOD, rate[r][0], rate[r][1], taps[n], ns, db);
+		}
+	}
+
+	return 0;
+}
@@ -19,6 +19,9 @@
 #define main_task_PRIORITY   (configMAX_PRIORITIES - 3)
 #define data_task_PRIORITY   (configMAX_PRIORITIES - 2)
 
+/* Pipeline elements run on the data task, sized for the heaviest one (plus logging) */
+#define data_task_STACK_SIZE (configMINIMAL_STACK_SIZE + 300)
+
 static void hardware_setup(void)
 {
 	BOARD_InitMemory();
@@ -50,7 +53,7 @@ void main_task(void *pvParameters)
 	os_assert(context, "control initialization failed!");
 
 	xResult = xTaskCreate(data_task, "data_task",
-                        configMINIMAL_STACK_SIZE + 100, context,
+                        data_task_STACK_SIZE, context,
                         data_task_PRIORITY, NULL);
 	os_assert(xResult == pdPASS, "data task creation failed");
 
@@ -16,11 +16,23 @@
 #include "sai_clock_config.h"
 
 #include "audio_entry.h"
+#include "audio_worker.h"
 
 #define STACK_SIZE (640 + CONFIG_TEST_EXTRA_STACKSIZE)
 
-K_THREAD_STACK_DEFINE(data_stack, STACK_SIZE);
+/* Pipeline elements run on the data and worker threads, sized for the heaviest one (plus logging) */
+#define DATA_STACK_SIZE (2400 + CONFIG_TEST_EXTRA_STACKSIZE)
+
+#if (AUDIO_WORKERS > 0) && (!defined(CONFIG_SMP) || (CONFIG_MP_NUM_CPUS <= AUDIO_WORKERS))
+#error "audio workers require one cpu core each, in addition to the data thread one"
+#endif
+
+K_THREAD_STACK_DEFINE(data_stack, DATA_STACK_SIZE);
 K_THREAD_STACK_DEFINE(ctrl_stack, STACK_SIZE);
+#if AUDIO_WORKERS > 0
+K_THREAD_STACK_ARRAY_DEFINE(worker_stack, AUDIO_WORKERS, DATA_STACK_SIZE);
+static struct k_thread worker_thread[AUDIO_WORKERS];
+#endif
 
 static void hardware_setup(void)
 {
@@ -41,6 +53,34 @@ static void ctrl_task(void *context, void *p2, void *p3)
 	audio_control_loop(context);
 }
 
+static void worker_task(void *worker, void *p2, void *p3)
+{
+	audio_worker_loop(worker);
+}
+
+static void worker_setup(void)
+{
+#if AUDIO_WORKERS > 0
+	void *worker;
+	int i;
+
+	for (i = 0; i < AUDIO_WORKERS; i++) {
+		worker = audio_worker_init(i);
+		os_assert(worker, "worker initialization failed!");
+
+		k_thread_create(&worker_thread[i], worker_stack[i], DATA_STACK_SIZE,
+			worker_task, worker, NULL, NULL,
+			K_HIGHEST_THREAD_PRIO, 0, K_FOREVER);
+
+#ifdef CONFIG_SCHED_CPU_MASK
+		/* one worker per secondary core */
+		k_thread_cpu_pin(&worker_thread[i], i + 1);
+#endif
+		k_thread_start(&worker_thread[i]);
+	}
+#endif
+}
+
 void main(void)
 {
 	struct k_thread data_thread, ctrl_thread;
@@ -50,10 +90,12 @@ void main(void)
 
 	hardware_setup();
 
+	worker_setup();
+
 	context = audio_control_init();
 	os_assert(context, "control initialization failed!");
 
-	k_thread_create(&data_thread, data_stack, STACK_SIZE,
+	k_thread_create(&data_thread, data_stack, DATA_STACK_SIZE,
 		data_task, context, NULL, NULL,
 		K_HIGHEST_THREAD_PRIO, 0, K_NO_WAIT);
 
@@ -8,6 +8,7 @@
 #define _COMMON_CPU_H_
 
 #include "os/stdio.h"
+#include "os/stdint.h"
 
 #ifdef OS_ZEPHYR /* TODO: Implement cache invalidation with OS-independant code */
 #include <zephyr.h>
@@ -32,4 +33,23 @@ static inline void os_invd_icache_all()
     __asm volatile ("IC IALLUIS");
 }
 
+/* ARM generic timer (virtual) counter, used for execution time measurements */
+static inline uint64_t os_cpu_counter(void)
+{
+    uint64_t cnt;
+
+    __asm volatile ("isb; mrs %0, cntvct_el0" : "=r" (cnt) :: "memory");
+
+    return cnt;
+}
+
+static inline uint64_t os_cpu_counter_freq(void)
+{
+    uint64_t freq;
+
+    __asm volatile ("mrs %0, cntfrq_el0" : "=r" (freq));
+
+    return freq;
+}
+
 #endif /* #ifndef _COMMON_CPU_H_ */
@@ -21,6 +21,8 @@ enum {
 	HRPN_RESP_TYPE_AUDIO = 0x0110,
 
 	HRPN_CMD_TYPE_AUDIO_PIPELINE_DUMP = 0x200,
+	HRPN_CMD_TYPE_AUDIO_PIPELINE_PROFILE = 0x201,
+	HRPN_CMD_TYPE_AUDIO_PIPELINE_LOAD = 0x202,
 	HRPN_RESP_TYPE_AUDIO_PIPELINE = 0x2ff,
 
 	HRPN_CMD_TYPE_AUDIO_ELEMENT_DUMP = 0x300,
@@ -35,6 +37,18 @@ enum {
 	HRPN_CMD_TYPE_AUDIO_ELEMENT_PLL_ID = 0x452,
 	HRPN_RESP_TYPE_AUDIO_ELEMENT_PLL = 0x45f,
 
+	HRPN_CMD_TYPE_AUDIO_ELEMENT_BIQUAD_SET = 0x460,
+	HRPN_RESP_TYPE_AUDIO_ELEMENT_BIQUAD = 0x46f,
+
+	HRPN_CMD_TYPE_AUDIO_ELEMENT_MIXER_SET = 0x470,
+	HRPN_RESP_TYPE_AUDIO_ELEMENT_MIXER = 0x47f,
+
+	HRPN_CMD_TYPE_AUDIO_ELEMENT_DETECTOR_READ = 0x480,
+	HRPN_RESP_TYPE_AUDIO_ELEMENT_DETECTOR = 0x48f,
+
+	HRPN_CMD_TYPE_AUDIO_ELEMENT_LATENCY_READ = 0x490,
+	HRPN_RESP_TYPE_AUDIO_ELEMENT_LATENCY = 0x49f,
+
 	HRPN_CMD_TYPE_INDUSTRIAL = 0x500,
 	HRPN_CMD_TYPE_CAN_RUN = 0x580,
 	HRPN_CMD_TYPE_CAN_STOP,
@@ -69,10 +83,12 @@ struct hrpn_cmd_audio_run {
 	uint32_t id;
 	uint32_t frequency;
 	uint32_t period;
+	uint32_t instance;	/* concurrently running audio instance */
 };
 
 struct hrpn_cmd_audio_stop {
 	uint32_t type;
+	uint32_t instance;
 };
 
 struct hrpn_resp_audio {
@@ -133,6 +149,7 @@ struct hrpn_command {
 		struct hrpn_cmd_audio_run audio_run;
 		struct hrpn_cmd_audio_stop audio_stop;
 		struct hrpn_cmd_audio_pipeline audio_pipeline;
+		struct hrpn_cmd_audio_pipeline_load audio_pipeline_load;
 		struct hrpn_cmd_industrial_run industrial_run;
 		struct hrpn_cmd_industrial_stop industrial_stop;
 		struct hrpn_cmd_ethernet ethernet;
@@ -59,6 +59,130 @@ struct hrpn_cmd_audio_element_pll {
 	uint32_t pll_id;
 };
 
+/* Normalized biquad coefficients (a0 = 1):
+ * y[n] = b0 x[n] + b1 x[n - 1] + b2 x[n - 2] - a1 y[n - 1] - a2 y[n - 2]
+ */
+struct hrpn_audio_biquad_coef {
+	double b0;
+	double b1;
+	double b2;
+	double a1;
+	double a2;
+};
+
+#define HRPN_AUDIO_ELEMENT_BIQUAD_ALL_CHANNELS	0xffffffff
+
+struct hrpn_resp_audio_element_biquad {
+	uint32_t type;		/* command type */
+	uint32_t status;
+};
+
+struct hrpn_cmd_audio_element_biquad_set {
+	uint32_t type;		/* command type */
+	struct hrpn_cmd_audio_pipeline_id pipeline;
+	struct hrpn_cmd_audio_element_id element;
+	uint32_t channel;	/* element input/output, or all channels */
+	uint32_t section;
+	struct hrpn_audio_biquad_coef coef;
+};
+
+struct hrpn_cmd_audio_element_biquad {
+	union {
+		struct hrpn_cmd_audio_element_common common;
+		struct hrpn_cmd_audio_element_biquad_set set;
+	} u;
+};
+
+/* Mixing matrix entry, output += gain * input */
+struct hrpn_audio_mixer_gain {
+	uint32_t input;
+	uint32_t output;
+	double gain;		/* linear */
+};
+
+struct hrpn_resp_audio_element_mixer {
+	uint32_t type;		/* command type */
+	uint32_t status;
+};
+
+struct hrpn_cmd_audio_element_mixer_set {
+	uint32_t type;		/* command type */
+	struct hrpn_cmd_audio_pipeline_id pipeline;
+	struct hrpn_cmd_audio_element_id element;
+	struct hrpn_audio_mixer_gain gain;
+};
+
+struct hrpn_cmd_audio_element_mixer {
+	union {
+		struct hrpn_cmd_audio_element_common common;
+		struct hrpn_cmd_audio_element_mixer_set set;
+	} u;
+};
+
+/*
+ * Tone detector event, timing in samples since the element start.
+ * tone is the DTMF digit ('0'-'9', 'A'-'D', '*', '#') or HRPN_AUDIO_DETECTOR_PILOT(n).
+ * A tone start is reported with a zero duration, its end with the tone duration.
+ */
+#define HRPN_AUDIO_DETECTOR_PILOT(n)	(0x100 + (n))
+#define HRPN_AUDIO_DETECTOR_EVENTS_MAX	12
+
+struct hrpn_audio_detector_event {
+	uint32_t tone;
+	uint32_t duration;
+	uint64_t start;
+};
+
+struct hrpn_resp_audio_element_detector {
+	uint32_t type;		/* command type */
+	uint32_t status;
+	uint32_t events;	/* valid event entries */
+	uint32_t lost;		/* events dropped since the previous read */
+	struct hrpn_audio_detector_event event[HRPN_AUDIO_DETECTOR_EVENTS_MAX];
+};
+
+struct hrpn_cmd_audio_element_detector_read {
+	uint32_t type;		/* command type */
+	struct hrpn_cmd_audio_pipeline_id pipeline;
+	struct hrpn_cmd_audio_element_id element;
+};
+
+struct hrpn_cmd_audio_element_detector {
+	union {
+		struct hrpn_cmd_audio_element_common common;
+		struct hrpn_cmd_audio_element_detector_read read;
+	} u;
+};
+
+/* Latency measurements, min/mean/max since the previous read */
+struct hrpn_resp_audio_element_latency {
+	uint32_t type;		/* command type */
+	uint32_t status;
+	uint32_t sample_rate;
+	uint32_t measurements;	/* since the element start */
+	uint32_t failures;	/* measurements without a correlation peak */
+	uint32_t count;		/* measurements since the previous read */
+	int32_t last;		/* last latency, in 1/256 samples, -1 if none */
+	int32_t min;		/* in ns */
+	int32_t mean;
+	int32_t max;
+	int32_t abs_min;	/* since the element start, in ns */
+	int32_t abs_max;
+};
+
+struct hrpn_cmd_audio_element_latency_read {
+	uint32_t type;		/* command type */
+	struct hrpn_cmd_audio_pipeline_id pipeline;
+	struct hrpn_cmd_audio_element_id element;
+};
+
+struct hrpn_cmd_audio_element_latency {
+	union {
+		struct hrpn_cmd_audio_element_common common;
+		struct hrpn_cmd_audio_element_latency_read read;
+	} u;
+};
+
 struct hrpn_cmd_audio_element_dump {
 	uint32_t type;		/* command type */
 	struct hrpn_cmd_audio_pipeline_id pipeline;
@@ -75,6 +199,10 @@ struct hrpn_cmd_audio_element {
 		struct hrpn_cmd_audio_element_common common;
 		struct hrpn_cmd_audio_element_routing routing;
 		struct hrpn_cmd_audio_element_pll pll;
+		struct hrpn_cmd_audio_element_biquad biquad;
+		struct hrpn_cmd_audio_element_mixer mixer;
+		struct hrpn_cmd_audio_element_detector detector;
+		struct hrpn_cmd_audio_element_latency latency;
 		struct hrpn_cmd_audio_element_dump dump;
 	} u;
 };
@@ -94,10 +222,166 @@ struct hrpn_resp_audio_pipeline {
 	uint32_t status;
 };
 
+struct hrpn_cmd_audio_pipeline_profile {
+	uint32_t type;		/* command type */
+	struct hrpn_cmd_audio_pipeline_id pipeline;
+	uint32_t element;	/* first element reported, in execution order */
+};
+
+/* Elements reported per response, limited by the mailbox payload size */
+#define HRPN_AUDIO_PIPELINE_PROFILE_ENTRIES	9
+
+/* Element run time, over the last profiling window, in counter ticks */
+struct hrpn_resp_audio_pipeline_profile_entry {
+	struct hrpn_cmd_audio_element_id element;
+	uint32_t min;
+	uint32_t mean;
+	uint32_t max;
+	uint32_t abs_max;	/* since pipeline start */
+};
+
+struct hrpn_resp_audio_pipeline_profile {
+	uint32_t type;		/* command type */
+	uint32_t status;
+	uint32_t counter_freq;	/* counter ticks frequency (Hz) */
+	uint32_t elements;	/* pipeline elements */
+	uint32_t entries;	/* elements reported in this response */
+	struct hrpn_resp_audio_pipeline_profile_entry entry[HRPN_AUDIO_PIPELINE_PROFILE_ENTRIES];
+};
+
+/*
+ * Binary pipeline configuration
+ *
+ * Written by the controller in its ivshmem output region, at
+ * HRPN_AUDIO_PIPELINE_CONFIG_OFFSET (after the mailbox), and loaded with
+ * HRPN_CMD_TYPE_AUDIO_PIPELINE_LOAD. All fields are little endian, all
+ * records are 32bit aligned. Indexes follow the same conventions as
+ * struct audio_pipeline_config (0 for default values).
+ *
+ * header
+ * stage[0]: elements, element[0] ... element[n]
+ * ...
+ * stage[stages - 1]
+ * buffer[0] ... buffer[buffers - 1]: storage index
+ * storage[0] ... storage[buffer_storage - 1]: periods
+ *
+ * with each element record followed by input[inputs], output[outputs]
+ * (buffer indexes) and the element parameters (params_size bytes).
+ */
+#define HRPN_AUDIO_PIPELINE_CONFIG_OFFSET	0x400
+#define HRPN_AUDIO_PIPELINE_CONFIG_MAGIC	0x4c505048	/* "HPPL" */
+#define HRPN_AUDIO_PIPELINE_CONFIG_VERSION	2
+#define HRPN_AUDIO_PIPELINE_CONFIG_NAME_MAX	32
+
+struct hrpn_audio_pipeline_config_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;		/* total size (including header), in bytes */
+	uint32_t checksum;	/* sum of all 32bit words following the header */
+	char name[HRPN_AUDIO_PIPELINE_CONFIG_NAME_MAX];	/* null terminated */
+	uint32_t stages;
+	uint32_t buffers;
+	uint32_t buffer_storage;
+};
+
+struct hrpn_audio_pipeline_config_element {
+	uint32_t type;		/* element type */
+	uint32_t period;	/* 0 for pipeline period */
+	uint32_t sample_rate;	/* 0 for pipeline sample rate */
+	uint32_t inputs;
+	uint32_t outputs;
+	uint32_t params_size;	/* multiple of 4 */
+};
+
+/* Element parameters */
+struct hrpn_audio_element_dtmf_params {
+	uint32_t us;
+	uint32_t pause_us;
+	uint32_t sequence_pause_us;
+	uint32_t reserved;
+	double amplitude;
+	char sequence[];	/* null terminated */
+};
+
+struct hrpn_audio_element_pll_params {
+	uint32_t src_sai_id;
+	uint32_t dst_sai_id;
+	uint32_t pll_id;
+};
+
+struct hrpn_audio_element_sine_params {
+	double freq;
+	double amplitude;
+};
+
+struct hrpn_audio_element_src_params {
+	uint32_t input_rate;
+	uint32_t taps;		/* 0 for default */
+};
+
+struct hrpn_audio_element_asrc_params {
+	uint32_t src_sai_id;
+	uint32_t dst_sai_id;
+	uint32_t input_rate;	/* 0 for the element sample rate */
+	uint32_t taps;		/* 0 for default */
+};
+
+/* followed by coefs struct hrpn_audio_biquad_coef records, in channel then section order */
+struct hrpn_audio_element_biquad_params {
+	uint32_t sections;	/* per channel */
+	uint32_t coefs;		/* 0 (pass through), sections (same for all channels) or channels * sections */
+};
+
+/* followed by filters * taps float coefficients, in filter then tap order */
+struct hrpn_audio_element_fir_params {
+	uint32_t taps;
+	uint32_t filters;	/* 1 (same for all channels) or channels */
+};
+
+/* followed by gains struct hrpn_audio_mixer_gain records, other entries are 0 */
+struct hrpn_audio_element_mixer_params {
+	uint32_t gains;
+};
+
+/* followed by pilots uint32_t frequencies, in Hz */
+struct hrpn_audio_element_detector_params {
+	uint32_t pilots;
+	uint32_t block;		/* analysis block, in samples, 0 for default (25ms) */
+	int32_t threshold;	/* detection level, in dBFS, 0 for default */
+};
+
+struct hrpn_audio_element_latency_params {
+	uint32_t interval_ms;	/* between measurements, 0 for default (1s) */
+	uint32_t max_latency;	/* in samples, 0 for default (100ms) */
+	double amplitude;	/* marker amplitude, 0 for default */
+};
+
+/* sai sink and sai source: sai_n sai records, each followed by line_n line records */
+struct hrpn_audio_element_sai_params {
+	uint32_t sai_n;
+};
+
+struct hrpn_audio_element_sai_params_sai {
+	uint32_t id;
+	uint32_t line_n;
+	uint32_t sync_mode;	/* 0: full, 1: partial, 2: none */
+};
+
+struct hrpn_audio_element_sai_params_line {
+	uint32_t id;
+	uint32_t channel_n;
+};
+
+struct hrpn_cmd_audio_pipeline_load {
+	uint32_t type;		/* command type */
+	uint32_t size;		/* configuration size, in bytes */
+};
+
 struct hrpn_cmd_audio_pipeline {
 	union {
 		struct hrpn_cmd_audio_pipeline_common common;
 		struct hrpn_cmd_audio_pipeline_dump audio_pipeline_dump;
+		struct hrpn_cmd_audio_pipeline_profile audio_pipeline_profile;
 		struct hrpn_cmd_audio_element element;
 	} u;
 };
@@ -8,8 +8,11 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
+#include <math.h>
 
 #include "hrpn_ctrl.h"
+#include "ivshmem.h"
 #include "common.h"
 
 void audio_pipeline_usage(void)
@@ -18,6 +21,10 @@ void audio_pipeline_usage(void)
 		"\nAudio pipeline options:\n"
 		"\t-a <pipeline_id>  audio pipeline id (default 0)\n"
 		"\t-d                audio pipeline dump\n"
+		"\t-l <file>         load binary audio pipeline configuration\n"
+		"\t                  (run with: audio -r 4)\n"
+		"\t-P                audio pipeline elements profile\n"
+		"\t                  (requires AUDIO_ELEMENT_PROFILE firmware build)\n"
 	);
 }
 
@@ -47,6 +54,67 @@ void audio_element_usage(void)
 		"\t                  2 - sai sink\n"
 		"\t                  3 - sai source\n"
 		"\t                  4 - sine source\n"
+		"\t                  6 - sample rate converter\n"
+		"\t                  7 - asynchronous sample rate converter\n"
+		"\t                  8 - biquad filter\n"
+		"\t                  9 - fir filter\n"
+		"\t                  10 - mixer\n"
+		"\t                  11 - tone detector\n"
+		"\t                  12 - latency measurement\n"
+	);
+}
+
+void audio_element_biquad_usage(void)
+{
+	printf(
+		"\nBiquad audio element options:\n"
+		"\t-a <pipeline_id>  audio pipeline id (default 0)\n"
+		"\t-e <element_id>   biquad element id (default 0)\n"
+		"\t-c <channel>      biquad element channel (default all)\n"
+		"\t-s <section>      biquad element section (default 0)\n"
+		"\t-t <filter_type>  filter type (default peak):\n"
+		"\t                  flat, peak, lowshelf, highshelf, lowpass, highpass\n"
+		"\t-r <rate>         element sample rate, in Hz (default 48000)\n"
+		"\t-f <freq>         filter center/corner frequency, in Hz (default 1000)\n"
+		"\t-g <gain>         filter gain, in dB (default 0)\n"
+		"\t-q <q>            filter quality factor (default 0.707)\n"
+		"\t-k <b0,b1,b2,a1,a2> filter coefficients, instead of type/frequency/gain/q\n"
+		"\t-w                write filter to the element section\n"
+	);
+}
+
+void audio_element_mixer_usage(void)
+{
+	printf(
+		"\nMixer audio element options:\n"
+		"\t-a <pipeline_id>  audio pipeline id (default 0)\n"
+		"\t-e <element_id>   mixer element id (default 0)\n"
+		"\t-i <input_id>     mixer element input (default 0)\n"
+		"\t-o <output_id>    mixer element output (default 0)\n"
+		"\t-g <gain>         gain, in dB (default 0)\n"
+		"\t-l <gain>         linear gain, instead of dB\n"
+		"\t-m                mute, gain 0\n"
+		"\t-w                write gain to the element input/output entry\n"
+	);
+}
+
+void audio_element_detector_usage(void)
+{
+	printf(
+		"\nTone detector audio element options:\n"
+		"\t-a <pipeline_id>  audio pipeline id (default 0)\n"
+		"\t-e <element_id>   detector element id (default 0)\n"
+		"\t-r                read detected tone events\n"
+	);
+}
+
+void audio_element_latency_usage(void)
+{
+	printf(
+		"\nLatency measurement audio element options:\n"
+		"\t-a <pipeline_id>  audio pipeline id (default 0)\n"
+		"\t-e <element_id>   latency element id (default 0)\n"
+		"\t-r                read latency statistics (reset on read)\n"
 	);
 }
 
@@ -150,6 +218,456 @@ out:
 	return rc;
 }
 
+/* Audio EQ cookbook filters (R. Bristow-Johnson), normalized by a0 */
+static int audio_element_biquad_design(const char *type, double rate, double freq, double gain, double q, struct hrpn_audio_biquad_coef *coef)
+{
+	double A = pow(10.0, gain / 40.0);
+	double w0 = 2.0 * M_PI * freq / rate;
+	double cw = cos(w0);
+	double alpha = sin(w0) / (2.0 * q);
+	double b0, b1, b2, a0, a1, a2;
+
+	if ((freq <= 0.0) || (freq >= rate / 2.0) || (q <= 0.0))
+		return -1;
+
+	if (!strcmp(type, "flat")) {
+		b0 = 1.0; b1 = 0.0; b2 = 0.0;
+		a0 = 1.0; a1 = 0.0; a2 = 0.0;
+	} else if (!strcmp(type, "peak")) {
+		b0 = 1.0 + alpha * A;
+		b1 = -2.0 * cw;
+		b2 = 1.0 - alpha * A;
+		a0 = 1.0 + alpha / A;
+		a1 = -2.0 * cw;
+		a2 = 1.0 - alpha / A;
+	} else if (!strcmp(type, "lowshelf")) {
+		b0 = A * ((A + 1.0) - (A - 1.0) * cw + 2.0 * sqrt(A) * alpha);
+		b1 = 2.0 * A * ((A - 1.0) - (A + 1.0) * cw);
+		b2 = A * ((A + 1.0) - (A - 1.0) * cw - 2.0 * sqrt(A) * alpha);
+		a0 = (A + 1.0) + (A - 1.0) * cw + 2.0 * sqrt(A) * alpha;
+		a1 = -2.0 * ((A - 1.0) + (A + 1.0) * cw);
+		a2 = (A + 1.0) + (A - 1.0) * cw - 2.0 * sqrt(A) * alpha;
+	} else if (!strcmp(type, "highshelf")) {
+		b0 = A * ((A + 1.0) + (A - 1.0) * cw + 2.0 * sqrt(A) * alpha);
+		b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cw);
+		b2 = A * ((A + 1.0) + (A - 1.0) * cw - 2.0 * sqrt(A) * alpha);
+		a0 = (A + 1.0) - (A - 1.0) * cw + 2.0 * sqrt(A) * alpha;
+		a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cw);
+		a2 = (A + 1.0) - (A - 1.0) * cw - 2.0 * sqrt(A) * alpha;
+	} else if (!strcmp(type, "lowpass")) {
+		b0 = (1.0 - cw) / 2.0;
+		b1 = 1.0 - cw;
+		b2 = (1.0 - cw) / 2.0;
+		a0 = 1.0 + alpha;
+		a1 = -2.0 * cw;
+		a2 = 1.0 - alpha;
+	} else if (!strcmp(type, "highpass")) {
+		b0 = (1.0 + cw) / 2.0;
+		b1 = -(1.0 + cw);
+		b2 = (1.0 + cw) / 2.0;
+		a0 = 1.0 + alpha;
+		a1 = -2.0 * cw;
+		a2 = 1.0 - alpha;
+	} else {
+		return -1;
+	}
+
+	coef->b0 = b0 / a0;
+	coef->b1 = b1 / a0;
+	coef->b2 = b2 / a0;
+	coef->a1 = a1 / a0;
+	coef->a2 = a2 / a0;
+
+	return 0;
+}
+
+static int audio_element_biquad_set(struct mailbox *m, unsigned int pipeline_id, unsigned int element_id, unsigned int channel, unsigned int section, struct hrpn_audio_biquad_coef *coef)
+{
+	struct hrpn_cmd_audio_element_biquad_set set;
+	struct hrpn_resp_audio_element_biquad resp;
+	unsigned int len;
+
+	set.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_BIQUAD_SET;
+	set.pipeline.id = pipeline_id;
+	set.element.type = 8;
+	set.element.id = element_id;
+	set.channel = channel;
+	set.section = section;
+	set.coef = *coef;
+	len = sizeof(resp);
+
+	return command(m, &set, sizeof(set), HRPN_RESP_TYPE_AUDIO_ELEMENT_BIQUAD, &resp, &len, COMMAND_TIMEOUT);
+}
+
+int audio_element_biquad_main(int argc, char *argv[], struct mailbox *m)
+{
+	struct hrpn_audio_biquad_coef coef;
+	int option;
+	unsigned int pipeline_id = 0;
+	unsigned int element_id = 0;
+	unsigned int channel = HRPN_AUDIO_ELEMENT_BIQUAD_ALL_CHANNELS;
+	unsigned int section = 0;
+	unsigned int rate = 48000;
+	const char *type = "peak";
+	double freq = 1000.0, gain = 0.0, q = 0.707;
+	bool raw = false;
+	int rc = 0;
+
+	while ((option = getopt(argc, argv, "a:c:e:f:g:k:q:r:s:t:wv")) != -1) {
+		switch (option) {
+		case 'a':
+			if (strtoul_check(optarg, NULL, 0, &pipeline_id) < 0) {
+				printf("Invalid pipeline id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'c':
+			if (strtoul_check(optarg, NULL, 0, &channel) < 0) {
+				printf("Invalid element channel\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'e':
+			if (strtoul_check(optarg, NULL, 0, &element_id) < 0) {
+				printf("Invalid element id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'f':
+			freq = strtod(optarg, NULL);
+			break;
+
+		case 'g':
+			gain = strtod(optarg, NULL);
+			break;
+
+		case 'k':
+			if (sscanf(optarg, "%lf,%lf,%lf,%lf,%lf", &coef.b0, &coef.b1, &coef.b2, &coef.a1, &coef.a2) != 5) {
+				printf("Invalid filter coefficients\n");
+				rc = -1;
+				goto out;
+			}
+
+			raw = true;
+
+			break;
+
+		case 'q':
+			q = strtod(optarg, NULL);
+			break;
+
+		case 'r':
+			if (strtoul_check(optarg, NULL, 0, &rate) < 0 || !rate) {
+				printf("Invalid sample rate\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 's':
+			if (strtoul_check(optarg, NULL, 0, &section) < 0) {
+				printf("Invalid element section\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 't':
+			type = optarg;
+			raw = false;
+			break;
+
+		case 'w':
+			if (!raw && (audio_element_biquad_design(type, rate, freq, gain, q, &coef) < 0)) {
+				printf("Invalid filter type/frequency/q\n");
+				rc = -1;
+				goto out;
+			}
+
+			printf("b0: %.9f b1: %.9f b2: %.9f a1: %.9f a2: %.9f\n", coef.b0, coef.b1, coef.b2, coef.a1, coef.a2);
+
+			rc = audio_element_biquad_set(m, pipeline_id, element_id, channel, section, &coef);
+
+			break;
+
+		default:
+			common_main(option, optarg);
+			break;
+		}
+	}
+
+out:
+	return rc;
+}
+
+static int audio_element_mixer_set(struct mailbox *m, unsigned int pipeline_id, unsigned int element_id, unsigned int input, unsigned int output, double gain)
+{
+	struct hrpn_cmd_audio_element_mixer_set set;
+	struct hrpn_resp_audio_element_mixer resp;
+	unsigned int len;
+
+	set.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_MIXER_SET;
+	set.pipeline.id = pipeline_id;
+	set.element.type = 10;
+	set.element.id = element_id;
+	set.gain.input = input;
+	set.gain.output = output;
+	set.gain.gain = gain;
+	len = sizeof(resp);
+
+	return command(m, &set, sizeof(set), HRPN_RESP_TYPE_AUDIO_ELEMENT_MIXER, &resp, &len, COMMAND_TIMEOUT);
+}
+
+int audio_element_mixer_main(int argc, char *argv[], struct mailbox *m)
+{
+	int option;
+	unsigned int pipeline_id = 0;
+	unsigned int element_id = 0;
+	unsigned int input = 0;
+	unsigned int output = 0;
+	double gain = 1.0;
+	int rc = 0;
+
+	while ((option = getopt(argc, argv, "a:e:g:i:l:mo:wv")) != -1) {
+		switch (option) {
+		case 'a':
+			if (strtoul_check(optarg, NULL, 0, &pipeline_id) < 0) {
+				printf("Invalid pipeline id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'e':
+			if (strtoul_check(optarg, NULL, 0, &element_id) < 0) {
+				printf("Invalid element id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'g':
+			gain = pow(10.0, strtod(optarg, NULL) / 20.0);
+			break;
+
+		case 'i':
+			if (strtoul_check(optarg, NULL, 0, &input) < 0) {
+				printf("Invalid element input\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'l':
+			gain = strtod(optarg, NULL);
+			break;
+
+		case 'm':
+			gain = 0.0;
+			break;
+
+		case 'o':
+			if (strtoul_check(optarg, NULL, 0, &output) < 0) {
+				printf("Invalid element output\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'w':
+			rc = audio_element_mixer_set(m, pipeline_id, element_id, input, output, gain);
+
+			break;
+
+		default:
+			common_main(option, optarg);
+			break;
+		}
+	}
+
+out:
+	return rc;
+}
+
+static int audio_element_detector_read(struct mailbox *m, unsigned int pipeline_id, unsigned int element_id)
+{
+	struct hrpn_cmd_audio_element_detector_read read;
+	struct hrpn_resp_audio_element_detector resp;
+	struct hrpn_audio_detector_event *event;
+	unsigned int len, i;
+	int rc;
+
+	read.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_DETECTOR_READ;
+	read.pipeline.id = pipeline_id;
+	read.element.type = 11;
+	read.element.id = element_id;
+	len = sizeof(resp);
+
+	rc = command(m, &read, sizeof(read), HRPN_RESP_TYPE_AUDIO_ELEMENT_DETECTOR, &resp, &len, COMMAND_TIMEOUT);
+	if (rc < 0)
+		goto out;
+
+	if (resp.events > HRPN_AUDIO_DETECTOR_EVENTS_MAX)
+		resp.events = HRPN_AUDIO_DETECTOR_EVENTS_MAX;
+
+	for (i = 0; i < resp.events; i++) {
+		event = &resp.event[i];
+
+		if (event->tone >= HRPN_AUDIO_DETECTOR_PILOT(0))
+			printf("pilot %u", event->tone - HRPN_AUDIO_DETECTOR_PILOT(0));
+		else
+			printf("digit %c", event->tone);
+
+		if (event->duration)
+			printf(" end, start: %llu, duration: %u samples\n", (unsigned long long)event->start, event->duration);
+		else
+			printf(" start: %llu\n", (unsigned long long)event->start);
+	}
+
+	if (resp.lost)
+		printf("%u events lost\n", resp.lost);
+
+out:
+	return rc;
+}
+
+int audio_element_detector_main(int argc, char *argv[], struct mailbox *m)
+{
+	int option;
+	unsigned int pipeline_id = 0;
+	unsigned int element_id = 0;
+	int rc = 0;
+
+	while ((option = getopt(argc, argv, "a:e:rv")) != -1) {
+		switch (option) {
+		case 'a':
+			if (strtoul_check(optarg, NULL, 0, &pipeline_id) < 0) {
+				printf("Invalid pipeline id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'e':
+			if (strtoul_check(optarg, NULL, 0, &element_id) < 0) {
+				printf("Invalid element id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'r':
+			rc = audio_element_detector_read(m, pipeline_id, element_id);
+
+			break;
+
+		default:
+			common_main(option, optarg);
+			break;
+		}
+	}
+
+out:
+	return rc;
+}
+
+static double ns_to_us(int32_t ns)
+{
+	return ns / 1000.0;
+}
+
+static int audio_element_latency_read(struct mailbox *m, unsigned int pipeline_id, unsigned int element_id)
+{
+	struct hrpn_cmd_audio_element_latency_read read;
+	struct hrpn_resp_audio_element_latency resp;
+	unsigned int len;
+	int rc;
+
+	read.type = HRPN_CMD_TYPE_AUDIO_ELEMENT_LATENCY_READ;
+	read.pipeline.id = pipeline_id;
+	read.element.type = 12;
+	read.element.id = element_id;
+	len = sizeof(resp);
+
+	rc = command(m, &read, sizeof(read), HRPN_RESP_TYPE_AUDIO_ELEMENT_LATENCY, &resp, &len, COMMAND_TIMEOUT);
+	if (rc < 0)
+		goto out;
+
+	printf("sample rate: %u Hz, measurements: %u, failures: %u\n", resp.sample_rate, resp.measurements, resp.failures);
+
+	if (resp.last >= 0)
+		printf("last: %.2f samples\n", resp.last / 256.0);
+
+	if (resp.count)
+		printf("last %u: min %.2f us, mean %.2f us, max %.2f us\n", resp.count,
+		       ns_to_us(resp.min), ns_to_us(resp.mean), ns_to_us(resp.max));
+
+	if (resp.measurements)
+		printf("all: min %.2f us, max %.2f us\n", ns_to_us(resp.abs_min), ns_to_us(resp.abs_max));
+
+out:
+	return rc;
+}
+
+int audio_element_latency_main(int argc, char *argv[], struct mailbox *m)
+{
+	int option;
+	unsigned int pipeline_id = 0;
+	unsigned int element_id = 0;
+	int rc = 0;
+
+	while ((option = getopt(argc, argv, "a:e:rv")) != -1) {
+		switch (option) {
+		case 'a':
+			if (strtoul_check(optarg, NULL, 0, &pipeline_id) < 0) {
+				printf("Invalid pipeline id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'e':
+			if (strtoul_check(optarg, NULL, 0, &element_id) < 0) {
+				printf("Invalid element id\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
+		case 'r':
+			rc = audio_element_latency_read(m, pipeline_id, element_id);
+
+			break;
+
+		default:
+			common_main(option, optarg);
+			break;
+		}
+	}
+
+out:
+	return rc;
+}
+
 static int audio_pipeline_element_dump(struct mailbox *m, unsigned int pipeline_id, unsigned int element_type, unsigned int element_id)
 {
 	struct hrpn_cmd_audio_element_dump dump;
@@ -230,13 +748,142 @@ static int audio_pipeline_dump(struct mailbox *m, unsigned int pipeline_id)
 	return command(m, &dump, sizeof(dump), HRPN_RESP_TYPE_AUDIO_PIPELINE, &resp, &len, COMMAND_TIMEOUT);
 }
 
+static const char *audio_element_name(unsigned int type)
+{
+	static const char *name[] = {"dtmf", "routing", "sai_sink", "sai_source", "sine", "pll", "src", "asrc", "biquad", "fir", "mixer", "detector", "latency"};
+
+	if (type < sizeof(name) / sizeof(name[0]))
+		return name[type];
+
+	return "unknown";
+}
+
+static double ticks_to_us(uint32_t ticks, uint32_t freq)
+{
+	return (double)ticks * 1000000.0 / freq;
+}
+
+static int audio_pipeline_profile(struct mailbox *m, unsigned int pipeline_id)
+{
+	struct hrpn_cmd_audio_pipeline_profile profile;
+	struct hrpn_resp_audio_pipeline_profile resp;
+	struct hrpn_resp_audio_pipeline_profile_entry *entry;
+	unsigned int element = 0;
+	unsigned int len;
+	int i, rc;
+
+	profile.type = HRPN_CMD_TYPE_AUDIO_PIPELINE_PROFILE;
+	profile.pipeline.id = pipeline_id;
+
+	do {
+		profile.element = element;
+		len = sizeof(resp);
+
+		rc = command(m, &profile, sizeof(profile), HRPN_RESP_TYPE_AUDIO_PIPELINE, &resp, &len, COMMAND_TIMEOUT);
+		if (rc < 0)
+			goto out;
+
+		if (len != sizeof(resp) || !resp.counter_freq) {
+			printf("invalid profile response\n");
+			rc = -1;
+			goto out;
+		}
+
+		if (!resp.entries)
+			break;
+
+		if (!element)
+			printf("%-4s %-10s %-4s %10s %10s %10s %10s (us)\n",
+			       "elt", "type", "id", "min", "mean", "max", "absmax");
+
+		for (i = 0; i < resp.entries; i++) {
+			entry = &resp.entry[i];
+
+			printf("%-4u %-10s %-4u %10.2f %10.2f %10.2f %10.2f\n",
+			       element + i, audio_element_name(entry->element.type), entry->element.id,
+			       ticks_to_us(entry->min, resp.counter_freq),
+			       ticks_to_us(entry->mean, resp.counter_freq),
+			       ticks_to_us(entry->max, resp.counter_freq),
+			       ticks_to_us(entry->abs_max, resp.counter_freq));
+		}
+
+		element += resp.entries;
+	} while (element < resp.elements);
+
+out:
+	return rc;
+}
+
+static int audio_pipeline_load(struct mailbox *m, const char *file)
+{
+	struct hrpn_audio_pipeline_config_header *header;
+	struct hrpn_cmd_audio_pipeline_load load;
+	struct hrpn_resp_audio_pipeline resp;
+	struct ivshmem *mem = ctrl_ivshmem();
+	size_t max, size;
+	unsigned int len;
+	void *data;
+	FILE *f;
+	int rc = -1;
+
+	if (mem->out_size <= HRPN_AUDIO_PIPELINE_CONFIG_OFFSET) {
+		printf("shared memory too small for pipeline configuration\n");
+		goto err;
+	}
+
+	max = mem->out_size - HRPN_AUDIO_PIPELINE_CONFIG_OFFSET;
+
+	data = malloc(max + 1);
+	if (!data)
+		goto err;
+
+	f = fopen(file, "rb");
+	if (!f) {
+		printf("fopen(%s) failed: %s\n", file, strerror(errno));
+		goto err_open;
+	}
+
+	size = fread(data, 1, max + 1, f);
+	if (size > max) {
+		printf("pipeline configuration too large (max %zu bytes)\n", max);
+		goto err_read;
+	}
+
+	header = data;
+	if ((size < sizeof(*header)) ||
+	    (header->magic != HRPN_AUDIO_PIPELINE_CONFIG_MAGIC) ||
+	    (header->version != HRPN_AUDIO_PIPELINE_CONFIG_VERSION) ||
+	    (header->size != size)) {
+		printf("invalid pipeline configuration file\n");
+		goto err_read;
+	}
+
+	memcpy((uint8_t *)mem->out + HRPN_AUDIO_PIPELINE_CONFIG_OFFSET, data, size);
+
+	load.type = HRPN_CMD_TYPE_AUDIO_PIPELINE_LOAD;
+	load.size = size;
+	len = sizeof(resp);
+
+	/* mailbox command write is ordered after the configuration write */
+	rc = command(m, &load, sizeof(load), HRPN_RESP_TYPE_AUDIO_PIPELINE, &resp, &len, COMMAND_TIMEOUT);
+
+err_read:
+	fclose(f);
+
+err_open:
+	free(data);
+
+err:
+	return rc;
+}
+
 int audio_pipeline_main(int argc, char *argv[], struct mailbox *m)
 {
 	int option;
 	unsigned int pipeline_id = 0;
 	int rc = 0;
 
-	while ((option = getopt(argc, argv, "a:dv")) != -1) {
+	while ((option = getopt(argc, argv, "a:dl:Pv")) != -1) {
 		switch (option) {
 		case 'a':
 			if (strtoul_check(optarg, NULL, 0, &pipeline_id) < 0) {
@@ -252,6 +899,16 @@ int audio_pipeline_main(int argc, char *argv[], struct mailbox *m)
 
 			break;
 
+		case 'l':
+			rc = audio_pipeline_load(m, optarg);
+
+			break;
+
+		case 'P':
+			rc = audio_pipeline_profile(m, pipeline_id);
+
+			break;
+
 		default:
 			common_main(option, optarg);
 			break;
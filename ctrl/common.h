@@ -16,6 +16,9 @@ struct cmd_handler {
 	void (* usage)(void);
 };
 
+struct ivshmem;
+
+struct ivshmem *ctrl_ivshmem(void);
 int command(struct mailbox *m, void *cmd, unsigned int cmd_len, unsigned int resp_type, void *resp, unsigned int *resp_len, unsigned int timeout_ms);
 int strtoul_check(const char *nptr, char **endptr, int base, unsigned int *val);
 void usage(void);
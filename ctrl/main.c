@@ -19,10 +19,18 @@
 
 int audio_element_routing_main(int argc, char *argv[], struct mailbox *m);
 int audio_element_main(int argc, char *argv[], struct mailbox *m);
+int audio_element_biquad_main(int argc, char *argv[], struct mailbox *m);
+int audio_element_mixer_main(int argc, char *argv[], struct mailbox *m);
+int audio_element_detector_main(int argc, char *argv[], struct mailbox *m);
+int audio_element_latency_main(int argc, char *argv[], struct mailbox *m);
 int audio_pipeline_main(int argc, char *argv[], struct mailbox *m);
 void audio_pipeline_usage(void);
 void audio_element_routing_usage(void);
 void audio_element_usage(void);
+void audio_element_biquad_usage(void);
+void audio_element_mixer_usage(void);
+void audio_element_detector_usage(void);
+void audio_element_latency_usage(void);
 
 int can_main(int argc, char *argv[], struct mailbox *m);
 int ethernet_main(int argc, char *argv[], struct mailbox *m);
@@ -42,22 +50,25 @@ static void audio_usage(void)
 {
 	printf(
 		"\nAudio options:\n"
+		"\t-i <instance>  audio instance (0 or 1), default 0\n"
+		"\t               Instances run concurrently, on distinct SAI interfaces\n"
 		"\t-f <frequency> audio clock frequency (in Hz)\n"
 		"\t               Supporting 44100, 48000, 88200, 176400, 96000, 192000 Hz\n"
 		"\t               Will use default frequency 44100Hz if not specified\n"
 		"\t-p <frames>    audio processing period (in frames)\n"
-		"\t               Supporting 2, 4, 8, 16, 32 frames\n"
+		"\t               Supporting 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 frames\n"
 		"\t               Will use default period 8 frames if not specified\n"
 		"\t-r <id>        run audio mode id:\n"
 		"\t               0 - dtmf playback\n"
 		"\t               1 - sine wave playback\n"
 		"\t               2 - playback & recording (loopback)\n"
 		"\t               3 - audio pipeline\n"
-		"\t-s             stop running audio mode\n"
+		"\t               4 - loaded audio pipeline (pipeline -l)\n"
+		"\t-s             stop audio instance\n"
 	);
 }
 
-static int audio_run(struct mailbox *m, unsigned int id, unsigned int frequency, unsigned int period)
+static int audio_run(struct mailbox *m, unsigned int instance, unsigned int id, unsigned int frequency, unsigned int period)
 {
 	struct hrpn_cmd_audio_run run;
 	struct hrpn_response resp;
@@ -67,19 +78,21 @@ static int audio_run(struct mailbox *m, unsigned int id, unsigned int frequency,
 	run.id = id;
 	run.frequency = frequency;
 	run.period = period;
+	run.instance = instance;
 
 	len = sizeof(resp);
 
 	return command(m, &run, sizeof(run), HRPN_RESP_TYPE_AUDIO, &resp, &len, COMMAND_TIMEOUT);
 }
 
-static int audio_stop(struct mailbox *m)
+static int audio_stop(struct mailbox *m, unsigned int instance)
 {
 	struct hrpn_cmd_audio_stop stop;
 	struct hrpn_response resp;
 	unsigned int len;
 
 	stop.type = HRPN_CMD_TYPE_AUDIO_STOP;
+	stop.instance = instance;
 
 	len = sizeof(resp);
 
@@ -93,10 +106,21 @@ static int audio_main(int argc, char *argv[], struct mailbox *m)
 	int rc = 0;
 	unsigned int frequency = 0;
 	unsigned int period = 0;
+	unsigned int instance = 0;
 	bool is_run_cmd = false;
+	bool is_stop_cmd = false;
 
-	while ((option = getopt(argc, argv, "f:p:r:sv")) != -1) {
+	while ((option = getopt(argc, argv, "f:i:p:r:sv")) != -1) {
 		switch (option) {
+		case 'i':
+			if (strtoul_check(optarg, NULL, 0, &instance) < 0) {
+				printf("Invalid instance\n");
+				rc = -1;
+				goto out;
+			}
+
+			break;
+
 		case 'f':
 			if (strtoul_check(optarg, NULL, 0, &frequency) < 0) {
 				printf("Invalid frequency\n");
@@ -126,7 +150,7 @@ static int audio_main(int argc, char *argv[], struct mailbox *m)
 			break;
 
 		case 's':
-			rc = audio_stop(m);
+			is_stop_cmd = true;
 			break;
 
 		default:
@@ -135,8 +159,11 @@ static int audio_main(int argc, char *argv[], struct mailbox *m)
 		}
 	}
 	/* Run the case after we get all parameters */
+	if (is_stop_cmd)
+		rc = audio_stop(m, instance);
+
 	if (is_run_cmd)
-		rc = audio_run(m, id, frequency, period);
+		rc = audio_run(m, instance, id, frequency, period);
 
 out:
 	return rc;
@@ -203,12 +230,23 @@ out:
 	return rc;
 }
 
+static struct ivshmem mem;
+
+struct ivshmem *ctrl_ivshmem(void)
+{
+	return &mem;
+}
+
 const struct cmd_handler command_handler[] = {
 	{ "audio", audio_main, audio_usage },
 	{ "latency", latency_main, latency_usage },
 	{ "pipeline", audio_pipeline_main, audio_pipeline_usage },
 	{ "element", audio_element_main, audio_element_usage },
 	{ "routing", audio_element_routing_main, audio_element_routing_usage },
+	{ "biquad", audio_element_biquad_main, audio_element_biquad_usage },
+	{ "mixer", audio_element_mixer_main, audio_element_mixer_usage },
+	{ "detector", audio_element_detector_main, audio_element_detector_usage },
+	{ "roundtrip", audio_element_latency_main, audio_element_latency_usage },
 
 	{ "can", can_main, can_usage },
 	{ "ethernet", ethernet_main, ethernet_usage },
@@ -216,7 +254,6 @@ const struct cmd_handler command_handler[] = {
 
 int main(int argc, char *argv[])
 {
-	struct ivshmem mem;
 	struct mailbox m;
 	unsigned int uio_id = 0;
 	int i;
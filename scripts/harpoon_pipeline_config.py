@@ -0,0 +1,256 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 NXP
+#
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# Converts a JSON audio pipeline description to the binary format loaded by
+# "harpoon_ctrl pipeline -l <file>" (see common/libs/ctrl/hrpn_ctrl_audio_pipeline.h).
+#
+# The JSON description mirrors struct audio_pipeline_config, e.g:
+#
+# {
+#   "name": "Sine pipeline",
+#   "stages": [
+#     [
+#       { "type": "sine", "outputs": [0], "freq": 440, "amplitude": 0.5 },
+#       { "type": "sine", "outputs": [1], "freq": 880, "amplitude": 0.5 }
+#     ],
+#     [
+#       { "type": "sai_sink", "inputs": [0, 1],
+#         "sai": [ { "id": 5, "line": [ { "channel_n": 2 } ] } ] }
+#     ]
+#   ],
+#   "buffers": 2
+# }
+#
+# "buffers" and "storage" are either a count (default buffer storage and
+# storage periods) or a list (of buffer storage indexes, of storage periods).
+# "storage" defaults to one storage per buffer.
+#
+# A sai sink/source "sai" entry may set "sync_mode" (see SAI_SYNC_MODES), for a
+# sai not synchronous to the pipeline scheduling source (default "full").
+#
+# A sai "line" entry "channel_n" above 2 selects TDM mode (e.g TDM8, TDM16, up
+# to 16 channels per line). All the lines of a sai, sink and source, share the
+# same frame format so they must have the same "channel_n". Lines are selected
+# by "id" (default 0), e.g 32 channels on two TDM16 lines:
+#
+#   "sai": [ { "id": 3, "line": [ { "id": 0, "channel_n": 16 },
+#                                 { "id": 1, "channel_n": 16 } ] } ]
+#
+# The line fifo (128 words) must hold two fifo periods of all the line
+# channels, e.g a fifo period of up to 4 frames for TDM16, 8 frames for TDM8.
+# Larger periods (up to 1024 frames) are transferred a fifo period at a time,
+# from the sai interrupt, and require the "full" sync_mode.
+#
+# Usage: harpoon_pipeline_config.py <input.json> <output.bin>
+
+import json
+import struct
+import sys
+
+MAGIC = 0x4c505048
+VERSION = 2
+NAME_MAX = 32
+
+ELEMENT_TYPES = {
+    "dtmf": 0,
+    "routing": 1,
+    "sai_sink": 2,
+    "sai_source": 3,
+    "sine": 4,
+    "pll": 5,
+    "src": 6,
+    "asrc": 7,
+    "biquad": 8,
+    "fir": 9,
+    "mixer": 10,
+    "detector": 11,
+    "latency": 12,
+}
+
+
+# sai sink/source synchronization to the pipeline scheduling source
+SAI_SYNC_MODES = {
+    "full": 0,
+    "partial": 1,
+    "none": 2,
+}
+
+
+def pad4(data):
+    return data + b"\0" * (-len(data) % 4)
+
+
+def dtmf_params(e):
+    return pad4(struct.pack("<IIIId", e.get("us", 0), e.get("pause_us", 0),
+                            e.get("sequence_pause_us", 0), 0, e["amplitude"]) +
+                e["sequence"].encode() + b"\0")
+
+
+def pll_params(e):
+    return struct.pack("<III", e["src_sai_id"], e["dst_sai_id"], e["pll_id"])
+
+
+def sai_params(e):
+    data = struct.pack("<I", len(e["sai"]))
+
+    for sai in e["sai"]:
+        data += struct.pack("<III", sai["id"], len(sai["line"]),
+                            SAI_SYNC_MODES[sai.get("sync_mode", "full")])
+
+        for line in sai["line"]:
+            data += struct.pack("<II", line.get("id", 0), line["channel_n"])
+
+    return data
+
+
+def sine_params(e):
+    return struct.pack("<dd", e["freq"], e["amplitude"])
+
+
+def src_params(e):
+    return struct.pack("<II", e["input_rate"], e.get("taps", 0))
+
+
+def asrc_params(e):
+    return struct.pack("<IIII", e["src_sai_id"], e["dst_sai_id"], e.get("input_rate", 0), e.get("taps", 0))
+
+
+# "coef": list of [b0, b1, b2, a1, a2] (normalized, a0 = 1), either one per
+# section (same for all channels) or one per channel and section
+def biquad_params(e):
+    coef = e.get("coef", [])
+    data = struct.pack("<II", e["sections"], len(coef))
+
+    for c in coef:
+        data += struct.pack("<ddddd", *c)
+
+    return data
+
+
+def fir_params(e):
+    coef = e["coef"]
+
+    # a single filter for all channels, or one filter per channel
+    if coef and not isinstance(coef[0], list):
+        coef = [coef]
+
+    taps = len(coef[0])
+    data = struct.pack("<II", taps, len(coef))
+
+    for c in coef:
+        if len(c) != taps:
+            raise ValueError("fir filters must have the same number of taps")
+
+        data += struct.pack("<%df" % taps, *c)
+
+    return data
+
+
+def mixer_params(e):
+    gains = e.get("gains", [])
+    data = struct.pack("<I", len(gains))
+
+    # [input, output, linear gain] entries, others are 0
+    for g in gains:
+        data += struct.pack("<IId", *g)
+
+    return data
+
+
+def detector_params(e):
+    pilots = e.get("pilots", [])
+    data = struct.pack("<IIi", len(pilots), e.get("block", 0), e.get("threshold", 0))
+
+    # pilot tones frequencies, in Hz
+    data += struct.pack("<%dI" % len(pilots), *pilots)
+
+    return data
+
+
+def latency_params(e):
+    # 0 selects the element defaults
+    return struct.pack("<IId", e.get("interval_ms", 0), e.get("max_latency", 0), e.get("amplitude", 0.0))
+
+
+ELEMENT_PARAMS = {
+    "asrc": asrc_params,
+    "biquad": biquad_params,
+    "detector": detector_params,
+    "dtmf": dtmf_params,
+    "fir": fir_params,
+    "latency": latency_params,
+    "mixer": mixer_params,
+    "pll": pll_params,
+    "routing": lambda e: b"",
+    "sai_sink": sai_params,
+    "sai_source": sai_params,
+    "sine": sine_params,
+    "src": src_params,
+}
+
+
+def element(e):
+    inputs = e.get("inputs", [])
+    outputs = e.get("outputs", [])
+    params = ELEMENT_PARAMS[e["type"]](e)
+
+    data = struct.pack("<IIIIII", ELEMENT_TYPES[e["type"]], e.get("period", 0),
+                       e.get("sample_rate", 0), len(inputs), len(outputs), len(params))
+    data += struct.pack("<%dI" % len(inputs), *inputs)
+    data += struct.pack("<%dI" % len(outputs), *outputs)
+
+    return data + params
+
+
+def index_list(value):
+    if isinstance(value, int):
+        return [0] * value
+
+    return value
+
+
+def pipeline(p):
+    buffers = index_list(p["buffers"])
+    storage = index_list(p.get("storage", len(buffers)))
+
+    body = b""
+    for stage in p["stages"]:
+        body += struct.pack("<I", len(stage))
+
+        for e in stage:
+            body += element(e)
+
+    body += struct.pack("<%dI" % len(buffers), *buffers)
+    body += struct.pack("<%dI" % len(storage), *storage)
+
+    name = p.get("name", "").encode()[:NAME_MAX - 1]
+    checksum = sum(struct.unpack("<%dI" % (len(body) // 4), body)) & 0xffffffff
+    size = struct.calcsize("<IIII%dsIII" % NAME_MAX) + len(body)
+
+    header = struct.pack("<IIII%dsIII" % NAME_MAX, MAGIC, VERSION, size, checksum, name,
+                         len(p["stages"]), len(buffers), len(storage))
+
+    return header + body
+
+
+def main():
+    if len(sys.argv) != 3:
+        print("Usage: %s <input.json> <output.bin>" % sys.argv[0])
+        return 1
+
+    with open(sys.argv[1]) as f:
+        data = pipeline(json.load(f))
+
+    with open(sys.argv[2], "wb") as f:
+        f.write(data)
+
+    print("%s: %u bytes" % (sys.argv[2], len(data)))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())